@@ -96,10 +96,68 @@ typedef FSEventStreamEventFlags CDEventFlags;
  *
  * @return The URL of the item which changed.
  *
+ * @discussion Events delivered by <code>CDEvents</code> for the same path
+ * usually share one URL object, see
+ * <code>+[CDEvents setURLInterningCapacity:]</code>.
+ *
  * @since 1.0.0
  */
 @property (strong, readonly) NSURL	*URL;
 
+/**
+ * The URL the item was moved from, if the event is a move.
+ *
+ * Only set if the watcher pairs renames, see
+ * <code>-[CDEvents pairsRenames]</code>. The URL is then where the item was
+ * moved to, and the event has <code>isRenamed</code> set.
+ *
+ * @return The URL the item was moved from, or <code>nil</code> if the event is not a paired rename.
+ *
+ * @since head
+ */
+@property (strong, readonly) NSURL	*sourceURL;
+
+/**
+ * The number of the file system the item is on, see <code>NSFileSystemNumber</code>.
+ *
+ * Only set if the watcher tracks file identities, see
+ * <code>-[CDEvents tracksFileIdentities]</code>. Together with
+ * <code>fileSystemFileNumber</code> it identifies the item whatever its path.
+ *
+ * @return The number of the file system the item is on, or 0 if the identity of the item is unknown.
+ *
+ * @since head
+ */
+@property (readonly) unsigned long long	fileSystemNumber;
+
+/**
+ * The number of the item on its file system, its inode number, see <code>NSFileSystemFileNumber</code>.
+ *
+ * Only set if the watcher tracks file identities, see
+ * <code>-[CDEvents tracksFileIdentities]</code>. For a removed or renamed
+ * item it is the number last seen at the path.
+ *
+ * @return The number of the item on its file system, or 0 if the identity of the item is unknown.
+ *
+ * @since head
+ */
+@property (readonly) unsigned long long	fileSystemFileNumber;
+
+/**
+ * The hash of the contents of the file the event concerns.
+ *
+ * Only set if the watcher verifies contents, see
+ * <code>-[CDEvents contentVerificationSizeLimit]</code>. The hash is the
+ * XXH64 hash of the contents the file had when the event was delivered, so
+ * it can be compared with a hash kept by the client instead of reading the
+ * file again.
+ *
+ * @return The hash of the contents of the file, or 0 if it was not hashed.
+ *
+ * @since head
+ */
+@property (readonly) unsigned long long	contentHash;
+
 
 /** @name Getting Event Flags */
 /**
@@ -405,4 +463,48 @@ typedef FSEventStreamEventFlags CDEventFlags;
 					 URL:(NSURL *)URL
 				   flags:(CDEventFlags)flags;
 
+/**
+ * Returns an <code>CDEvent</code> object initialized with the given identifier, date, URLs and flags.
+ *
+ * @param identifier The identifier of the the event.
+ * @param date The date when the event occured.
+ * @param URL The URL of the item the event concerns, where it was moved to if the event is a move.
+ * @param sourceURL The URL the item was moved from, or <code>nil</code> if the event is not a move.
+ * @param flags The flags of the event.
+ * @return An <code>CDEvent</code> object initialized with the given identifier, date, URLs and flags.
+ * @see FSEventStreamEventFlags
+ *
+ * @since head
+ */
+- (id)initWithIdentifier:(NSUInteger)identifier
+					date:(NSDate *)date
+					 URL:(NSURL *)URL
+			   sourceURL:(NSURL *)sourceURL
+				   flags:(CDEventFlags)flags;
+
+/**
+ * Returns an <code>CDEvent</code> object initialized with the given identifier, date, URLs, file identity, content hash and flags.
+ *
+ * @param identifier The identifier of the the event.
+ * @param date The date when the event occured.
+ * @param URL The URL of the item the event concerns, where it was moved to if the event is a move.
+ * @param sourceURL The URL the item was moved from, or <code>nil</code> if the event is not a move.
+ * @param fileSystemNumber The number of the file system the item is on, or 0 if unknown.
+ * @param fileSystemFileNumber The number of the item on its file system, or 0 if unknown.
+ * @param contentHash The hash of the contents of the file, or 0 if it was not hashed.
+ * @param flags The flags of the event.
+ * @return An <code>CDEvent</code> object initialized with the given identifier, date, URLs, file identity, content hash and flags.
+ * @see FSEventStreamEventFlags
+ *
+ * @since head
+ */
+- (id)initWithIdentifier:(NSUInteger)identifier
+					date:(NSDate *)date
+					 URL:(NSURL *)URL
+			   sourceURL:(NSURL *)sourceURL
+		fileSystemNumber:(unsigned long long)fileSystemNumber
+	fileSystemFileNumber:(unsigned long long)fileSystemFileNumber
+			 contentHash:(unsigned long long)contentHash
+				   flags:(CDEventFlags)flags;
+
 @end
@@ -32,10 +32,14 @@
 @implementation CDEvent
 
 #pragma mark Properties
-@synthesize identifier	= _identifier;
-@synthesize date		= _date;
-@synthesize URL			= _URL;
-@synthesize flags		= _flags;
+@synthesize identifier				= _identifier;
+@synthesize date					= _date;
+@synthesize URL						= _URL;
+@synthesize sourceURL				= _sourceURL;
+@synthesize fileSystemNumber		= _fileSystemNumber;
+@synthesize fileSystemFileNumber	= _fileSystemFileNumber;
+@synthesize contentHash				= _contentHash;
+@synthesize flags					= _flags;
 
 
 #pragma mark Class object creators
@@ -57,12 +61,48 @@ - (id)initWithIdentifier:(NSUInteger)identifier
 					date:(NSDate *)date
 					 URL:(NSURL *)URL
 				   flags:(CDEventFlags)flags
+{
+	return [self initWithIdentifier:identifier
+							   date:date
+								URL:URL
+						  sourceURL:nil
+							  flags:flags];
+}
+
+- (id)initWithIdentifier:(NSUInteger)identifier
+					date:(NSDate *)date
+					 URL:(NSURL *)URL
+			   sourceURL:(NSURL *)sourceURL
+				   flags:(CDEventFlags)flags
+{
+	return [self initWithIdentifier:identifier
+							   date:date
+								URL:URL
+						  sourceURL:sourceURL
+				   fileSystemNumber:0
+			   fileSystemFileNumber:0
+						contentHash:0
+							  flags:flags];
+}
+
+- (id)initWithIdentifier:(NSUInteger)identifier
+					date:(NSDate *)date
+					 URL:(NSURL *)URL
+			   sourceURL:(NSURL *)sourceURL
+		fileSystemNumber:(unsigned long long)fileSystemNumber
+	fileSystemFileNumber:(unsigned long long)fileSystemFileNumber
+			 contentHash:(unsigned long long)contentHash
+				   flags:(CDEventFlags)flags
 {
 	if ((self = [super init])) {
-		_identifier	= identifier;
-		_flags		= flags;
-		_date		= date;
-		_URL		= URL;
+		_identifier				= identifier;
+		_flags					= flags;
+		_date					= date;
+		_URL					= URL;
+		_sourceURL				= sourceURL;
+		_fileSystemNumber		= fileSystemNumber;
+		_fileSystemFileNumber	= fileSystemFileNumber;
+		_contentHash			= contentHash;
 	}
 	
 	return self;
@@ -76,6 +116,10 @@ - (void)encodeWithCoder:(NSCoder *)aCoder
 	[aCoder encodeObject:[NSNumber numberWithUnsignedInteger:[self flags]] forKey:@"flags"];
 	[aCoder encodeObject:[self date] forKey:@"date"];
 	[aCoder encodeObject:[self URL] forKey:@"URL"];
+	[aCoder encodeObject:[self sourceURL] forKey:@"sourceURL"];
+	[aCoder encodeObject:[NSNumber numberWithUnsignedLongLong:[self fileSystemNumber]] forKey:@"fileSystemNumber"];
+	[aCoder encodeObject:[NSNumber numberWithUnsignedLongLong:[self fileSystemFileNumber]] forKey:@"fileSystemFileNumber"];
+	[aCoder encodeObject:[NSNumber numberWithUnsignedLongLong:[self contentHash]] forKey:@"contentHash"];
 }
 
 - (id)initWithCoder:(NSCoder *)aDecoder
@@ -83,6 +127,10 @@ - (id)initWithCoder:(NSCoder *)aDecoder
 	self = [self initWithIdentifier:[[aDecoder decodeObjectForKey:@"identifier"] unsignedIntegerValue]
 							   date:[aDecoder decodeObjectForKey:@"date"]
 								URL:[aDecoder decodeObjectForKey:@"URL"]
+						  sourceURL:[aDecoder decodeObjectForKey:@"sourceURL"]
+				   fileSystemNumber:[[aDecoder decodeObjectForKey:@"fileSystemNumber"] unsignedLongLongValue]
+			   fileSystemFileNumber:[[aDecoder decodeObjectForKey:@"fileSystemFileNumber"] unsignedLongLongValue]
+						contentHash:[[aDecoder decodeObjectForKey:@"contentHash"] unsignedLongLongValue]
 							  flags:[[aDecoder decodeObjectForKey:@"flags"] unsignedIntValue]];
 	
 	return self;
@@ -133,11 +181,15 @@ - (BOOL)name                                        \
 #pragma mark Misc
 - (NSString *)description
 {
-	return [NSString stringWithFormat:@"<%@: %p { identifier = %ld, URL = %@, flags = %ld, date = %@ }>",
+	return [NSString stringWithFormat:@"<%@: %p { identifier = %ld, URL = %@, sourceURL = %@, file = %llu:%llu, contentHash = %016llx, flags = %ld, date = %@ }>",
 			[self className],
 			self,
 			(unsigned long)[self identifier],
 			[self URL],
+			[self sourceURL],
+			[self fileSystemNumber],
+			[self fileSystemFileNumber],
+			[self contentHash],
 			(unsigned long)[self flags],
 			[self date]];
 }
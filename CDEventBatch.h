@@ -0,0 +1,160 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDEventBatch.h CDEvents/CDEventBatch.h
+ * A batch of compact event records delivered by CDEvents.
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "CDEvent.h"
+
+
+#pragma mark -
+#pragma mark CDEventBatch types
+/**
+ * A compact, plain record of an event.
+ *
+ * The path of the event is not part of the record but lives in the
+ * pathBuffer of the CDEventBatch the record belongs to, at
+ * <code>pathOffset</code>. Paths are standardized, in the file system
+ * representation and NUL terminated.
+ *
+ * @since head
+ */
+typedef struct {
+	/** The event identifier. */
+	CDEventIdentifier	identifier;
+	/** The event flags. */
+	CDEventFlags		flags;
+	/** An approximate time the event occured, in seconds since 1970. */
+	NSTimeInterval		timestamp;
+	/** The offset of the path in the path buffer of the batch. */
+	NSUInteger			pathOffset;
+	/** The length of the path in bytes, not counting the terminating NUL. */
+	NSUInteger			pathLength;
+	/** The offset of the path the item was moved from in the path buffer of the batch, if the event is a paired rename. */
+	NSUInteger			sourcePathOffset;
+	/** The length of the path the item was moved from in bytes, 0 unless the event is a paired rename. */
+	NSUInteger			sourcePathLength;
+	/** The number of the file system the item is on, 0 unless the watcher tracks file identities. */
+	uint64_t			fileSystemNumber;
+	/** The number of the item on its file system, 0 unless the watcher tracks file identities. */
+	uint64_t			fileSystemFileNumber;
+	/** The hash of the contents of the file, 0 unless the watcher verifies contents and hashed it. */
+	uint64_t			contentHash;
+} CDEventRecord;
+
+
+#pragma mark -
+#pragma mark CDEventBatch interface
+/**
+ * The events of one batch delivered by a <code>CDEvents</code> object, as compact records.
+ *
+ * The records and paths live in storage which is reused from one batch to
+ * the next, so delivering them allocates nothing. <code>CDEvent</code>
+ * objects are only created if asked for with eventAtIndex: or events.
+ *
+ * @note A batch is only valid for the duration of the block it is passed to.
+ * Do not keep a reference to it, its records or its path buffer; copy what you
+ * need or materialize the events instead. Once the block has returned the batch
+ * is empty.
+ *
+ * @see CDEventsRecordBlock
+ *
+ * @since head
+ */
+@interface CDEventBatch : NSObject {}
+
+/** @name Getting the Records */
+/**
+ * The number of events in the batch.
+ *
+ * @since head
+ */
+@property (readonly) NSUInteger				count;
+
+/**
+ * The records of the batch, <code>count</code> contiguous records.
+ *
+ * @since head
+ */
+@property (readonly) const CDEventRecord	*records;
+
+/**
+ * The buffer the path offsets of the records refer to.
+ *
+ * @since head
+ */
+@property (readonly) const char				*pathBuffer;
+
+/**
+ * Returns the file system representation of the path of the event at the given index.
+ *
+ * @param index The index of the event.
+ * @return The NUL terminated path, valid as long as the batch is.
+ *
+ * @since head
+ */
+- (const char *)fileSystemRepresentationAtIndex:(NSUInteger)index;
+
+/**
+ * Returns the file system representation of the path the item of the event at the given index was moved from.
+ *
+ * @param index The index of the event.
+ * @return The NUL terminated path, valid as long as the batch is, or <code>NULL</code> if the event is not a paired rename.
+ *
+ * @see -[CDEvents pairsRenames]
+ *
+ * @since head
+ */
+- (const char *)sourceFileSystemRepresentationAtIndex:(NSUInteger)index;
+
+/** @name Materializing Events */
+/**
+ * Returns a newly created <code>CDEvent</code> for the event at the given index.
+ *
+ * @param index The index of the event.
+ * @return The event.
+ * @throws NSRangeException if <em>index</em> is beyond the end of the batch.
+ *
+ * @since head
+ */
+- (CDEvent *)eventAtIndex:(NSUInteger)index;
+
+/**
+ * Returns newly created <code>CDEvent</code> objects for all events of the batch.
+ *
+ * @return An array of <code>CDEvent</code> objects, in the order they occurred.
+ *
+ * @since head
+ */
+- (NSArray *)events;
+
+@end
@@ -0,0 +1,194 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "CDEventBatchPrivate.h"
+
+#include <stddef.h>
+#include <mutex>
+
+#include "CDCorePathInternTable.h"
+
+// The records of the core are handed out as they are, without copying.
+static_assert(sizeof(CDEventRecord) == sizeof(cdevents::EventRecord),
+			  "CDEventRecord must match cdevents::EventRecord");
+static_assert(offsetof(CDEventRecord, identifier) == offsetof(cdevents::EventRecord, identifier) &&
+			  offsetof(CDEventRecord, flags) == offsetof(cdevents::EventRecord, flags) &&
+			  offsetof(CDEventRecord, timestamp) == offsetof(cdevents::EventRecord, timestamp) &&
+			  offsetof(CDEventRecord, pathOffset) == offsetof(cdevents::EventRecord, pathOffset) &&
+			  offsetof(CDEventRecord, pathLength) == offsetof(cdevents::EventRecord, pathLength) &&
+			  offsetof(CDEventRecord, sourcePathOffset) == offsetof(cdevents::EventRecord, sourcePathOffset) &&
+			  offsetof(CDEventRecord, sourcePathLength) == offsetof(cdevents::EventRecord, sourcePathLength) &&
+			  offsetof(CDEventRecord, fileSystemNumber) == offsetof(cdevents::EventRecord, fileIdentity) + offsetof(cdevents::FileIdentity, device) &&
+			  offsetof(CDEventRecord, fileSystemFileNumber) == offsetof(cdevents::EventRecord, fileIdentity) + offsetof(cdevents::FileIdentity, inode) &&
+			  offsetof(CDEventRecord, contentHash) == offsetof(cdevents::EventRecord, contentHash),
+			  "CDEventRecord must match cdevents::EventRecord");
+
+
+#pragma mark URL interning
+// The URLs of all events, shared by every watcher.
+static std::mutex &CDEventBatchURLTableMutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
+
+static cdevents::PathInternTable<NSURL *> &CDEventBatchURLTable()
+{
+	static cdevents::PathInternTable<NSURL *> table(CD_EVENTS_DEFAULT_URL_INTERNING_CAPACITY);
+	return table;
+}
+
+static NSURL *CDEventBatchURLForPath(const char *path, size_t length)
+{
+	std::lock_guard<std::mutex> lock(CDEventBatchURLTableMutex());
+	return CDEventBatchURLTable().valueForPath(path, length, [](const char *path, size_t length) {
+		NSString *eventPath = [[NSFileManager defaultManager] stringWithFileSystemRepresentation:path
+																						  length:length];
+		return [NSURL fileURLWithPath:eventPath];
+	});
+}
+
+
+@implementation CDEventBatch
+
+#pragma mark Properties
+@synthesize coreBatch	= _coreBatch;
+
+
+#pragma mark Materializing core records
++ (CDEvent *)eventWithRecord:(const cdevents::EventRecord &)record path:(const char *)path sourcePath:(const char *)sourcePath
+{
+	NSURL *eventURL		= CDEventBatchURLForPath(path, record.pathLength);
+	NSURL *sourceURL	= (sourcePath ? CDEventBatchURLForPath(sourcePath, record.sourcePathLength) : nil);
+	NSDate *eventDate	= [NSDate dateWithTimeIntervalSince1970:record.timestamp];
+	
+	return [[CDEvent alloc] initWithIdentifier:record.identifier
+										  date:eventDate
+										   URL:eventURL
+									 sourceURL:sourceURL
+							  fileSystemNumber:record.fileIdentity.device
+						  fileSystemFileNumber:record.fileIdentity.inode
+								   contentHash:record.contentHash
+										 flags:record.flags];
+}
+
+
++ (void)setURLInterningCapacity:(NSUInteger)capacity
+{
+	std::lock_guard<std::mutex> lock(CDEventBatchURLTableMutex());
+	CDEventBatchURLTable().setCapacity(capacity);
+}
+
++ (NSUInteger)URLInterningCapacity
+{
+	std::lock_guard<std::mutex> lock(CDEventBatchURLTableMutex());
+	return CDEventBatchURLTable().capacity();
+}
+
++ (CDEventsURLInterningStatistics)URLInterningStatistics
+{
+	std::lock_guard<std::mutex> lock(CDEventBatchURLTableMutex());
+	const cdevents::PathInternStatistics &counters = CDEventBatchURLTable().statistics();
+	
+	CDEventsURLInterningStatistics statistics;
+	statistics.hitCount			= counters.hits;
+	statistics.missCount		= counters.misses;
+	statistics.evictionCount	= counters.evictions;
+	statistics.count			= CDEventBatchURLTable().size();
+	
+	return statistics;
+}
+
+
+#pragma mark Records
+- (NSUInteger)count
+{
+	return (_coreBatch ? _coreBatch->size() : 0);
+}
+
+- (const CDEventRecord *)records
+{
+	return (_coreBatch ? reinterpret_cast<const CDEventRecord *>(_coreBatch->records()) : NULL);
+}
+
+- (const char *)pathBuffer
+{
+	return (_coreBatch ? _coreBatch->pathBuffer() : NULL);
+}
+
+- (const char *)fileSystemRepresentationAtIndex:(NSUInteger)index
+{
+	if (index >= [self count]) {
+		[NSException raise:NSRangeException
+					format:@"Index %lu beyond bounds of batch with %lu events.", (unsigned long)index, (unsigned long)[self count]];
+	}
+	
+	return _coreBatch->path(index);
+}
+
+- (const char *)sourceFileSystemRepresentationAtIndex:(NSUInteger)index
+{
+	if (index >= [self count]) {
+		[NSException raise:NSRangeException
+					format:@"Index %lu beyond bounds of batch with %lu events.", (unsigned long)index, (unsigned long)[self count]];
+	}
+	
+	return _coreBatch->sourcePath(index);
+}
+
+
+#pragma mark Materializing events
+- (CDEvent *)eventAtIndex:(NSUInteger)index
+{
+	const char *path = [self fileSystemRepresentationAtIndex:index];
+	
+	return [CDEventBatch eventWithRecord:(*_coreBatch)[index] path:path sourcePath:_coreBatch->sourcePath(index)];
+}
+
+- (NSArray *)events
+{
+	const NSUInteger count = [self count];
+	NSMutableArray *events = [NSMutableArray arrayWithCapacity:count];
+	for (NSUInteger i = 0; i < count; ++i) {
+		[events addObject:[self eventAtIndex:i]];
+	}
+	
+	return events;
+}
+
+
+#pragma mark Misc methods
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<%@: %p { count = %lu }>",
+			[self className],
+			self,
+			(unsigned long)[self count]];
+}
+
+@end
@@ -0,0 +1,58 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDEventBatchPrivate.h
+ * The interface between CDEventBatch and the CDEvents core, not public.
+ */
+
+#import "CDEventBatch.h"
+#import "CDEvents.h"
+
+#include "CDCoreEvent.h"
+
+@interface CDEventBatch ()
+
+/**
+ * The core batch the records are read from, or <code>NULL</code> outside of a delivery.
+ */
+@property (assign) const cdevents::EventBatch *coreBatch;
+
+/**
+ * Returns a newly created <code>CDEvent</code> for the given core record, path and source path (or <code>NULL</code>).
+ */
++ (CDEvent *)eventWithRecord:(const cdevents::EventRecord &)record path:(const char *)path sourcePath:(const char *)sourcePath;
+
+/**
+ * The table the URLs of the events created by eventWithRecord:path: are interned in, see CDEvents.
+ */
++ (void)setURLInterningCapacity:(NSUInteger)capacity;
++ (NSUInteger)URLInterningCapacity;
++ (CDEventsURLInterningStatistics)URLInterningStatistics;
+
+@end
@@ -39,6 +39,8 @@
 #import <CoreServices/CoreServices.h>
 
 #import "CDEvent.h"
+#import "CDEventBatch.h"
+#import "CDEventsCheckpointStore.h"
 
 @protocol CDEventsDelegate;
 
@@ -52,6 +54,120 @@
  */
 typedef FSEventStreamCreateFlags CDEventsEventStreamCreationFlags;
 
+/**
+ * The counters of the table the event URLs are interned in.
+ *
+ * @see URLInterningStatistics
+ *
+ * @since head
+ */
+typedef struct {
+	/** The number of events whose URL was found in the table. */
+	unsigned long long	hitCount;
+	/** The number of events whose URL had to be created. */
+	unsigned long long	missCount;
+	/** The number of URLs evicted from the table to make room for another one. */
+	unsigned long long	evictionCount;
+	/** The number of URLs currently in the table. */
+	NSUInteger			count;
+} CDEventsURLInterningStatistics;
+
+/**
+ * What a watcher with delivery threads does with a batch of events when its queue is full.
+ *
+ * @see overflowPolicy
+ *
+ * @since head
+ */
+typedef enum {
+	/** Hold up the event stream until there is room. FSEvents may then drop events, which are reported with <code>isUserDropped</code> set. */
+	kCDEventsOverflowPolicyBlock		= 0,
+	/** Drop the oldest queued batch to make room, and deliver an event with <code>mustRescanSubDirectories</code> and <code>isUserDropped</code> set for each watched URL after the batches queued before it. */
+	kCDEventsOverflowPolicyDropOldest	= 1,
+	/** Drop the batch, and deliver an event with <code>mustRescanSubDirectories</code> and <code>isUserDropped</code> set for each watched URL in its place. */
+	kCDEventsOverflowPolicyRescan		= 2
+} CDEventsOverflowPolicy;
+
+/**
+ * The counters of the queue between the event stream of a watcher and its delivery threads.
+ *
+ * @see deliveryQueueStatistics
+ *
+ * @since head
+ */
+typedef struct {
+	/** The number of batches waiting for a delivery thread. */
+	NSUInteger			depth;
+	/** The highest number of batches which have been waiting at once. */
+	NSUInteger			maximumDepth;
+	/** The number of batches queued. */
+	unsigned long long	queuedBatchCount;
+	/** The number of batches which had to wait for room in the queue. */
+	unsigned long long	blockedBatchCount;
+	/** The number of batches dropped because the queue was full. */
+	unsigned long long	droppedBatchCount;
+	/** The number of events in the dropped batches. */
+	unsigned long long	droppedEventCount;
+	/** The number of rescan events delivered in place of dropped batches. */
+	unsigned long long	rescanCount;
+} CDEventsDeliveryQueueStatistics;
+
+/**
+ * A summary of the time one stage of delivering events took, per batch of events.
+ *
+ * @see CDEventsMetrics
+ *
+ * @since head
+ */
+typedef struct {
+	/** The number of batches measured. */
+	unsigned long long	count;
+	/** The mean time, in nanoseconds. */
+	unsigned long long	meanNanoseconds;
+	/** The median time, in nanoseconds. */
+	unsigned long long	p50Nanoseconds;
+	/** The time 90% of the batches took less than, in nanoseconds. */
+	unsigned long long	p90Nanoseconds;
+	/** The time 99% of the batches took less than, in nanoseconds. */
+	unsigned long long	p99Nanoseconds;
+	/** The longest time, in nanoseconds. */
+	unsigned long long	maximumNanoseconds;
+} CDEventsLatencySummary;
+
+/**
+ * The counters of the events of a watcher and the time each stage of delivering them took.
+ *
+ * The percentiles are accurate to within an eighth.
+ *
+ * @see metrics
+ *
+ * @since head
+ */
+typedef struct {
+	/** The number of events reported by the event stream. */
+	unsigned long long		receivedEventCount;
+	/** The number of events ignored because they are in an excluded URL. */
+	unsigned long long		excludedEventCount;
+	/** The number of events ignored because they are in a sub-directory of a watched URL. */
+	unsigned long long		subDirectoryEventCount;
+	/** The number of events delivered to the block or delegate. */
+	unsigned long long		deliveredEventCount;
+	/** The number of batches of events delivered to the block or delegate. */
+	unsigned long long		deliveredBatchCount;
+	/** The number of events with <code>isUserDropped</code> or <code>isKernelDropped</code> set. */
+	unsigned long long		droppedEventReportCount;
+	/** The number of events with <code>mustRescanSubDirectories</code> set. */
+	unsigned long long		rescanRequestCount;
+	/** The time batches waited for a delivery thread. */
+	CDEventsLatencySummary	queueWaitLatency;
+	/** The time standardizing, filtering and coalescing the events of a batch took. */
+	CDEventsLatencySummary	filteringLatency;
+	/** The time creating the CDEvent objects of a batch took. */
+	CDEventsLatencySummary	eventConstructionLatency;
+	/** The time the block or delegate took with a batch. */
+	CDEventsLatencySummary	blockLatency;
+} CDEventsMetrics;
+
 
 #pragma mark -
 #pragma mark CDEvents custom exceptions
@@ -93,6 +209,20 @@ extern const CDEventsEventStreamCreationFlags kCDEventsDefaultEventStreamFlags;
  */
 extern const CDEventIdentifier kCDEventsSinceEventNow;
 
+/**
+ * The default number of event URLs kept in the interning table.
+ *
+ * @since head
+ */
+#define CD_EVENTS_DEFAULT_URL_INTERNING_CAPACITY		((NSUInteger)4096)
+
+/**
+ * The default number of batches which may wait for a delivery thread.
+ *
+ * @since head
+ */
+#define CD_EVENTS_DEFAULT_DELIVERY_QUEUE_CAPACITY		((NSUInteger)16)
+
 
 #pragma mark -
 #pragma mark CDEvents Block Type
@@ -104,6 +234,31 @@ extern const CDEventIdentifier kCDEventsSinceEventNow;
  */
 typedef void (^CDEventsEventBlock)(CDEvents *watcher, CDEvent *event);
 
+/**
+ * Type of the block which gets called with all events of a batch at once.
+ *
+ * The events are the filtered events of one batch delivered by the event
+ * stream, in the order they occurred.
+ *
+ * @param watcher The <code>CDEvents</code> object which the events were recieved thru.
+ * @param events An array of <code>CDEvent</code> objects.
+ *
+ * @since head
+ */
+typedef void (^CDEventsBatchBlock)(CDEvents *watcher, NSArray *events);
+
+/**
+ * Type of the block which gets called with the compact records of a batch of events.
+ *
+ * @param watcher The <code>CDEvents</code> object which the events were recieved thru.
+ * @param batch The records of the events, only valid until the block returns.
+ *
+ * @see CDEventBatch
+ *
+ * @since head
+ */
+typedef void (^CDEventsRecordBlock)(CDEvents *watcher, CDEventBatch *batch);
+
 
 #pragma mark -
 #pragma mark CDEvents interface
@@ -142,6 +297,24 @@ typedef void (^CDEventsEventBlock)(CDEvents *watcher, CDEvent *event);
  */
 @property (readonly) CDEventsEventBlock				eventBlock;
 
+/**
+ * The batch block.
+ *
+ * @return The CDEventsBatchBlock block which is executed with every batch of events, or <code>nil</code> if the events are delivered one by one to the eventBlock.
+ *
+ * @since head
+ */
+@property (readonly) CDEventsBatchBlock				batchBlock;
+
+/**
+ * The record block.
+ *
+ * @return The CDEventsRecordBlock block which is executed with the records of every batch of events, or <code>nil</code> if the events are delivered as <code>CDEvent</code> objects.
+ *
+ * @since head
+ */
+@property (readonly) CDEventsRecordBlock			recordBlock;
+
 /** @name Getting Event Watcher Properties */
 /**
  * The (approximate) time intervall between notifications sent to the delegate.
@@ -166,6 +339,9 @@ typedef void (^CDEventsEventBlock)(CDEvents *watcher, CDEvent *event);
  *
  * @return The last event that occured and has been delivered to the delegate.
  *
+ * @discussion When events are delivered as records the event object is only
+ * created once this property is read.
+ *
  * @since 1.0.0
  */
 @property (strong, readonly) CDEvent				*lastEvent;
@@ -191,6 +367,54 @@ typedef void (^CDEventsEventBlock)(CDEvents *watcher, CDEvent *event);
  */
 @property (copy) NSArray							*excludedURLs;
 
+/**
+ * Patterns of the paths that we should ignore events from.
+ *
+ * Each pattern is a <code>NSString</code> written like a line of a
+ * <code>.gitignore</code> file: <code>*</code>, <code>?</code> and
+ * <code>[...]</code> match within a path component and <code>**</code> any
+ * number of components. A pattern starting with <code>/</code> is matched
+ * against the whole path, any other against its trailing components, and a
+ * pattern matching a directory matches everything in it too. Patterns
+ * prefixed with <code>re:</code> are extended regular expressions searched
+ * for in the path instead. A pattern prefixed with <code>!</code> includes
+ * the paths it matches again, and the last matching pattern decides.
+ *
+ * The patterns are compiled into a single automaton, so every path is
+ * matched against all of them in one pass before any <code>CDEvent</code>
+ * is created for it.
+ *
+ * @return An array of <code>NSString</code> objects for the patterns of the paths which we want to ignore.
+ *
+ * @throws NSInvalidArgumentException if a pattern is malformed.
+ *
+ * @see excludedURLs
+ *
+ * @since head
+ */
+@property (copy) NSArray							*excludedPatterns;
+
+/**
+ * Whether to ignore events according to the <code>.gitignore</code> and <code>.ignore</code> files in the watched URLs.
+ *
+ * The ignore files of a directory are read and compiled the first time an
+ * event occurs beneath it, and read again when an event tells that they
+ * changed, so the events they ignore are dropped before any
+ * <code>CDEvent</code> is created for them. The deepest directory with a
+ * pattern matching a path decides whether it is ignored, and within a
+ * directory <code>.ignore</code> takes precedence over
+ * <code>.gitignore</code>. Ignore files outside the watched URLs and the
+ * global git excludes are not read.
+ *
+ * @param flag Whether to honor the ignore files, <code>NO</code> by default.
+ * @return Whether the ignore files are honored.
+ *
+ * @see excludedPatterns
+ *
+ * @since head
+ */
+@property (assign) BOOL								honorsIgnoreFiles;
+
 /**
  * Wheter events from sub-directories of the watched URLs should be ignored or not.
  *
@@ -201,6 +425,315 @@ typedef void (^CDEventsEventBlock)(CDEvents *watcher, CDEvent *event);
  */
 @property (assign) BOOL								ignoreEventsFromSubDirectories;
 
+/**
+ * The time window within which events for the same URL are merged into one.
+ *
+ * During bulk operations an item typically gets a creation, several
+ * modifications and metadata changes within milliseconds. With a window set,
+ * all the events for one URL in a window are delivered as a single event
+ * whose flags are the combination of their flags. A removal or rename ends
+ * the events merged for a URL, so an item created and then removed is
+ * reported as one event with both flags, while an item removed and then
+ * created again is reported as a removal followed by a creation.
+ *
+ * Events are only merged within one batch of the event stream, so the
+ * notification latency is raised to at least the window. Setting the window
+ * recreates the event stream, resuming from the last delivered event.
+ *
+ * @param window The window in seconds, <code>0</code> (the default) to deliver every event.
+ * @return The window in seconds.
+ *
+ * @since head
+ */
+@property (assign) CFTimeInterval					coalescingWindow;
+
+/**
+ * Whether the two halves of a move are delivered as one event.
+ *
+ * The event stream reports a move as two events with <code>isRenamed</code>
+ * set, one for where the item was and one for where it went, so a moved
+ * directory looks like a removal of one tree and the creation of another.
+ * With renames paired the two are delivered as one event, for the
+ * destination, with the source in <code>sourceURL</code>. The halves are
+ * paired by the cookie of the move where the platform has one (inotify), and
+ * otherwise by their identifiers following each other (FSEvents), telling
+ * source from destination by which of the two still exists.
+ *
+ * Only halves delivered in the same batch are paired, a move into or out of
+ * the watched URLs, or one whose other half is ignored, is delivered as the
+ * single <code>isRenamed</code> event it was. Requires file-level events.
+ * Setting the property recreates the event stream, resuming from the last
+ * delivered event.
+ *
+ * @param flag Whether to pair renames, <code>NO</code> by default.
+ * @return Whether renames are paired.
+ *
+ * @see -[CDEvent sourceURL]
+ *
+ * @since head
+ */
+@property (assign) BOOL								pairsRenames;
+
+/**
+ * Whether events carry the file identity of their item, which is used to recognize moves and atomic saves.
+ *
+ * Editors save a file by writing a temporary file and renaming it over the
+ * original, which the event stream reports as a creation, a rename and
+ * sometimes a removal on different paths. With file identities tracked the
+ * watcher reads the file system and file numbers of the item of every event
+ * once, keeps a bounded map between identities and the paths they were last
+ * seen at, and delivers such a save as one <code>isModified</code> event for
+ * the saved file. An item which turns up with the identity last seen at a
+ * path it has since left is delivered as a move, with
+ * <code>sourceURL</code> set, even if the halves of the rename were not
+ * paired by <code>pairsRenames</code>.
+ *
+ * A save is only recognized if the temporary file was created within the
+ * same batch, that is within the notification latency. Requires file-level
+ * events. Setting the property recreates the event stream, resuming from
+ * the last delivered event.
+ *
+ * @param flag Whether to track file identities, <code>NO</code> by default.
+ * @return Whether file identities are tracked.
+ *
+ * @see -[CDEvent fileSystemFileNumber]
+ *
+ * @since head
+ */
+@property (assign) BOOL								tracksFileIdentities;
+
+/**
+ * The size, in bytes, up to which the contents of modified files are verified to have changed, 0 to deliver every modification.
+ *
+ * Touching a file, or a build tool writing the same output again, is
+ * reported as a modification although the contents did not change. With a
+ * size limit the watcher hashes every file of at most that many bytes an
+ * event concerns, on a pool of one thread per processor, remembers the hash
+ * of each path and drops the events which only say a file or its inode
+ * metadata was modified when the file has the same size and hash as the
+ * last time. The delivered events carry the hash in
+ * <code>contentHash</code>.
+ *
+ * The first modification of a file the watcher has not hashed yet is always
+ * delivered. Requires file-level events. Setting the property forgets the
+ * hashes and recreates the event stream, resuming from the last delivered
+ * event.
+ *
+ * @param sizeLimit The size up to which files are verified, 0 (no verification) by default.
+ * @return The size up to which files are verified.
+ *
+ * @see -[CDEvent contentHash]
+ *
+ * @since head
+ */
+@property (assign) unsigned long long				contentVerificationSizeLimit;
+
+/** @name Adaptive Latency */
+/**
+ * The lowest notification latency the watcher may use when events are sparse.
+ *
+ * With a minimum set, the latency adapts to the load: while events are
+ * sparse they are delivered after the minimum latency, for example 0.05
+ * seconds for interactive use. When a burst makes the batches large, the
+ * latency is doubled, up to notificationLatency, so that fewer and larger
+ * batches amortize the cost of each delivery, and it drops back to the
+ * minimum once the burst is over. FSEvents cannot change the latency of an
+ * event stream, so the event stream is recreated from the last event it
+ * delivered whenever the latency changes; no events are lost or repeated.
+ * Setting the property recreates the event stream, resuming from the last
+ * delivered event.
+ *
+ * @param latency The minimum latency in seconds, <code>0</code> (the default) to always use notificationLatency.
+ * @return The minimum latency in seconds.
+ *
+ * @see currentNotificationLatency
+ *
+ * @since head
+ */
+@property (assign) CFTimeInterval					minimumNotificationLatency;
+
+/**
+ * The notification latency the event stream currently uses.
+ *
+ * @return The latency in seconds, between minimumNotificationLatency and notificationLatency.
+ *
+ * @since head
+ */
+@property (readonly) CFTimeInterval					currentNotificationLatency;
+
+/** @name Slow Consumers */
+/**
+ * What the watcher does with a batch of events when its delivery threads fall behind.
+ *
+ * A watcher with delivery threads hands each batch from the event stream to
+ * them through a bounded lock-free queue. With the default policy, a full
+ * queue holds up the event stream until the block or delegate catches up,
+ * after which FSEvents itself may drop events. The other policies keep the
+ * event stream going instead, dropping either the oldest batch or the
+ * batches which do not fit, and deliver a request to rescan in their place,
+ * which a watcher maintaining a snapshot answers with the precise changes.
+ *
+ * Only applies to watchers created with delivery threads. Setting the
+ * property recreates the event stream, resuming from the last delivered
+ * event.
+ *
+ * @param policy The overflow policy, kCDEventsOverflowPolicyBlock by default.
+ * @return The overflow policy.
+ *
+ * @see deliveryQueueCapacity
+ * @see deliveryQueueStatistics
+ *
+ * @since head
+ */
+@property (assign) CDEventsOverflowPolicy			overflowPolicy;
+
+/**
+ * The number of batches of events which may wait for a delivery thread before the overflow policy applies.
+ *
+ * Setting the property recreates the event stream, resuming from the last delivered event.
+ *
+ * @param capacity The capacity of the queue, CD_EVENTS_DEFAULT_DELIVERY_QUEUE_CAPACITY by default.
+ * @return The capacity of the queue.
+ *
+ * @see overflowPolicy
+ *
+ * @since head
+ */
+@property (assign) NSUInteger						deliveryQueueCapacity;
+
+/**
+ * The counters of the queue to the delivery threads, read without stopping the event stream.
+ *
+ * All zero for watchers without delivery threads or sharing an event stream.
+ * The counters start over when the event stream is recreated.
+ *
+ * @return The counters of the queue.
+ *
+ * @see overflowPolicy
+ *
+ * @since head
+ */
+@property (readonly) CDEventsDeliveryQueueStatistics	deliveryQueueStatistics;
+
+/** @name Metrics */
+/**
+ * Whether the watcher counts its events and measures how long delivering them takes.
+ *
+ * Measuring costs a few clock reads and atomic additions per batch of
+ * events, and never takes a lock, so it may be left on in production. The
+ * time is measured from when the event stream hands over a batch; FSEvents
+ * does not tell when the kernel saw the events. Counters and times carry
+ * over when the event stream is recreated, and start over when the
+ * property is set again after being cleared. Setting the property
+ * recreates the event stream, resuming from the last delivered event.
+ *
+ * @param flag Whether to measure, <code>NO</code> by default.
+ * @return <code>YES</code> if the watcher measures itself, otherwise <code>NO</code>.
+ *
+ * @see metrics
+ *
+ * @since head
+ */
+@property (assign) BOOL								metricsEnabled;
+
+/**
+ * The counters and latencies of the watcher, read without stopping the event stream.
+ *
+ * All zero unless metricsEnabled is set.
+ *
+ * @return The metrics of the watcher.
+ *
+ * @see metricsEnabled
+ *
+ * @since head
+ */
+@property (readonly) CDEventsMetrics				metrics;
+
+/** @name Recording Events */
+/**
+ * The file the watcher records every batch of the event stream to.
+ *
+ * The paths, flags and identifiers of the events are recorded as the event
+ * stream hands them over, before any of them are ignored, together with the
+ * time each batch arrived at. The log is compact, a few bytes per event, and
+ * can be played back through the same filtering and delivery, at the
+ * recorded pace or as fast as possible, with
+ * <code>cdevents::PlaybackBackend</code> or <code>CDEventsTestTool -P</code>.
+ * Use it to reproduce an event storm, or a slow block, away from the machine
+ * it happened on.
+ *
+ * Setting the property truncates the file and recreates the event stream,
+ * resuming from the last delivered event. The log is complete once the
+ * property is cleared or the watcher is deallocated.
+ *
+ * @param URL The file URL of the log, or <code>nil</code> (the default) to not record.
+ * @return The file URL of the log.
+ *
+ * @throws NSInvalidArgumentException if the file could not be created.
+ *
+ * @since head
+ */
+@property (copy) NSURL								*recordingURL;
+
+/** @name Precise Rescans */
+/**
+ * Whether the watcher keeps a snapshot of the watched trees to answer rescans with.
+ *
+ * Events with <code>mustRescanSubDirectories</code>, <code>isUserDropped</code>
+ * or <code>isKernelDropped</code> set tell you that events were lost and that
+ * you must compare the affected directory with what you knew about it. A
+ * watcher maintaining a snapshot of the inode, size and modification time of
+ * every item does that for you: it walks only the affected directory and
+ * delivers a creation, removal or modification event for each difference
+ * instead. The snapshot is kept current with the events delivered.
+ *
+ * Building the snapshot walks the watched trees once, when the event stream
+ * is created. Setting the property recreates the event stream, resuming
+ * from the last delivered event.
+ *
+ * @param flag Whether to maintain a snapshot, <code>NO</code> by default.
+ * @return <code>YES</code> if the watcher maintains a snapshot, otherwise <code>NO</code>.
+ *
+ * @see snapshotURL
+ *
+ * @since head
+ */
+@property (assign) BOOL								maintainsSnapshot;
+
+/**
+ * The file the snapshot is kept in between runs.
+ *
+ * The snapshot is read from the file when the watcher starts maintaining it,
+ * so set the URL first, and written to it whenever the event stream is
+ * disposed of. The file is mapped into memory rather than read, so even the
+ * snapshot of a large tree is available without walking it again.
+ *
+ * @param URL The file URL of the snapshot, or <code>nil</code> (the default) to keep it in memory only.
+ * @return The file URL of the snapshot.
+ *
+ * @since head
+ */
+@property (copy) NSURL								*snapshotURL;
+
+/** @name Resuming After a Restart */
+/**
+ * The store the watcher records the last delivered event in.
+ *
+ * @return The checkpoint store, or <code>nil</code> if the watcher keeps no checkpoint.
+ *
+ * @since head
+ */
+@property (strong, readonly) CDEventsCheckpointStore	*checkpointStore;
+
+/**
+ * The key of the watcher in its checkpoint store.
+ *
+ * @return The key, or <code>nil</code> if the watcher keeps no checkpoint.
+ *
+ * @since head
+ */
+@property (copy, readonly) NSString					*checkpointKey;
+
 
 #pragma mark Event identifier class methods
 /** @name Current Event Identifier */
@@ -216,6 +749,87 @@ typedef void (^CDEventsEventBlock)(CDEvents *watcher, CDEvent *event);
 + (CDEventIdentifier)currentEventIdentifier;
 
 
+#pragma mark Sharing event streams class methods
+/** @name Sharing Event Streams */
+/**
+ * Sets whether <code>CDEvents</code> objects created from now on share event streams.
+ *
+ * Each event stream costs the kernel and the <code>fseventsd</code> daemon
+ * resources of their own. When sharing is enabled, watchers asking for events
+ * since now which are scheduled on the same run loop or dispatch queue, with
+ * the same notification latency, creation flags and at most one delivery
+ * thread, subscribe to one shared event stream instead of creating their own.
+ * The shared stream watches the union of their URLs; every watcher still only
+ * gets the events of its own URLs, filtered with its own excluded URLs.
+ *
+ * When a watcher is added for URLs the shared stream does not cover yet, the
+ * stream changes its watched paths in place, dropping those of watchers gone
+ * meanwhile, rather than being recreated. No event of the URLs watched
+ * throughout is lost or delivered twice, and the added URLs are reported
+ * from the moment they are watched.
+ *
+ * @param flag Whether event streams should be shared. The default is <code>NO</code>.
+ *
+ * @see sharesEventStreams
+ *
+ * @since head
+ */
++ (void)setSharesEventStreams:(BOOL)flag;
+
+/**
+ * Whether <code>CDEvents</code> objects created from now on share event streams.
+ *
+ * @return <code>YES</code> if event streams are shared, otherwise <code>NO</code>.
+ *
+ * @see setSharesEventStreams:
+ *
+ * @since head
+ */
++ (BOOL)sharesEventStreams;
+
+
+#pragma mark URL interning class methods
+/** @name Interning Event URLs */
+/**
+ * Sets the number of event URLs kept in the interning table.
+ *
+ * Events for a path which is in the table share one <code>NSURL</code>
+ * object, so the URLs of repeated events can be compared by pointer and
+ * creating them allocates nothing. When the table is full the least recently
+ * used URL is evicted. Setting the capacity empties the table but keeps its
+ * counters.
+ *
+ * @param capacity The maximum number of URLs in the table, <code>0</code> disables interning. The default is CD_EVENTS_DEFAULT_URL_INTERNING_CAPACITY.
+ *
+ * @see URLInterningStatistics
+ *
+ * @since head
+ */
++ (void)setURLInterningCapacity:(NSUInteger)capacity;
+
+/**
+ * The number of event URLs kept in the interning table.
+ *
+ * @return The maximum number of URLs in the table.
+ *
+ * @see setURLInterningCapacity:
+ *
+ * @since head
+ */
++ (NSUInteger)URLInterningCapacity;
+
+/**
+ * The counters of the interning table, shared by all <code>CDEvents</code> objects.
+ *
+ * @return The hit, miss and eviction counts and the number of URLs in the table.
+ *
+ * @discussion A high eviction count relative to the hit count means the capacity is too small for the working set of paths.
+ *
+ * @since head
+ */
++ (CDEventsURLInterningStatistics)URLInterningStatistics;
+
+
 #pragma mark Creating CDEvents Objects With a Delegate
 /** @name Creating CDEvents Objects With a Delegate */
 /**
@@ -412,6 +1026,389 @@ ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
 	   excludeURLs:(NSArray *)exludeURLs
 streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags;
 
+#pragma mark Creating CDEvents Objects With a Batch Block
+/** @name Creating CDEvents Objects With a Batch Block */
+/**
+ * Returns an <code>CDEvents</code> object initialized with the given URLs to watch which delivers events in batches.
+ *
+ * @param URLs An array of URLs we want to watch.
+ * @param block The block which the CDEvents object executes with every batch of events it recieves.
+ * @return An CDEvents object initialized with the given URLs to watch.
+ * @throws NSInvalidArgumentException if <em>URLs</em> is empty or points to <code>nil</code>.
+ * @throws NSInvalidArgumentException if <em>block</em>is <code>nil</code>.
+ * @throws CDEventsEventStreamCreationFailureException if we failed to create a event stream.
+ *
+ * @see initWithURLs:batchBlock:onRunLoop:
+ * @see initWithURLs:batchBlock:onRunLoop:sinceEventIdentifier:notificationLantency:ignoreEventsFromSubDirs:excludeURLs:streamCreationFlags:
+ * @see CDEventsBatchBlock
+ *
+ * @discussion Calls initWithURLs:batchBlock:onRunLoop:sinceEventIdentifier:notificationLantency:ignoreEventsFromSubDirs:excludeURLs:streamCreationFlags:
+ * with the same defaults as initWithURLs:block: and schedueled on the current
+ * run loop.
+ *
+ * @since head
+ */
+- (id)initWithURLs:(NSArray *)URLs batchBlock:(CDEventsBatchBlock)block;
+
+/**
+ * Returns an <code>CDEvents</code> object initialized with the given URLs to watch which delivers events in batches and schedules the watcher on the given run loop.
+ *
+ * @param URLs An array of URLs we want to watch.
+ * @param block The block which the CDEvents object executes with every batch of events it recieves.
+ * @param runLoop The run loop which the which the watcher should be schedueled on.
+ * @return An CDEvents object initialized with the given URLs to watch.
+ * @throws NSInvalidArgumentException if <em>URLs</em> is empty or points to <code>nil</code>.
+ * @throws NSInvalidArgumentException if <em>block</em>is <code>nil</code>.
+ * @throws CDEventsEventStreamCreationFailureException if we failed to create a event stream.
+ *
+ * @see initWithURLs:batchBlock:
+ * @see initWithURLs:batchBlock:onRunLoop:sinceEventIdentifier:notificationLantency:ignoreEventsFromSubDirs:excludeURLs:streamCreationFlags:
+ * @see CDEventsBatchBlock
+ *
+ * @since head
+ */
+- (id)initWithURLs:(NSArray *)URLs
+		batchBlock:(CDEventsBatchBlock)block
+		 onRunLoop:(NSRunLoop *)runLoop;
+
+/**
+ * Returns an <code>CDEvents</code> object initialized with the given URLs to watch, URLs to exclude, whether events from sub-directories are ignored or not which delivers events in batches and schedules the watcher on the given run loop.
+ *
+ * @param URLs An array of URLs (<code>NSURL</code>) we want to watch.
+ * @param block The block which the CDEvents object executes with every batch of events it recieves.
+ * @param runLoop The run loop which the which the watcher should be schedueled on.
+ * @param sinceEventIdentifier Events that have happened after the given event identifier will be supplied.
+ * @param notificationLatency The (approximate) time intervall between notifications sent to the block.
+ * @param ignoreEventsFromSubDirs Wheter events from sub-directories of the watched URLs should be ignored or not.
+ * @param exludeURLs An array of URLs that we should ignore events from. Pass <code>nil</code> if none should be excluded.
+ * @param streamCreationFlags The event stream creation flags.
+ * @return An CDEvents object initialized with the given URLs to watch, URLs to exclude, whether events from sub-directories are ignored or not and run on the given run loop.
+ * @throws NSInvalidArgumentException if the parameter URLs is empty or points to <code>nil</code>.
+ * @throws NSInvalidArgumentException if <em>block</em>is <code>nil</code>.
+ * @throws CDEventsEventStreamCreationFailureException if we failed to create a event stream.
+ *
+ * @see initWithURLs:batchBlock:
+ * @see initWithURLs:batchBlock:onRunLoop:
+ * @see CDEventsBatchBlock
+ *
+ * @discussion The block is called once for each batch delivered by the
+ * event stream instead of once per event, with all of its events that were
+ * not filtered out. Batches where every event was filtered out are not
+ * delivered at all.
+ *
+ * @since head
+ */
+- (id)initWithURLs:(NSArray *)URLs
+		batchBlock:(CDEventsBatchBlock)block
+		 onRunLoop:(NSRunLoop *)runLoop
+sinceEventIdentifier:(CDEventIdentifier)sinceEventIdentifier
+notificationLantency:(CFTimeInterval)notificationLatency
+ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
+	   excludeURLs:(NSArray *)exludeURLs
+streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags;
+
+#pragma mark Creating CDEvents Objects With a Record Block
+/** @name Creating CDEvents Objects With a Record Block */
+/**
+ * Returns an <code>CDEvents</code> object initialized with the given URLs to watch which delivers events as compact records.
+ *
+ * @param URLs An array of URLs we want to watch.
+ * @param block The block which the CDEvents object executes with the records of every batch of events it recieves.
+ * @return An CDEvents object initialized with the given URLs to watch.
+ * @throws NSInvalidArgumentException if <em>URLs</em> is empty or points to <code>nil</code>.
+ * @throws NSInvalidArgumentException if <em>block</em>is <code>nil</code>.
+ * @throws CDEventsEventStreamCreationFailureException if we failed to create a event stream.
+ *
+ * @see initWithURLs:recordBlock:onRunLoop:
+ * @see initWithURLs:recordBlock:onRunLoop:sinceEventIdentifier:notificationLantency:ignoreEventsFromSubDirs:excludeURLs:streamCreationFlags:
+ * @see CDEventsRecordBlock
+ *
+ * @discussion Calls initWithURLs:recordBlock:onRunLoop:sinceEventIdentifier:notificationLantency:ignoreEventsFromSubDirs:excludeURLs:streamCreationFlags:
+ * with the same defaults as initWithURLs:block: and schedueled on the current
+ * run loop.
+ *
+ * @since head
+ */
+- (id)initWithURLs:(NSArray *)URLs recordBlock:(CDEventsRecordBlock)block;
+
+/**
+ * Returns an <code>CDEvents</code> object initialized with the given URLs to watch which delivers events as compact records and schedules the watcher on the given run loop.
+ *
+ * @param URLs An array of URLs we want to watch.
+ * @param block The block which the CDEvents object executes with the records of every batch of events it recieves.
+ * @param runLoop The run loop which the which the watcher should be schedueled on.
+ * @return An CDEvents object initialized with the given URLs to watch.
+ * @throws NSInvalidArgumentException if <em>URLs</em> is empty or points to <code>nil</code>.
+ * @throws NSInvalidArgumentException if <em>block</em>is <code>nil</code>.
+ * @throws CDEventsEventStreamCreationFailureException if we failed to create a event stream.
+ *
+ * @see initWithURLs:recordBlock:
+ * @see initWithURLs:recordBlock:onRunLoop:sinceEventIdentifier:notificationLantency:ignoreEventsFromSubDirs:excludeURLs:streamCreationFlags:
+ * @see CDEventsRecordBlock
+ *
+ * @since head
+ */
+- (id)initWithURLs:(NSArray *)URLs
+	   recordBlock:(CDEventsRecordBlock)block
+		 onRunLoop:(NSRunLoop *)runLoop;
+
+/**
+ * Returns an <code>CDEvents</code> object initialized with the given URLs to watch, URLs to exclude, whether events from sub-directories are ignored or not which delivers events as compact records and schedules the watcher on the given run loop.
+ *
+ * @param URLs An array of URLs (<code>NSURL</code>) we want to watch.
+ * @param block The block which the CDEvents object executes with the records of every batch of events it recieves.
+ * @param runLoop The run loop which the which the watcher should be schedueled on.
+ * @param sinceEventIdentifier Events that have happened after the given event identifier will be supplied.
+ * @param notificationLatency The (approximate) time intervall between notifications sent to the block.
+ * @param ignoreEventsFromSubDirs Wheter events from sub-directories of the watched URLs should be ignored or not.
+ * @param exludeURLs An array of URLs that we should ignore events from. Pass <code>nil</code> if none should be excluded.
+ * @param streamCreationFlags The event stream creation flags.
+ * @return An CDEvents object initialized with the given URLs to watch, URLs to exclude, whether events from sub-directories are ignored or not and run on the given run loop.
+ * @throws NSInvalidArgumentException if the parameter URLs is empty or points to <code>nil</code>.
+ * @throws NSInvalidArgumentException if <em>block</em>is <code>nil</code>.
+ * @throws CDEventsEventStreamCreationFailureException if we failed to create a event stream.
+ *
+ * @see initWithURLs:recordBlock:
+ * @see initWithURLs:recordBlock:onRunLoop:
+ * @see CDEventsRecordBlock
+ * @see CDEventBatch
+ *
+ * @discussion No objects are created per event: the block gets the records
+ * of each batch in storage that is reused for every batch, and
+ * <code>CDEvent</code> objects are only created when asked for through
+ * the batch. Use this for watchers which receive a lot of events.
+ *
+ * @since head
+ */
+- (id)initWithURLs:(NSArray *)URLs
+	   recordBlock:(CDEventsRecordBlock)block
+		 onRunLoop:(NSRunLoop *)runLoop
+sinceEventIdentifier:(CDEventIdentifier)sinceEventIdentifier
+notificationLantency:(CFTimeInterval)notificationLatency
+ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
+	   excludeURLs:(NSArray *)exludeURLs
+streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags;
+
+#pragma mark Creating CDEvents Objects on a Dispatch Queue
+/** @name Creating CDEvents Objects on a Dispatch Queue */
+/*
+ * The watchers created by these methods never use a run loop. The event
+ * stream is scheduled on the given dispatch queue, where the events are
+ * filtered and the block is executed, unless a number of delivery threads is
+ * given. In that case every batch is handed to one of a pool of that many
+ * threads, which filters it and executes the block, and the stream holds back
+ * new batches while more than a few are waiting. With more than one delivery
+ * thread the block is executed concurrently and batches may arrive out of
+ * order.
+ */
+/**
+ * Returns an <code>CDEvents</code> object initialized with the given URLs to watch, URLs to exclude, whether events from sub-directories are ignored or not which delivers events one by one and schedules the watcher on the given dispatch queue.
+ *
+ * @param URLs An array of URLs (<code>NSURL</code>) we want to watch.
+ * @param block The block which the CDEvents object executes for every event it recieves.
+ * @param queue The dispatch queue the event stream should be scheduled on, preferably a serial queue.
+ * @param deliveryThreadCount The number of threads filtering the events and executing the block, <code>0</code> to do so on <em>queue</em>.
+ * @param sinceEventIdentifier Events that have happened after the given event identifier will be supplied.
+ * @param notificationLatency The (approximate) time intervall between notifications sent to the block.
+ * @param ignoreEventsFromSubDirs Wheter events from sub-directories of the watched URLs should be ignored or not.
+ * @param exludeURLs An array of URLs that we should ignore events from. Pass <code>nil</code> if none should be excluded.
+ * @param streamCreationFlags The event stream creation flags.
+ * @return An CDEvents object initialized with the given URLs to watch, URLs to exclude, whether events from sub-directories are ignored or not and run on the given dispatch queue.
+ * @throws NSInvalidArgumentException if the parameter URLs is empty or points to <code>nil</code>.
+ * @throws NSInvalidArgumentException if <em>block</em> or <em>queue</em> is <code>nil</code>.
+ * @throws CDEventsEventStreamCreationFailureException if we failed to create a event stream.
+ *
+ * @see CDEventsEventBlock
+ * @see FSEventStreamSetDispatchQueue
+ *
+ * @since head
+ */
+- (id)initWithURLs:(NSArray *)URLs
+			 block:(CDEventsEventBlock)block
+   onDispatchQueue:(dispatch_queue_t)queue
+deliveryThreadCount:(NSUInteger)deliveryThreadCount
+sinceEventIdentifier:(CDEventIdentifier)sinceEventIdentifier
+notificationLantency:(CFTimeInterval)notificationLatency
+ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
+	   excludeURLs:(NSArray *)exludeURLs
+streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags;
+
+/**
+ * Returns an <code>CDEvents</code> object initialized with the given URLs to watch, URLs to exclude, whether events from sub-directories are ignored or not which delivers events in batches and schedules the watcher on the given dispatch queue.
+ *
+ * @param URLs An array of URLs (<code>NSURL</code>) we want to watch.
+ * @param block The block which the CDEvents object executes with every batch of events it recieves.
+ * @param queue The dispatch queue the event stream should be scheduled on, preferably a serial queue.
+ * @param deliveryThreadCount The number of threads filtering the events and executing the block, <code>0</code> to do so on <em>queue</em>.
+ * @param sinceEventIdentifier Events that have happened after the given event identifier will be supplied.
+ * @param notificationLatency The (approximate) time intervall between notifications sent to the block.
+ * @param ignoreEventsFromSubDirs Wheter events from sub-directories of the watched URLs should be ignored or not.
+ * @param exludeURLs An array of URLs that we should ignore events from. Pass <code>nil</code> if none should be excluded.
+ * @param streamCreationFlags The event stream creation flags.
+ * @return An CDEvents object initialized with the given URLs to watch, URLs to exclude, whether events from sub-directories are ignored or not and run on the given dispatch queue.
+ * @throws NSInvalidArgumentException if the parameter URLs is empty or points to <code>nil</code>.
+ * @throws NSInvalidArgumentException if <em>block</em> or <em>queue</em> is <code>nil</code>.
+ * @throws CDEventsEventStreamCreationFailureException if we failed to create a event stream.
+ *
+ * @see CDEventsBatchBlock
+ * @see FSEventStreamSetDispatchQueue
+ *
+ * @since head
+ */
+- (id)initWithURLs:(NSArray *)URLs
+		batchBlock:(CDEventsBatchBlock)block
+   onDispatchQueue:(dispatch_queue_t)queue
+deliveryThreadCount:(NSUInteger)deliveryThreadCount
+sinceEventIdentifier:(CDEventIdentifier)sinceEventIdentifier
+notificationLantency:(CFTimeInterval)notificationLatency
+ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
+	   excludeURLs:(NSArray *)exludeURLs
+streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags;
+
+/**
+ * Returns an <code>CDEvents</code> object initialized with the given URLs to watch, URLs to exclude, whether events from sub-directories are ignored or not which delivers events as compact records and schedules the watcher on the given dispatch queue.
+ *
+ * @param URLs An array of URLs (<code>NSURL</code>) we want to watch.
+ * @param block The block which the CDEvents object executes with the records of every batch of events it recieves.
+ * @param queue The dispatch queue the event stream should be scheduled on, preferably a serial queue.
+ * @param deliveryThreadCount The number of threads filtering the events and executing the block, <code>0</code> to do so on <em>queue</em>.
+ * @param sinceEventIdentifier Events that have happened after the given event identifier will be supplied.
+ * @param notificationLatency The (approximate) time intervall between notifications sent to the block.
+ * @param ignoreEventsFromSubDirs Wheter events from sub-directories of the watched URLs should be ignored or not.
+ * @param exludeURLs An array of URLs that we should ignore events from. Pass <code>nil</code> if none should be excluded.
+ * @param streamCreationFlags The event stream creation flags.
+ * @return An CDEvents object initialized with the given URLs to watch, URLs to exclude, whether events from sub-directories are ignored or not and run on the given dispatch queue.
+ * @throws NSInvalidArgumentException if the parameter URLs is empty or points to <code>nil</code>.
+ * @throws NSInvalidArgumentException if <em>block</em> or <em>queue</em> is <code>nil</code>.
+ * @throws CDEventsEventStreamCreationFailureException if we failed to create a event stream.
+ *
+ * @see CDEventsRecordBlock
+ * @see FSEventStreamSetDispatchQueue
+ *
+ * @since head
+ */
+- (id)initWithURLs:(NSArray *)URLs
+	   recordBlock:(CDEventsRecordBlock)block
+   onDispatchQueue:(dispatch_queue_t)queue
+deliveryThreadCount:(NSUInteger)deliveryThreadCount
+sinceEventIdentifier:(CDEventIdentifier)sinceEventIdentifier
+notificationLantency:(CFTimeInterval)notificationLatency
+ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
+	   excludeURLs:(NSArray *)exludeURLs
+streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags;
+
+
+#pragma mark Creating CDEvents Objects Resuming From a Checkpoint
+/** @name Creating CDEvents Objects Resuming From a Checkpoint */
+/*
+ * The watchers created by these methods record the identifier of the last
+ * event they delivered in the given checkpoint store, under the given key,
+ * and resume from it: if the store has a checkpoint for the key, the events
+ * since it are delivered first, otherwise events since now. If the event
+ * history the checkpoint belongs to is gone (for example because the event
+ * database of the volume was purged) the watcher delivers an event with
+ * mustRescanSubDirectories set for each watched URL instead. Event identifiers
+ * wrapping around are reported by the event stream itself, with
+ * isEventIdentifiersWrapped set.
+ */
+/**
+ * Returns an <code>CDEvents</code> object initialized with the given URLs to watch which delivers events one by one and resumes from its checkpoint.
+ *
+ * @param URLs An array of URLs (<code>NSURL</code>) we want to watch.
+ * @param block The block which the CDEvents object executes for every event it recieves.
+ * @param checkpointStore The store the watcher records and resumes from its checkpoint in.
+ * @param checkpointKey The key of the watcher in the store, unique among the watchers using the store.
+ * @return An CDEvents object initialized with the given URLs to watch, run on the current run loop.
+ * @throws NSInvalidArgumentException if the parameter URLs is empty or points to <code>nil</code>.
+ * @throws NSInvalidArgumentException if <em>block</em>, <em>checkpointStore</em> or <em>checkpointKey</em> is <code>nil</code>.
+ * @throws CDEventsEventStreamCreationFailureException if we failed to create a event stream.
+ *
+ * @see CDEventsCheckpointStore
+ *
+ * @since head
+ */
+- (id)initWithURLs:(NSArray *)URLs
+			 block:(CDEventsEventBlock)block
+   checkpointStore:(CDEventsCheckpointStore *)checkpointStore
+	 checkpointKey:(NSString *)checkpointKey;
+
+/**
+ * Returns an <code>CDEvents</code> object initialized with the given URLs to watch which delivers events in batches and resumes from its checkpoint.
+ *
+ * @param URLs An array of URLs (<code>NSURL</code>) we want to watch.
+ * @param block The block which the CDEvents object executes with every batch of events it recieves.
+ * @param checkpointStore The store the watcher records and resumes from its checkpoint in.
+ * @param checkpointKey The key of the watcher in the store, unique among the watchers using the store.
+ * @return An CDEvents object initialized with the given URLs to watch, run on the current run loop.
+ * @throws NSInvalidArgumentException if the parameter URLs is empty or points to <code>nil</code>.
+ * @throws NSInvalidArgumentException if <em>block</em>, <em>checkpointStore</em> or <em>checkpointKey</em> is <code>nil</code>.
+ * @throws CDEventsEventStreamCreationFailureException if we failed to create a event stream.
+ *
+ * @see CDEventsCheckpointStore
+ *
+ * @since head
+ */
+- (id)initWithURLs:(NSArray *)URLs
+		batchBlock:(CDEventsBatchBlock)block
+   checkpointStore:(CDEventsCheckpointStore *)checkpointStore
+	 checkpointKey:(NSString *)checkpointKey;
+
+/**
+ * Returns an <code>CDEvents</code> object initialized with the given URLs to watch which delivers the records of every batch of events and resumes from its checkpoint.
+ *
+ * @param URLs An array of URLs (<code>NSURL</code>) we want to watch.
+ * @param block The block which the CDEvents object executes with the records of every batch of events it recieves.
+ * @param checkpointStore The store the watcher records and resumes from its checkpoint in.
+ * @param checkpointKey The key of the watcher in the store, unique among the watchers using the store.
+ * @return An CDEvents object initialized with the given URLs to watch, run on the current run loop.
+ * @throws NSInvalidArgumentException if the parameter URLs is empty or points to <code>nil</code>.
+ * @throws NSInvalidArgumentException if <em>block</em>, <em>checkpointStore</em> or <em>checkpointKey</em> is <code>nil</code>.
+ * @throws CDEventsEventStreamCreationFailureException if we failed to create a event stream.
+ *
+ * @see CDEventsCheckpointStore
+ *
+ * @since head
+ */
+- (id)initWithURLs:(NSArray *)URLs
+	   recordBlock:(CDEventsRecordBlock)block
+   checkpointStore:(CDEventsCheckpointStore *)checkpointStore
+	 checkpointKey:(NSString *)checkpointKey;
+
+#pragma mark Watched URLs methods
+/** @name Changing the Watched URLs */
+/**
+ * Starts watching the given URLs as well.
+ *
+ * The event stream is updated in place: on Linux watches are only added for
+ * the new URLs, on OS X the event stream hands over from the last event it
+ * delivered, so no events are lost or delivered twice for the URLs already
+ * watched. If the watcher maintains a snapshot the new URLs are walked into
+ * it first. URLs already watched are ignored.
+ *
+ * @param URLs An array of <code>NSURL</code> objects to watch as well.
+ *
+ * @see removeWatchedURLs:
+ * @see watchedURLs
+ *
+ * @since head
+ */
+- (void)addWatchedURLs:(NSArray *)URLs;
+
+/**
+ * Stops watching the given URLs.
+ *
+ * The event stream is updated in place, see <code>addWatchedURLs:</code>.
+ * URLs not watched are ignored.
+ *
+ * @param URLs An array of <code>NSURL</code> objects to stop watching.
+ *
+ * @see addWatchedURLs:
+ * @see watchedURLs
+ *
+ * @since head
+ */
+- (void)removeWatchedURLs:(NSArray *)URLs;
+
 #pragma mark Flush methods
 /** @name Flushing Events */
 /**
@@ -436,6 +1433,30 @@ streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags;
  */
 - (void)flushAsynchronously;
 
+#pragma mark Rescanning
+/** @name Rescanning */
+/**
+ * Walks the watched URLs and delivers what it finds as events.
+ *
+ * The trees are walked in the background by one thread per processor,
+ * skipping the excluded URLs without descending into them. The events are
+ * delivered to the block or delegate like any other, on the run loop or
+ * dispatch queue of the watcher. If the watcher maintains a snapshot only
+ * the differences from it are delivered, otherwise an event with
+ * <code>isCreated</code> set is delivered for every item.
+ *
+ * Use it to recover from an event with <code>mustRescanSubDirectories</code>
+ * set, or to learn what is in the watched URLs on first start. A watcher
+ * sharing its event stream (see <code>+setSharesEventStreams:</code>)
+ * delivers an event with <code>mustRescanSubDirectories</code> set for each
+ * watched URL instead.
+ *
+ * @see maintainsSnapshot
+ *
+ * @since head
+ */
+- (void)rescan;
+
 #pragma mark Misc methods
 /** @name Events Description */
 /**
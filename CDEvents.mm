@@ -0,0 +1,1729 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "CDEvents.h"
+
+#import "CDEventsDelegate.h"
+#import "CDEventBatchPrivate.h"
+#import "CDEventsCheckpointStorePrivate.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "CDCoreContentVerifier.h"
+#include "CDCoreDirectorySnapshot.h"
+#include "CDCoreEventLog.h"
+#include "CDCoreFSEventsBackend.h"
+#include "CDCoreFileIdentityTracker.h"
+#include "CDCoreMetrics.h"
+#include "CDCorePathMatcher.h"
+#include "CDCoreStream.h"
+#include "CDCoreStreamMultiplexer.h"
+
+#ifndef __has_feature
+	#define __has_feature(x) 0
+#endif
+
+#if !__has_feature(objc_arc)
+	#error CDEvents must be built with ARC.
+#endif
+
+#if !__has_feature(blocks)
+	#error CDEvents must be built with support for blocks.
+#endif
+
+
+#pragma mark CDEvents custom exceptions
+NSString *const CDEventsEventStreamCreationFailureException = @"CDEventsEventStreamCreationFailureException";
+
+#pragma -
+#pragma mark Default values
+const CDEventsEventStreamCreationFlags kCDEventsDefaultEventStreamFlags =
+	(kFSEventStreamCreateFlagUseCFTypes |
+	 kFSEventStreamCreateFlagWatchRoot);
+
+const CDEventIdentifier kCDEventsSinceEventNow = kFSEventStreamEventIdSinceNow;
+
+
+#pragma mark Shared event streams
+// The run loop or dispatch queue, latency and creation flags of a shared stream.
+typedef std::tuple<const void *, CFTimeInterval, CDEventsEventStreamCreationFlags> CDEventsSharedStreamKey;
+
+static std::atomic<bool> sSharesEventStreams(false);
+static std::mutex sSharedStreamsMutex;
+static std::map<CDEventsSharedStreamKey, std::weak_ptr<cdevents::StreamMultiplexer> > sSharedStreams;
+
+
+#pragma mark -
+#pragma mark Private API
+// Private API
+@interface CDEvents () {
+@private
+	CDEventsEventBlock							_eventBlock;
+	CDEventsBatchBlock							_batchBlock;
+	CDEventsRecordBlock							_recordBlock;
+	CDEventBatch								*_recordBatch;
+	
+	// The last event is only materialized when asked for.
+	CDEvent										*_lastEvent;
+	cdevents::EventRecord						_lastEventRecord;
+	std::string									_lastEventPath;
+	std::string									_lastEventSourcePath;
+	BOOL										_lastEventPending;
+	
+	std::unique_ptr<cdevents::Stream>			_eventStream;
+	NSArray										*_excludedPatterns;
+	BOOL										_honorsIgnoreFiles;
+	BOOL										_resumesEventStream;
+	std::shared_ptr<cdevents::StreamMultiplexer>	_sharedStream;
+	cdevents::StreamMultiplexer::Subscriber		_sharedStreamSubscriber;
+	CDEventsEventStreamCreationFlags			_eventStreamCreationFlags;
+	CFTimeInterval								_coalescingWindow;
+	BOOL										_pairsRenames;
+	std::shared_ptr<cdevents::FileIdentityTracker>	_identityTracker;
+	std::shared_ptr<cdevents::ContentVerifier>	_contentVerifier;
+	CFTimeInterval								_minimumNotificationLatency;
+	CDEventsOverflowPolicy						_overflowPolicy;
+	NSUInteger									_deliveryQueueCapacity;
+	std::shared_ptr<cdevents::DirectorySnapshot>	_snapshot;
+	std::shared_ptr<cdevents::StreamMetrics>	_metrics;
+	std::shared_ptr<cdevents::EventRecorder>	_recorder;
+	NSURL										*_recordingURL;
+	std::shared_ptr<std::atomic<bool> >			_rescanDeliversEvents;
+	NSURL										*_snapshotURL;
+	CDEventsCheckpointStore						*_checkpointStore;
+	NSString									*_checkpointKey;
+	NSRunLoop									*_runLoop;
+	dispatch_queue_t							_dispatchQueue;
+	NSUInteger									_deliveryThreadCount;
+}
+
+// Redefine the properties that should be writeable.
+@property (strong, readwrite) CDEvent *lastEvent;
+@property (copy, readwrite) NSArray *watchedURLs;
+
+// The core stream callback function
+static void CDEventsCallback(
+	CDEvents *watcher,
+	const cdevents::EventBatch &events,
+	cdevents::StreamMetrics *metrics);
+
+// Returns the shared stream for watchers with the given scheduling and configuration.
+static std::shared_ptr<cdevents::StreamMultiplexer> CDEventsSharedStream(
+	NSRunLoop *runLoop,
+	dispatch_queue_t dispatchQueue,
+	const cdevents::StreamConfiguration &configuration);
+
+// Path helpers
+static std::string CDEventsPathFromURL(NSURL *URL);
+static std::vector<std::string> CDEventsPathsFromURLs(NSArray *URLs);
+static std::vector<std::string> CDEventsStringsFromArray(NSArray *strings);
+
+// Summarizes one of the latency histograms of the metrics.
+static CDEventsLatencySummary CDEventsLatencySummaryFromSnapshot(const cdevents::LatencyHistogramSnapshot &snapshot);
+
+// Exactly one of the blocks and one of the run loop and dispatch queue is set.
+- (id)initWithURLs:(NSArray *)URLs
+		eventBlock:(CDEventsEventBlock)eventBlock
+		batchBlock:(CDEventsBatchBlock)batchBlock
+	   recordBlock:(CDEventsRecordBlock)recordBlock
+		 onRunLoop:(NSRunLoop *)runLoop
+	 dispatchQueue:(dispatch_queue_t)dispatchQueue
+deliveryThreadCount:(NSUInteger)deliveryThreadCount
+sinceEventIdentifier:(CDEventIdentifier)sinceEventIdentifier
+notificationLantency:(CFTimeInterval)notificationLatency
+ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
+	   excludeURLs:(NSArray *)exludeURLs
+streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags
+   checkpointStore:(CDEventsCheckpointStore *)checkpointStore
+	 checkpointKey:(NSString *)checkpointKey;
+
+// The designated initializer, which leaves the event stream to be created
+// by the caller, so that a copy is configured before its stream exists.
+- (id)initWithURLs:(NSArray *)URLs
+		eventBlock:(CDEventsEventBlock)eventBlock
+		batchBlock:(CDEventsBatchBlock)batchBlock
+	   recordBlock:(CDEventsRecordBlock)recordBlock
+		 onRunLoop:(NSRunLoop *)runLoop
+	 dispatchQueue:(dispatch_queue_t)dispatchQueue
+deliveryThreadCount:(NSUInteger)deliveryThreadCount
+sinceEventIdentifier:(CDEventIdentifier)sinceEventIdentifier
+notificationLantency:(CFTimeInterval)notificationLatency
+ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
+	   excludeURLs:(NSArray *)exludeURLs
+streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags
+   checkpointStore:(CDEventsCheckpointStore *)checkpointStore
+	 checkpointKey:(NSString *)checkpointKey
+ createEventStream:(BOOL)createEventStream;
+
+// Remembers the last delivered event without creating an object for it.
+- (void)setLastEventRecord:(const cdevents::EventRecord &)record path:(const char *)path sourcePath:(const char *)sourcePath;
+
+// Creates and initiates the event stream.
+- (void)createEventStream;
+// Disposes of the event stream.
+- (void)disposeEventStream;
+// Replaces the event stream with one resuming from the last delivered event.
+- (void)recreateEventStream;
+// Watches the given URLs instead, updating the event stream in place.
+- (void)updateWatchedURLs:(NSArray *)URLs;
+// Tells the client to rescan the watched URLs, as the events since the checkpoint are unknown.
+- (void)postRescanEvents;
+// Runs the block on the run loop or dispatch queue the event stream is scheduled on.
+- (void)performOnEventStreamScheduler:(void (^)(void))block;
+
+@end
+
+
+#pragma mark -
+#pragma mark Implementation
+@implementation CDEvents
+
+#pragma mark Properties
+@synthesize delegate						= _delegate;
+@synthesize notificationLatency				= _notificationLatency;
+@synthesize sinceEventIdentifier			= _sinceEventIdentifier;
+@synthesize ignoreEventsFromSubDirectories	= _ignoreEventsFromSubDirectories;
+@synthesize watchedURLs						= _watchedURLs;
+@synthesize excludedURLs					= _excludedURLs;
+@synthesize checkpointStore					= _checkpointStore;
+@synthesize checkpointKey					= _checkpointKey;
+
+
+#pragma mark Event identifier class methods
++ (CDEventIdentifier)currentEventIdentifier
+{
+	return (NSUInteger)FSEventsGetCurrentEventId();
+}
+
+
+#pragma mark Sharing event streams class methods
++ (void)setSharesEventStreams:(BOOL)flag
+{
+	sSharesEventStreams = (flag ? true : false);
+}
+
++ (BOOL)sharesEventStreams
+{
+	return (sSharesEventStreams ? YES : NO);
+}
+
+
+#pragma mark URL interning class methods
++ (void)setURLInterningCapacity:(NSUInteger)capacity
+{
+	[CDEventBatch setURLInterningCapacity:capacity];
+}
+
++ (NSUInteger)URLInterningCapacity
+{
+	return [CDEventBatch URLInterningCapacity];
+}
+
++ (CDEventsURLInterningStatistics)URLInterningStatistics
+{
+	return [CDEventBatch URLInterningStatistics];
+}
+
+
+#pragma mark Init/dealloc/finalize methods
+- (void)dealloc
+{
+	[self disposeEventStream];
+	
+	if (_dispatchQueue) {
+		dispatch_release(_dispatchQueue);
+	}
+	
+	_delegate = nil;
+}
+
+- (void)finalize
+{
+	[self disposeEventStream];
+	
+	_delegate = nil;
+	
+	[super finalize];
+}
+
+- (id)initWithURLs:(NSArray *)URLs delegate:(id<CDEventsDelegate>)delegate
+{
+	return [self initWithURLs:URLs
+					 delegate:delegate
+					onRunLoop:[NSRunLoop currentRunLoop]];
+}
+
+- (id)initWithURLs:(NSArray *)URLs
+			delegate:(id<CDEventsDelegate>)delegate
+		   onRunLoop:(NSRunLoop *)runLoop
+{
+	return [self initWithURLs:URLs
+					 delegate:delegate
+					onRunLoop:runLoop
+		 sinceEventIdentifier:kCDEventsSinceEventNow
+		 notificationLantency:CD_EVENTS_DEFAULT_NOTIFICATION_LATENCY
+	  ignoreEventsFromSubDirs:CD_EVENTS_DEFAULT_IGNORE_EVENT_FROM_SUB_DIRS
+				  excludeURLs:nil
+		  streamCreationFlags:kCDEventsDefaultEventStreamFlags];
+}
+
+- (id)initWithURLs:(NSArray *)URLs
+		  delegate:(id<CDEventsDelegate>)delegate
+		 onRunLoop:(NSRunLoop *)runLoop
+sinceEventIdentifier:(CDEventIdentifier)sinceEventIdentifier
+notificationLantency:(CFTimeInterval)notificationLatency
+ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
+	   excludeURLs:(NSArray *)exludeURLs
+streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags
+{
+	if (delegate == nil) {
+		[NSException raise:NSInvalidArgumentException
+					format:@"Invalid arguments passed to CDEvents init-method."];
+	}
+	
+	_delegate = delegate;
+	
+	// The delegate is asked once per batch so that delegates implementing
+	// the batch method do not pay for a call per event.
+	return [self initWithURLs:URLs
+				   batchBlock:^(CDEvents *watcher, NSArray *events){
+					   id<CDEventsDelegate> watcherDelegate = [watcher delegate];
+					   if (![(id)watcherDelegate conformsToProtocol:@protocol(CDEventsDelegate)]) {
+						   return;
+					   }
+					   
+					   if ([(id)watcherDelegate respondsToSelector:@selector(URLWatcher:eventsOccurred:)]) {
+						   [watcherDelegate URLWatcher:watcher eventsOccurred:events];
+					   } else {
+						   for (CDEvent *event in events) {
+							   [watcherDelegate URLWatcher:watcher eventOccurred:event];
+						   }
+					   }
+				   }
+					onRunLoop:runLoop
+		 sinceEventIdentifier:sinceEventIdentifier
+		 notificationLantency:notificationLatency
+	  ignoreEventsFromSubDirs:ignoreEventsFromSubDirs
+				  excludeURLs:exludeURLs
+		  streamCreationFlags:streamCreationFlags];
+}
+
+
+#pragma mark Creating CDEvents Objects With a Block
+- (id)initWithURLs:(NSArray *)URLs block:(CDEventsEventBlock)block
+{
+	return [self initWithURLs:URLs block:block onRunLoop:[NSRunLoop currentRunLoop]];
+}
+
+- (id)initWithURLs:(NSArray *)URLs
+			 block:(CDEventsEventBlock)block
+		 onRunLoop:(NSRunLoop *)runLoop
+{
+	return [self initWithURLs:URLs
+						block:block
+					onRunLoop:runLoop
+		 sinceEventIdentifier:kCDEventsSinceEventNow
+		 notificationLantency:CD_EVENTS_DEFAULT_NOTIFICATION_LATENCY
+	  ignoreEventsFromSubDirs:CD_EVENTS_DEFAULT_IGNORE_EVENT_FROM_SUB_DIRS
+				  excludeURLs:nil
+		  streamCreationFlags:kCDEventsDefaultEventStreamFlags];
+}
+
+- (id)initWithURLs:(NSArray *)URLs
+			 block:(CDEventsEventBlock)block
+		 onRunLoop:(NSRunLoop *)runLoop
+sinceEventIdentifier:(CDEventIdentifier)sinceEventIdentifier
+notificationLantency:(CFTimeInterval)notificationLatency
+ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
+	   excludeURLs:(NSArray *)exludeURLs
+streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags
+{
+	if (block == NULL) {
+		[NSException raise:NSInvalidArgumentException
+					format:@"Invalid arguments passed to CDEvents init-method."];
+	}
+	
+	return [self initWithURLs:URLs
+				   eventBlock:block
+				   batchBlock:NULL
+				  recordBlock:NULL
+					onRunLoop:runLoop
+				dispatchQueue:NULL
+		  deliveryThreadCount:0
+		 sinceEventIdentifier:sinceEventIdentifier
+		 notificationLantency:notificationLatency
+	  ignoreEventsFromSubDirs:ignoreEventsFromSubDirs
+				  excludeURLs:exludeURLs
+		  streamCreationFlags:streamCreationFlags
+			  checkpointStore:nil
+				checkpointKey:nil];
+}
+
+
+#pragma mark Creating CDEvents Objects With a Batch Block
+- (id)initWithURLs:(NSArray *)URLs batchBlock:(CDEventsBatchBlock)block
+{
+	return [self initWithURLs:URLs batchBlock:block onRunLoop:[NSRunLoop currentRunLoop]];
+}
+
+- (id)initWithURLs:(NSArray *)URLs
+		batchBlock:(CDEventsBatchBlock)block
+		 onRunLoop:(NSRunLoop *)runLoop
+{
+	return [self initWithURLs:URLs
+				   batchBlock:block
+					onRunLoop:runLoop
+		 sinceEventIdentifier:kCDEventsSinceEventNow
+		 notificationLantency:CD_EVENTS_DEFAULT_NOTIFICATION_LATENCY
+	  ignoreEventsFromSubDirs:CD_EVENTS_DEFAULT_IGNORE_EVENT_FROM_SUB_DIRS
+				  excludeURLs:nil
+		  streamCreationFlags:kCDEventsDefaultEventStreamFlags];
+}
+
+- (id)initWithURLs:(NSArray *)URLs
+		batchBlock:(CDEventsBatchBlock)block
+		 onRunLoop:(NSRunLoop *)runLoop
+sinceEventIdentifier:(CDEventIdentifier)sinceEventIdentifier
+notificationLantency:(CFTimeInterval)notificationLatency
+ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
+	   excludeURLs:(NSArray *)exludeURLs
+streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags
+{
+	if (block == NULL) {
+		[NSException raise:NSInvalidArgumentException
+					format:@"Invalid arguments passed to CDEvents init-method."];
+	}
+	
+	return [self initWithURLs:URLs
+				   eventBlock:NULL
+				   batchBlock:block
+				  recordBlock:NULL
+					onRunLoop:runLoop
+				dispatchQueue:NULL
+		  deliveryThreadCount:0
+		 sinceEventIdentifier:sinceEventIdentifier
+		 notificationLantency:notificationLatency
+	  ignoreEventsFromSubDirs:ignoreEventsFromSubDirs
+				  excludeURLs:exludeURLs
+		  streamCreationFlags:streamCreationFlags
+			  checkpointStore:nil
+				checkpointKey:nil];
+}
+
+
+#pragma mark Creating CDEvents Objects With a Record Block
+- (id)initWithURLs:(NSArray *)URLs recordBlock:(CDEventsRecordBlock)block
+{
+	return [self initWithURLs:URLs recordBlock:block onRunLoop:[NSRunLoop currentRunLoop]];
+}
+
+- (id)initWithURLs:(NSArray *)URLs
+	   recordBlock:(CDEventsRecordBlock)block
+		 onRunLoop:(NSRunLoop *)runLoop
+{
+	return [self initWithURLs:URLs
+				  recordBlock:block
+					onRunLoop:runLoop
+		 sinceEventIdentifier:kCDEventsSinceEventNow
+		 notificationLantency:CD_EVENTS_DEFAULT_NOTIFICATION_LATENCY
+	  ignoreEventsFromSubDirs:CD_EVENTS_DEFAULT_IGNORE_EVENT_FROM_SUB_DIRS
+				  excludeURLs:nil
+		  streamCreationFlags:kCDEventsDefaultEventStreamFlags];
+}
+
+- (id)initWithURLs:(NSArray *)URLs
+	   recordBlock:(CDEventsRecordBlock)block
+		 onRunLoop:(NSRunLoop *)runLoop
+sinceEventIdentifier:(CDEventIdentifier)sinceEventIdentifier
+notificationLantency:(CFTimeInterval)notificationLatency
+ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
+	   excludeURLs:(NSArray *)exludeURLs
+streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags
+{
+	if (block == NULL) {
+		[NSException raise:NSInvalidArgumentException
+					format:@"Invalid arguments passed to CDEvents init-method."];
+	}
+	
+	return [self initWithURLs:URLs
+				   eventBlock:NULL
+				   batchBlock:NULL
+				  recordBlock:block
+					onRunLoop:runLoop
+				dispatchQueue:NULL
+		  deliveryThreadCount:0
+		 sinceEventIdentifier:sinceEventIdentifier
+		 notificationLantency:notificationLatency
+	  ignoreEventsFromSubDirs:ignoreEventsFromSubDirs
+				  excludeURLs:exludeURLs
+		  streamCreationFlags:streamCreationFlags
+			  checkpointStore:nil
+				checkpointKey:nil];
+}
+
+
+#pragma mark Creating CDEvents Objects Resuming From a Checkpoint
+- (id)initWithURLs:(NSArray *)URLs
+			 block:(CDEventsEventBlock)block
+   checkpointStore:(CDEventsCheckpointStore *)checkpointStore
+	 checkpointKey:(NSString *)checkpointKey
+{
+	if (block == NULL || checkpointStore == nil || checkpointKey == nil) {
+		[NSException raise:NSInvalidArgumentException
+					format:@"Invalid arguments passed to CDEvents init-method."];
+	}
+	
+	return [self initWithURLs:URLs
+				   eventBlock:block
+				   batchBlock:NULL
+				  recordBlock:NULL
+					onRunLoop:[NSRunLoop currentRunLoop]
+				dispatchQueue:NULL
+		  deliveryThreadCount:0
+		 sinceEventIdentifier:kCDEventsSinceEventNow
+		 notificationLantency:CD_EVENTS_DEFAULT_NOTIFICATION_LATENCY
+	  ignoreEventsFromSubDirs:CD_EVENTS_DEFAULT_IGNORE_EVENT_FROM_SUB_DIRS
+				  excludeURLs:nil
+		  streamCreationFlags:kCDEventsDefaultEventStreamFlags
+			  checkpointStore:checkpointStore
+				checkpointKey:checkpointKey];
+}
+
+- (id)initWithURLs:(NSArray *)URLs
+		batchBlock:(CDEventsBatchBlock)block
+   checkpointStore:(CDEventsCheckpointStore *)checkpointStore
+	 checkpointKey:(NSString *)checkpointKey
+{
+	if (block == NULL || checkpointStore == nil || checkpointKey == nil) {
+		[NSException raise:NSInvalidArgumentException
+					format:@"Invalid arguments passed to CDEvents init-method."];
+	}
+	
+	return [self initWithURLs:URLs
+				   eventBlock:NULL
+				   batchBlock:block
+				  recordBlock:NULL
+					onRunLoop:[NSRunLoop currentRunLoop]
+				dispatchQueue:NULL
+		  deliveryThreadCount:0
+		 sinceEventIdentifier:kCDEventsSinceEventNow
+		 notificationLantency:CD_EVENTS_DEFAULT_NOTIFICATION_LATENCY
+	  ignoreEventsFromSubDirs:CD_EVENTS_DEFAULT_IGNORE_EVENT_FROM_SUB_DIRS
+				  excludeURLs:nil
+		  streamCreationFlags:kCDEventsDefaultEventStreamFlags
+			  checkpointStore:checkpointStore
+				checkpointKey:checkpointKey];
+}
+
+- (id)initWithURLs:(NSArray *)URLs
+	   recordBlock:(CDEventsRecordBlock)block
+   checkpointStore:(CDEventsCheckpointStore *)checkpointStore
+	 checkpointKey:(NSString *)checkpointKey
+{
+	if (block == NULL || checkpointStore == nil || checkpointKey == nil) {
+		[NSException raise:NSInvalidArgumentException
+					format:@"Invalid arguments passed to CDEvents init-method."];
+	}
+	
+	return [self initWithURLs:URLs
+				   eventBlock:NULL
+				   batchBlock:NULL
+				  recordBlock:block
+					onRunLoop:[NSRunLoop currentRunLoop]
+				dispatchQueue:NULL
+		  deliveryThreadCount:0
+		 sinceEventIdentifier:kCDEventsSinceEventNow
+		 notificationLantency:CD_EVENTS_DEFAULT_NOTIFICATION_LATENCY
+	  ignoreEventsFromSubDirs:CD_EVENTS_DEFAULT_IGNORE_EVENT_FROM_SUB_DIRS
+				  excludeURLs:nil
+		  streamCreationFlags:kCDEventsDefaultEventStreamFlags
+			  checkpointStore:checkpointStore
+				checkpointKey:checkpointKey];
+}
+
+
+#pragma mark Creating CDEvents Objects on a Dispatch Queue
+- (id)initWithURLs:(NSArray *)URLs
+			 block:(CDEventsEventBlock)block
+   onDispatchQueue:(dispatch_queue_t)queue
+deliveryThreadCount:(NSUInteger)deliveryThreadCount
+sinceEventIdentifier:(CDEventIdentifier)sinceEventIdentifier
+notificationLantency:(CFTimeInterval)notificationLatency
+ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
+	   excludeURLs:(NSArray *)exludeURLs
+streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags
+{
+	if (block == NULL || queue == NULL) {
+		[NSException raise:NSInvalidArgumentException
+					format:@"Invalid arguments passed to CDEvents init-method."];
+	}
+	
+	return [self initWithURLs:URLs
+				   eventBlock:block
+				   batchBlock:NULL
+				  recordBlock:NULL
+					onRunLoop:nil
+				dispatchQueue:queue
+		  deliveryThreadCount:deliveryThreadCount
+		 sinceEventIdentifier:sinceEventIdentifier
+		 notificationLantency:notificationLatency
+	  ignoreEventsFromSubDirs:ignoreEventsFromSubDirs
+				  excludeURLs:exludeURLs
+		  streamCreationFlags:streamCreationFlags
+			  checkpointStore:nil
+				checkpointKey:nil];
+}
+
+- (id)initWithURLs:(NSArray *)URLs
+		batchBlock:(CDEventsBatchBlock)block
+   onDispatchQueue:(dispatch_queue_t)queue
+deliveryThreadCount:(NSUInteger)deliveryThreadCount
+sinceEventIdentifier:(CDEventIdentifier)sinceEventIdentifier
+notificationLantency:(CFTimeInterval)notificationLatency
+ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
+	   excludeURLs:(NSArray *)exludeURLs
+streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags
+{
+	if (block == NULL || queue == NULL) {
+		[NSException raise:NSInvalidArgumentException
+					format:@"Invalid arguments passed to CDEvents init-method."];
+	}
+	
+	return [self initWithURLs:URLs
+				   eventBlock:NULL
+				   batchBlock:block
+				  recordBlock:NULL
+					onRunLoop:nil
+				dispatchQueue:queue
+		  deliveryThreadCount:deliveryThreadCount
+		 sinceEventIdentifier:sinceEventIdentifier
+		 notificationLantency:notificationLatency
+	  ignoreEventsFromSubDirs:ignoreEventsFromSubDirs
+				  excludeURLs:exludeURLs
+		  streamCreationFlags:streamCreationFlags
+			  checkpointStore:nil
+				checkpointKey:nil];
+}
+
+- (id)initWithURLs:(NSArray *)URLs
+	   recordBlock:(CDEventsRecordBlock)block
+   onDispatchQueue:(dispatch_queue_t)queue
+deliveryThreadCount:(NSUInteger)deliveryThreadCount
+sinceEventIdentifier:(CDEventIdentifier)sinceEventIdentifier
+notificationLantency:(CFTimeInterval)notificationLatency
+ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
+	   excludeURLs:(NSArray *)exludeURLs
+streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags
+{
+	if (block == NULL || queue == NULL) {
+		[NSException raise:NSInvalidArgumentException
+					format:@"Invalid arguments passed to CDEvents init-method."];
+	}
+	
+	return [self initWithURLs:URLs
+				   eventBlock:NULL
+				   batchBlock:NULL
+				  recordBlock:block
+					onRunLoop:nil
+				dispatchQueue:queue
+		  deliveryThreadCount:deliveryThreadCount
+		 sinceEventIdentifier:sinceEventIdentifier
+		 notificationLantency:notificationLatency
+	  ignoreEventsFromSubDirs:ignoreEventsFromSubDirs
+				  excludeURLs:exludeURLs
+		  streamCreationFlags:streamCreationFlags
+			  checkpointStore:nil
+				checkpointKey:nil];
+}
+
+
+#pragma mark Designated initializer
+- (id)initWithURLs:(NSArray *)URLs
+		eventBlock:(CDEventsEventBlock)eventBlock
+		batchBlock:(CDEventsBatchBlock)batchBlock
+	   recordBlock:(CDEventsRecordBlock)recordBlock
+		 onRunLoop:(NSRunLoop *)runLoop
+	 dispatchQueue:(dispatch_queue_t)dispatchQueue
+deliveryThreadCount:(NSUInteger)deliveryThreadCount
+sinceEventIdentifier:(CDEventIdentifier)sinceEventIdentifier
+notificationLantency:(CFTimeInterval)notificationLatency
+ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
+	   excludeURLs:(NSArray *)exludeURLs
+streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags
+   checkpointStore:(CDEventsCheckpointStore *)checkpointStore
+	 checkpointKey:(NSString *)checkpointKey
+{
+	return [self initWithURLs:URLs
+				   eventBlock:eventBlock
+				   batchBlock:batchBlock
+				  recordBlock:recordBlock
+					onRunLoop:runLoop
+				dispatchQueue:dispatchQueue
+		  deliveryThreadCount:deliveryThreadCount
+		 sinceEventIdentifier:sinceEventIdentifier
+		 notificationLantency:notificationLatency
+	  ignoreEventsFromSubDirs:ignoreEventsFromSubDirs
+				  excludeURLs:exludeURLs
+		  streamCreationFlags:streamCreationFlags
+			  checkpointStore:checkpointStore
+				checkpointKey:checkpointKey
+			createEventStream:YES];
+}
+
+- (id)initWithURLs:(NSArray *)URLs
+		eventBlock:(CDEventsEventBlock)eventBlock
+		batchBlock:(CDEventsBatchBlock)batchBlock
+	   recordBlock:(CDEventsRecordBlock)recordBlock
+		 onRunLoop:(NSRunLoop *)runLoop
+	 dispatchQueue:(dispatch_queue_t)dispatchQueue
+deliveryThreadCount:(NSUInteger)deliveryThreadCount
+sinceEventIdentifier:(CDEventIdentifier)sinceEventIdentifier
+notificationLantency:(CFTimeInterval)notificationLatency
+ignoreEventsFromSubDirs:(BOOL)ignoreEventsFromSubDirs
+	   excludeURLs:(NSArray *)exludeURLs
+streamCreationFlags:(CDEventsEventStreamCreationFlags)streamCreationFlags
+   checkpointStore:(CDEventsCheckpointStore *)checkpointStore
+	 checkpointKey:(NSString *)checkpointKey
+ createEventStream:(BOOL)createEventStream
+{
+	if (URLs == nil || [URLs count] == 0 || (runLoop == nil && dispatchQueue == NULL) ||
+		((checkpointStore == nil) != (checkpointKey == nil))) {
+		[NSException raise:NSInvalidArgumentException
+					format:@"Invalid arguments passed to CDEvents init-method."];
+	}
+	
+	if ((self = [super init])) {
+		_watchedURLs = [URLs copy];
+		_excludedURLs = [exludeURLs copy];
+		_eventBlock = eventBlock;
+		_batchBlock = batchBlock;
+		_recordBlock = recordBlock;
+		_recordBatch = (recordBlock ? [[CDEventBatch alloc] init] : nil);
+		
+		_sinceEventIdentifier = sinceEventIdentifier;
+		_eventStreamCreationFlags = streamCreationFlags;
+		
+		_notificationLatency = notificationLatency;
+		_ignoreEventsFromSubDirectories = ignoreEventsFromSubDirs;
+		
+		_lastEvent = nil;
+		_lastEventPending = NO;
+		_runLoop = runLoop;
+		_dispatchQueue = dispatchQueue;
+		_deliveryThreadCount = deliveryThreadCount;
+		_deliveryQueueCapacity = CD_EVENTS_DEFAULT_DELIVERY_QUEUE_CAPACITY;
+		_overflowPolicy = kCDEventsOverflowPolicyBlock;
+		if (_dispatchQueue) {
+			dispatch_retain(_dispatchQueue);
+		}
+		_checkpointStore = checkpointStore;
+		_checkpointKey = [checkpointKey copy];
+		
+		if (createEventStream) {
+			[self createEventStream];
+		}
+	}
+	
+	return self;
+}
+
+
+#pragma mark NSCopying method
+- (id)copyWithZone:(NSZone *)zone
+{
+	CDEvents *copy = [[CDEvents alloc] initWithURLs:[self watchedURLs]
+										 eventBlock:[self eventBlock]
+										 batchBlock:[self batchBlock]
+										recordBlock:[self recordBlock]
+										  onRunLoop:(_dispatchQueue ? nil : [NSRunLoop currentRunLoop])
+									  dispatchQueue:_dispatchQueue
+								deliveryThreadCount:_deliveryThreadCount
+							   sinceEventIdentifier:[self sinceEventIdentifier]
+							   notificationLantency:[self notificationLatency]
+							ignoreEventsFromSubDirs:[self ignoreEventsFromSubDirectories]
+										excludeURLs:[self excludedURLs]
+								streamCreationFlags:_eventStreamCreationFlags
+									checkpointStore:nil
+									  checkpointKey:nil
+								  createEventStream:NO];
+	
+	// The options are copied before the stream of the copy is created, once,
+	// rather than through the setters, each of which would recreate it. A
+	// checkpoint key, or a snapshot file, belongs to one watcher, so the copy
+	// keeps none, and the trackers and caches start out empty.
+	@synchronized(self) {
+		copy->_coalescingWindow				= _coalescingWindow;
+		copy->_minimumNotificationLatency	= _minimumNotificationLatency;
+		copy->_pairsRenames					= _pairsRenames;
+		copy->_excludedPatterns				= _excludedPatterns;
+		copy->_honorsIgnoreFiles			= _honorsIgnoreFiles;
+		copy->_overflowPolicy				= _overflowPolicy;
+		copy->_deliveryQueueCapacity		= _deliveryQueueCapacity;
+		if (_identityTracker) {
+			copy->_identityTracker = std::make_shared<cdevents::FileIdentityTracker>();
+		}
+		if (_contentVerifier) {
+			copy->_contentVerifier = std::make_shared<cdevents::ContentVerifier>(_contentVerifier->sizeLimit(), [[NSProcessInfo processInfo] activeProcessorCount]);
+		}
+		if (_snapshot) {
+			copy->_snapshot = std::make_shared<cdevents::DirectorySnapshot>();
+		}
+		if (_metrics) {
+			copy->_metrics = std::make_shared<cdevents::StreamMetrics>();
+		}
+	}
+	[copy createEventStream];
+	
+	return copy;
+}
+
+#pragma mark Block
+- (CDEventsEventBlock)eventBlock
+{
+	return _eventBlock;
+}
+
+- (CDEventsBatchBlock)batchBlock
+{
+	return _batchBlock;
+}
+
+- (CDEventsRecordBlock)recordBlock
+{
+	return _recordBlock;
+}
+
+
+#pragma mark Last event
+- (void)setLastEvent:(CDEvent *)lastEvent
+{
+	@synchronized(self) {
+		_lastEvent = lastEvent;
+		_lastEventPending = NO;
+	}
+}
+
+- (CDEvent *)lastEvent
+{
+	@synchronized(self) {
+		if (_lastEventPending) {
+			_lastEvent = [CDEventBatch eventWithRecord:_lastEventRecord
+												  path:_lastEventPath.c_str()
+											sourcePath:(_lastEventRecord.sourcePathLength > 0 ? _lastEventSourcePath.c_str() : NULL)];
+			_lastEventPending = NO;
+		}
+		
+		return _lastEvent;
+	}
+}
+
+- (void)setLastEventRecord:(const cdevents::EventRecord &)record path:(const char *)path sourcePath:(const char *)sourcePath
+{
+	@synchronized(self) {
+		// The path strings keep their storage, so this does not allocate once
+		// they have grown to hold the longest path.
+		_lastEventRecord = record;
+		_lastEventPath.assign(path, record.pathLength);
+		_lastEventSourcePath.assign((sourcePath ? sourcePath : ""), record.sourcePathLength);
+		_lastEventRecord.pathOffset = 0;
+		_lastEventRecord.sourcePathOffset = 0;
+		_lastEvent = nil;
+		_lastEventPending = YES;
+	}
+}
+
+
+#pragma mark Filtering
+- (void)setExcludedURLs:(NSArray *)excludedURLs
+{
+	NSArray *URLs = [excludedURLs copy];
+	
+	@synchronized(self) {
+		_excludedURLs = URLs;
+		if (_eventStream) {
+			_eventStream->setExcludedPaths(CDEventsPathsFromURLs(URLs));
+		} else if (_sharedStream) {
+			_sharedStream->setExcludedPaths(_sharedStreamSubscriber, CDEventsPathsFromURLs(URLs));
+		}
+	}
+}
+
+- (NSArray *)excludedURLs
+{
+	@synchronized(self) {
+		return _excludedURLs;
+	}
+}
+
+- (void)setExcludedPatterns:(NSArray *)excludedPatterns
+{
+	NSArray *patterns = [excludedPatterns copy];
+	const std::vector<std::string> corePatterns = CDEventsStringsFromArray(patterns);
+	
+	// Compiled once up front so that a malformed pattern leaves the current ones in place.
+	try {
+		cdevents::PathMatcher matcher(corePatterns);
+	} catch (const cdevents::PathPatternError &error) {
+		[NSException raise:NSInvalidArgumentException format:@"%s", error.what()];
+	}
+	
+	@synchronized(self) {
+		_excludedPatterns = patterns;
+		if (_eventStream) {
+			_eventStream->setPathPatterns(corePatterns);
+		} else if (_sharedStream) {
+			_sharedStream->setPathPatterns(_sharedStreamSubscriber, corePatterns);
+		}
+	}
+}
+
+- (NSArray *)excludedPatterns
+{
+	@synchronized(self) {
+		return _excludedPatterns;
+	}
+}
+
+- (void)setHonorsIgnoreFiles:(BOOL)flag
+{
+	BOOL sharesEventStream;
+	@synchronized(self) {
+		if (flag == _honorsIgnoreFiles) {
+			return;
+		}
+		_honorsIgnoreFiles = flag;
+		sharesEventStream = (_sharedStream != NULL);
+		if (_eventStream) {
+			_eventStream->setHonorsIgnoreFiles(flag ? true : false);
+		}
+	}
+	
+	// A shared event stream does not read ignore files.
+	if (sharesEventStream) {
+		[self recreateEventStream];
+	}
+}
+
+- (BOOL)honorsIgnoreFiles
+{
+	@synchronized(self) {
+		return _honorsIgnoreFiles;
+	}
+}
+
+- (void)setIgnoreEventsFromSubDirectories:(BOOL)flag
+{
+	@synchronized(self) {
+		_ignoreEventsFromSubDirectories = flag;
+		if (_eventStream) {
+			_eventStream->setIgnoreEventsFromSubDirectories(flag ? true : false);
+		} else if (_sharedStream) {
+			_sharedStream->setIgnoreEventsFromSubDirectories(_sharedStreamSubscriber, flag ? true : false);
+		}
+	}
+}
+
+- (BOOL)ignoreEventsFromSubDirectories
+{
+	@synchronized(self) {
+		return _ignoreEventsFromSubDirectories;
+	}
+}
+
+- (void)setCoalescingWindow:(CFTimeInterval)window
+{
+	@synchronized(self) {
+		if (window == _coalescingWindow) {
+			return;
+		}
+		_coalescingWindow = window;
+	}
+	
+	// The window is part of the stream configuration.
+	[self recreateEventStream];
+}
+
+- (CFTimeInterval)coalescingWindow
+{
+	@synchronized(self) {
+		return _coalescingWindow;
+	}
+}
+
+- (void)setPairsRenames:(BOOL)flag
+{
+	@synchronized(self) {
+		if (flag == _pairsRenames) {
+			return;
+		}
+		_pairsRenames = flag;
+	}
+	
+	[self recreateEventStream];
+}
+
+- (BOOL)pairsRenames
+{
+	@synchronized(self) {
+		return _pairsRenames;
+	}
+}
+
+- (void)setTracksFileIdentities:(BOOL)flag
+{
+	@synchronized(self) {
+		if ((flag ? YES : NO) == (_identityTracker ? YES : NO)) {
+			return;
+		}
+		
+		// The tracker outlives recreated event streams, so that the items
+		// seen before are still known.
+		if (flag) {
+			_identityTracker = std::make_shared<cdevents::FileIdentityTracker>();
+		} else {
+			_identityTracker.reset();
+		}
+	}
+	
+	[self recreateEventStream];
+}
+
+- (BOOL)tracksFileIdentities
+{
+	@synchronized(self) {
+		return (_identityTracker ? YES : NO);
+	}
+}
+
+- (void)setContentVerificationSizeLimit:(unsigned long long)sizeLimit
+{
+	@synchronized(self) {
+		if (sizeLimit == (_contentVerifier ? _contentVerifier->sizeLimit() : 0)) {
+			return;
+		}
+		
+		if (sizeLimit > 0) {
+			_contentVerifier = std::make_shared<cdevents::ContentVerifier>(sizeLimit, [[NSProcessInfo processInfo] activeProcessorCount]);
+		} else {
+			_contentVerifier.reset();
+		}
+	}
+	
+	[self recreateEventStream];
+}
+
+- (unsigned long long)contentVerificationSizeLimit
+{
+	@synchronized(self) {
+		return (_contentVerifier ? _contentVerifier->sizeLimit() : 0);
+	}
+}
+
+
+#pragma mark Adaptive latency
+- (void)setMinimumNotificationLatency:(CFTimeInterval)latency
+{
+	@synchronized(self) {
+		if (latency == _minimumNotificationLatency) {
+			return;
+		}
+		_minimumNotificationLatency = latency;
+	}
+	
+	[self recreateEventStream];
+}
+
+- (CFTimeInterval)minimumNotificationLatency
+{
+	@synchronized(self) {
+		return _minimumNotificationLatency;
+	}
+}
+
+- (CFTimeInterval)currentNotificationLatency
+{
+	if (_eventStream) {
+		return _eventStream->notificationLatency();
+	}
+	
+	return [self notificationLatency];
+}
+
+
+#pragma mark Slow consumers
+- (void)setOverflowPolicy:(CDEventsOverflowPolicy)policy
+{
+	@synchronized(self) {
+		if (policy == _overflowPolicy) {
+			return;
+		}
+		_overflowPolicy = policy;
+	}
+	
+	[self recreateEventStream];
+}
+
+- (CDEventsOverflowPolicy)overflowPolicy
+{
+	@synchronized(self) {
+		return _overflowPolicy;
+	}
+}
+
+- (void)setDeliveryQueueCapacity:(NSUInteger)capacity
+{
+	@synchronized(self) {
+		if (capacity == _deliveryQueueCapacity) {
+			return;
+		}
+		_deliveryQueueCapacity = capacity;
+	}
+	
+	[self recreateEventStream];
+}
+
+- (NSUInteger)deliveryQueueCapacity
+{
+	@synchronized(self) {
+		return _deliveryQueueCapacity;
+	}
+}
+
+- (CDEventsDeliveryQueueStatistics)deliveryQueueStatistics
+{
+	CDEventsDeliveryQueueStatistics statistics = { 0, 0, 0, 0, 0, 0, 0 };
+	if (_eventStream) {
+		const cdevents::DeliveryQueueStatistics queue = _eventStream->deliveryQueueStatistics();
+		statistics.depth				= (NSUInteger)queue.depth;
+		statistics.maximumDepth			= (NSUInteger)queue.maximumDepth;
+		statistics.queuedBatchCount		= queue.queuedBatches;
+		statistics.blockedBatchCount	= queue.blockedBatches;
+		statistics.droppedBatchCount	= queue.droppedBatches;
+		statistics.droppedEventCount	= queue.droppedEvents;
+		statistics.rescanCount			= queue.rescans;
+	}
+	
+	return statistics;
+}
+
+
+#pragma mark Snapshot
+- (void)setMaintainsSnapshot:(BOOL)flag
+{
+	@synchronized(self) {
+		if ((flag ? YES : NO) == (_snapshot ? YES : NO)) {
+			return;
+		}
+		
+		if (flag) {
+			_snapshot = std::make_shared<cdevents::DirectorySnapshot>();
+			if (_snapshotURL) {
+				_snapshot->load(std::string([[_snapshotURL path] fileSystemRepresentation]));
+			}
+		}
+	}
+	
+	// Disposing writes the snapshot, if it has a URL, before it is dropped.
+	if (!flag) {
+		[self disposeEventStream];
+		@synchronized(self) {
+			_snapshot.reset();
+		}
+		[self createEventStream];
+		return;
+	}
+	[self recreateEventStream];
+}
+
+- (BOOL)maintainsSnapshot
+{
+	@synchronized(self) {
+		return (_snapshot ? YES : NO);
+	}
+}
+
+- (void)setSnapshotURL:(NSURL *)URL
+{
+	NSURL *snapshotURL = [URL copy];
+	
+	@synchronized(self) {
+		_snapshotURL = snapshotURL;
+	}
+}
+
+- (NSURL *)snapshotURL
+{
+	@synchronized(self) {
+		return _snapshotURL;
+	}
+}
+
+
+#pragma mark Metrics
+- (void)setMetricsEnabled:(BOOL)flag
+{
+	@synchronized(self) {
+		if ((flag ? YES : NO) == (_metrics ? YES : NO)) {
+			return;
+		}
+		
+		// The stream being replaced keeps its own reference until it is disposed of.
+		if (flag) {
+			_metrics = std::make_shared<cdevents::StreamMetrics>();
+		} else {
+			_metrics.reset();
+		}
+	}
+	
+	[self recreateEventStream];
+}
+
+- (BOOL)metricsEnabled
+{
+	@synchronized(self) {
+		return (_metrics ? YES : NO);
+	}
+}
+
+- (CDEventsMetrics)metrics
+{
+	CDEventsMetrics metrics;
+	memset(&metrics, 0, sizeof(metrics));
+	
+	std::shared_ptr<cdevents::StreamMetrics> streamMetrics;
+	@synchronized(self) {
+		streamMetrics = _metrics;
+	}
+	if (!streamMetrics) {
+		return metrics;
+	}
+	
+	cdevents::StreamMetricsSnapshot snapshot;
+	streamMetrics->read(snapshot);
+	metrics.receivedEventCount				= snapshot.counters[cdevents::kMetricsCounterEventsReceived];
+	metrics.excludedEventCount				= snapshot.counters[cdevents::kMetricsCounterEventsExcluded];
+	metrics.subDirectoryEventCount			= snapshot.counters[cdevents::kMetricsCounterEventsInSubDirectories];
+	metrics.deliveredEventCount				= snapshot.counters[cdevents::kMetricsCounterEventsDelivered];
+	metrics.deliveredBatchCount				= snapshot.counters[cdevents::kMetricsCounterBatchesDelivered];
+	metrics.droppedEventReportCount			= snapshot.counters[cdevents::kMetricsCounterDroppedEventReports];
+	metrics.rescanRequestCount				= snapshot.counters[cdevents::kMetricsCounterRescanRequests];
+	metrics.queueWaitLatency				= CDEventsLatencySummaryFromSnapshot(snapshot.stages[cdevents::kMetricsStageQueueWait]);
+	metrics.filteringLatency				= CDEventsLatencySummaryFromSnapshot(snapshot.stages[cdevents::kMetricsStageFiltering]);
+	metrics.eventConstructionLatency		= CDEventsLatencySummaryFromSnapshot(snapshot.stages[cdevents::kMetricsStageObjectConstruction]);
+	metrics.blockLatency					= CDEventsLatencySummaryFromSnapshot(snapshot.stages[cdevents::kMetricsStageClient]);
+	
+	return metrics;
+}
+
+
+#pragma mark Recording
+- (void)setRecordingURL:(NSURL *)URL
+{
+	NSURL *recordingURL = [URL copy];
+	std::shared_ptr<cdevents::EventRecorder> recorder;
+	if (recordingURL) {
+		recorder = std::make_shared<cdevents::EventRecorder>();
+		if (!recorder->open(std::string([[recordingURL path] fileSystemRepresentation]))) {
+			[NSException raise:NSInvalidArgumentException
+						format:@"Failed to create the event log %@.", recordingURL];
+		}
+	}
+	
+	@synchronized(self) {
+		if (!recorder && !_recorder) {
+			return;
+		}
+		
+		// The stream being replaced keeps recording until it is disposed of,
+		// the log is closed once the last reference to the recorder is gone.
+		_recordingURL = recordingURL;
+		_recorder = recorder;
+	}
+	
+	[self recreateEventStream];
+}
+
+- (NSURL *)recordingURL
+{
+	@synchronized(self) {
+		return _recordingURL;
+	}
+}
+
+
+#pragma mark Watched URLs methods
+- (void)addWatchedURLs:(NSArray *)URLs
+{
+	NSMutableArray *watchedURLs = [[self watchedURLs] mutableCopy];
+	for (NSURL *URL in URLs) {
+		if (![watchedURLs containsObject:URL]) {
+			[watchedURLs addObject:URL];
+		}
+	}
+	
+	[self updateWatchedURLs:watchedURLs];
+}
+
+- (void)removeWatchedURLs:(NSArray *)URLs
+{
+	NSMutableArray *watchedURLs = [[self watchedURLs] mutableCopy];
+	[watchedURLs removeObjectsInArray:URLs];
+	
+	[self updateWatchedURLs:watchedURLs];
+}
+
+- (void)updateWatchedURLs:(NSArray *)URLs
+{
+	const std::vector<std::string> paths = CDEventsPathsFromURLs(URLs);
+	
+	@synchronized(self) {
+		if ([URLs isEqualToArray:_watchedURLs]) {
+			return;
+		}
+		[self setWatchedURLs:URLs];
+	}
+	
+	// The stream is updated outside the lock: it may wait for the backend
+	// thread, which may in turn be delivering events needing the lock.
+	if (_eventStream) {
+		_eventStream->setWatchedPaths(paths);
+	} else if (_sharedStream) {
+		_sharedStream->setWatchedPaths(_sharedStreamSubscriber, paths);
+	}
+}
+
+
+#pragma mark Flush methods
+- (void)flushSynchronously
+{
+	if (_sharedStream) {
+		_sharedStream->flushSynchronously();
+	} else {
+		_eventStream->flushSynchronously();
+	}
+}
+
+- (void)flushAsynchronously
+{
+	if (_sharedStream) {
+		_sharedStream->flushAsynchronously();
+	} else {
+		_eventStream->flushAsynchronously();
+	}
+}
+
+
+#pragma mark Rescanning
+- (void)rescan
+{
+	// A shared event stream does not rescan for its watchers.
+	if (!_eventStream) {
+		[self postRescanEvents];
+		return;
+	}
+	
+	if (!_rescanDeliversEvents) {
+		_rescanDeliversEvents = std::make_shared<std::atomic<bool> >(true);
+	}
+	
+	// The rescan is stopped before the watcher goes away, so it need not be retained.
+	__unsafe_unretained CDEvents *watcher = self;
+	std::shared_ptr<std::atomic<bool> > deliversEvents = _rescanDeliversEvents;
+	_eventStream->rescan([watcher, deliversEvents](const cdevents::EventBatch &events, bool) {
+		if (events.empty()) {
+			return;
+		}
+		
+		std::shared_ptr<cdevents::EventBatch> batch = std::make_shared<cdevents::EventBatch>(events);
+		[watcher performOnEventStreamScheduler:^{
+			if (deliversEvents->load()) {
+				CDEventsCallback(watcher, *batch, NULL);
+			}
+		}];
+	});
+}
+
+
+#pragma mark Misc methods
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<%@: %p { watchedURLs = %@ }>",
+			[self className],
+			self,
+			[self watchedURLs]];
+}
+
+- (NSString *)streamDescription
+{
+	const std::string description = (_sharedStream ? _sharedStream->description() : _eventStream->description());
+	return [NSString stringWithUTF8String:description.c_str()];
+}
+
+
+#pragma mark Private API:
+- (void)createEventStream
+{
+	cdevents::StreamConfiguration configuration;
+	configuration.watchedPaths						= CDEventsPathsFromURLs([self watchedURLs]);
+	configuration.excludedPaths						= CDEventsPathsFromURLs([self excludedURLs]);
+	configuration.pathPatterns						= CDEventsStringsFromArray([self excludedPatterns]);
+	configuration.sinceEventIdentifier				= (cdevents::EventIdentifier)[self sinceEventIdentifier];
+	configuration.notificationLatency				= [self notificationLatency];
+	configuration.ignoreEventsFromSubDirectories	= ([self ignoreEventsFromSubDirectories] ? true : false);
+	configuration.honorsIgnoreFiles					= ([self honorsIgnoreFiles] ? true : false);
+	configuration.creationFlags						= (cdevents::StreamCreationFlags)_eventStreamCreationFlags;
+	configuration.deliveryThreadCount				= _deliveryThreadCount;
+	configuration.deliveryQueueCapacity				= _deliveryQueueCapacity;
+	configuration.overflowPolicy					= (cdevents::OverflowPolicy)_overflowPolicy;
+	configuration.coalescingWindow					= _coalescingWindow;
+	configuration.pairsRenames						= (_pairsRenames ? true : false);
+	configuration.identityTracker					= _identityTracker;
+	configuration.contentVerifier					= _contentVerifier;
+	configuration.minimumNotificationLatency		= _minimumNotificationLatency;
+	configuration.snapshot							= _snapshot;
+	configuration.metrics							= _metrics;
+	configuration.recorder							= _recorder;
+	configuration.resumesEarlierStream				= (_resumesEventStream ? true : false);
+	if (_checkpointStore) {
+		configuration.checkpointStore				= [_checkpointStore coreStore];
+		configuration.checkpointKey					= std::string([_checkpointKey UTF8String]);
+	}
+	
+	// The stream is owned by us, so it must not retain us in return.
+	__unsafe_unretained CDEvents *watcher = self;
+	
+	// Watchers asking for past events, keeping a checkpoint, a snapshot,
+	// metrics or a recording, merging events, pairing renames, tracking file
+	// identities or verifying contents, adapting the latency, honoring ignore
+	// files or delivering concurrently need a stream of their own.
+	if ([CDEvents sharesEventStreams] &&
+		configuration.sinceEventIdentifier == cdevents::kEventIdentifierSinceNow &&
+		!configuration.checkpointStore &&
+		!configuration.snapshot &&
+		!configuration.metrics &&
+		!configuration.recorder &&
+		configuration.overflowPolicy == cdevents::kOverflowPolicyBlock &&
+		configuration.coalescingWindow <= 0.0 &&
+		!configuration.pairsRenames &&
+		!configuration.identityTracker &&
+		!configuration.contentVerifier &&
+		configuration.minimumNotificationLatency <= 0.0 &&
+		!configuration.honorsIgnoreFiles &&
+		_deliveryThreadCount <= 1) {
+		_sharedStream = CDEventsSharedStream(_runLoop, _dispatchQueue, configuration);
+		try {
+			_sharedStreamSubscriber = _sharedStream->addSubscriber(configuration.watchedPaths,
+																   configuration.excludedPaths,
+																   configuration.ignoreEventsFromSubDirectories,
+																   [watcher](const cdevents::EventBatch &events) {
+				CDEventsCallback(watcher, events, NULL);
+			});
+			_sharedStream->setPathPatterns(_sharedStreamSubscriber, configuration.pathPatterns);
+		} catch (const cdevents::StreamCreationFailure &failure) {
+			_sharedStream.reset();
+			[NSException raise:CDEventsEventStreamCreationFailureException
+						format:@"Failed to create event stream (%s).", failure.what()];
+		}
+		return;
+	}
+	
+	std::unique_ptr<cdevents::Backend> backend(_dispatchQueue ?
+											   new cdevents::FSEventsBackend(_dispatchQueue) :
+											   new cdevents::FSEventsBackend([_runLoop getCFRunLoop]));
+	std::shared_ptr<cdevents::StreamMetrics> metrics = configuration.metrics;
+	_eventStream.reset(new cdevents::Stream(std::move(backend),
+											configuration,
+											[watcher, metrics](cdevents::Stream &, const cdevents::EventBatch &events) {
+												CDEventsCallback(watcher, events, metrics.get());
+											}));
+	
+	try {
+		_eventStream->create();
+	} catch (const cdevents::StreamCreationFailure &failure) {
+		_eventStream.reset();
+		[NSException raise:CDEventsEventStreamCreationFailureException
+					format:@"Failed to create event stream (%s).", failure.what()];
+	}
+	
+	if (_eventStream->resumedWithoutHistory()) {
+		[self postRescanEvents];
+	}
+}
+
+- (void)postRescanEvents
+{
+	// Delivered like any other batch, on the run loop or queue of the stream.
+	std::shared_ptr<cdevents::EventBatch> events = std::make_shared<cdevents::EventBatch>();
+	const cdevents::EventIdentifier identifier = (cdevents::EventIdentifier)[CDEvents currentEventIdentifier];
+	const double timestamp = [[NSDate date] timeIntervalSince1970];
+	const std::vector<std::string> paths = CDEventsPathsFromURLs([self watchedURLs]);
+	for (size_t i = 0; i < paths.size(); ++i) {
+		events->append(identifier, cdevents::kEventFlagMustScanSubDirs, timestamp, paths[i].data(), paths[i].size());
+	}
+	if (events->empty()) {
+		return;
+	}
+	
+	CDEvents *watcher = self;
+	[self performOnEventStreamScheduler:^{
+		CDEventsCallback(watcher, *events, NULL);
+	}];
+}
+
+- (void)performOnEventStreamScheduler:(void (^)(void))block
+{
+	if (_dispatchQueue) {
+		dispatch_async(_dispatchQueue, block);
+	} else {
+		CFRunLoopRef runLoop = [_runLoop getCFRunLoop];
+		CFRunLoopPerformBlock(runLoop, kCFRunLoopDefaultMode, block);
+		CFRunLoopWakeUp(runLoop);
+	}
+}
+
+- (void)disposeEventStream
+{
+	if (_sharedStream) {
+		_sharedStream->removeSubscriber(_sharedStreamSubscriber);
+		_sharedStream.reset();
+		return;
+	}
+	
+	if (!(_eventStream)) {
+		return;
+	}
+	
+	_eventStream->dispose();
+	_eventStream.reset();
+	
+	// Disposing stopped the rescan, its batches not yet delivered are dropped.
+	if (_rescanDeliversEvents) {
+		_rescanDeliversEvents->store(false);
+		_rescanDeliversEvents.reset();
+	}
+	
+	std::shared_ptr<cdevents::DirectorySnapshot> snapshot;
+	NSURL *snapshotURL;
+	@synchronized(self) {
+		snapshot = _snapshot;
+		snapshotURL = _snapshotURL;
+	}
+	if (snapshot && snapshotURL) {
+		snapshot->save(std::string([[snapshotURL path] fileSystemRepresentation]));
+	}
+}
+
+- (void)recreateEventStream
+{
+	// Not done while locked, as disposing waits for deliveries which may need the lock.
+	cdevents::EventIdentifier lastEventIdentifier = cdevents::kEventIdentifierSinceNow;
+	if (_eventStream) {
+		lastEventIdentifier = _eventStream->lastEventIdentifier();
+	}
+	[self disposeEventStream];
+	
+	// The new stream skips what the old one delivered already, the end of
+	// the replay included, as the backend does when it restarts its own.
+	if (lastEventIdentifier != cdevents::kEventIdentifierSinceNow) {
+		_sinceEventIdentifier = (CDEventIdentifier)lastEventIdentifier;
+		_resumesEventStream = YES;
+	}
+	[self createEventStream];
+	_resumesEventStream = NO;
+}
+
+static std::shared_ptr<cdevents::StreamMultiplexer> CDEventsSharedStream(
+	NSRunLoop *runLoop,
+	dispatch_queue_t dispatchQueue,
+	const cdevents::StreamConfiguration &configuration)
+{
+	CFRunLoopRef cfRunLoop = (dispatchQueue ? NULL : [runLoop getCFRunLoop]);
+	const CDEventsSharedStreamKey key((dispatchQueue ? (const void *)dispatchQueue : (const void *)cfRunLoop),
+									  configuration.notificationLatency,
+									  (CDEventsEventStreamCreationFlags)configuration.creationFlags);
+	
+	std::lock_guard<std::mutex> lock(sSharedStreamsMutex);
+	std::shared_ptr<cdevents::StreamMultiplexer> sharedStream = sSharedStreams[key].lock();
+	if (sharedStream) {
+		return sharedStream;
+	}
+	
+	// Keep the run loop or queue alive for as long as the shared stream may be recreated on it.
+	std::shared_ptr<const void> scheduler;
+	if (dispatchQueue) {
+		dispatch_retain(dispatchQueue);
+		scheduler.reset(dispatchQueue, [](const void *queue) {
+			dispatch_release((dispatch_queue_t)queue);
+		});
+	} else {
+		scheduler.reset(CFRetain(cfRunLoop), [](const void *loop) {
+			CFRelease(loop);
+		});
+	}
+	
+	sharedStream.reset(new cdevents::StreamMultiplexer([scheduler, dispatchQueue, cfRunLoop]() {
+		return std::unique_ptr<cdevents::Backend>(dispatchQueue ?
+												  new cdevents::FSEventsBackend(dispatchQueue) :
+												  new cdevents::FSEventsBackend(cfRunLoop));
+	}, configuration));
+	
+	// Drop the entries of shared streams whose watchers have all gone away.
+	for (auto it = sSharedStreams.begin(); it != sSharedStreams.end(); ) {
+		if (it->second.expired()) {
+			it = sSharedStreams.erase(it);
+		} else {
+			++it;
+		}
+	}
+	sSharedStreams[key] = sharedStream;
+	
+	return sharedStream;
+}
+
+static std::string CDEventsPathFromURL(NSURL *URL)
+{
+	return std::string([[[URL path] stringByStandardizingPath] fileSystemRepresentation]);
+}
+
+static std::vector<std::string> CDEventsPathsFromURLs(NSArray *URLs)
+{
+	std::vector<std::string> paths;
+	paths.reserve([URLs count]);
+	for (NSURL *URL in URLs) {
+		paths.push_back(CDEventsPathFromURL(URL));
+	}
+	
+	return paths;
+}
+
+static std::vector<std::string> CDEventsStringsFromArray(NSArray *strings)
+{
+	std::vector<std::string> coreStrings;
+	coreStrings.reserve([strings count]);
+	for (NSString *string in strings) {
+		coreStrings.push_back(std::string([string UTF8String]));
+	}
+	
+	return coreStrings;
+}
+
+static CDEventsLatencySummary CDEventsLatencySummaryFromSnapshot(const cdevents::LatencyHistogramSnapshot &snapshot)
+{
+	CDEventsLatencySummary summary;
+	summary.count				= snapshot.count;
+	summary.meanNanoseconds		= snapshot.mean();
+	summary.p50Nanoseconds		= snapshot.percentile(0.5);
+	summary.p90Nanoseconds		= snapshot.percentile(0.9);
+	summary.p99Nanoseconds		= snapshot.percentile(0.99);
+	summary.maximumNanoseconds	= snapshot.maximum;
+	
+	return summary;
+}
+
+static void CDEventsCallback(
+	CDEvents *watcher,
+	const cdevents::EventBatch &events,
+	cdevents::StreamMetrics *metrics)
+{
+	// The events have already been standardized and filtered by the stream.
+	if (events.empty()) {
+		return;
+	}
+	
+	CDEventsRecordBlock recordBlock = [watcher recordBlock];
+	if (recordBlock) {
+		// Concurrent deliveries cannot share the batch object.
+		CDEventBatch *batch = (watcher->_deliveryThreadCount > 1 ? [[CDEventBatch alloc] init] : watcher->_recordBatch);
+		[batch setCoreBatch:&events];
+		const uint64_t blockTime = (metrics ? cdevents::monotonicNanoseconds() : 0);
+		recordBlock(watcher, batch);
+		if (metrics) {
+			metrics->record(cdevents::kMetricsStageClient, cdevents::monotonicNanoseconds() - blockTime);
+		}
+		[batch setCoreBatch:NULL];
+		
+		[watcher setLastEventRecord:events.back() path:events.path(events.size() - 1) sourcePath:events.sourcePath(events.size() - 1)];
+		return;
+	}
+	
+	CDEventsEventBlock eventBlock	= [watcher eventBlock];
+	CDEventsBatchBlock batchBlock	= [watcher batchBlock];
+	NSMutableArray *batch			= (batchBlock ? [NSMutableArray arrayWithCapacity:events.size()] : nil);
+	CDEvent *lastEvent				= nil;
+	
+	// The time spent creating the events and in the blocks, in nanoseconds.
+	uint64_t constructionTime = 0;
+	uint64_t blockTime = 0;
+	uint64_t startTime = (metrics ? cdevents::monotonicNanoseconds() : 0);
+	
+	for (size_t i = 0; i < events.size(); ++i) {
+		CDEvent *event = [CDEventBatch eventWithRecord:events[i] path:events.path(i) sourcePath:events.sourcePath(i)];
+		lastEvent = event;
+		
+		if (batchBlock) {
+			[batch addObject:event];
+		} else if (metrics) {
+			const uint64_t eventTime = cdevents::monotonicNanoseconds();
+			constructionTime += eventTime - startTime;
+			eventBlock(watcher, event);
+			startTime = cdevents::monotonicNanoseconds();
+			blockTime += startTime - eventTime;
+		} else {
+			eventBlock(watcher, event);
+		}
+	}
+	
+	if (batchBlock && [batch count] > 0) {
+		if (metrics) {
+			const uint64_t batchTime = cdevents::monotonicNanoseconds();
+			constructionTime = batchTime - startTime;
+			batchBlock(watcher, batch);
+			blockTime = cdevents::monotonicNanoseconds() - batchTime;
+		} else {
+			batchBlock(watcher, batch);
+		}
+	}
+	
+	if (metrics) {
+		metrics->record(cdevents::kMetricsStageObjectConstruction, constructionTime);
+		metrics->record(cdevents::kMetricsStageClient, blockTime);
+	}
+	
+	if (lastEvent) {
+		[watcher setLastEvent:lastEvent];
+	}
+}
+
+@end
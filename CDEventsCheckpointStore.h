@@ -0,0 +1,123 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDEventsCheckpointStore.h CDEvents/CDEventsCheckpointStore.h
+ * A file recording how far CDEvents objects have delivered events.
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "CDEvent.h"
+
+
+#pragma mark -
+#pragma mark CDEventsCheckpointStore interface
+/**
+ * Durably records the identifier of the last event each watcher fully delivered, so that it can resume after a restart.
+ *
+ * A <code>CDEvents</code> object created with a checkpoint store records a
+ * checkpoint after each batch of events has been delivered to its block or
+ * delegate, and resumes from its checkpoint when created again with the same
+ * key. Recording is cheap: the checkpoints are written to the file by a
+ * background thread at most once per synchronization interval, replacing the
+ * file atomically so that a crash leaves either the old or the new
+ * checkpoints. After a crash the events of the last interval may be
+ * delivered again.
+ *
+ * The store is thread-safe and may be shared by any number of watchers, each
+ * with its own key.
+ *
+ * @see CDEvents
+ *
+ * @since head
+ */
+@interface CDEventsCheckpointStore : NSObject {}
+
+/** @name Creating Checkpoint Stores */
+/**
+ * Returns a checkpoint store kept in the file at the given URL, synchronized to disk once per second.
+ *
+ * @param fileURL The file URL of the store, created if it does not exist.
+ * @return A checkpoint store initialized with the checkpoints in the file.
+ *
+ * @see initWithURL:synchronizationInterval:
+ *
+ * @since head
+ */
+- (id)initWithURL:(NSURL *)fileURL;
+
+/**
+ * Returns a checkpoint store kept in the file at the given URL.
+ *
+ * @param fileURL The file URL of the store, created if it does not exist.
+ * @param synchronizationInterval The time in seconds after a checkpoint is recorded until it is written to disk.
+ * @return A checkpoint store initialized with the checkpoints in the file.
+ * @throws NSInvalidArgumentException if <em>fileURL</em> is <code>nil</code> or not a file URL.
+ *
+ * @since head
+ */
+- (id)initWithURL:(NSURL *)fileURL synchronizationInterval:(NSTimeInterval)synchronizationInterval;
+
+/** @name Accessing Checkpoints */
+/**
+ * The file URL of the store.
+ *
+ * @since head
+ */
+@property (readonly) NSURL	*URL;
+
+/**
+ * Returns the identifier of the last event delivered by the watcher with the given key.
+ *
+ * @param key The key of the watcher.
+ * @return The event identifier, or kCDEventsSinceEventNow if there is no checkpoint for the key.
+ *
+ * @since head
+ */
+- (CDEventIdentifier)eventIdentifierForKey:(NSString *)key;
+
+/**
+ * Removes the checkpoint of the given key, the next watcher created with it starts with events since now.
+ *
+ * @param key The key of the watcher.
+ *
+ * @since head
+ */
+- (void)removeCheckpointForKey:(NSString *)key;
+
+/**
+ * Writes the recorded checkpoints to disk now, instead of at the end of the synchronization interval.
+ *
+ * @return <code>YES</code> if the checkpoints are on disk, otherwise <code>NO</code>.
+ *
+ * @since head
+ */
+- (BOOL)synchronize;
+
+@end
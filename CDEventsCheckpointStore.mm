@@ -0,0 +1,99 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#import "CDEventsCheckpointStorePrivate.h"
+
+#include <string>
+
+
+@implementation CDEventsCheckpointStore
+
+#pragma mark Properties
+@synthesize URL			= _URL;
+
+
+#pragma mark Init/dealloc
+- (id)initWithURL:(NSURL *)fileURL
+{
+	return [self initWithURL:fileURL synchronizationInterval:cdevents::kDefaultCheckpointSynchronizationInterval];
+}
+
+- (id)initWithURL:(NSURL *)fileURL synchronizationInterval:(NSTimeInterval)synchronizationInterval
+{
+	if (fileURL == nil || ![fileURL isFileURL]) {
+		[NSException raise:NSInvalidArgumentException
+					format:@"Invalid arguments passed to CDEventsCheckpointStore init-method."];
+	}
+	
+	if ((self = [super init])) {
+		_URL = [fileURL copy];
+		_coreStore = std::make_shared<cdevents::CheckpointStore>(std::string([[fileURL path] fileSystemRepresentation]),
+																 synchronizationInterval);
+	}
+	
+	return self;
+}
+
+
+#pragma mark Checkpoints
+- (std::shared_ptr<cdevents::CheckpointStore>)coreStore
+{
+	return _coreStore;
+}
+
+- (CDEventIdentifier)eventIdentifierForKey:(NSString *)key
+{
+	cdevents::CheckpointStore::Checkpoint checkpoint;
+	if (!_coreStore->checkpoint(std::string([key UTF8String]), checkpoint)) {
+		return (CDEventIdentifier)cdevents::kEventIdentifierSinceNow;
+	}
+	
+	return (CDEventIdentifier)checkpoint.identifier;
+}
+
+- (void)removeCheckpointForKey:(NSString *)key
+{
+	_coreStore->remove(std::string([key UTF8String]));
+}
+
+- (BOOL)synchronize
+{
+	return (_coreStore->synchronize() ? YES : NO);
+}
+
+
+#pragma mark Misc methods
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<%@: %p { URL = %@ }>",
+			[self className],
+			self,
+			[self URL]];
+}
+
+@end
@@ -67,5 +67,24 @@
  */
 - (void)URLWatcher:(CDEvents *)URLWatcher eventOccurred:(CDEvent *)event;
 
+@optional
+/**
+ * The method called by the <code>CDEvents</code> object on its delegate object with a whole batch of events.
+ *
+ * @param URLWatcher The <code>CDEvents</code> object which the events were recieved thru.
+ * @param events An array of <code>CDEvent</code> objects, in the order they occurred.
+ *
+ * @see CDEvents
+ * @see CDEvent
+ * @see URLWatcher:eventOccurred:
+ *
+ * @discussion If the delegate implements this method it is called once for
+ * every batch of events delivered by the event stream <em>instead</em> of
+ * calling URLWatcher:eventOccurred: once per event.
+ *
+ * @since head
+ */
+- (void)URLWatcher:(CDEvents *)URLWatcher eventsOccurred:(NSArray *)events;
+
 @end
 
@@ -0,0 +1,82 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreAdaptiveLatency.h"
+
+#include <algorithm>
+
+namespace cdevents {
+
+#pragma mark Constants
+// Batches expected to be larger than this at the current latency are worth
+// waiting longer for.
+static const double kLargeBatchSize = 256.0;
+
+// Batches expected to be smaller than this mean the burst is over.
+static const double kSmallBatchSize = 32.0;
+
+// The weight of the latest batch in the moving average of the rate.
+static const double kRateWeight = 0.5;
+
+
+#pragma mark Init
+AdaptiveLatency::AdaptiveLatency(double minimum, double maximum)
+:	_minimum(minimum),
+	_maximum(std::max(minimum, maximum)),
+	_latency(minimum),
+	_rate(0.0),
+	_observed(false)
+{
+}
+
+
+#pragma mark Adapting
+bool AdaptiveLatency::observe(size_t count, std::chrono::steady_clock::time_point time)
+{
+	// Batches arrive no more often than the latency, a longer interval means
+	// the stream was idle in between.
+	double interval = _latency;
+	if (_observed) {
+		interval = std::max(_latency, std::chrono::duration<double>(time - _lastBatchTime).count());
+	}
+	const double rate = (double)count / interval;
+	_rate = (_observed ? (kRateWeight * rate + (1.0 - kRateWeight) * _rate) : rate);
+	_lastBatchTime = time;
+	_observed = true;
+	
+	const double previous = _latency;
+	if ((double)count < kSmallBatchSize || _rate * _latency < kSmallBatchSize) {
+		_latency = _minimum;
+	} else if (_rate * _latency > kLargeBatchSize) {
+		_latency = std::min(_latency * 2.0, _maximum);
+	}
+	
+	return (_latency != previous);
+}
+
+} // namespace cdevents
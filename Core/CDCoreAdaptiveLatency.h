@@ -0,0 +1,87 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreAdaptiveLatency.h
+ * Picks the notification latency of a stream from the load it is under.
+ */
+
+#ifndef CD_CORE_ADAPTIVE_LATENCY_H
+#define CD_CORE_ADAPTIVE_LATENCY_H
+
+#include <stddef.h>
+#include <chrono>
+
+namespace cdevents {
+
+/**
+ * Adapts the notification latency of a stream to the rate events arrive at.
+ *
+ * While events are sparse the latency is kept at the minimum so that they
+ * are delivered promptly. When a burst makes the batches large, the latency
+ * is doubled, up to the maximum, so that fewer and larger batches amortize
+ * the cost of each delivery. As soon as a batch is small again the latency
+ * drops back to the minimum.
+ *
+ * The controller only computes the latency, the stream applies it to its
+ * backend. It is not thread-safe; it is fed from the thread of the backend.
+ *
+ * @since head
+ */
+class AdaptiveLatency {
+public:
+	AdaptiveLatency(double minimum, double maximum);
+	
+	/**
+	 * The latency batches should be delivered with, in seconds.
+	 */
+	double latency() const { return _latency; }
+	
+	/**
+	 * Takes a batch of <em>count</em> events received at <em>time</em> into account.
+	 *
+	 * @return Whether the latency changed.
+	 */
+	bool observe(size_t count, std::chrono::steady_clock::time_point time);
+	
+private:
+	AdaptiveLatency(const AdaptiveLatency &);
+	AdaptiveLatency &operator=(const AdaptiveLatency &);
+	
+	double								_minimum;
+	double								_maximum;
+	double								_latency;
+	// The moving average of the events per second.
+	double								_rate;
+	std::chrono::steady_clock::time_point	_lastBatchTime;
+	bool								_observed;
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_ADAPTIVE_LATENCY_H
@@ -0,0 +1,290 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreBackend.h
+ * The interface between the CDEvents core and the platform event sources.
+ */
+
+#ifndef CD_CORE_BACKEND_H
+#define CD_CORE_BACKEND_H
+
+#include <stddef.h>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "CDCoreEvent.h"
+
+namespace cdevents {
+
+class CheckpointStore;
+class ContentVerifier;
+class DirectorySnapshot;
+class EventRecorder;
+class FileIdentityTracker;
+class StreamMetrics;
+
+
+#pragma mark -
+#pragma mark Stream configuration
+/**
+ * The default notification latency, in seconds.
+ *
+ * @since head
+ */
+const double kDefaultNotificationLatency = 3.0;
+
+/**
+ * The default stream creation flags.
+ *
+ * @since head
+ */
+const StreamCreationFlags kDefaultStreamCreationFlags = (kStreamCreationFlagUseCFTypes |
+														 kStreamCreationFlagWatchRoot);
+
+/**
+ * The default number of batches which may wait for a delivery thread.
+ *
+ * @since head
+ */
+const size_t kDefaultDeliveryQueueCapacity = 16;
+
+/**
+ * What a stream does with a batch when the queue to its delivery threads is full.
+ *
+ * @since head
+ */
+enum OverflowPolicy {
+	/** Hold up the backend until there is room. The platform may then drop events itself. */
+	kOverflowPolicyBlock,
+	/** Drop the oldest queued batch to make room, and deliver one event telling the client to rescan the watched paths after the batches queued before it. The checkpoint stays before the dropped batch until then. */
+	kOverflowPolicyDropOldest,
+	/** Drop the batch, and deliver one event telling the client to rescan the watched paths in its place. */
+	kOverflowPolicyRescan
+};
+
+/**
+ * The parameters a stream, and its backend, is created with.
+ *
+ * @since head
+ */
+struct StreamConfiguration {
+	/** The paths to watch. */
+	std::vector<std::string>	watchedPaths;
+	/** The paths (and their sub-directories) events should be ignored from. */
+	std::vector<std::string>	excludedPaths;
+	/** The glob and regular expression patterns of paths events should be ignored from, see PathMatcher. */
+	std::vector<std::string>	pathPatterns;
+	/** Events that have happened after this identifier will be supplied. */
+	EventIdentifier				sinceEventIdentifier;
+	/** Whether the stream takes over from one which delivered the events up to sinceEventIdentifier, so that neither the events replayed up to it nor the end of the replay are delivered again. */
+	bool						resumesEarlierStream;
+	/** The (approximate) time interval between notifications, in seconds. */
+	double						notificationLatency;
+	/** The lowest latency the stream may pick, between it and notificationLatency, for the load it is under. 0 to always use notificationLatency. */
+	double						minimumNotificationLatency;
+	/** Whether events from sub-directories of the watched paths should be ignored. */
+	bool						ignoreEventsFromSubDirectories;
+	/** Whether events should be ignored according to the .gitignore and .ignore files in the watched paths, see IgnoreFileCache. */
+	bool						honorsIgnoreFiles;
+	/** Whether the two halves of a rename are delivered as one event, whose source path is where the item was moved from. */
+	bool						pairsRenames;
+	/** The stream creation flags. */
+	StreamCreationFlags			creationFlags;
+	/** The number of threads filtering and delivering batches, 0 to do so on the thread of the backend. */
+	size_t						deliveryThreadCount;
+	/** The number of batches which may wait for a delivery thread before the overflow policy applies. */
+	size_t						deliveryQueueCapacity;
+	/** What to do with a batch when deliveryQueueCapacity batches are already waiting. */
+	OverflowPolicy				overflowPolicy;
+	/** Events for the same path within this many seconds are merged into one, 0 to deliver every event. Raises the latency to at least the window. */
+	double						coalescingWindow;
+	/** The store the stream records the last delivered event in, and resumes from when created. May be null. */
+	std::shared_ptr<CheckpointStore>	checkpointStore;
+	/** The key of the stream in the checkpoint store. */
+	std::string					checkpointKey;
+	/** The snapshot of the watched trees rescans are answered from, built when the stream is created if empty. May be null. */
+	std::shared_ptr<DirectorySnapshot>	snapshot;
+	/** The number of threads walking the watched trees when they are rescanned, 0 for one per processor. */
+	size_t						rescanThreadCount;
+	/** The counters and latency histograms the stream records into, see StreamMetrics. May be null. */
+	std::shared_ptr<StreamMetrics>	metrics;
+	/** The log every batch reported by the backend is recorded to, before it is filtered, see EventRecorder. May be null. */
+	std::shared_ptr<EventRecorder>	recorder;
+	/** The tracker giving events the identities of their items and recognizing moves and atomic saves with them, see FileIdentityTracker. May be null. */
+	std::shared_ptr<FileIdentityTracker>	identityTracker;
+	/** The verifier hashing the files of the events and dropping the modifications which left their contents unchanged, see ContentVerifier. May be null. */
+	std::shared_ptr<ContentVerifier>	contentVerifier;
+	
+	StreamConfiguration()
+	:	sinceEventIdentifier(kEventIdentifierSinceNow),
+		resumesEarlierStream(false),
+		notificationLatency(kDefaultNotificationLatency),
+		minimumNotificationLatency(0.0),
+		ignoreEventsFromSubDirectories(false),
+		honorsIgnoreFiles(false),
+		pairsRenames(false),
+		creationFlags(kDefaultStreamCreationFlags),
+		deliveryThreadCount(0),
+		deliveryQueueCapacity(kDefaultDeliveryQueueCapacity),
+		overflowPolicy(kOverflowPolicyBlock),
+		coalescingWindow(0.0),
+		rescanThreadCount(0)
+	{}
+};
+
+/**
+ * The exception thrown if a backend failed to create its event stream.
+ *
+ * @see CDEventsEventStreamCreationFailureException
+ *
+ * @since head
+ */
+class StreamCreationFailure : public std::runtime_error {
+public:
+	explicit StreamCreationFailure(const std::string &reason)
+	:	std::runtime_error(reason)
+	{}
+};
+
+
+#pragma mark -
+#pragma mark Backend
+/**
+ * An event as reported by a backend, before filtering.
+ *
+ * The path is only valid for the duration of the handler call.
+ *
+ * @since head
+ */
+struct RawEvent {
+	const char		*path;
+	size_t			pathLength;
+	EventFlags		flags;
+	EventIdentifier	identifier;
+	/** The same for both halves of a rename, such as the cookie of inotify, or 0 if the backend cannot tell which events belong together. */
+	uint64_t		renameCookie;
+};
+
+/**
+ * The handler a backend calls with every batch of events it receives.
+ *
+ * @since head
+ */
+typedef std::function<void (const RawEvent *events, size_t count)> BackendHandler;
+
+/**
+ * A source of file system events.
+ *
+ * A backend owns the platform event stream and reports batches of raw events
+ * to its handler. Filtering, standardization and delivery is done by the
+ * Stream which owns the backend.
+ *
+ * @see Stream
+ *
+ * @since head
+ */
+class Backend {
+public:
+	virtual ~Backend() {}
+	
+	/**
+	 * Creates and starts the platform event stream.
+	 *
+	 * @throws StreamCreationFailure if the event stream could not be created.
+	 */
+	virtual void start(const StreamConfiguration &configuration, const BackendHandler &handler) = 0;
+	
+	/**
+	 * Stops and disposes of the platform event stream. Must not be called from within the handler.
+	 */
+	virtual void stop() = 0;
+	
+	/**
+	 * Changes the notification latency of the running event stream. Must be called from within the handler.
+	 *
+	 * No events are lost or delivered twice. A backend which cannot change
+	 * the latency of its event stream recreates it, once the handler has
+	 * returned, from the last event it delivered.
+	 */
+	virtual void setNotificationLatency(double latency) = 0;
+	
+	/**
+	 * Changes the watched paths of the running event stream. Must not be called from within the handler.
+	 *
+	 * No events of the paths watched before and after are lost or delivered
+	 * twice. Events of added paths are reported from when they are watched.
+	 */
+	virtual void setWatchedPaths(const std::vector<std::string> &paths) = 0;
+	
+	/**
+	 * Delivers events that have already occurred but not yet been delivered, and waits until they have been.
+	 */
+	virtual void flushSynchronously() = 0;
+	
+	/**
+	 * Delivers events that have already occurred but not yet been delivered, without waiting.
+	 */
+	virtual void flushAsynchronously() = 0;
+	
+	/**
+	 * The most recent event identifier handed out by the backend.
+	 */
+	virtual EventIdentifier currentEventIdentifier() const = 0;
+	
+	/**
+	 * Identifies the event history the identifiers of the given path belong to, or returns an empty string if the backend keeps no history.
+	 *
+	 * Identifiers can only be resumed from within the same history. A backend
+	 * without history reports a rescan of the watched paths instead of
+	 * replaying the events since an identifier.
+	 */
+	virtual std::string historyIdentifier(const std::string &path) const { (void)path; return std::string(); }
+	
+	/**
+	 * A description of the event stream, for debugging only.
+	 */
+	virtual std::string description() const = 0;
+};
+
+/**
+ * Creates the default backend of the platform: FSEvents scheduled on the
+ * current run loop on OS X, inotify on Linux.
+ *
+ * @return The default backend, or <code>nullptr</code> if the platform has none.
+ *
+ * @since head
+ */
+std::unique_ptr<Backend> createDefaultBackend();
+
+} // namespace cdevents
+
+#endif // CD_CORE_BACKEND_H
@@ -0,0 +1,281 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreCheckpointStore.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utility>
+
+namespace cdevents {
+
+#pragma mark Constants
+static const char *const kCheckpointFileHeader = "CDEventsCheckpoints 1";
+
+// Written in place of an empty history so that every line has three fields.
+static const char *const kNoHistory = "-";
+
+
+#pragma mark Helpers
+// Makes a written file, or the entries of a directory, durable.
+static bool synchronizeDescriptor(int descriptor)
+{
+#if defined(__APPLE__)
+	// fsync only pushes the data to the drive, which may still cache it.
+	if (fcntl(descriptor, F_FULLFSYNC) == 0) {
+		return true;
+	}
+#endif
+	return (fsync(descriptor) == 0);
+}
+
+
+#pragma mark Init/dealloc
+CheckpointStore::CheckpointStore(const std::string &path, double synchronizationInterval)
+:	_path(path),
+	_synchronizationInterval(synchronizationInterval),
+	_generation(0),
+	_writtenGeneration(0),
+	_stopping(false)
+{
+	load();
+	_thread = std::thread(&CheckpointStore::run, this);
+}
+
+CheckpointStore::~CheckpointStore()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_changed.notify_all();
+	_thread.join();
+	
+	synchronize();
+}
+
+
+#pragma mark Checkpoints
+bool CheckpointStore::checkpoint(const std::string &key, Checkpoint &checkpoint) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::map<std::string, Checkpoint>::const_iterator it = _checkpoints.find(key);
+	if (it == _checkpoints.end()) {
+		return false;
+	}
+	
+	checkpoint = it->second;
+	return true;
+}
+
+void CheckpointStore::record(const std::string &key, EventIdentifier identifier, const std::string &history)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		std::map<std::string, Checkpoint>::iterator it = _checkpoints.find(key);
+		if (it == _checkpoints.end()) {
+			it = _checkpoints.insert(std::make_pair(key, Checkpoint())).first;
+		} else if (it->second.identifier == identifier && it->second.history == history) {
+			return;
+		}
+		
+		it->second.identifier = identifier;
+		if (it->second.history != history) {
+			it->second.history = history;
+		}
+		++_generation;
+	}
+	_changed.notify_one();
+}
+
+void CheckpointStore::remove(const std::string &key)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_checkpoints.erase(key) == 0) {
+			return;
+		}
+		++_generation;
+	}
+	_changed.notify_one();
+}
+
+bool CheckpointStore::synchronize()
+{
+	std::lock_guard<std::mutex> writeLock(_writeMutex);
+	
+	std::string contents(kCheckpointFileHeader);
+	contents += '\n';
+	uint64_t generation;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_generation == _writtenGeneration) {
+			return true;
+		}
+		generation = _generation;
+		
+		char identifier[32];
+		for (std::map<std::string, Checkpoint>::const_iterator it = _checkpoints.begin(); it != _checkpoints.end(); ++it) {
+			snprintf(identifier, sizeof(identifier), "%llu ", (unsigned long long)it->second.identifier);
+			contents += identifier;
+			contents += (it->second.history.empty() ? kNoHistory : it->second.history.c_str());
+			contents += ' ';
+			contents += it->first;
+			contents += '\n';
+		}
+	}
+	
+	if (!write(contents)) {
+		return false;
+	}
+	
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (generation > _writtenGeneration) {
+		_writtenGeneration = generation;
+	}
+	return true;
+}
+
+
+#pragma mark Private
+void CheckpointStore::load()
+{
+	FILE *file = fopen(_path.c_str(), "r");
+	if (file == NULL) {
+		return;
+	}
+	
+	char *line = NULL;
+	size_t capacity = 0;
+	ssize_t length;
+	bool header = true;
+	while ((length = getline(&line, &capacity, file)) > 0) {
+		if (line[length - 1] == '\n') {
+			line[--length] = '\0';
+		}
+		
+		// A file of another format is ignored, and overwritten on the next write.
+		if (header) {
+			header = false;
+			if (strcmp(line, kCheckpointFileHeader) != 0) {
+				break;
+			}
+			continue;
+		}
+		
+		char *history = strchr(line, ' ');
+		char *key = (history ? strchr(history + 1, ' ') : NULL);
+		if (key == NULL || key[1] == '\0') {
+			continue;
+		}
+		*history++ = '\0';
+		*key++ = '\0';
+		
+		char *end = NULL;
+		Checkpoint checkpoint;
+		checkpoint.identifier = (EventIdentifier)strtoull(line, &end, 10);
+		if (end == line || *end != '\0') {
+			continue;
+		}
+		if (strcmp(history, kNoHistory) != 0) {
+			checkpoint.history = history;
+		}
+		_checkpoints[key] = checkpoint;
+	}
+	
+	free(line);
+	fclose(file);
+}
+
+bool CheckpointStore::write(const std::string &contents)
+{
+	const std::string temporaryPath = _path + ".tmp";
+	const int descriptor = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (descriptor < 0) {
+		return false;
+	}
+	
+	size_t offset = 0;
+	while (offset < contents.size()) {
+		const ssize_t written = ::write(descriptor, contents.data() + offset, contents.size() - offset);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		offset += (size_t)written;
+	}
+	
+	const bool synchronized = (offset == contents.size() && synchronizeDescriptor(descriptor));
+	close(descriptor);
+	if (!synchronized || rename(temporaryPath.c_str(), _path.c_str()) != 0) {
+		unlink(temporaryPath.c_str());
+		return false;
+	}
+	
+	// The rename itself is only durable once the directory is synced.
+	const std::string::size_type slash = _path.rfind('/');
+	const std::string directory = (slash == std::string::npos ? std::string(".") :
+								   slash == 0 ? std::string("/") : _path.substr(0, slash));
+	const int directoryDescriptor = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+	if (directoryDescriptor >= 0) {
+		synchronizeDescriptor(directoryDescriptor);
+		close(directoryDescriptor);
+	}
+	
+	return true;
+}
+
+void CheckpointStore::run()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (!_stopping) {
+		_changed.wait(lock, [this]() {
+			return (_stopping || _generation != _writtenGeneration);
+		});
+		if (_stopping) {
+			break;
+		}
+		
+		// Gather the changes of a whole interval into one write.
+		_changed.wait_for(lock, _synchronizationInterval, [this]() {
+			return _stopping;
+		});
+		
+		lock.unlock();
+		synchronize();
+		lock.lock();
+	}
+}
+
+} // namespace cdevents
@@ -0,0 +1,146 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreCheckpointStore.h
+ * A file recording how far streams have delivered, so that they can resume after a restart.
+ */
+
+#ifndef CD_CORE_CHECKPOINT_STORE_H
+#define CD_CORE_CHECKPOINT_STORE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "CDCoreEvent.h"
+
+namespace cdevents {
+
+/**
+ * The default interval, in seconds, at which checkpoints are written to disk.
+ *
+ * @since head
+ */
+const double kDefaultCheckpointSynchronizationInterval = 1.0;
+
+
+/**
+ * A durable map from keys to the identifier of the last event a stream fully delivered.
+ *
+ * Recording a checkpoint only updates memory, a background thread writes the
+ * changed checkpoints to disk at most once per synchronization interval. The
+ * file is replaced atomically: written to a temporary file, synced and
+ * renamed over the old one, so a crash leaves either the previous or the new
+ * checkpoints, never a torn file. At most the checkpoints of the last interval
+ * are lost, and resuming from an older checkpoint only delivers some events
+ * again.
+ *
+ * Every checkpoint also records the event history it belongs to (see
+ * Backend::historyIdentifier()); a checkpoint from another history can not be
+ * resumed from.
+ *
+ * Keys must not contain line breaks. The store is thread-safe.
+ *
+ * @since head
+ */
+class CheckpointStore {
+public:
+	/** A recorded checkpoint. */
+	struct Checkpoint {
+		/** The identifier of the last event delivered. */
+		EventIdentifier	identifier;
+		/** The history the identifier belongs to, empty if the backend keeps none. */
+		std::string		history;
+		
+		Checkpoint() : identifier(kEventIdentifierSinceNow) {}
+	};
+	
+	/**
+	 * Returns a store kept in the file at <em>path</em>, loading the checkpoints it already contains.
+	 */
+	explicit CheckpointStore(const std::string &path,
+							 double synchronizationInterval = kDefaultCheckpointSynchronizationInterval);
+	
+	/**
+	 * Writes any unsynchronized checkpoints and stops the background thread.
+	 */
+	~CheckpointStore();
+	
+	const std::string &path() const { return _path; }
+	
+	/**
+	 * Copies the checkpoint of the given key to <em>checkpoint</em>, returns <code>false</code> if there is none.
+	 */
+	bool checkpoint(const std::string &key, Checkpoint &checkpoint) const;
+	
+	/**
+	 * Records the checkpoint of the given key. Cheap, the disk is only written by the background thread.
+	 */
+	void record(const std::string &key, EventIdentifier identifier, const std::string &history);
+	
+	/**
+	 * Removes the checkpoint of the given key.
+	 */
+	void remove(const std::string &key);
+	
+	/**
+	 * Writes the checkpoints to disk now if any changed, and returns whether they are on disk.
+	 */
+	bool synchronize();
+	
+private:
+	CheckpointStore(const CheckpointStore &);
+	CheckpointStore &operator=(const CheckpointStore &);
+	
+	void load();
+	bool write(const std::string &contents);
+	void run();
+	
+	const std::string					_path;
+	const std::chrono::duration<double>	_synchronizationInterval;
+	
+	mutable std::mutex					_mutex;
+	std::map<std::string, Checkpoint>	_checkpoints;
+	uint64_t							_generation;
+	uint64_t							_writtenGeneration;
+	
+	// Serializes the writes of the file.
+	std::mutex							_writeMutex;
+	
+	std::condition_variable				_changed;
+	bool								_stopping;
+	std::thread							_thread;
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_CHECKPOINT_STORE_H
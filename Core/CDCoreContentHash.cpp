@@ -0,0 +1,191 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreContentHash.h"
+
+#include <string.h>
+
+namespace cdevents {
+
+#pragma mark Constants
+static const uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+static const uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+const size_t ContentHasher::kStripeLength;
+
+
+#pragma mark Helpers
+static inline uint64_t rotateLeft(uint64_t value, unsigned int count)
+{
+	return ((value << count) | (value >> (64 - count)));
+}
+
+// The hash is defined on little-endian words.
+static inline uint64_t read64(const unsigned char *bytes)
+{
+	uint64_t value;
+	memcpy(&value, bytes, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	value = __builtin_bswap64(value);
+#endif
+	return value;
+}
+
+static inline uint32_t read32(const unsigned char *bytes)
+{
+	uint32_t value;
+	memcpy(&value, bytes, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	value = __builtin_bswap32(value);
+#endif
+	return value;
+}
+
+static inline uint64_t mixLane(uint64_t lane, uint64_t input)
+{
+	lane += input * kPrime2;
+	lane = rotateLeft(lane, 31);
+	return (lane * kPrime1);
+}
+
+static inline uint64_t mergeLane(uint64_t hash, uint64_t lane)
+{
+	hash ^= mixLane(0, lane);
+	return (hash * kPrime1 + kPrime4);
+}
+
+static inline const unsigned char *consumeStripes(uint64_t lanes[4], const unsigned char *bytes, const unsigned char *end)
+{
+	// The lanes don't depend on each other, so their multiplications overlap.
+	uint64_t lane1 = lanes[0];
+	uint64_t lane2 = lanes[1];
+	uint64_t lane3 = lanes[2];
+	uint64_t lane4 = lanes[3];
+	for (; bytes + 32 <= end; bytes += 32) {
+		lane1 = mixLane(lane1, read64(bytes));
+		lane2 = mixLane(lane2, read64(bytes + 8));
+		lane3 = mixLane(lane3, read64(bytes + 16));
+		lane4 = mixLane(lane4, read64(bytes + 24));
+	}
+	lanes[0] = lane1;
+	lanes[1] = lane2;
+	lanes[2] = lane3;
+	lanes[3] = lane4;
+	
+	return bytes;
+}
+
+
+#pragma mark Hashing
+void ContentHasher::reset(uint64_t seed)
+{
+	_seed		= seed;
+	_lanes[0]	= seed + kPrime1 + kPrime2;
+	_lanes[1]	= seed + kPrime2;
+	_lanes[2]	= seed;
+	_lanes[3]	= seed - kPrime1;
+	_length		= 0;
+	_buffered	= 0;
+}
+
+void ContentHasher::update(const void *data, size_t length)
+{
+	const unsigned char *bytes	= static_cast<const unsigned char *>(data);
+	const unsigned char *end	= bytes + length;
+	_length += length;
+	
+	if (_buffered > 0) {
+		const size_t missing = kStripeLength - _buffered;
+		if (length < missing) {
+			memcpy(_buffer + _buffered, bytes, length);
+			_buffered += length;
+			return;
+		}
+		memcpy(_buffer + _buffered, bytes, missing);
+		consumeStripes(_lanes, _buffer, _buffer + kStripeLength);
+		bytes		+= missing;
+		_buffered	= 0;
+	}
+	
+	bytes = consumeStripes(_lanes, bytes, end);
+	
+	_buffered = (size_t)(end - bytes);
+	memcpy(_buffer, bytes, _buffered);
+}
+
+uint64_t ContentHasher::digest() const
+{
+	uint64_t hash;
+	if (_length >= kStripeLength) {
+		hash = (rotateLeft(_lanes[0], 1) + rotateLeft(_lanes[1], 7) +
+				rotateLeft(_lanes[2], 12) + rotateLeft(_lanes[3], 18));
+		hash = mergeLane(hash, _lanes[0]);
+		hash = mergeLane(hash, _lanes[1]);
+		hash = mergeLane(hash, _lanes[2]);
+		hash = mergeLane(hash, _lanes[3]);
+	} else {
+		hash = _seed + kPrime5;
+	}
+	hash += _length;
+	
+	const unsigned char *bytes	= _buffer;
+	const unsigned char *end	= _buffer + _buffered;
+	for (; bytes + 8 <= end; bytes += 8) {
+		hash ^= mixLane(0, read64(bytes));
+		hash = rotateLeft(hash, 27) * kPrime1 + kPrime4;
+	}
+	if (bytes + 4 <= end) {
+		hash ^= (uint64_t)read32(bytes) * kPrime1;
+		hash = rotateLeft(hash, 23) * kPrime2 + kPrime3;
+		bytes += 4;
+	}
+	for (; bytes < end; ++bytes) {
+		hash ^= (*bytes) * kPrime5;
+		hash = rotateLeft(hash, 11) * kPrime1;
+	}
+	
+	hash ^= hash >> 33;
+	hash *= kPrime2;
+	hash ^= hash >> 29;
+	hash *= kPrime3;
+	hash ^= hash >> 32;
+	
+	return hash;
+}
+
+uint64_t hashContent(const void *data, size_t length, uint64_t seed)
+{
+	ContentHasher hasher(seed);
+	hasher.update(data, length);
+	return hasher.digest();
+}
+
+} // namespace cdevents
@@ -0,0 +1,89 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @headerfile CDCoreContentHash.h
+ * A fast non-cryptographic hash of file contents.
+ */
+
+#ifndef CD_CORE_CONTENT_HASH_H
+#define CD_CORE_CONTENT_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace cdevents {
+
+/**
+ * Computes the XXH64 hash of a stream of bytes handed over in pieces of any size.
+ *
+ * XXH64 mixes four independent 64-bit lanes, one per 8 bytes of every 32
+ * byte stripe, so the processor works on the lanes in parallel and hashes at
+ * several gigabytes per second, far faster than the contents can be read.
+ * It detects accidental changes, not deliberate ones.
+ *
+ * @since head
+ */
+class ContentHasher {
+public:
+	explicit ContentHasher(uint64_t seed = 0) { reset(seed); }
+	
+	/**
+	 * Starts over with the given seed.
+	 */
+	void reset(uint64_t seed = 0);
+	
+	/**
+	 * Hashes the given bytes, following those hashed so far.
+	 */
+	void update(const void *data, size_t length);
+	
+	/**
+	 * The hash of the bytes hashed so far. The hasher can go on hashing more.
+	 */
+	uint64_t digest() const;
+	
+private:
+	static const size_t kStripeLength = 32;
+	
+	uint64_t		_seed;
+	uint64_t		_lanes[4];
+	uint64_t		_length;
+	unsigned char	_buffer[kStripeLength];
+	size_t			_buffered;
+};
+
+/**
+ * Returns the XXH64 hash of the given bytes.
+ *
+ * @since head
+ */
+uint64_t hashContent(const void *data, size_t length, uint64_t seed = 0);
+
+} // namespace cdevents
+
+#endif // CD_CORE_CONTENT_HASH_H
@@ -0,0 +1,279 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreContentVerifier.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <vector>
+
+#include "CDCoreContentHash.h"
+#include "CDCoreWorkerPool.h"
+
+namespace cdevents {
+
+#pragma mark Constants
+// Events which say something about the stream or a whole tree, not an item.
+static const EventFlags kStreamEventFlags = (kEventFlagMustScanSubDirs |
+											 kEventFlagUserDropped |
+											 kEventFlagKernelDropped |
+											 kEventFlagEventIdsWrapped |
+											 kEventFlagHistoryDone |
+											 kEventFlagRootChanged |
+											 kEventFlagMount |
+											 kEventFlagUnmount);
+
+// The changes an unchanged hash shows to have been no change of the contents.
+static const EventFlags kVerifiedEventFlags = (kEventFlagItemModified |
+											   kEventFlagItemInodeMetaMod);
+
+// The changes which are worth delivering whatever the contents.
+static const EventFlags kUnverifiedEventFlags = (kEventFlagItemCreated |
+												 kEventFlagItemRemoved |
+												 kEventFlagItemRenamed |
+												 kEventFlagItemFinderInfoMod |
+												 kEventFlagItemChangeOwner |
+												 kEventFlagItemXattrMod);
+
+// Large enough for the cost of a read to be negligible next to hashing.
+static const size_t kReadLength = 64 * 1024;
+
+
+#pragma mark Init/dealloc
+ContentVerifier::ContentVerifier(uint64_t sizeLimit, size_t threadCount, size_t capacity)
+:	_sizeLimit(sizeLimit),
+	_capacity(capacity)
+{
+	if (threadCount > 0) {
+		_workers.reset(new WorkerPool(threadCount, threadCount * 4));
+	}
+}
+
+ContentVerifier::~ContentVerifier()
+{}
+
+size_t ContentVerifier::threadCount() const
+{
+	return (_workers ? _workers->threadCount() : 0);
+}
+
+size_t ContentVerifier::size() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _entries.size();
+}
+
+void ContentVerifier::clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_entriesByPath.clear();
+	_entries.clear();
+}
+
+ContentVerificationStatistics ContentVerifier::statistics() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _statistics;
+}
+
+
+#pragma mark Verifying
+void ContentVerifier::verify(const EventBatch &events, EventBatch &verified)
+{
+	verified.clear();
+	if (events.empty()) {
+		return;
+	}
+	
+	std::vector<Check> checks;
+	for (size_t i = 0; i < events.size(); ++i) {
+		const EventFlags flags = events[i].flags;
+		if ((flags & kEventFlagItemIsFile) && !(flags & kStreamEventFlags)) {
+			Check check;
+			check.index		= i;
+			check.isHashed	= false;
+			check.hash		= 0;
+			check.size		= 0;
+			checks.push_back(check);
+		}
+	}
+	
+	// The files are read without holding the lock, so that batches being
+	// verified concurrently don't wait for each other's reads.
+	if (_workers && checks.size() > 1) {
+		std::mutex doneMutex;
+		std::condition_variable done;
+		size_t remaining = checks.size();
+		for (size_t i = 0; i < checks.size(); ++i) {
+			Check *check = &checks[i];
+			_workers->submit([this, &events, check, &doneMutex, &done, &remaining]() {
+				hash(events, *check);
+				
+				std::lock_guard<std::mutex> lock(doneMutex);
+				if (--remaining == 0) {
+					done.notify_one();
+				}
+			});
+		}
+		
+		std::unique_lock<std::mutex> lock(doneMutex);
+		done.wait(lock, [&remaining]() { return (remaining == 0); });
+	} else {
+		for (size_t i = 0; i < checks.size(); ++i) {
+			hash(events, checks[i]);
+		}
+	}
+	
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::string path;
+	size_t nextCheck = 0;
+	for (size_t i = 0; i < events.size(); ++i) {
+		const EventRecord &event = events[i];
+		uint64_t contentHash = 0;
+		
+		if (nextCheck < checks.size() && checks[nextCheck].index == i) {
+			const Check &check = checks[nextCheck++];
+			path.assign(events.path(i), event.pathLength);
+			if (const char *sourcePath = events.sourcePath(i)) {
+				forgetPath(std::string(sourcePath, event.sourcePathLength));
+			}
+			
+			if (!check.isHashed) {
+				forgetPath(path);
+			} else {
+				++_statistics.filesHashed;
+				_statistics.bytesHashed += check.size;
+				
+				const Entry *entry = entryOfPath(path);
+				const bool isUnchanged = (entry && entry->hash == check.hash && entry->size == check.size);
+				setEntry(path, check.hash, check.size);
+				
+				if (isUnchanged && (event.flags & kVerifiedEventFlags) && !(event.flags & kUnverifiedEventFlags)) {
+					++_statistics.eventsSuppressed;
+					continue;
+				}
+				contentHash = check.hash;
+			}
+		}
+		
+		verified.append(event.identifier, event.flags, event.timestamp, events.path(i), event.pathLength, events.sourcePath(i), event.sourcePathLength);
+		verified.setFileIdentity(event.fileIdentity);
+		verified.setContentHash(contentHash);
+	}
+}
+
+
+#pragma mark Private
+void ContentVerifier::hash(const EventBatch &events, Check &check) const
+{
+	// Not blocking on whatever else than a regular file now has the path.
+	const int descriptor = open(events.path(check.index), (O_RDONLY | O_NONBLOCK | O_NOFOLLOW | O_CLOEXEC));
+	if (descriptor < 0) {
+		return;
+	}
+	
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode) || (uint64_t)status.st_size > _sizeLimit) {
+		close(descriptor);
+		return;
+	}
+	
+	ContentHasher hasher;
+	unsigned char buffer[kReadLength];
+	uint64_t size = 0;
+	for (;;) {
+		const ssize_t count = read(descriptor, buffer, sizeof(buffer));
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		if (count == 0) {
+			check.isHashed	= true;
+			check.hash		= hasher.digest();
+			check.size		= size;
+			break;
+		}
+		
+		hasher.update(buffer, (size_t)count);
+		size += (uint64_t)count;
+		if (size > _sizeLimit) {
+			// Grew past the limit while being read.
+			break;
+		}
+	}
+	close(descriptor);
+}
+
+const ContentVerifier::Entry *ContentVerifier::entryOfPath(const std::string &path) const
+{
+	std::unordered_map<std::string, Entries::iterator>::const_iterator entry = _entriesByPath.find(path);
+	return (entry != _entriesByPath.end() ? &*entry->second : NULL);
+}
+
+void ContentVerifier::setEntry(const std::string &path, uint64_t hash, uint64_t size)
+{
+	std::unordered_map<std::string, Entries::iterator>::iterator known = _entriesByPath.find(path);
+	if (known != _entriesByPath.end()) {
+		known->second->hash = hash;
+		known->second->size = size;
+		_entries.splice(_entries.begin(), _entries, known->second);
+		return;
+	}
+	
+	if (_capacity == 0) {
+		return;
+	}
+	
+	Entry entry;
+	entry.path	= path;
+	entry.hash	= hash;
+	entry.size	= size;
+	_entries.push_front(entry);
+	_entriesByPath[path] = _entries.begin();
+	
+	if (_entries.size() > _capacity) {
+		_entriesByPath.erase(_entries.back().path);
+		_entries.pop_back();
+	}
+}
+
+void ContentVerifier::forgetPath(const std::string &path)
+{
+	std::unordered_map<std::string, Entries::iterator>::iterator known = _entriesByPath.find(path);
+	if (known != _entriesByPath.end()) {
+		_entries.erase(known->second);
+		_entriesByPath.erase(known);
+	}
+}
+
+} // namespace cdevents
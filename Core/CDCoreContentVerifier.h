@@ -0,0 +1,175 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @headerfile CDCoreContentVerifier.h
+ * Drops modification events of files whose contents did not change.
+ */
+
+#ifndef CD_CORE_CONTENT_VERIFIER_H
+#define CD_CORE_CONTENT_VERIFIER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "CDCoreEvent.h"
+
+namespace cdevents {
+
+class WorkerPool;
+
+/**
+ * The default size, in bytes, above which files are not hashed.
+ *
+ * @since head
+ */
+const uint64_t kDefaultContentVerificationSizeLimit = 4 * 1024 * 1024;
+
+/**
+ * The default number of paths a content verifier remembers the hash of.
+ *
+ * @since head
+ */
+const size_t kDefaultContentHashCapacity = 65536;
+
+
+/**
+ * The counters of a content verifier.
+ *
+ * @since head
+ */
+struct ContentVerificationStatistics {
+	/** The number of files hashed. */
+	uint64_t	filesHashed;
+	/** The number of bytes hashed. */
+	uint64_t	bytesHashed;
+	/** The number of events dropped because the contents of their file did not change. */
+	uint64_t	eventsSuppressed;
+	
+	ContentVerificationStatistics() : filesHashed(0), bytesHashed(0), eventsSuppressed(0) {}
+};
+
+
+/**
+ * Hashes the files of the events of a batch and drops the modifications which left the contents as they were.
+ *
+ * Touching a file, or a build tool writing the same output again, reports a
+ * modification of a file whose contents did not change. The verifier hashes
+ * every file of an event which is at most <em>sizeLimit</em> bytes with
+ * ContentHasher, remembers the hash of the path, and drops an event which
+ * only says the file or its inode metadata was modified if the file has the
+ * same size and hash as the last time. The events it keeps carry the hash
+ * of their file, 0 if it was not hashed, so that the client need not read
+ * the file to tell.
+ *
+ * The first modification of a file the verifier has no hash of yet is
+ * always delivered. The verifier remembers the hashes of at most
+ * <em>capacity</em> paths, forgetting the least recently seen one first.
+ * With <em>threadCount</em> above 0 the files of a batch are hashed by a
+ * pool of that many threads, otherwise by the thread verifying the batch.
+ *
+ * The verifier is thread-safe.
+ *
+ * @since head
+ */
+class ContentVerifier {
+public:
+	/**
+	 * Returns a verifier hashing files of at most <em>sizeLimit</em> bytes with <em>threadCount</em> threads, remembering the hashes of at most <em>capacity</em> paths.
+	 */
+	explicit ContentVerifier(uint64_t sizeLimit = kDefaultContentVerificationSizeLimit,
+							 size_t threadCount = 0,
+							 size_t capacity = kDefaultContentHashCapacity);
+	~ContentVerifier();
+	
+	/**
+	 * Clears <em>verified</em> and appends the events of <em>events</em> to it, with the hashes of their files, except those which did not change the contents.
+	 */
+	void verify(const EventBatch &events, EventBatch &verified);
+	
+	uint64_t sizeLimit() const { return _sizeLimit; }
+	size_t threadCount() const;
+	size_t capacity() const { return _capacity; }
+	
+	/**
+	 * The number of paths whose hash is remembered.
+	 */
+	size_t size() const;
+	
+	/**
+	 * Forgets all hashes, keeping the counters.
+	 */
+	void clear();
+	
+	/** @name Counters */
+	ContentVerificationStatistics statistics() const;
+	
+private:
+	// A file of the batch to hash, and what hashing it found.
+	struct Check {
+		size_t		index;
+		bool		isHashed;
+		uint64_t	hash;
+		uint64_t	size;
+	};
+	
+	struct Entry {
+		std::string	path;
+		uint64_t	hash;
+		uint64_t	size;
+	};
+	typedef std::list<Entry> Entries;
+	
+	ContentVerifier(const ContentVerifier &);
+	ContentVerifier &operator=(const ContentVerifier &);
+	
+	void hash(const EventBatch &events, Check &check) const;
+	
+	const Entry *entryOfPath(const std::string &path) const;
+	void setEntry(const std::string &path, uint64_t hash, uint64_t size);
+	void forgetPath(const std::string &path);
+	
+	const uint64_t					_sizeLimit;
+	const size_t					_capacity;
+	std::unique_ptr<WorkerPool>		_workers;
+	
+	mutable std::mutex				_mutex;
+	
+	// Most recently seen first.
+	Entries											_entries;
+	std::unordered_map<std::string, Entries::iterator>	_entriesByPath;
+	ContentVerificationStatistics					_statistics;
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_CONTENT_VERIFIER_H
@@ -0,0 +1,606 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreDirectorySnapshot.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <utility>
+
+#include "CDCorePath.h"
+
+namespace cdevents {
+
+#pragma mark Constants
+// The file starts with a header, followed by the records and then the paths,
+// all in native byte order.
+static const char kSnapshotFileMagic[8] = { 'C', 'D', 'S', 'N', 'A', 'P', '0', '1' };
+
+struct SnapshotFileHeader {
+	char		magic[8];
+	uint64_t	recordCount;
+	uint64_t	pathBytes;
+};
+
+// The overlay is merged into the base once it holds this many entries, or a
+// quarter of the base if that is more.
+static const size_t kMinimumCompactionThreshold = 1024;
+
+
+#pragma mark Records
+struct DirectorySnapshot::Record {
+	uint64_t	inode;
+	uint64_t	size;
+	int64_t		modificationTime;
+	uint64_t	pathOffset;
+	uint32_t	pathLength;
+	uint32_t	type;
+};
+
+
+#pragma mark Helpers
+// Orders paths like strings, except that '/' sorts before every other
+// character, so that a directory is directly followed by its whole tree.
+static int comparePaths(const char *a, size_t aLength, const char *b, size_t bLength)
+{
+	const size_t length = std::min(aLength, bLength);
+	for (size_t i = 0; i < length; ++i) {
+		if (a[i] != b[i]) {
+			const int aCharacter = (a[i] == '/' ? 0 : (unsigned char)a[i] + 1);
+			const int bCharacter = (b[i] == '/' ? 0 : (unsigned char)b[i] + 1);
+			return (aCharacter - bCharacter);
+		}
+	}
+	
+	return (aLength < bLength ? -1 : (aLength > bLength ? 1 : 0));
+}
+
+// The prefix every path below the given directory starts with.
+static std::string subtreePrefix(const std::string &path)
+{
+	return (!path.empty() && path[path.size() - 1] == '/' ? path : path + '/');
+}
+
+static bool isSameItem(const SnapshotEntry &a, const SnapshotEntry &b)
+{
+	return (a.inode == b.inode && a.type == b.type);
+}
+
+static bool hasChanged(const SnapshotEntry &a, const SnapshotEntry &b)
+{
+	// The contents of a directory are compared entry by entry instead.
+	return (a.type != kEventFlagItemIsDir &&
+			(a.size != b.size || a.modificationTime != b.modificationTime));
+}
+
+#pragma mark Init/dealloc
+DirectorySnapshot::DirectorySnapshot()
+:	_records(NULL),
+	_recordCount(0),
+	_paths(NULL),
+	_mapping(NULL),
+	_mappingLength(0),
+	_size(0)
+{
+}
+
+DirectorySnapshot::~DirectorySnapshot()
+{
+	unmap();
+}
+
+
+#pragma mark Entries
+bool DirectorySnapshot::PathLess::operator()(const std::string &a, const std::string &b) const
+{
+	return (comparePaths(a.data(), a.size(), b.data(), b.size()) < 0);
+}
+
+bool DirectorySnapshot::empty() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return (_size == 0);
+}
+
+size_t DirectorySnapshot::size() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _size;
+}
+
+bool DirectorySnapshot::entry(const std::string &path, SnapshotEntry &entry) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return findEntry(path, entry);
+}
+
+
+#pragma mark Updating the snapshot
+bool DirectorySnapshot::rescan(const std::string &path, bool recursive, const TreeWalker &walker, const ChangeHandler &handler)
+{
+	SnapshotEntry previousRoot;
+	Entries previousChildren;
+	bool hadRoot;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		hadRoot = findEntry(path, previousRoot);
+		if (hadRoot && !recursive) {
+			collectSubtree(path, false, previousChildren);
+		}
+	}
+	
+	// The file system is walked without holding the lock.
+	Entries current;
+	SnapshotEntry currentRoot;
+	const bool hasRoot = (!walker.isExcluded(path) && TreeWalker::readAttributes(path, currentRoot));
+	if (hasRoot) {
+		current[path] = currentRoot;
+		if (!hadRoot || !isSameItem(previousRoot, currentRoot)) {
+			recursive = true;
+		}
+		if (!walk(walker, std::vector<std::string>(1, path), recursive, current)) {
+			return false;
+		}
+		
+		// Nothing is known about the trees of new directories, so they are walked whole.
+		if (!recursive) {
+			std::vector<std::string> directories;
+			for (Entries::const_iterator it = current.begin(); it != current.end(); ++it) {
+				if (it->second.type != kEventFlagItemIsDir || it->first == path) {
+					continue;
+				}
+				Entries::const_iterator previous = previousChildren.find(it->first);
+				if (previous == previousChildren.end() || !isSameItem(previous->second, it->second)) {
+					directories.push_back(it->first);
+				}
+			}
+			if (!directories.empty() && !walk(walker, directories, true, current)) {
+				return false;
+			}
+		}
+	}
+	
+	std::vector<std::pair<std::string, EventFlags> > changes;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		
+		Entries previous;
+		SnapshotEntry root;
+		if (findEntry(path, root)) {
+			previous[path] = root;
+			if (!hasRoot) {
+				recursive = true;
+			}
+			collectSubtree(path, recursive, previous);
+		}
+		// The trees of directories which are gone, or were replaced, are gone too.
+		if (!recursive) {
+			std::vector<std::string> directories;
+			for (Entries::const_iterator it = previous.begin(); it != previous.end(); ++it) {
+				if (it->second.type != kEventFlagItemIsDir || it->first == path) {
+					continue;
+				}
+				Entries::const_iterator now = current.find(it->first);
+				if (now == current.end() || !isSameItem(now->second, it->second)) {
+					directories.push_back(it->first);
+				}
+			}
+			for (size_t i = 0; i < directories.size(); ++i) {
+				collectSubtree(directories[i], true, previous);
+			}
+		}
+		
+		// Both sides are ordered the same way, so they are compared in one pass.
+		PathLess less;
+		Entries::const_iterator before = previous.begin();
+		Entries::const_iterator after = current.begin();
+		while (before != previous.end() || after != current.end()) {
+			if (after == current.end() || (before != previous.end() && less(before->first, after->first))) {
+				changes.push_back(std::make_pair(before->first, kEventFlagItemRemoved | before->second.type));
+				removeEntry(before->first);
+				++before;
+			} else if (before == previous.end() || less(after->first, before->first)) {
+				changes.push_back(std::make_pair(after->first, kEventFlagItemCreated | after->second.type));
+				setEntry(after->first, after->second);
+				++after;
+			} else {
+				if (!isSameItem(before->second, after->second)) {
+					changes.push_back(std::make_pair(before->first, kEventFlagItemRemoved | before->second.type));
+					changes.push_back(std::make_pair(after->first, kEventFlagItemCreated | after->second.type));
+					setEntry(after->first, after->second);
+				} else if (hasChanged(before->second, after->second)) {
+					changes.push_back(std::make_pair(after->first, kEventFlagItemModified | after->second.type));
+					setEntry(after->first, after->second);
+				}
+				++before;
+				++after;
+			}
+		}
+		
+		compactIfNeeded();
+	}
+	
+	if (handler) {
+		for (size_t i = 0; i < changes.size(); ++i) {
+			handler(changes[i].first, changes[i].second);
+		}
+	}
+	
+	return true;
+}
+
+void DirectorySnapshot::update(const std::string &path)
+{
+	SnapshotEntry current;
+	const bool exists = TreeWalker::readAttributes(path, current);
+	
+	std::lock_guard<std::mutex> lock(_mutex);
+	SnapshotEntry previous;
+	if (findEntry(path, previous) && previous.type == kEventFlagItemIsDir &&
+		(!exists || !isSameItem(previous, current))) {
+		removeSubtree(path);
+	}
+	if (exists) {
+		setEntry(path, current);
+	} else {
+		removeEntry(path);
+	}
+	
+	compactIfNeeded();
+}
+
+
+#pragma mark Persistence
+bool DirectorySnapshot::save(const std::string &file)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	compact();
+	
+	const std::string temporaryPath = file + ".tmp";
+	FILE *stream = fopen(temporaryPath.c_str(), "wb");
+	if (stream == NULL) {
+		return false;
+	}
+	
+	SnapshotFileHeader header;
+	memcpy(header.magic, kSnapshotFileMagic, sizeof(header.magic));
+	header.recordCount	= _recordCount;
+	header.pathBytes	= (_recordCount > 0 ? _records[_recordCount - 1].pathOffset + _records[_recordCount - 1].pathLength : 0);
+	
+	bool written = (fwrite(&header, sizeof(header), 1, stream) == 1 &&
+					(_recordCount == 0 || fwrite(_records, sizeof(Record), _recordCount, stream) == _recordCount) &&
+					(header.pathBytes == 0 || fwrite(_paths, 1, (size_t)header.pathBytes, stream) == header.pathBytes));
+	written = (fflush(stream) == 0 && written);
+	written = (fsync(fileno(stream)) == 0 && written);
+	written = (fclose(stream) == 0 && written);
+	
+	if (!written || rename(temporaryPath.c_str(), file.c_str()) != 0) {
+		unlink(temporaryPath.c_str());
+		return false;
+	}
+	
+	return true;
+}
+
+bool DirectorySnapshot::load(const std::string &file)
+{
+	const int descriptor = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (descriptor < 0) {
+		return false;
+	}
+	
+	struct stat info;
+	void *mapping = MAP_FAILED;
+	if (fstat(descriptor, &info) == 0 && (size_t)info.st_size >= sizeof(SnapshotFileHeader)) {
+		mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	}
+	close(descriptor);
+	if (mapping == MAP_FAILED) {
+		return false;
+	}
+	
+	// A file of another format, or a truncated one, is not used.
+	const size_t length = (size_t)info.st_size;
+	const SnapshotFileHeader *header = (const SnapshotFileHeader *)mapping;
+	const size_t recordBytes = (size_t)header->recordCount * sizeof(Record);
+	bool valid = (memcmp(header->magic, kSnapshotFileMagic, sizeof(header->magic)) == 0 &&
+				  header->recordCount <= length / sizeof(Record) &&
+				  sizeof(SnapshotFileHeader) + recordBytes + header->pathBytes == length);
+	const Record *records = (const Record *)((const char *)mapping + sizeof(SnapshotFileHeader));
+	const char *paths = (const char *)records + recordBytes;
+	for (size_t i = 0; valid && i < header->recordCount; ++i) {
+		valid = (records[i].pathOffset + records[i].pathLength <= header->pathBytes);
+		
+		// The records are binary-searched, so they must be strictly ordered.
+		if (valid && i > 0) {
+			valid = (comparePaths(paths + records[i - 1].pathOffset, records[i - 1].pathLength,
+								  paths + records[i].pathOffset, records[i].pathLength) < 0);
+		}
+	}
+	if (!valid) {
+		munmap(mapping, length);
+		return false;
+	}
+	
+	std::lock_guard<std::mutex> lock(_mutex);
+	unmap();
+	_ownedRecords.clear();
+	_ownedPaths.clear();
+	_overlay.clear();
+	
+	_mapping		= mapping;
+	_mappingLength	= length;
+	_records		= records;
+	_recordCount	= (size_t)header->recordCount;
+	_paths			= paths;
+	_size			= _recordCount;
+	
+	return true;
+}
+
+
+#pragma mark Private
+bool DirectorySnapshot::walk(const TreeWalker &walker, const std::vector<std::string> &paths, bool recursive, Entries &entries)
+{
+	// Each thread of the walk collects its own entries, which are only
+	// merged, and sorted, once it is done.
+	std::vector<std::vector<std::pair<std::string, SnapshotEntry> > > found(walker.threadCount());
+	const bool walked = walker.walk(paths, recursive,
+									[&found](size_t thread, const std::string &item, const ItemAttributes &attributes) {
+		found[thread].push_back(std::make_pair(item, attributes));
+	});
+	if (!walked) {
+		return false;
+	}
+	
+	for (size_t i = 0; i < found.size(); ++i) {
+		entries.insert(found[i].begin(), found[i].end());
+	}
+	return true;
+}
+
+size_t DirectorySnapshot::baseLowerBound(const std::string &path) const
+{
+	size_t low = 0;
+	size_t high = _recordCount;
+	while (low < high) {
+		const size_t middle = low + (high - low) / 2;
+		const Record &record = _records[middle];
+		if (comparePaths(_paths + record.pathOffset, record.pathLength, path.data(), path.size()) < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	
+	return low;
+}
+
+bool DirectorySnapshot::findEntry(const std::string &path, SnapshotEntry &entry) const
+{
+	Overlay::const_iterator overlaid = _overlay.find(path);
+	if (overlaid != _overlay.end()) {
+		if (overlaid->second.removed) {
+			return false;
+		}
+		entry = overlaid->second.entry;
+		return true;
+	}
+	
+	const size_t index = baseLowerBound(path);
+	if (index == _recordCount) {
+		return false;
+	}
+	const Record &record = _records[index];
+	if (record.pathLength != path.size() || memcmp(_paths + record.pathOffset, path.data(), path.size()) != 0) {
+		return false;
+	}
+	
+	entry.inode				= record.inode;
+	entry.size				= record.size;
+	entry.modificationTime	= record.modificationTime;
+	entry.type				= record.type;
+	return true;
+}
+
+void DirectorySnapshot::collectSubtree(const std::string &path, bool recursive, Entries &entries) const
+{
+	const std::string prefix = subtreePrefix(path);
+	
+	// Returns whether the path is below the directory, and one level down unless recursive.
+	const auto isIncluded = [&prefix, recursive](const char *candidate, size_t length) -> bool {
+		if (length <= prefix.size() || memcmp(candidate, prefix.data(), prefix.size()) != 0) {
+			return false;
+		}
+		return (recursive || memchr(candidate + prefix.size(), '/', length - prefix.size()) == NULL);
+	};
+	const auto isPastSubtree = [&prefix](const char *candidate, size_t length) -> bool {
+		return (length < prefix.size() || memcmp(candidate, prefix.data(), prefix.size()) != 0);
+	};
+	
+	for (size_t index = baseLowerBound(prefix); index < _recordCount; ++index) {
+		const Record &record = _records[index];
+		const char *candidate = _paths + record.pathOffset;
+		if (isPastSubtree(candidate, record.pathLength)) {
+			break;
+		}
+		if (!isIncluded(candidate, record.pathLength)) {
+			continue;
+		}
+		
+		SnapshotEntry entry;
+		entry.inode				= record.inode;
+		entry.size				= record.size;
+		entry.modificationTime	= record.modificationTime;
+		entry.type				= record.type;
+		entries[std::string(candidate, record.pathLength)] = entry;
+	}
+	
+	for (Overlay::const_iterator it = _overlay.lower_bound(prefix); it != _overlay.end(); ++it) {
+		if (isPastSubtree(it->first.data(), it->first.size())) {
+			break;
+		}
+		if (!isIncluded(it->first.data(), it->first.size())) {
+			continue;
+		}
+		
+		if (it->second.removed) {
+			entries.erase(it->first);
+		} else {
+			entries[it->first] = it->second.entry;
+		}
+	}
+}
+
+void DirectorySnapshot::setEntry(const std::string &path, const SnapshotEntry &entry)
+{
+	SnapshotEntry previous;
+	if (!findEntry(path, previous)) {
+		++_size;
+	}
+	
+	OverlayEntry &overlaid = _overlay[path];
+	overlaid.entry		= entry;
+	overlaid.removed	= false;
+}
+
+void DirectorySnapshot::removeEntry(const std::string &path)
+{
+	SnapshotEntry previous;
+	if (!findEntry(path, previous)) {
+		return;
+	}
+	--_size;
+	
+	// Entries of the base are hidden, others simply dropped.
+	const size_t index = baseLowerBound(path);
+	const bool inBase = (index < _recordCount && _records[index].pathLength == path.size() &&
+						 memcmp(_paths + _records[index].pathOffset, path.data(), path.size()) == 0);
+	if (inBase) {
+		OverlayEntry &overlaid = _overlay[path];
+		overlaid.entry		= SnapshotEntry();
+		overlaid.removed	= true;
+	} else {
+		_overlay.erase(path);
+	}
+}
+
+void DirectorySnapshot::removeSubtree(const std::string &path)
+{
+	Entries entries;
+	collectSubtree(path, true, entries);
+	for (Entries::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+		removeEntry(it->first);
+	}
+}
+
+void DirectorySnapshot::compactIfNeeded()
+{
+	if (_overlay.size() > std::max(kMinimumCompactionThreshold, _recordCount / 4)) {
+		compact();
+	}
+}
+
+void DirectorySnapshot::compact()
+{
+	if (_overlay.empty() && _mapping == NULL) {
+		return;
+	}
+	
+	std::vector<Record> records;
+	std::string paths;
+	records.reserve(_size);
+	
+	const auto append = [&records, &paths](const char *path, size_t length, const SnapshotEntry &entry) {
+		Record record;
+		record.inode			= entry.inode;
+		record.size				= entry.size;
+		record.modificationTime	= entry.modificationTime;
+		record.pathOffset		= paths.size();
+		record.pathLength		= (uint32_t)length;
+		record.type				= entry.type;
+		records.push_back(record);
+		paths.append(path, length);
+	};
+	
+	// The base and the overlay are both ordered, so they are merged in one pass.
+	size_t index = 0;
+	Overlay::const_iterator overlaid = _overlay.begin();
+	while (index < _recordCount || overlaid != _overlay.end()) {
+		const Record *record = (index < _recordCount ? &_records[index] : NULL);
+		const int order = (record == NULL ? 1 :
+						   overlaid == _overlay.end() ? -1 :
+						   comparePaths(_paths + record->pathOffset, record->pathLength,
+										overlaid->first.data(), overlaid->first.size()));
+		if (order < 0) {
+			SnapshotEntry entry;
+			entry.inode				= record->inode;
+			entry.size				= record->size;
+			entry.modificationTime	= record->modificationTime;
+			entry.type				= record->type;
+			append(_paths + record->pathOffset, record->pathLength, entry);
+			++index;
+		} else {
+			if (!overlaid->second.removed) {
+				append(overlaid->first.data(), overlaid->first.size(), overlaid->second.entry);
+			}
+			if (order == 0) {
+				++index;
+			}
+			++overlaid;
+		}
+	}
+	
+	unmap();
+	_overlay.clear();
+	_ownedRecords.swap(records);
+	_ownedPaths.swap(paths);
+	_records		= _ownedRecords.data();
+	_recordCount	= _ownedRecords.size();
+	_paths			= _ownedPaths.data();
+}
+
+void DirectorySnapshot::unmap()
+{
+	if (_mapping != NULL) {
+		munmap(_mapping, _mappingLength);
+		_mapping		= NULL;
+		_mappingLength	= 0;
+		_records		= NULL;
+		_recordCount	= 0;
+		_paths			= NULL;
+	}
+}
+
+} // namespace cdevents
@@ -0,0 +1,180 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreDirectorySnapshot.h
+ * A compact index of the watched trees, used to turn rescans into precise events.
+ */
+
+#ifndef CD_CORE_DIRECTORY_SNAPSHOT_H
+#define CD_CORE_DIRECTORY_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "CDCoreEvent.h"
+#include "CDCoreTreeWalker.h"
+
+namespace cdevents {
+
+/**
+ * What the snapshot knows about one file system entry.
+ *
+ * @since head
+ */
+typedef ItemAttributes SnapshotEntry;
+
+
+/**
+ * The inode, size and modification time of every entry of the watched trees.
+ *
+ * When a stream has to tell its client to rescan a directory, because events
+ * were dropped or coalesced by the kernel, the snapshot walks only that
+ * directory, compares what it finds with what it knew and reports precise
+ * creations, removals and modifications instead. The stream keeps the
+ * snapshot current by refreshing the entries of every other event it
+ * delivers.
+ *
+ * The entries are kept in a sorted, compact base array, in which a directory
+ * and everything below it is one contiguous range, plus an ordered overlay of
+ * the changes since the base was last rebuilt. The base can be written to a
+ * file and mapped back into memory, so that a large snapshot survives a
+ * restart without being rebuilt or read up front.
+ *
+ * The snapshot is thread-safe.
+ *
+ * @since head
+ */
+class DirectorySnapshot {
+public:
+	/** The function differences are reported to, with the path and the event flags of the change. */
+	typedef std::function<void (const std::string &path, EventFlags flags)> ChangeHandler;
+	
+	DirectorySnapshot();
+	~DirectorySnapshot();
+	
+	/**
+	 * Whether the snapshot has no entries.
+	 */
+	bool empty() const;
+	
+	/**
+	 * The number of entries.
+	 */
+	size_t size() const;
+	
+	/**
+	 * Copies the entry of the given standardized path to <em>entry</em>, returns <code>false</code> if there is none.
+	 */
+	bool entry(const std::string &path, SnapshotEntry &entry) const;
+	
+	/** @name Updating the snapshot */
+	/**
+	 * Walks the tree at the given standardized path with <em>walker</em> and makes the snapshot match it.
+	 *
+	 * Every difference found is reported to <em>handler</em> (if any): a
+	 * creation, a removal, a modification (the size or modification time
+	 * changed) or a removal followed by a creation (the inode changed).
+	 * With <em>recursive</em> false only the path and its direct children are
+	 * compared, and the trees of removed children are dropped. Paths excluded
+	 * by the walker are treated as removed.
+	 *
+	 * @return <code>false</code> if the walker was cancelled, in which case the snapshot is left as it was.
+	 */
+	bool rescan(const std::string &path, bool recursive, const TreeWalker &walker, const ChangeHandler &handler);
+	
+	/**
+	 * Refreshes the entry of the given standardized path only, dropping the tree below it if it is no longer a directory.
+	 */
+	void update(const std::string &path);
+	
+	/** @name Persistence */
+	/**
+	 * Writes the snapshot to the file at the given path, replacing it atomically.
+	 */
+	bool save(const std::string &file);
+	
+	/**
+	 * Replaces the snapshot with the one in the file at the given path, mapping it into memory rather than reading it.
+	 *
+	 * A file of another format, truncated, or whose entries are out of order
+	 * is rejected, leaving the snapshot as it was.
+	 */
+	bool load(const std::string &file);
+	
+private:
+	struct Record;
+	struct PathLess {
+		bool operator()(const std::string &a, const std::string &b) const;
+	};
+	struct OverlayEntry {
+		SnapshotEntry	entry;
+		bool			removed;
+	};
+	typedef std::map<std::string, OverlayEntry, PathLess> Overlay;
+	typedef std::map<std::string, SnapshotEntry, PathLess> Entries;
+	
+	DirectorySnapshot(const DirectorySnapshot &);
+	DirectorySnapshot &operator=(const DirectorySnapshot &);
+	
+	static bool walk(const TreeWalker &walker, const std::vector<std::string> &paths, bool recursive, Entries &entries);
+	
+	size_t baseLowerBound(const std::string &path) const;
+	bool findEntry(const std::string &path, SnapshotEntry &entry) const;
+	void collectSubtree(const std::string &path, bool recursive, Entries &entries) const;
+	void setEntry(const std::string &path, const SnapshotEntry &entry);
+	void removeEntry(const std::string &path);
+	void removeSubtree(const std::string &path);
+	void compactIfNeeded();
+	void compact();
+	void unmap();
+	
+	mutable std::mutex		_mutex;
+	
+	// The base, either owned or mapped from a file.
+	const Record			*_records;
+	size_t					_recordCount;
+	const char				*_paths;
+	std::vector<Record>		_ownedRecords;
+	std::string				_ownedPaths;
+	void					*_mapping;
+	size_t					_mappingLength;
+	
+	// The changes since the base was built, ordered like it.
+	Overlay					_overlay;
+	size_t					_size;
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_DIRECTORY_SNAPSHOT_H
@@ -0,0 +1,354 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreEvent.h
+ * The platform-neutral event model of the CDEvents core.
+ *
+ * The flag values are identical to the FSEventStreamEventFlags and
+ * FSEventStreamCreateFlags constants so that events coming from FSEvents can
+ * be passed through untouched, while other backends translate their native
+ * events into the same model.
+ */
+
+#ifndef CD_CORE_EVENT_H
+#define CD_CORE_EVENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace cdevents {
+
+#pragma mark -
+#pragma mark Event types
+/**
+ * The event identifier type.
+ *
+ * @since head
+ */
+typedef uint64_t EventIdentifier;
+
+/**
+ * The event flags type.
+ *
+ * @since head
+ */
+typedef uint32_t EventFlags;
+
+/**
+ * The stream creation flags type.
+ *
+ * @since head
+ */
+typedef uint32_t StreamCreationFlags;
+
+
+#pragma mark -
+#pragma mark Event flags
+/**
+ * The event flags, see <code>FSEventStreamEventFlags</code>.
+ *
+ * @since head
+ */
+enum {
+	kEventFlagNone					= 0x00000000,
+	kEventFlagMustScanSubDirs		= 0x00000001,
+	kEventFlagUserDropped			= 0x00000002,
+	kEventFlagKernelDropped			= 0x00000004,
+	kEventFlagEventIdsWrapped		= 0x00000008,
+	kEventFlagHistoryDone			= 0x00000010,
+	kEventFlagRootChanged			= 0x00000020,
+	kEventFlagMount					= 0x00000040,
+	kEventFlagUnmount				= 0x00000080,
+	
+	// file-level events
+	kEventFlagItemCreated			= 0x00000100,
+	kEventFlagItemRemoved			= 0x00000200,
+	kEventFlagItemInodeMetaMod		= 0x00000400,
+	kEventFlagItemRenamed			= 0x00000800,
+	kEventFlagItemModified			= 0x00001000,
+	kEventFlagItemFinderInfoMod		= 0x00002000,
+	kEventFlagItemChangeOwner		= 0x00004000,
+	kEventFlagItemXattrMod			= 0x00008000,
+	kEventFlagItemIsFile			= 0x00010000,
+	kEventFlagItemIsDir				= 0x00020000,
+	kEventFlagItemIsSymlink			= 0x00040000
+};
+
+/**
+ * The stream creation flags, see <code>FSEventStreamCreateFlags</code>.
+ *
+ * @since head
+ */
+enum {
+	kStreamCreationFlagNone			= 0x00000000,
+	kStreamCreationFlagUseCFTypes	= 0x00000001,
+	kStreamCreationFlagNoDefer		= 0x00000002,
+	kStreamCreationFlagWatchRoot	= 0x00000004,
+	kStreamCreationFlagIgnoreSelf	= 0x00000008,
+	kStreamCreationFlagFileEvents	= 0x00000010
+};
+
+/**
+ * Use this to get all event since now when creating a stream.
+ *
+ * @see kFSEventStreamEventIdSinceNow
+ *
+ * @since head
+ */
+const EventIdentifier kEventIdentifierSinceNow = 0xFFFFFFFFFFFFFFFFULL;
+
+
+#pragma mark -
+#pragma mark Specific flag predicates
+#define CD_CORE_FLAG_PREDICATE(name, flag)			\
+inline bool name(EventFlags flags)					\
+{ return (((flags) & (flag)) ? true : false); }
+
+inline bool isGenericChange(EventFlags flags)
+{ return (kEventFlagNone == flags); }
+
+CD_CORE_FLAG_PREDICATE(mustRescanSubDirectories,	kEventFlagMustScanSubDirs)
+CD_CORE_FLAG_PREDICATE(isUserDropped,				kEventFlagUserDropped)
+CD_CORE_FLAG_PREDICATE(isKernelDropped,				kEventFlagKernelDropped)
+CD_CORE_FLAG_PREDICATE(isEventIdentifiersWrapped,	kEventFlagEventIdsWrapped)
+CD_CORE_FLAG_PREDICATE(isHistoryDone,				kEventFlagHistoryDone)
+CD_CORE_FLAG_PREDICATE(isRootChanged,				kEventFlagRootChanged)
+CD_CORE_FLAG_PREDICATE(didVolumeMount,				kEventFlagMount)
+CD_CORE_FLAG_PREDICATE(didVolumeUnmount,			kEventFlagUnmount)
+
+CD_CORE_FLAG_PREDICATE(isCreated,					kEventFlagItemCreated)
+CD_CORE_FLAG_PREDICATE(isRemoved,					kEventFlagItemRemoved)
+CD_CORE_FLAG_PREDICATE(isInodeMetadataModified,		kEventFlagItemInodeMetaMod)
+CD_CORE_FLAG_PREDICATE(isRenamed,					kEventFlagItemRenamed)
+CD_CORE_FLAG_PREDICATE(isModified,					kEventFlagItemModified)
+CD_CORE_FLAG_PREDICATE(isFinderInfoModified,		kEventFlagItemFinderInfoMod)
+CD_CORE_FLAG_PREDICATE(didChangeOwner,				kEventFlagItemChangeOwner)
+CD_CORE_FLAG_PREDICATE(isXattrModified,				kEventFlagItemXattrMod)
+CD_CORE_FLAG_PREDICATE(isFile,						kEventFlagItemIsFile)
+CD_CORE_FLAG_PREDICATE(isDir,						kEventFlagItemIsDir)
+CD_CORE_FLAG_PREDICATE(isSymlink,					kEventFlagItemIsSymlink)
+
+#undef CD_CORE_FLAG_PREDICATE
+
+
+#pragma mark -
+#pragma mark File identities
+/**
+ * What an item is, independently of its path: the device it is on and its inode number there.
+ *
+ * An item keeps its identity when it is renamed or moved within its device,
+ * and a file written elsewhere and renamed over an existing one has another
+ * identity than the file it replaced.
+ *
+ * @since head
+ */
+struct FileIdentity {
+	/** The device the item is on. */
+	uint64_t	device;
+	/** The inode number of the item on its device, 0 if the identity is unknown. */
+	uint64_t	inode;
+	
+	FileIdentity() : device(0), inode(0) {}
+	FileIdentity(uint64_t aDevice, uint64_t anInode) : device(aDevice), inode(anInode) {}
+	
+	bool isKnown() const { return (inode != 0); }
+	
+	bool operator==(const FileIdentity &other) const { return (device == other.device && inode == other.inode); }
+	bool operator!=(const FileIdentity &other) const { return !(*this == other); }
+};
+
+
+#pragma mark -
+#pragma mark Event records
+/**
+ * An event which passed the filtering of a stream.
+ *
+ * Records are plain values; the path lives in the path buffer of the
+ * EventBatch the record belongs to.
+ *
+ * @since head
+ */
+struct EventRecord {
+	/** The event identifier. */
+	EventIdentifier	identifier;
+	/** The flags of the event. */
+	EventFlags		flags;
+	/** An approximate time the event occured, in seconds since 1970. */
+	double			timestamp;
+	/** The offset of the standardized path in the path buffer of the batch. */
+	size_t			pathOffset;
+	/** The length of the path, in bytes, not counting the terminating NUL. */
+	size_t			pathLength;
+	/** The offset of the path the item was renamed from in the path buffer of the batch, if the event is a paired rename. */
+	size_t			sourcePathOffset;
+	/** The length of the path the item was renamed from, 0 unless the event is a paired rename. */
+	size_t			sourcePathLength;
+	/** The identity of the item, unknown unless the stream tracks file identities. */
+	FileIdentity	fileIdentity;
+	/** The hash of the contents of the file, 0 unless the stream verifies contents and hashed it. */
+	uint64_t		contentHash;
+};
+
+/**
+ * The events of one batch, stored as compact records and a shared path buffer.
+ *
+ * A stream reuses the same batch for every delivery, so once the storage has
+ * grown to the size of the largest batch no more allocations happen. The
+ * records and paths are only valid for the duration of the handler call.
+ *
+ * @since head
+ */
+class EventBatch {
+public:
+	EventBatch() {}
+	
+	/**
+	 * Removes all events, keeping the storage.
+	 */
+	void clear()
+	{
+		_records.clear();
+		_paths.clear();
+	}
+	
+	/**
+	 * Appends an event, copying the path into the path buffer.
+	 */
+	void append(EventIdentifier identifier, EventFlags flags, double timestamp, const char *path, size_t pathLength)
+	{
+		EventRecord record;
+		record.identifier		= identifier;
+		record.flags			= flags;
+		record.timestamp		= timestamp;
+		record.pathOffset		= appendPath(path, pathLength);
+		record.pathLength		= pathLength;
+		record.sourcePathOffset	= 0;
+		record.sourcePathLength	= 0;
+		record.fileIdentity		= FileIdentity();
+		record.contentHash		= 0;
+		_records.push_back(record);
+	}
+	
+	/**
+	 * Appends a rename, copying both paths into the path buffer.
+	 */
+	void append(EventIdentifier identifier, EventFlags flags, double timestamp, const char *path, size_t pathLength, const char *sourcePath, size_t sourcePathLength)
+	{
+		append(identifier, flags, timestamp, path, pathLength);
+		if (sourcePathLength > 0) {
+			_records.back().sourcePathOffset = appendPath(sourcePath, sourcePathLength);
+			_records.back().sourcePathLength = sourcePathLength;
+		}
+	}
+	
+	/**
+	 * Joins the other half of a rename to the last event, which then has the destination as its path and the source as its source path.
+	 *
+	 * @param isDestination Whether <em>path</em> is where the item was moved to, rather than from.
+	 */
+	void joinRename(EventIdentifier identifier, EventFlags flags, const char *path, size_t pathLength, bool isDestination)
+	{
+		EventRecord &record = _records.back();
+		const size_t offset = appendPath(path, pathLength);
+		if (isDestination) {
+			record.sourcePathOffset	= record.pathOffset;
+			record.sourcePathLength	= record.pathLength;
+			record.pathOffset		= offset;
+			record.pathLength		= pathLength;
+		} else {
+			record.sourcePathOffset	= offset;
+			record.sourcePathLength	= pathLength;
+		}
+		record.identifier	= identifier;
+		record.flags		|= flags;
+	}
+	
+	/**
+	 * Sets the identity of the item of the last event.
+	 */
+	void setFileIdentity(const FileIdentity &identity) { _records.back().fileIdentity = identity; }
+	
+	/**
+	 * Sets the hash of the contents of the file of the last event.
+	 */
+	void setContentHash(uint64_t hash) { _records.back().contentHash = hash; }
+	
+	bool empty() const { return _records.empty(); }
+	size_t size() const { return _records.size(); }
+	
+	const EventRecord &operator[](size_t index) const { return _records[index]; }
+	const EventRecord &back() const { return _records.back(); }
+	
+	/**
+	 * The records of the batch, contiguous in memory.
+	 */
+	const EventRecord *records() const { return _records.data(); }
+	
+	/**
+	 * The buffer the path offsets of the records refer to.
+	 */
+	const char *pathBuffer() const { return _paths.data(); }
+	
+	/**
+	 * The NUL terminated path of the event at the given index.
+	 */
+	const char *path(size_t index) const { return (_paths.data() + _records[index].pathOffset); }
+	
+	/**
+	 * The NUL terminated path the item of the event at the given index was renamed from, or <code>NULL</code> unless it is a paired rename.
+	 */
+	const char *sourcePath(size_t index) const
+	{
+		const EventRecord &record = _records[index];
+		return (record.sourcePathLength > 0 ? _paths.data() + record.sourcePathOffset : NULL);
+	}
+	
+private:
+	EventBatch(const EventBatch &);
+	EventBatch &operator=(const EventBatch &);
+	
+	size_t appendPath(const char *path, size_t pathLength)
+	{
+		// Every path is NUL terminated so that it can be used as a C string.
+		const size_t offset = _paths.size();
+		_paths.append(path, pathLength);
+		_paths.push_back('\0');
+		
+		return offset;
+	}
+	
+	std::vector<EventRecord>	_records;
+	std::string					_paths;
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_EVENT_H
@@ -0,0 +1,139 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreEventCoalescer.h"
+
+#include <string.h>
+
+#include "CDCorePath.h"
+
+namespace cdevents {
+
+#pragma mark Constants
+// Events which say something about the stream or a whole tree, not an item.
+static const EventFlags kUncoalescedEventFlags = (kEventFlagMustScanSubDirs |
+												  kEventFlagUserDropped |
+												  kEventFlagKernelDropped |
+												  kEventFlagEventIdsWrapped |
+												  kEventFlagHistoryDone |
+												  kEventFlagRootChanged |
+												  kEventFlagMount |
+												  kEventFlagUnmount);
+
+// Events after which the item at the path is gone.
+static const EventFlags kRunEndingEventFlags = (kEventFlagItemRemoved |
+												kEventFlagItemRenamed);
+
+static const size_t kNone = (size_t)-1;
+
+
+#pragma mark Coalescing
+void EventCoalescer::coalesce(const EventBatch &events, EventBatch &coalesced)
+{
+	coalesced.clear();
+	if (events.empty()) {
+		return;
+	}
+	
+	// At most half full, so that the probe sequences stay short.
+	size_t slotCount = 16;
+	while (slotCount < events.size() * 2) {
+		slotCount *= 2;
+	}
+	Slot empty;
+	empty.hash			= 0;
+	empty.eventIndex	= kNone;
+	empty.openRun		= kNone;
+	_slots.assign(slotCount, empty);
+	_runs.clear();
+	_runOfEvent.resize(events.size());
+	
+	for (size_t i = 0; i < events.size(); ++i) {
+		const EventRecord &event = events[i];
+		
+		size_t run = kNone;
+		Slot *slot = NULL;
+		if (!(event.flags & kUncoalescedEventFlags)) {
+			slot = &slotForPath(events, i);
+			run = slot->openRun;
+		}
+		
+		if (run == kNone) {
+			Run newRun;
+			newRun.identifier	= event.identifier;
+			newRun.flags		= kEventFlagNone;
+			newRun.lastIndex	= i;
+			_runs.push_back(newRun);
+			run = _runs.size() - 1;
+		}
+		
+		_runs[run].identifier	= event.identifier;
+		_runs[run].flags		|= event.flags;
+		_runs[run].lastIndex	= i;
+		_runOfEvent[i]			= run;
+		
+		if (slot) {
+			slot->openRun = ((event.flags & kRunEndingEventFlags) ? kNone : run);
+		}
+	}
+	
+	for (size_t i = 0; i < events.size(); ++i) {
+		const Run &run = _runs[_runOfEvent[i]];
+		if (run.lastIndex == i) {
+			const EventRecord &event = events[i];
+			coalesced.append(run.identifier, run.flags, event.timestamp, events.path(i), event.pathLength, events.sourcePath(i), event.sourcePathLength);
+			coalesced.setFileIdentity(event.fileIdentity);
+		}
+	}
+}
+
+
+#pragma mark Private
+EventCoalescer::Slot &EventCoalescer::slotForPath(const EventBatch &events, size_t index)
+{
+	const char *path		= events.path(index);
+	const size_t length		= events[index].pathLength;
+	const uint32_t hash		= hashPath(path, length);
+	const size_t mask		= _slots.size() - 1;
+	
+	for (size_t probe = hash & mask; ; probe = (probe + 1) & mask) {
+		Slot &slot = _slots[probe];
+		if (slot.eventIndex == kNone) {
+			slot.hash		= hash;
+			slot.eventIndex	= index;
+			return slot;
+		}
+		if (slot.hash == hash &&
+			events[slot.eventIndex].pathLength == length &&
+			memcmp(events.path(slot.eventIndex), path, length) == 0) {
+			return slot;
+		}
+	}
+}
+
+} // namespace cdevents
@@ -0,0 +1,99 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreEventCoalescer.h
+ * Merges the events of a batch which concern the same path.
+ */
+
+#ifndef CD_CORE_EVENT_COALESCER_H
+#define CD_CORE_EVENT_COALESCER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "CDCoreEvent.h"
+
+namespace cdevents {
+
+/**
+ * Collapses the events of a batch into one event per path and outcome.
+ *
+ * All events for a path are merged into one event whose flags are the OR of
+ * the flags of the merged events, and which takes the identifier and place in
+ * the batch of the last of them. A removal (or rename) ends the run of events
+ * merged for its path, so that an item which was created and then removed
+ * ends up as one event with both flags, while an item which was removed and
+ * then created again is reported as a removal followed by a creation.
+ *
+ * Events about the stream rather than a single item (dropped events,
+ * rescans, mounts, root changes) are never merged. A paired rename is merged
+ * with the events for its destination and keeps its source path. The merged
+ * event has the file identity of the last of the events.
+ *
+ * The coalescer reuses its storage, once it has grown to the size of the
+ * largest batch no more allocations happen. It is not thread-safe.
+ *
+ * @since head
+ */
+class EventCoalescer {
+public:
+	EventCoalescer() {}
+	
+	/**
+	 * Clears <em>coalesced</em> and appends the coalesced events of <em>events</em> to it.
+	 */
+	void coalesce(const EventBatch &events, EventBatch &coalesced);
+	
+private:
+	struct Run {
+		EventIdentifier	identifier;
+		EventFlags		flags;
+		size_t			lastIndex;
+	};
+	
+	struct Slot {
+		uint32_t		hash;
+		size_t			eventIndex;
+		size_t			openRun;
+	};
+	
+	EventCoalescer(const EventCoalescer &);
+	EventCoalescer &operator=(const EventCoalescer &);
+	
+	Slot &slotForPath(const EventBatch &events, size_t index);
+	
+	std::vector<Run>	_runs;
+	std::vector<size_t>	_runOfEvent;
+	std::vector<Slot>	_slots;
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_EVENT_COALESCER_H
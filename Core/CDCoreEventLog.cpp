@@ -0,0 +1,275 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreEventLog.h"
+
+#include <algorithm>
+#include <string.h>
+
+#include "CDCoreMetrics.h"
+
+namespace cdevents {
+
+#pragma mark Constants
+static const char kEventLogMagic[8] = { 'C', 'D', 'E', 'V', 'L', 'O', 'G', '1' };
+
+// Sanity limits of a batch read back, past which the log is taken to be damaged.
+static const uint64_t kMaximumBatchEventCount = 1 << 24;
+static const uint64_t kMaximumPathLength = 1 << 16;
+
+
+#pragma mark Helpers
+// A batch is written as the varints:
+//
+//     time since the previous batch, event count,
+//     and per event: length shared with the previous path, length of the
+//     rest, the rest of the path (bytes), flags, zigzag encoded difference
+//     from the previous identifier.
+static void appendVarint(std::string &buffer, uint64_t value)
+{
+	while (value >= 0x80) {
+		buffer.push_back((char)((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	buffer.push_back((char)value);
+}
+
+static uint64_t zigzagEncode(int64_t value)
+{
+	return (((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static int64_t zigzagDecode(uint64_t value)
+{
+	return (int64_t)((value >> 1) ^ (~(value & 1) + 1));
+}
+
+
+#pragma mark -
+#pragma mark Recorder
+EventRecorder::EventRecorder()
+:	_file(NULL),
+	_failed(false),
+	_startTime(0),
+	_lastTime(0),
+	_batchCount(0),
+	_lastIdentifier(0)
+{
+}
+
+EventRecorder::~EventRecorder()
+{
+	close();
+}
+
+bool EventRecorder::open(const std::string &file)
+{
+	close();
+	
+	std::lock_guard<std::mutex> lock(_mutex);
+	_file = fopen(file.c_str(), "wb");
+	if (_file == NULL) {
+		return false;
+	}
+	
+	_failed			= (fwrite(kEventLogMagic, sizeof(kEventLogMagic), 1, _file) != 1);
+	_startTime		= monotonicNanoseconds();
+	_lastTime		= 0;
+	_batchCount		= 0;
+	_lastIdentifier	= 0;
+	_lastPath.clear();
+	
+	return !_failed;
+}
+
+bool EventRecorder::close()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_file == NULL) {
+		return true;
+	}
+	
+	const bool closed = (fclose(_file) == 0 && !_failed);
+	_file = NULL;
+	
+	return closed;
+}
+
+void EventRecorder::record(const RawEvent *events, size_t count)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (_file == NULL || _failed) {
+		return;
+	}
+	
+	const uint64_t time = monotonicNanoseconds() - _startTime;
+	_buffer.clear();
+	appendVarint(_buffer, time - _lastTime);
+	appendVarint(_buffer, count);
+	for (size_t i = 0; i < count; ++i) {
+		const RawEvent &event = events[i];
+		
+		size_t shared = 0;
+		const size_t limit = std::min(event.pathLength, _lastPath.size());
+		while (shared < limit && event.path[shared] == _lastPath[shared]) {
+			++shared;
+		}
+		appendVarint(_buffer, shared);
+		appendVarint(_buffer, event.pathLength - shared);
+		_buffer.append(event.path + shared, event.pathLength - shared);
+		appendVarint(_buffer, event.flags);
+		appendVarint(_buffer, zigzagEncode((int64_t)(event.identifier - _lastIdentifier)));
+		
+		_lastPath.assign(event.path, event.pathLength);
+		_lastIdentifier = event.identifier;
+	}
+	
+	_failed = (fwrite(_buffer.data(), 1, _buffer.size(), _file) != _buffer.size());
+	_lastTime = time;
+	++_batchCount;
+}
+
+uint64_t EventRecorder::batchCount() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _batchCount;
+}
+
+
+#pragma mark -
+#pragma mark Reader
+EventLogReader::EventLogReader()
+:	_file(NULL),
+	_lastTime(0),
+	_lastIdentifier(0)
+{
+}
+
+EventLogReader::~EventLogReader()
+{
+	close();
+}
+
+bool EventLogReader::open(const std::string &file)
+{
+	close();
+	
+	_file = fopen(file.c_str(), "rb");
+	if (_file == NULL) {
+		return false;
+	}
+	
+	char magic[sizeof(kEventLogMagic)];
+	if (fread(magic, sizeof(magic), 1, _file) != 1 || memcmp(magic, kEventLogMagic, sizeof(magic)) != 0) {
+		close();
+		return false;
+	}
+	
+	_lastTime = 0;
+	_lastIdentifier = 0;
+	_lastPath.clear();
+	
+	return true;
+}
+
+void EventLogReader::close()
+{
+	if (_file != NULL) {
+		fclose(_file);
+		_file = NULL;
+	}
+}
+
+bool EventLogReader::read(EventLogBatch &batch)
+{
+	uint64_t timeDelta;
+	uint64_t count;
+	if (_file == NULL || !readVarint(timeDelta) || !readVarint(count) || count > kMaximumBatchEventCount) {
+		return false;
+	}
+	
+	batch.time = _lastTime + timeDelta;
+	batch.events.resize((size_t)count);
+	batch.paths.clear();
+	_pathOffsets.resize((size_t)count);
+	for (size_t i = 0; i < count; ++i) {
+		uint64_t shared;
+		uint64_t rest;
+		if (!readVarint(shared) || !readVarint(rest) ||
+			shared > _lastPath.size() || rest > kMaximumPathLength) {
+			return false;
+		}
+		
+		_lastPath.resize((size_t)(shared + rest));
+		if (rest > 0 && fread(&_lastPath[(size_t)shared], 1, (size_t)rest, _file) != rest) {
+			return false;
+		}
+		
+		uint64_t flags;
+		uint64_t identifierDelta;
+		if (!readVarint(flags) || !readVarint(identifierDelta)) {
+			return false;
+		}
+		_lastIdentifier += (EventIdentifier)zigzagDecode(identifierDelta);
+		
+		RawEvent &event		= batch.events[i];
+		event.pathLength	= _lastPath.size();
+		event.flags			= (EventFlags)flags;
+		event.identifier	= _lastIdentifier;
+		event.renameCookie	= 0;
+		_pathOffsets[i]		= batch.paths.size();
+		batch.paths.append(_lastPath);
+	}
+	
+	// The paths are only pointed to once the buffer has stopped growing.
+	for (size_t i = 0; i < count; ++i) {
+		batch.events[i].path = batch.paths.data() + _pathOffsets[i];
+	}
+	_lastTime = batch.time;
+	
+	return true;
+}
+
+bool EventLogReader::readVarint(uint64_t &value)
+{
+	value = 0;
+	for (unsigned shift = 0; shift < 64; shift += 7) {
+		const int byte = getc(_file);
+		if (byte == EOF) {
+			return false;
+		}
+		value |= ((uint64_t)(byte & 0x7F) << shift);
+		if ((byte & 0x80) == 0) {
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+} // namespace cdevents
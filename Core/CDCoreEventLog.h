@@ -0,0 +1,161 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreEventLog.h
+ * A compact binary log of the raw event batches of a backend.
+ */
+
+#ifndef CD_CORE_EVENT_LOG_H
+#define CD_CORE_EVENT_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "CDCoreBackend.h"
+#include "CDCoreEvent.h"
+
+namespace cdevents {
+
+/**
+ * Writes the raw batches of a backend to a log, for PlaybackBackend to play back.
+ *
+ * Set a recorder as StreamConfiguration::recorder to have a stream record
+ * every batch its backend reports, before any filtering. The log holds the
+ * paths, flags and identifiers of the events and the time each batch
+ * arrived at. Batches are varint encoded and each path only stores what
+ * differs from the one before it, so a log takes a few bytes per event.
+ *
+ * The recorder is thread-safe.
+ *
+ * @since head
+ */
+class EventRecorder {
+public:
+	EventRecorder();
+	~EventRecorder();
+	
+	/**
+	 * Creates, or truncates, the log at the given path and starts recording to it.
+	 *
+	 * @return <code>false</code> if the log could not be created.
+	 */
+	bool open(const std::string &file);
+	
+	/**
+	 * Writes out what is buffered and closes the log. Batches recorded after are ignored.
+	 *
+	 * @return <code>false</code> if the log could not be written completely.
+	 */
+	bool close();
+	
+	/**
+	 * Appends a batch to the log, stamped with the time since the log was opened.
+	 */
+	void record(const RawEvent *events, size_t count);
+	
+	/**
+	 * The number of batches recorded since the log was opened.
+	 */
+	uint64_t batchCount() const;
+	
+private:
+	EventRecorder(const EventRecorder &);
+	EventRecorder &operator=(const EventRecorder &);
+	
+	mutable std::mutex	_mutex;
+	FILE				*_file;
+	bool				_failed;
+	uint64_t			_startTime;
+	uint64_t			_lastTime;
+	uint64_t			_batchCount;
+	EventIdentifier		_lastIdentifier;
+	std::string			_lastPath;
+	std::string			_buffer;
+};
+
+
+/**
+ * One batch read back from a log.
+ *
+ * @since head
+ */
+struct EventLogBatch {
+	/** When the batch was recorded, in nanoseconds since the log was opened. */
+	uint64_t				time;
+	/** The events, whose paths point into <em>paths</em>. */
+	std::vector<RawEvent>	events;
+	/** The paths of the events, one after the other. */
+	std::string				paths;
+};
+
+/**
+ * Reads the batches of a log written by EventRecorder, one at a time.
+ *
+ * @since head
+ */
+class EventLogReader {
+public:
+	EventLogReader();
+	~EventLogReader();
+	
+	/**
+	 * Opens the log at the given path.
+	 *
+	 * @return <code>false</code> if it could not be opened or is not a log.
+	 */
+	bool open(const std::string &file);
+	void close();
+	
+	/**
+	 * Reads the next batch into <em>batch</em>, reusing its buffers.
+	 *
+	 * @return <code>false</code> at the end of the log, or if the rest of it is truncated or damaged.
+	 */
+	bool read(EventLogBatch &batch);
+	
+private:
+	EventLogReader(const EventLogReader &);
+	EventLogReader &operator=(const EventLogReader &);
+	
+	bool readVarint(uint64_t &value);
+	
+	FILE				*_file;
+	uint64_t			_lastTime;
+	EventIdentifier		_lastIdentifier;
+	std::string			_lastPath;
+	std::vector<size_t>	_pathOffsets;
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_EVENT_LOG_H
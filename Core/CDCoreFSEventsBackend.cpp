@@ -0,0 +1,412 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreFSEventsBackend.h"
+
+#if defined(__APPLE__)
+
+#include <string.h>
+#include <sys/stat.h>
+
+namespace cdevents {
+
+// The core flags are the FSEvents flags, events are passed through untouched.
+static_assert(kEventFlagMustScanSubDirs == kFSEventStreamEventFlagMustScanSubDirs, "flag mismatch");
+static_assert(kEventFlagUserDropped == kFSEventStreamEventFlagUserDropped, "flag mismatch");
+static_assert(kEventFlagKernelDropped == kFSEventStreamEventFlagKernelDropped, "flag mismatch");
+static_assert(kEventFlagEventIdsWrapped == kFSEventStreamEventFlagEventIdsWrapped, "flag mismatch");
+static_assert(kEventFlagHistoryDone == kFSEventStreamEventFlagHistoryDone, "flag mismatch");
+static_assert(kEventFlagRootChanged == kFSEventStreamEventFlagRootChanged, "flag mismatch");
+static_assert(kEventFlagMount == kFSEventStreamEventFlagMount, "flag mismatch");
+static_assert(kEventFlagUnmount == kFSEventStreamEventFlagUnmount, "flag mismatch");
+static_assert(kStreamCreationFlagUseCFTypes == kFSEventStreamCreateFlagUseCFTypes, "flag mismatch");
+static_assert(kStreamCreationFlagNoDefer == kFSEventStreamCreateFlagNoDefer, "flag mismatch");
+static_assert(kStreamCreationFlagWatchRoot == kFSEventStreamCreateFlagWatchRoot, "flag mismatch");
+static_assert(kEventIdentifierSinceNow == kFSEventStreamEventIdSinceNow, "identifier mismatch");
+
+
+// The target of the source the event stream is restarted from, which may
+// fire on the run loop or queue while the backend is being stopped.
+struct FSEventsBackend::Restarter {
+	std::mutex		mutex;
+	FSEventsBackend	*backend;
+};
+
+
+#pragma mark Helpers
+static std::string stringFromCFString(CFStringRef string)
+{
+	const CFIndex length = CFStringGetMaximumSizeForEncoding(CFStringGetLength(string), kCFStringEncodingUTF8) + 1;
+	std::vector<char> buffer((size_t)length);
+	if (!CFStringGetCString(string, buffer.data(), length, kCFStringEncodingUTF8)) {
+		return std::string();
+	}
+	
+	return std::string(buffer.data());
+}
+
+
+#pragma mark Init/dealloc
+FSEventsBackend::FSEventsBackend(CFRunLoopRef runLoop)
+:	_runLoop(runLoop),
+	_queue(NULL),
+	_eventStream(NULL),
+	_lastEventIdentifier(kEventIdentifierSinceNow),
+	_restartEventIdentifier(kEventIdentifierSinceNow),
+	_skipsHistoryDone(false),
+	_restarter(NULL),
+	_restartSource(NULL),
+	_restartQueueSource(NULL)
+{
+	CFRetain(_runLoop);
+}
+
+FSEventsBackend::FSEventsBackend(dispatch_queue_t queue)
+:	_runLoop(NULL),
+	_queue(queue),
+	_eventStream(NULL),
+	_lastEventIdentifier(kEventIdentifierSinceNow),
+	_restartEventIdentifier(kEventIdentifierSinceNow),
+	_skipsHistoryDone(false),
+	_restarter(NULL),
+	_restartSource(NULL),
+	_restartQueueSource(NULL)
+{
+	dispatch_retain(_queue);
+}
+
+FSEventsBackend::~FSEventsBackend()
+{
+	stop();
+	if (_runLoop) {
+		CFRelease(_runLoop);
+	}
+	if (_queue) {
+		dispatch_release(_queue);
+	}
+}
+
+
+#pragma mark Backend
+void FSEventsBackend::start(const StreamConfiguration &configuration, const BackendHandler &handler)
+{
+	_handler				= handler;
+	_configuration			= configuration;
+	_lastEventIdentifier	= (configuration.sinceEventIdentifier == kEventIdentifierSinceNow ?
+							   (EventIdentifier)FSEventsGetCurrentEventId() :
+							   configuration.sinceEventIdentifier);
+	
+	// Taking over from an earlier stream is a restart like those below.
+	_skipsHistoryDone		= (configuration.resumesEarlierStream &&
+							   configuration.sinceEventIdentifier != kEventIdentifierSinceNow);
+	_restartEventIdentifier	= (_skipsHistoryDone ? configuration.sinceEventIdentifier : kEventIdentifierSinceNow);
+	
+	createEventStream();
+	
+	// The restarter is freed by the source, once it can no longer fire.
+	_restarter = new Restarter();
+	_restarter->backend = this;
+	if (_queue) {
+		_restartQueueSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_OR, 0, 0, _queue);
+		dispatch_set_context(_restartQueueSource, _restarter);
+		dispatch_source_set_event_handler_f(_restartQueueSource, &FSEventsBackend::restartCallback);
+		dispatch_source_set_cancel_handler_f(_restartQueueSource, &FSEventsBackend::releaseRestarter);
+		dispatch_resume(_restartQueueSource);
+	} else {
+		CFRunLoopSourceContext sourceCtx;
+		memset(&sourceCtx, 0, sizeof(sourceCtx));
+		sourceCtx.info		= _restarter;
+		sourceCtx.release	= &FSEventsBackend::releaseRestarter;
+		sourceCtx.perform	= &FSEventsBackend::restartCallback;
+		_restartSource = CFRunLoopSourceCreate(kCFAllocatorDefault, 0, &sourceCtx);
+		CFRunLoopAddSource(_runLoop, _restartSource, kCFRunLoopDefaultMode);
+	}
+}
+
+void FSEventsBackend::stop()
+{
+	// Waits for a restart in progress, none is started afterwards.
+	if (_restarter) {
+		std::lock_guard<std::mutex> lock(_restarter->mutex);
+		_restarter->backend = NULL;
+		_restarter = NULL;
+	}
+	if (_restartQueueSource) {
+		dispatch_source_cancel(_restartQueueSource);
+		dispatch_release(_restartQueueSource);
+		_restartQueueSource = NULL;
+	}
+	if (_restartSource) {
+		CFRunLoopSourceInvalidate(_restartSource);
+		CFRelease(_restartSource);
+		_restartSource = NULL;
+	}
+	
+	disposeEventStream();
+}
+
+void FSEventsBackend::setNotificationLatency(double latency)
+{
+	if (latency == _configuration.notificationLatency) {
+		return;
+	}
+	_configuration.notificationLatency = latency;
+	
+	// The event stream cannot be disposed of from within its callback.
+	scheduleRestart();
+}
+
+void FSEventsBackend::setWatchedPaths(const std::vector<std::string> &paths)
+{
+	if (_restarter == NULL) {
+		_configuration.watchedPaths = paths;
+		return;
+	}
+	
+	// Read by the restart, on the run loop or queue.
+	{
+		std::lock_guard<std::mutex> lock(_restarter->mutex);
+		_configuration.watchedPaths = paths;
+	}
+	scheduleRestart();
+}
+
+void FSEventsBackend::flushSynchronously()
+{
+	if (_eventStream) {
+		FSEventStreamFlushSync(_eventStream);
+	}
+}
+
+void FSEventsBackend::flushAsynchronously()
+{
+	if (_eventStream) {
+		FSEventStreamFlushAsync(_eventStream);
+	}
+}
+
+EventIdentifier FSEventsBackend::currentEventIdentifier() const
+{
+	return (EventIdentifier)FSEventsGetCurrentEventId();
+}
+
+std::string FSEventsBackend::historyIdentifier(const std::string &path) const
+{
+	// Each volume has its own event database, identified by a UUID which
+	// changes whenever the database is purged.
+	struct stat status;
+	if (stat(path.c_str(), &status) != 0) {
+		return std::string();
+	}
+	
+	CFUUIDRef uuid = FSEventsCopyUUIDForDevice(status.st_dev);
+	if (uuid == NULL) {
+		return std::string();
+	}
+	CFStringRef uuidString = CFUUIDCreateString(kCFAllocatorDefault, uuid);
+	const std::string history = stringFromCFString(uuidString);
+	CFRelease(uuidString);
+	CFRelease(uuid);
+	
+	return history;
+}
+
+std::string FSEventsBackend::description() const
+{
+	if (!(_eventStream)) {
+		return std::string();
+	}
+	
+	CFStringRef descriptionCF = FSEventStreamCopyDescription(_eventStream);
+	const std::string description = stringFromCFString(descriptionCF);
+	CFRelease(descriptionCF);
+	
+	return description;
+}
+
+
+#pragma mark Event stream
+void FSEventsBackend::createEventStream()
+{
+	FSEventStreamContext callbackCtx;
+	callbackCtx.version			= 0;
+	callbackCtx.info			= this;
+	callbackCtx.retain			= NULL;
+	callbackCtx.release			= NULL;
+	callbackCtx.copyDescription	= NULL;
+	
+	CFMutableArrayRef watchedPaths = CFArrayCreateMutable(kCFAllocatorDefault,
+														  (CFIndex)_configuration.watchedPaths.size(),
+														  &kCFTypeArrayCallBacks);
+	for (size_t i = 0; i < _configuration.watchedPaths.size(); ++i) {
+		CFStringRef path = CFStringCreateWithFileSystemRepresentation(kCFAllocatorDefault,
+																	  _configuration.watchedPaths[i].c_str());
+		CFArrayAppendValue(watchedPaths, path);
+		CFRelease(path);
+	}
+	
+	_eventStream = FSEventStreamCreate(kCFAllocatorDefault,
+									   &FSEventsBackend::callback,
+									   &callbackCtx,
+									   watchedPaths,
+									   (FSEventStreamEventId)_configuration.sinceEventIdentifier,
+									   _configuration.notificationLatency,
+									   (FSEventStreamCreateFlags)(_configuration.creationFlags & ~kStreamCreationFlagUseCFTypes));
+	CFRelease(watchedPaths);
+	
+	if (_eventStream == NULL) {
+		throw StreamCreationFailure("Failed to create event stream.");
+	}
+	
+	if (_queue) {
+		FSEventStreamSetDispatchQueue(_eventStream, _queue);
+	} else {
+		FSEventStreamScheduleWithRunLoop(_eventStream, _runLoop, kCFRunLoopDefaultMode);
+	}
+	if (!FSEventStreamStart(_eventStream)) {
+		disposeEventStream();
+		throw StreamCreationFailure("Failed to create event stream.");
+	}
+}
+
+void FSEventsBackend::disposeEventStream()
+{
+	if (!(_eventStream)) {
+		return;
+	}
+	
+	FSEventStreamStop(_eventStream);
+	FSEventStreamInvalidate(_eventStream);
+	FSEventStreamRelease(_eventStream);
+	_eventStream = NULL;
+}
+
+void FSEventsBackend::scheduleRestart()
+{
+	if (_restartQueueSource) {
+		dispatch_source_merge_data(_restartQueueSource, 1);
+	} else if (_restartSource) {
+		CFRunLoopSourceSignal(_restartSource);
+		CFRunLoopWakeUp(_runLoop);
+	}
+}
+
+void FSEventsBackend::restart()
+{
+	if (!(_eventStream)) {
+		return;
+	}
+	
+	// The new event stream replays everything after the last event delivered,
+	// without the end of the replay, which the client never asked for. The
+	// old one is gone first, so no event is delivered by both.
+	disposeEventStream();
+	_configuration.sinceEventIdentifier = _lastEventIdentifier;
+	_restartEventIdentifier = _lastEventIdentifier;
+	_skipsHistoryDone = true;
+	try {
+		createEventStream();
+	} catch (const StreamCreationFailure &) {
+		// Nothing more will be delivered, tell the client what it missed.
+		std::vector<RawEvent> events(_configuration.watchedPaths.size());
+		for (size_t i = 0; i < events.size(); ++i) {
+			events[i].path			= _configuration.watchedPaths[i].c_str();
+			events[i].pathLength	= _configuration.watchedPaths[i].size();
+			events[i].flags			= (kEventFlagMustScanSubDirs | kEventFlagUserDropped);
+			events[i].identifier	= _lastEventIdentifier;
+			events[i].renameCookie	= 0;
+		}
+		_handler(events.data(), events.size());
+	}
+}
+
+
+#pragma mark FSEvents callback
+void FSEventsBackend::callback(ConstFSEventStreamRef streamRef,
+							   void *callbackCtxInfo,
+							   size_t numEvents,
+							   void *eventPaths, // char **
+							   const FSEventStreamEventFlags eventFlags[],
+							   const FSEventStreamEventId eventIds[])
+{
+	FSEventsBackend *backend	= static_cast<FSEventsBackend *>(callbackCtxInfo);
+	const char **paths			= static_cast<const char **>(eventPaths);
+	
+	backend->_events.clear();
+	for (size_t i = 0; i < numEvents; ++i) {
+		if (backend->_skipsHistoryDone) {
+			if (eventFlags[i] & kFSEventStreamEventFlagHistoryDone) {
+				backend->_skipsHistoryDone = false;
+				continue;
+			}
+			// Whatever the replay repeats of the old event stream.
+			if (eventIds[i] != 0 && eventIds[i] <= backend->_restartEventIdentifier &&
+				!(eventFlags[i] & kFSEventStreamEventFlagEventIdsWrapped)) {
+				continue;
+			}
+		}
+		if (eventIds[i] != 0) {
+			backend->_lastEventIdentifier = (EventIdentifier)eventIds[i];
+		}
+		
+		RawEvent event;
+		event.path			= paths[i];
+		event.pathLength	= strlen(paths[i]);
+		event.flags			= (EventFlags)eventFlags[i];
+		event.identifier	= (EventIdentifier)eventIds[i];
+		event.renameCookie	= 0;
+		backend->_events.push_back(event);
+	}
+	
+	if (!backend->_events.empty()) {
+		backend->_handler(backend->_events.data(), backend->_events.size());
+	}
+}
+
+void FSEventsBackend::restartCallback(void *info)
+{
+	Restarter *restarter = static_cast<Restarter *>(info);
+	std::lock_guard<std::mutex> lock(restarter->mutex);
+	if (restarter->backend) {
+		restarter->backend->restart();
+	}
+}
+
+void FSEventsBackend::releaseRestarter(const void *info)
+{
+	delete static_cast<const Restarter *>(info);
+}
+
+void FSEventsBackend::releaseRestarter(void *info)
+{
+	delete static_cast<Restarter *>(info);
+}
+
+} // namespace cdevents
+
+#endif // defined(__APPLE__)
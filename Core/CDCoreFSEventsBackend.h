@@ -0,0 +1,124 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreFSEventsBackend.h
+ * An OS X backend built on FSEvents.
+ */
+
+#ifndef CD_CORE_FSEVENTS_BACKEND_H
+#define CD_CORE_FSEVENTS_BACKEND_H
+
+#if defined(__APPLE__)
+
+#include <CoreServices/CoreServices.h>
+#include <dispatch/dispatch.h>
+#include <mutex>
+#include <vector>
+
+#include "CDCoreBackend.h"
+
+// The backend is compiled as C++ but also used from Objective-C++, where
+// dispatch objects would otherwise be Objective-C objects of another type.
+#if OS_OBJECT_USE_OBJC
+	#error The CDEvents core requires OS_OBJECT_USE_OBJC=0.
+#endif
+
+namespace cdevents {
+
+/**
+ * A backend which wraps an <code>FSEventStream</code> scheduled on a run loop or a dispatch queue.
+ *
+ * Events are delivered on the run loop or dispatch queue the backend was
+ * created with. A (serial) dispatch queue keeps the stream, and everything
+ * done with its events, off the thread of any run loop. The
+ * stream is always created without kStreamCreationFlagUseCFTypes so that the
+ * event paths reach the core as C strings, without any CoreFoundation object
+ * being created per event.
+ *
+ * @since head
+ */
+class FSEventsBackend : public Backend {
+public:
+	explicit FSEventsBackend(CFRunLoopRef runLoop);
+	explicit FSEventsBackend(dispatch_queue_t queue);
+	virtual ~FSEventsBackend();
+	
+	virtual void start(const StreamConfiguration &configuration, const BackendHandler &handler);
+	virtual void stop();
+	virtual void setNotificationLatency(double latency);
+	virtual void setWatchedPaths(const std::vector<std::string> &paths);
+	virtual void flushSynchronously();
+	virtual void flushAsynchronously();
+	virtual EventIdentifier currentEventIdentifier() const;
+	virtual std::string historyIdentifier(const std::string &path) const;
+	virtual std::string description() const;
+	
+private:
+	FSEventsBackend(const FSEventsBackend &);
+	FSEventsBackend &operator=(const FSEventsBackend &);
+	
+	struct Restarter;
+	
+	void createEventStream();
+	void disposeEventStream();
+	void scheduleRestart();
+	void restart();
+	
+	static void callback(ConstFSEventStreamRef streamRef,
+						 void *callbackCtxInfo,
+						 size_t numEvents,
+						 void *eventPaths,
+						 const FSEventStreamEventFlags eventFlags[],
+						 const FSEventStreamEventId eventIds[]);
+	static void restartCallback(void *info);
+	static void releaseRestarter(const void *info);
+	static void releaseRestarter(void *info);
+	
+	CFRunLoopRef			_runLoop;
+	dispatch_queue_t		_queue;
+	FSEventStreamRef		_eventStream;
+	BackendHandler			_handler;
+	std::vector<RawEvent>	_events;
+	
+	// The event stream is recreated to change its latency or paths, on its
+	// run loop or queue, from the last event it delivered.
+	StreamConfiguration		_configuration;
+	EventIdentifier			_lastEventIdentifier;
+	EventIdentifier			_restartEventIdentifier;
+	bool					_skipsHistoryDone;
+	Restarter				*_restarter;
+	CFRunLoopSourceRef		_restartSource;
+	dispatch_source_t		_restartQueueSource;
+};
+
+} // namespace cdevents
+
+#endif // defined(__APPLE__)
+
+#endif // CD_CORE_FSEVENTS_BACKEND_H
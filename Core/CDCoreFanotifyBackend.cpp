@@ -0,0 +1,407 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreFanotifyBackend.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/fanotify.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+
+#include <sstream>
+
+#include "CDCorePath.h"
+
+// Older C library headers lack the directory file handle reporting of Linux 5.9.
+#ifndef FAN_REPORT_DIR_FID
+	#define FAN_REPORT_DIR_FID				0x00000400
+#endif
+#ifndef FAN_REPORT_NAME
+	#define FAN_REPORT_NAME					0x00000800
+#endif
+#ifndef FAN_REPORT_DFID_NAME
+	#define FAN_REPORT_DFID_NAME			(FAN_REPORT_DIR_FID | FAN_REPORT_NAME)
+#endif
+#ifndef FAN_EVENT_INFO_TYPE_DFID_NAME
+	#define FAN_EVENT_INFO_TYPE_DFID_NAME	2
+#endif
+#ifndef FAN_EVENT_INFO_TYPE_DFID
+	#define FAN_EVENT_INFO_TYPE_DFID		3
+#endif
+
+namespace cdevents {
+
+#pragma mark Constants
+static const uint64_t kFanotifyMarkMask = (FAN_CREATE |
+										   FAN_DELETE |
+										   FAN_MOVED_FROM |
+										   FAN_MOVED_TO |
+										   FAN_MODIFY |
+										   FAN_ATTRIB |
+										   FAN_DELETE_SELF |
+										   FAN_MOVE_SELF |
+										   FAN_ONDIR);
+
+// The resolved directories are forgotten all at once when there are this many.
+static const size_t kMaxResolvedDirectories = 64 * 1024;
+
+static const char kDeletedSuffix[] = " (deleted)";
+
+static uint64_t filesystemIdentifier(const int *fsid)
+{
+	return ((uint64_t)(uint32_t)fsid[0] | ((uint64_t)(uint32_t)fsid[1] << 32));
+}
+
+static std::string handleKey(uint64_t filesystem, const struct file_handle *handle)
+{
+	std::string key((const char *)&filesystem, sizeof(filesystem));
+	key.append((const char *)&handle->handle_type, sizeof(handle->handle_type));
+	key.append((const char *)handle->f_handle, handle->handle_bytes);
+	
+	return key;
+}
+
+
+#pragma mark Init/dealloc
+FanotifyBackend::FanotifyBackend()
+{
+}
+
+FanotifyBackend::~FanotifyBackend()
+{
+	stop();
+}
+
+
+#pragma mark Backend
+std::string FanotifyBackend::description() const
+{
+	std::ostringstream description;
+	description << "FanotifyBackend { watchedPaths = (";
+	for (size_t i = 0; i < _configuration.watchedPaths.size(); ++i) {
+		description << (i > 0 ? ", " : "") << _configuration.watchedPaths[i];
+	}
+	description << "), latency = " << _configuration.notificationLatency
+				<< ", sinceWhen = " << _configuration.sinceEventIdentifier
+				<< ", flags = " << _configuration.creationFlags
+				<< ", filesystems = " << _mountDescriptors.size()
+				<< ", resolvedDirectories = " << _directories.size() << " }";
+	
+	return description.str();
+}
+
+
+#pragma mark Event source
+void FanotifyBackend::openEventSource()
+{
+	_eventDescriptor = fanotify_init((FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_CLOEXEC | FAN_NONBLOCK),
+									 (O_RDONLY | O_LARGEFILE));
+	if (_eventDescriptor < 0) {
+		const int error = errno;
+		throw StreamCreationFailure(std::string("fanotify_init failed: ") + strerror(error) +
+									(error == EPERM ? " (CAP_SYS_ADMIN is required)" :
+									 (error == EINVAL ? " (FAN_REPORT_DFID_NAME requires Linux 5.9)" : "")));
+	}
+	
+	watchPaths();
+}
+
+void FanotifyBackend::watchPaths()
+{
+	// Filesystems stay marked, events outside the watched paths are ignored anyway.
+	_resolvedWatchedPaths.clear();
+	_resolvedWatchedPathTrie.clear();
+	_watchedPathIndexes.clear();
+	_watchedDirectories.clear();
+	
+	for (size_t i = 0; i < _configuration.watchedPaths.size(); ++i) {
+		const std::string &watchedPath = _configuration.watchedPaths[i];
+		
+		// Paths which do not exist (yet) have nothing to watch, just like with inotify.
+		char resolved[PATH_MAX];
+		if (realpath(watchedPath.c_str(), resolved) == NULL) {
+			_resolvedWatchedPaths.push_back(std::string());
+			continue;
+		}
+		_resolvedWatchedPaths.push_back(resolved);
+		
+		const PathTrie::Node node = _resolvedWatchedPathTrie.insert(_resolvedWatchedPaths.back());
+		_watchedPathIndexes.resize(_resolvedWatchedPathTrie.nodeCount(), 0);
+		_watchedPathIndexes[node] = i;
+		
+		// Kept open to resolve file handles with, which does not work with O_PATH descriptors.
+		const int descriptor = open(resolved, (O_RDONLY | O_NONBLOCK | O_CLOEXEC));
+		struct statfs filesystemInfo;
+		if (descriptor < 0 || fstatfs(descriptor, &filesystemInfo) != 0) {
+			if (descriptor >= 0) {
+				close(descriptor);
+			}
+			continue;
+		}
+		const uint64_t filesystem = filesystemIdentifier((const int *)&filesystemInfo.f_fsid);
+		
+		// One mark covers every path of the filesystem.
+		if (_mountDescriptors.find(filesystem) == _mountDescriptors.end()) {
+			if (fanotify_mark(_eventDescriptor, (FAN_MARK_ADD | FAN_MARK_FILESYSTEM), kFanotifyMarkMask, AT_FDCWD, resolved) != 0) {
+				const int error = errno;
+				close(descriptor);
+				throw StreamCreationFailure("Failed to mark the filesystem of \"" + watchedPath + "\": " + strerror(error));
+			}
+			_mountDescriptors[filesystem] = descriptor;
+		} else {
+			close(descriptor);
+		}
+		
+		union {
+			struct file_handle	handle;
+			char				storage[sizeof(struct file_handle) + MAX_HANDLE_SZ];
+		} handle;
+		int mountIdentifier;
+		handle.handle.handle_bytes = MAX_HANDLE_SZ;
+		if (name_to_handle_at(AT_FDCWD, resolved, &handle.handle, &mountIdentifier, 0) == 0) {
+			_watchedDirectories[handleKey(filesystem, &handle.handle)] = resolved;
+		}
+	}
+}
+
+void FanotifyBackend::readEvents()
+{
+	char buffer[64 * 1024] __attribute__((aligned(__alignof__(struct fanotify_event_metadata))));
+	
+	for (;;) {
+		ssize_t length = read(_eventDescriptor, buffer, sizeof(buffer));
+		if (length <= 0) {
+			break;
+		}
+		
+		const struct fanotify_event_metadata *metadata = (const struct fanotify_event_metadata *)buffer;
+		for (; FAN_EVENT_OK(metadata, length); metadata = FAN_EVENT_NEXT(metadata, length)) {
+			if (metadata->vers != FANOTIFY_METADATA_VERSION) {
+				return;
+			}
+			
+			if (metadata->mask & FAN_Q_OVERFLOW) {
+				addRescanEvents(kEventFlagKernelDropped);
+			} else {
+				handleEvent(metadata->mask,
+							(const char *)metadata + metadata->metadata_len,
+							(metadata->event_len - metadata->metadata_len));
+			}
+			
+			if (metadata->fd >= 0) {
+				close(metadata->fd);
+			}
+		}
+	}
+}
+
+void FanotifyBackend::watchedPathsChanged(const std::vector<std::string> &previous)
+{
+	(void)previous;
+	
+	try {
+		watchPaths();
+	} catch (const StreamCreationFailure &) {
+		addRescanEvents(kEventFlagUserDropped);
+	}
+}
+
+void FanotifyBackend::closeEventSource()
+{
+	for (std::unordered_map<uint64_t, int>::const_iterator mount = _mountDescriptors.begin(); mount != _mountDescriptors.end(); ++mount) {
+		close(mount->second);
+	}
+	_mountDescriptors.clear();
+	
+	_resolvedWatchedPaths.clear();
+	_resolvedWatchedPathTrie.clear();
+	_watchedPathIndexes.clear();
+	_watchedDirectories.clear();
+	_directories.clear();
+}
+
+
+#pragma mark Events
+void FanotifyBackend::handleEvent(uint64_t mask, const void *info, size_t infoLength)
+{
+	// Find the directory record, there is exactly one with FAN_REPORT_DFID_NAME.
+	const struct fanotify_event_info_fid *record = NULL;
+	for (size_t offset = 0; offset + sizeof(struct fanotify_event_info_header) <= infoLength; ) {
+		const struct fanotify_event_info_header *header = (const struct fanotify_event_info_header *)((const char *)info + offset);
+		if (header->len == 0) {
+			break;
+		}
+		if (header->info_type == FAN_EVENT_INFO_TYPE_DFID_NAME ||
+			header->info_type == FAN_EVENT_INFO_TYPE_DFID ||
+			header->info_type == FAN_EVENT_INFO_TYPE_FID) {
+			record = (const struct fanotify_event_info_fid *)header;
+			break;
+		}
+		offset += header->len;
+	}
+	if (record == NULL) {
+		return;
+	}
+	
+	const uint64_t filesystem = filesystemIdentifier((const int *)&record->fsid);
+	const struct file_handle *handle = (const struct file_handle *)record->handle;
+	const char *name = NULL;
+	if (record->hdr.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME) {
+		name = (const char *)handle->f_handle + handle->handle_bytes;
+		if (strcmp(name, ".") == 0) {
+			name = NULL;
+		}
+	}
+	const std::string key = handleKey(filesystem, handle);
+	
+	if (mask & (FAN_DELETE_SELF | FAN_MOVE_SELF)) {
+		// Changes of other directories are reported by their parents.
+		std::unordered_map<std::string, std::string>::const_iterator root = _watchedDirectories.find(key);
+		if (root != _watchedDirectories.end() && (_configuration.creationFlags & kStreamCreationFlagWatchRoot)) {
+			std::string path(root->second);
+			if (mapToWatchedPath(path)) {
+				addEvent(path, kEventFlagRootChanged, 0);
+			}
+		}
+		return;
+	}
+	
+	std::string directory;
+	if (!resolveDirectory(key, filesystem, handle, directory)) {
+		return;
+	}
+	
+	std::string path = (name != NULL ? pathByAppendingComponent(directory, name) : directory);
+	if (!mapToWatchedPath(path)) {
+		return;
+	}
+	// Changes of the watched paths themselves are reported for the paths, not their parents.
+	if (!mapToWatchedPath(directory)) {
+		directory = path;
+	}
+	
+	const bool isDirectory = ((mask & FAN_ONDIR) != 0);
+	EventFlags flags = (isDirectory ? kEventFlagItemIsDir : kEventFlagItemIsFile);
+	if (mask & FAN_CREATE) {
+		flags |= kEventFlagItemCreated;
+	}
+	if (mask & FAN_DELETE) {
+		flags |= kEventFlagItemRemoved;
+	}
+	if (mask & (FAN_MOVED_FROM | FAN_MOVED_TO)) {
+		flags |= kEventFlagItemRenamed;
+	}
+	if (mask & FAN_MODIFY) {
+		flags |= kEventFlagItemModified;
+	}
+	if (mask & FAN_ATTRIB) {
+		flags |= kEventFlagItemInodeMetaMod;
+	}
+	addItemEvent(directory, path, flags);
+	
+	// The resolved paths of a moved directory and everything below it are stale.
+	if (isDirectory && (mask & (FAN_MOVED_FROM | FAN_MOVED_TO))) {
+		_directories.clear();
+	}
+}
+
+bool FanotifyBackend::resolveDirectory(const std::string &key, uint64_t filesystem, const void *handle, std::string &path)
+{
+	std::unordered_map<std::string, std::string>::const_iterator directory = _watchedDirectories.find(key);
+	if (directory != _watchedDirectories.end()) {
+		path = directory->second;
+		return true;
+	}
+	directory = _directories.find(key);
+	if (directory != _directories.end()) {
+		path = directory->second;
+		return true;
+	}
+	
+	std::unordered_map<uint64_t, int>::const_iterator mount = _mountDescriptors.find(filesystem);
+	if (mount == _mountDescriptors.end()) {
+		return false;
+	}
+	
+	// The directory may be gone by now, in which case its events are lost.
+	const int descriptor = open_by_handle_at(mount->second, (struct file_handle *)handle, (O_PATH | O_CLOEXEC));
+	if (descriptor < 0) {
+		return false;
+	}
+	
+	char link[32];
+	char target[PATH_MAX];
+	snprintf(link, sizeof(link), "/proc/self/fd/%d", descriptor);
+	const ssize_t length = readlink(link, target, sizeof(target));
+	close(descriptor);
+	if (length <= 0 || (size_t)length >= sizeof(target)) {
+		return false;
+	}
+	
+	path.assign(target, length);
+	const size_t suffixLength = sizeof(kDeletedSuffix) - 1;
+	if (path.size() > suffixLength && path.compare(path.size() - suffixLength, suffixLength, kDeletedSuffix) == 0) {
+		return false;
+	}
+	
+	if (_directories.size() >= kMaxResolvedDirectories) {
+		_directories.clear();
+	}
+	_directories[key] = path;
+	
+	return true;
+}
+
+bool FanotifyBackend::mapToWatchedPath(std::string &path) const
+{
+	const PathTrie::Node node = _resolvedWatchedPathTrie.longestPrefixOfPath(path.data(), path.size());
+	if (node == PathTrie::kNotFound) {
+		return false;
+	}
+	
+	// Report paths below the watched paths as they were given, not as the kernel knows them.
+	const size_t index = _watchedPathIndexes[node];
+	const std::string &resolved = _resolvedWatchedPaths[index];
+	const std::string &watched = _configuration.watchedPaths[index];
+	if (resolved != watched && resolved != "/") {
+		path.replace(0, resolved.size(), watched);
+	}
+	
+	return true;
+}
+
+} // namespace cdevents
+
+#endif // defined(__linux__)
@@ -0,0 +1,113 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreFanotifyBackend.h
+ * A Linux backend built on fanotify filesystem marks.
+ */
+
+#ifndef CD_CORE_FANOTIFY_BACKEND_H
+#define CD_CORE_FANOTIFY_BACKEND_H
+
+#if defined(__linux__)
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CDCorePathTrie.h"
+#include "CDCorePollingBackend.h"
+
+namespace cdevents {
+
+/**
+ * A backend which watches whole filesystems with fanotify.
+ *
+ * Unlike InotifyBackend, which needs a watch for every directory below the
+ * watched paths, a single FAN_MARK_FILESYSTEM mark is placed on each
+ * filesystem containing a watched path, so starting the stream takes the same
+ * time no matter how large the watched trees are. Events are reported with
+ * the file handle of the containing directory and the name of the entry
+ * (FAN_REPORT_DFID_NAME); directory handles are resolved into paths lazily,
+ * when an event for them is read, and cached. Events outside the watched paths
+ * are dropped before they are batched.
+ *
+ * The event flags are mapped as by InotifyBackend, with FAN_ONDIR marking
+ * directories.
+ *
+ * Marking a filesystem requires CAP_SYS_ADMIN and resolving file handles
+ * CAP_DAC_READ_SEARCH, as well as Linux 5.9 or later for FAN_REPORT_DFID_NAME.
+ * If any of these are missing the stream fails to be created and the caller
+ * may fall back to InotifyBackend.
+ *
+ * @see PollingBackend for batching, event identifiers and event history.
+ *
+ * @since head
+ */
+class FanotifyBackend : public PollingBackend {
+public:
+	FanotifyBackend();
+	virtual ~FanotifyBackend();
+	
+	virtual std::string description() const;
+	
+protected:
+	virtual void openEventSource();
+	virtual void readEvents();
+	virtual void watchedPathsChanged(const std::vector<std::string> &previous);
+	virtual void closeEventSource();
+	
+private:
+	FanotifyBackend(const FanotifyBackend &);
+	FanotifyBackend &operator=(const FanotifyBackend &);
+	
+	void watchPaths();
+	void handleEvent(uint64_t mask, const void *info, size_t infoLength);
+	bool resolveDirectory(const std::string &key, uint64_t filesystem, const void *handle, std::string &path);
+	bool mapToWatchedPath(std::string &path) const;
+	
+	/** One mount descriptor per marked filesystem, used to open file handles. */
+	std::unordered_map<uint64_t, int>				_mountDescriptors;
+	
+	/** The watched paths with symbolic links resolved, as the kernel reports them. */
+	std::vector<std::string>						_resolvedWatchedPaths;
+	PathTrie										_resolvedWatchedPathTrie;
+	std::vector<size_t>								_watchedPathIndexes;
+	
+	/** The handles of the watched paths, resolved up front so that they can be reported once gone. */
+	std::unordered_map<std::string, std::string>	_watchedDirectories;
+	/** Resolved directory handles. */
+	std::unordered_map<std::string, std::string>	_directories;
+};
+
+} // namespace cdevents
+
+#endif // defined(__linux__)
+
+#endif // CD_CORE_FANOTIFY_BACKEND_H
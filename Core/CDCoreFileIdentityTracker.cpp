@@ -0,0 +1,323 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreFileIdentityTracker.h"
+
+#include <string.h>
+#include <sys/stat.h>
+
+namespace cdevents {
+
+#pragma mark Constants
+// Events which say something about the stream or a whole tree, not an item.
+static const EventFlags kStreamEventFlags = (kEventFlagMustScanSubDirs |
+											 kEventFlagUserDropped |
+											 kEventFlagKernelDropped |
+											 kEventFlagEventIdsWrapped |
+											 kEventFlagHistoryDone |
+											 kEventFlagRootChanged |
+											 kEventFlagMount |
+											 kEventFlagUnmount);
+
+// The flags a replaced file no longer gets, it was modified in place as far
+// as the client is concerned.
+static const EventFlags kReplacementClearedFlags = (kEventFlagItemCreated |
+													kEventFlagItemRemoved |
+													kEventFlagItemRenamed);
+
+static const size_t kNone = (size_t)-1;
+
+
+#pragma mark Helpers
+static bool isPathOfEvent(const EventBatch &events, size_t index, const std::string &path)
+{
+	return (events[index].pathLength == path.size() &&
+			memcmp(events.path(index), path.data(), path.size()) == 0);
+}
+
+
+#pragma mark Init
+FileIdentityTracker::FileIdentityTracker(size_t capacity)
+:	_capacity(capacity)
+{}
+
+FileIdentity FileIdentityTracker::rememberedIdentity(const std::string &path) const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return identityOfPath(path);
+}
+
+size_t FileIdentityTracker::size() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _entries.size();
+}
+
+void FileIdentityTracker::clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_entriesByPath.clear();
+	_entriesByIdentity.clear();
+	_entries.clear();
+}
+
+
+#pragma mark Tracking
+void FileIdentityTracker::track(const EventBatch &events, EventBatch &tracked)
+{
+	tracked.clear();
+	if (events.empty()) {
+		return;
+	}
+	
+	std::lock_guard<std::mutex> lock(_mutex);
+	_items.resize(events.size());
+	_vanished.clear();
+	
+	std::string path;
+	for (size_t i = 0; i < events.size(); ++i) {
+		const EventRecord &event = events[i];
+		Item &item = _items[i];
+		item.identity	= FileIdentity();
+		item.exists		= false;
+		item.action		= kActionKeep;
+		item.sourcePath.clear();
+		
+		if (event.flags & kStreamEventFlags) {
+			continue;
+		}
+		
+		path.assign(events.path(i), event.pathLength);
+		struct stat status;
+		if (lstat(path.c_str(), &status) != 0) {
+			// Gone already, it was whatever was last seen at the path.
+			item.identity = identityOfPath(path);
+			_vanished.push_back(i);
+			
+			// A renamed item may turn up at another path later on.
+			if ((event.flags & kEventFlagItemRemoved) && !(event.flags & kEventFlagItemRenamed)) {
+				forgetPath(path);
+			} else {
+				leavePath(path);
+			}
+			continue;
+		}
+		
+		item.identity	= FileIdentity(status.st_dev, status.st_ino);
+		item.exists		= true;
+		
+		if ((event.flags & kEventFlagItemRenamed) && S_ISREG(status.st_mode)) {
+			// A file renamed to the path, from a temporary file if it is a save.
+			// The identity is the current one, so a later save in the same
+			// batch looks no different from the first.
+			const char *sourcePath = events.sourcePath(i);
+			if (sourcePath) {
+				const std::string source(sourcePath, event.sourcePathLength);
+				if ((event.flags & kEventFlagItemCreated) || wasCreatedInBatch(events, i, source)) {
+					item.action = kActionReplace;
+					dropVanishedEvents(events, i, source, item.identity);
+				}
+			} else {
+				const size_t temporary = findTemporarySource(events, i, item.identity);
+				if (temporary != kNone) {
+					const std::string source(events.path(temporary), events[temporary].pathLength);
+					item.action = kActionReplace;
+					dropVanishedEvents(events, i, source, item.identity);
+				}
+			}
+		}
+		
+		if (item.action == kActionKeep && !events.sourcePath(i) &&
+			(event.flags & (kEventFlagItemCreated | kEventFlagItemRenamed))) {
+			// The item left a path it was seen at before for this one.
+			const Entry *entry = entryOfIdentity(item.identity);
+			if (entry && !entry->isAtPath && entry->path != path) {
+				item.action		= kActionMove;
+				item.sourcePath	= entry->path;
+				dropVanishedEvents(events, i, item.sourcePath, item.identity);
+			}
+		}
+		
+		setPath(path, item.identity);
+	}
+	
+	for (size_t i = 0; i < events.size(); ++i) {
+		const EventRecord &event = events[i];
+		const Item &item = _items[i];
+		switch (item.action) {
+			case kActionDrop:
+				continue;
+			case kActionKeep:
+				tracked.append(event.identifier, event.flags, event.timestamp, events.path(i), event.pathLength, events.sourcePath(i), event.sourcePathLength);
+				break;
+			case kActionReplace:
+				tracked.append(event.identifier, ((event.flags & ~kReplacementClearedFlags) | kEventFlagItemModified), event.timestamp, events.path(i), event.pathLength);
+				break;
+			case kActionMove:
+				tracked.append(event.identifier, (event.flags | kEventFlagItemRenamed), event.timestamp, events.path(i), event.pathLength, item.sourcePath.data(), item.sourcePath.size());
+				break;
+		}
+		tracked.setFileIdentity(item.identity);
+	}
+}
+
+
+#pragma mark Private
+size_t FileIdentityTracker::findTemporarySource(const EventBatch &events, size_t index, const FileIdentity &identity) const
+{
+	// The latest earlier rename away from a path a file was created at in the
+	// batch, which could have been this file.
+	for (size_t k = _vanished.size(); k > 0; --k) {
+		const size_t candidate = _vanished[k - 1];
+		const EventRecord &event = events[candidate];
+		if (_items[candidate].action == kActionDrop || !(event.flags & kEventFlagItemRenamed)) {
+			continue;
+		}
+		if (_items[candidate].identity.isKnown() && _items[candidate].identity != identity) {
+			continue;
+		}
+		
+		const std::string path(events.path(candidate), event.pathLength);
+		if (isPathOfEvent(events, index, path)) {
+			continue;
+		}
+		if ((event.flags & kEventFlagItemCreated) || wasCreatedInBatch(events, candidate, path)) {
+			return candidate;
+		}
+	}
+	return kNone;
+}
+
+bool FileIdentityTracker::wasCreatedInBatch(const EventBatch &events, size_t index, const std::string &path) const
+{
+	for (size_t k = 0; k < _vanished.size() && _vanished[k] < index; ++k) {
+		const size_t candidate = _vanished[k];
+		if ((events[candidate].flags & kEventFlagItemCreated) && isPathOfEvent(events, candidate, path)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void FileIdentityTracker::dropVanishedEvents(const EventBatch &events, size_t index, const std::string &path, const FileIdentity &identity)
+{
+	for (size_t k = 0; k < _vanished.size() && _vanished[k] < index; ++k) {
+		Item &item = _items[_vanished[k]];
+		if ((!item.identity.isKnown() || item.identity == identity) && isPathOfEvent(events, _vanished[k], path)) {
+			item.action = kActionDrop;
+		}
+	}
+}
+
+FileIdentity FileIdentityTracker::identityOfPath(const std::string &path) const
+{
+	std::unordered_map<std::string, Entries::iterator>::const_iterator entry = _entriesByPath.find(path);
+	return (entry != _entriesByPath.end() ? entry->second->identity : FileIdentity());
+}
+
+const FileIdentityTracker::Entry *FileIdentityTracker::entryOfIdentity(const FileIdentity &identity) const
+{
+	std::unordered_map<FileIdentity, Entries::iterator, IdentityHash>::const_iterator entry = _entriesByIdentity.find(identity);
+	return (entry != _entriesByIdentity.end() ? &*entry->second : NULL);
+}
+
+void FileIdentityTracker::setPath(const std::string &path, const FileIdentity &identity)
+{
+	std::unordered_map<std::string, Entries::iterator>::iterator atPath = _entriesByPath.find(path);
+	if (atPath != _entriesByPath.end()) {
+		if (atPath->second->identity == identity) {
+			_entries.splice(_entries.begin(), _entries, atPath->second);
+			return;
+		}
+		// Replaced by another item.
+		erase(atPath->second);
+	}
+	
+	std::unordered_map<FileIdentity, Entries::iterator, IdentityHash>::iterator known = _entriesByIdentity.find(identity);
+	if (known != _entriesByIdentity.end()) {
+		// Moved here, or another link to it.
+		Entries::iterator entry = known->second;
+		if (entry->isAtPath) {
+			_entriesByPath.erase(entry->path);
+		}
+		entry->path		= path;
+		entry->isAtPath	= true;
+		_entries.splice(_entries.begin(), _entries, entry);
+		_entriesByPath[path] = entry;
+		return;
+	}
+	
+	if (_capacity == 0) {
+		return;
+	}
+	
+	Entry entry;
+	entry.identity	= identity;
+	entry.path		= path;
+	entry.isAtPath	= true;
+	_entries.push_front(entry);
+	_entriesByPath[path]			= _entries.begin();
+	_entriesByIdentity[identity]	= _entries.begin();
+	
+	if (_entries.size() > _capacity) {
+		erase(--_entries.end());
+	}
+}
+
+void FileIdentityTracker::leavePath(const std::string &path)
+{
+	std::unordered_map<std::string, Entries::iterator>::iterator atPath = _entriesByPath.find(path);
+	if (atPath != _entriesByPath.end()) {
+		atPath->second->isAtPath = false;
+		_entriesByPath.erase(atPath);
+	}
+}
+
+void FileIdentityTracker::forgetPath(const std::string &path)
+{
+	std::unordered_map<std::string, Entries::iterator>::iterator atPath = _entriesByPath.find(path);
+	if (atPath != _entriesByPath.end()) {
+		erase(atPath->second);
+	}
+}
+
+void FileIdentityTracker::erase(Entries::iterator entry)
+{
+	if (entry->isAtPath) {
+		_entriesByPath.erase(entry->path);
+	}
+	_entriesByIdentity.erase(entry->identity);
+	_entries.erase(entry);
+}
+
+size_t FileIdentityTracker::IdentityHash::operator()(const FileIdentity &identity) const
+{
+	return (size_t)(identity.inode * 0x9E3779B97F4A7C15ULL ^ identity.device);
+}
+
+} // namespace cdevents
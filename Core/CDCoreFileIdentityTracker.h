@@ -0,0 +1,175 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+/**
+ * @headerfile CDCoreFileIdentityTracker.h
+ * Follows items by their file identity to recognize moves and atomic saves.
+ */
+
+#ifndef CD_CORE_FILE_IDENTITY_TRACKER_H
+#define CD_CORE_FILE_IDENTITY_TRACKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CDCoreEvent.h"
+
+namespace cdevents {
+
+/**
+ * The default number of items a file identity tracker remembers.
+ *
+ * @since head
+ */
+const size_t kDefaultFileIdentityCapacity = 65536;
+
+
+/**
+ * Gives every event the identity of its item and uses a bounded map between identities and paths to make sense of renames.
+ *
+ * The identity of an item which still exists is read once per event with
+ * <code>lstat()</code>, that of a removed or renamed item is the one last
+ * seen at its path. With the identities the tracker rewrites a batch in two
+ * ways.
+ *
+ * A file written under another name and renamed over its destination, as
+ * editors save files, is reported as one modification of the destination
+ * and the events of the temporary file are dropped. The temporary file must
+ * have been created in the same batch, so the notification latency bounds
+ * how long a save may take to be recognized.
+ *
+ * An item which turns up at a path with the identity last seen at another
+ * path it has since left is reported as renamed from that path, and the
+ * event of the old path in the same batch is dropped. This pairs the halves
+ * of renames the stream could not pair itself, for example because they
+ * were reported in different batches.
+ *
+ * The tracker only knows the items it has seen events for, and remembers at
+ * most <em>capacity</em> of them, forgetting the least recently seen one
+ * first. Events about the stream rather than an item are left as they are.
+ *
+ * The tracker is thread-safe.
+ *
+ * @since head
+ */
+class FileIdentityTracker {
+public:
+	/**
+	 * Returns a tracker remembering at most the given number of items.
+	 */
+	explicit FileIdentityTracker(size_t capacity = kDefaultFileIdentityCapacity);
+	
+	/**
+	 * Clears <em>tracked</em> and appends the events of <em>events</em> to it, with their file identities and the moves and saves recognized.
+	 */
+	void track(const EventBatch &events, EventBatch &tracked);
+	
+	/**
+	 * The identity last seen at the given standardized path, unknown if no item is remembered there.
+	 */
+	FileIdentity rememberedIdentity(const std::string &path) const;
+	
+	/**
+	 * The maximum number of items remembered.
+	 */
+	size_t capacity() const { return _capacity; }
+	
+	/**
+	 * The number of items remembered.
+	 */
+	size_t size() const;
+	
+	/**
+	 * Forgets all items.
+	 */
+	void clear();
+	
+private:
+	enum Action {
+		kActionKeep,
+		kActionDrop,
+		kActionReplace,
+		kActionMove
+	};
+	
+	// What the first pass found out about an event of the batch.
+	struct Item {
+		FileIdentity	identity;
+		bool			exists;
+		Action			action;
+		std::string		sourcePath;
+	};
+	
+	// A remembered item and the path it was last seen at, which it may have
+	// been renamed away from since.
+	struct Entry {
+		FileIdentity	identity;
+		std::string		path;
+		bool			isAtPath;
+	};
+	typedef std::list<Entry> Entries;
+	
+	struct IdentityHash {
+		size_t operator()(const FileIdentity &identity) const;
+	};
+	
+	FileIdentityTracker(const FileIdentityTracker &);
+	FileIdentityTracker &operator=(const FileIdentityTracker &);
+	
+	size_t findTemporarySource(const EventBatch &events, size_t index, const FileIdentity &identity) const;
+	bool wasCreatedInBatch(const EventBatch &events, size_t index, const std::string &path) const;
+	void dropVanishedEvents(const EventBatch &events, size_t index, const std::string &path, const FileIdentity &identity);
+	
+	FileIdentity identityOfPath(const std::string &path) const;
+	const Entry *entryOfIdentity(const FileIdentity &identity) const;
+	void setPath(const std::string &path, const FileIdentity &identity);
+	void leavePath(const std::string &path);
+	void forgetPath(const std::string &path);
+	void erase(Entries::iterator entry);
+	
+	const size_t	_capacity;
+	
+	mutable std::mutex	_mutex;
+	
+	// Most recently seen first.
+	Entries													_entries;
+	std::unordered_map<std::string, Entries::iterator>		_entriesByPath;
+	std::unordered_map<FileIdentity, Entries::iterator, IdentityHash>	_entriesByIdentity;
+	
+	// The storage of track(), reused.
+	std::vector<Item>	_items;
+	std::vector<size_t>	_vanished;
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_FILE_IDENTITY_TRACKER_H
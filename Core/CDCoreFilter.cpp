@@ -0,0 +1,105 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreFilter.h"
+
+#include "CDCorePath.h"
+
+namespace cdevents {
+
+Filter::Filter()
+:	_pathMatcher(new PathMatcher()),
+	_ignoreEventsFromSubDirectories(false)
+{
+}
+
+void Filter::setWatchedPaths(const std::vector<std::string> &paths)
+{
+	_watchedPathList.clear();
+	_watchedPaths.clear();
+	_watchedPaths.reserve(paths.size());
+	_watchedPathTrie.clear();
+	for (size_t i = 0; i < paths.size(); ++i) {
+		_watchedPathList.push_back(standardizedPath(paths[i]));
+		_watchedPaths.insert(_watchedPathList.back());
+		_watchedPathTrie.insert(_watchedPathList.back());
+	}
+	
+	_watchedPathIndexes.assign(_watchedPathTrie.nodeCount(), 0);
+	for (size_t i = 0; i < _watchedPathList.size(); ++i) {
+		_watchedPathIndexes[_watchedPathTrie.find(_watchedPathList[i])] = i;
+	}
+}
+
+void Filter::setExcludedPaths(const std::vector<std::string> &paths)
+{
+	_excludedPaths = paths;
+	_excludedPathTrie.clear();
+	for (size_t i = 0; i < paths.size(); ++i) {
+		_excludedPathTrie.insert(standardizedPath(paths[i]));
+	}
+}
+
+void Filter::setPathPatterns(const std::vector<std::string> &patterns)
+{
+	// Filters are copied whenever a rule changes, the compiled patterns are shared.
+	_pathMatcher.reset(new PathMatcher(patterns));
+}
+
+FilterResult Filter::classifyPath(const std::string &path) const
+{
+	// Ignore all events except for the paths we are explicitly watching.
+	if (_ignoreEventsFromSubDirectories) {
+		return (_watchedPaths.find(path) == _watchedPaths.end() ? kFilterResultSubDirectory : kFilterResultPass);
+	}
+	
+	// Ignore all explicitly excluded paths (not required to check if we ignore
+	// all events from sub-directories).
+	if (_excludedPathTrie.containsPrefixOfPath(path)) {
+		return kFilterResultExcluded;
+	}
+	
+	if (_pathMatcher->match(path) == kPathMatchExcluded) {
+		return kFilterResultExcluded;
+	}
+	
+	// Ignore files only apply beneath the watched path they are in.
+	if (_ignoreFiles) {
+		bool ignored = false;
+		_watchedPathTrie.visitPrefixesOfPath(path.data(), path.size(), [this, &path, &ignored](PathTrie::Node node) {
+			ignored = (ignored || _ignoreFiles->isIgnored(path, _watchedPathList[_watchedPathIndexes[node]]));
+		});
+		if (ignored) {
+			return kFilterResultExcluded;
+		}
+	}
+	
+	return kFilterResultPass;
+}
+
+} // namespace cdevents
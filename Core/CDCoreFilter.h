@@ -0,0 +1,137 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreFilter.h
+ * The per-event filtering rules of a stream.
+ */
+
+#ifndef CD_CORE_FILTER_H
+#define CD_CORE_FILTER_H
+
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "CDCoreIgnoreFileCache.h"
+#include "CDCorePathMatcher.h"
+#include "CDCorePathTrie.h"
+
+namespace cdevents {
+
+/**
+ * Why a filter lets an event through or not.
+ *
+ * @since head
+ */
+enum FilterResult {
+	/** The event is let through. */
+	kFilterResultPass,
+	/** The event is in a sub-directory of a watched path and those are ignored. */
+	kFilterResultSubDirectory,
+	/** The event is in an excluded path. */
+	kFilterResultExcluded
+};
+
+/**
+ * The compiled filtering rules of a stream.
+ *
+ * A filter is built once whenever the watched paths, excluded paths, path
+ * patterns or the sub-directory rule change and is then only read while
+ * events are delivered, so matching never allocates. The one exception is
+ * the ignore file cache, which is shared by the copies of a filter and
+ * reads and compiles the ignore files of a directory when first needed.
+ *
+ * @since head
+ */
+class Filter {
+public:
+	Filter();
+	
+	/**
+	 * Sets the watched paths, used when events from sub-directories are ignored and to find the ignore files of a path.
+	 */
+	void setWatchedPaths(const std::vector<std::string> &paths);
+	const std::vector<std::string> &watchedPaths() const { return _watchedPathList; }
+	
+	/**
+	 * Sets the paths that events should be ignored from, including their sub-directories.
+	 */
+	void setExcludedPaths(const std::vector<std::string> &paths);
+	const std::vector<std::string> &excludedPaths() const { return _excludedPaths; }
+	
+	/**
+	 * Sets the glob and regular expression patterns of the paths that events should be ignored from, see PathMatcher.
+	 *
+	 * Negated patterns only include paths excluded by earlier patterns
+	 * again, never paths excluded by setExcludedPaths().
+	 *
+	 * @throws PathPatternError if a pattern is malformed.
+	 */
+	void setPathPatterns(const std::vector<std::string> &patterns);
+	const std::vector<std::string> &pathPatterns() const { return _pathMatcher->patterns(); }
+	
+	/**
+	 * Sets the cache of the ignore files whose patterns events should be ignored by, or NULL to not honor ignore files.
+	 */
+	void setIgnoreFiles(const std::shared_ptr<IgnoreFileCache> &ignoreFiles) { _ignoreFiles = ignoreFiles; }
+	IgnoreFileCache *ignoreFiles() const { return _ignoreFiles.get(); }
+	
+	/**
+	 * Sets whether only events for the watched paths themselves are let through.
+	 */
+	void setIgnoreEventsFromSubDirectories(bool flag) { _ignoreEventsFromSubDirectories = flag; }
+	bool ignoreEventsFromSubDirectories() const { return _ignoreEventsFromSubDirectories; }
+	
+	/**
+	 * Whether an event for the given standardized path should be ignored.
+	 */
+	bool shouldIgnorePath(const std::string &path) const { return (classifyPath(path) != kFilterResultPass); }
+	
+	/**
+	 * Whether, and by which rule, an event for the given standardized path should be ignored.
+	 */
+	FilterResult classifyPath(const std::string &path) const;
+	
+private:
+	std::vector<std::string>		_watchedPathList;
+	std::unordered_set<std::string>	_watchedPaths;
+	PathTrie						_watchedPathTrie;
+	// The index in _watchedPathList of the path of each node of _watchedPathTrie.
+	std::vector<size_t>				_watchedPathIndexes;
+	std::vector<std::string>		_excludedPaths;
+	PathTrie						_excludedPathTrie;
+	std::shared_ptr<const PathMatcher>	_pathMatcher;
+	std::shared_ptr<IgnoreFileCache>	_ignoreFiles;
+	bool							_ignoreEventsFromSubDirectories;
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_FILTER_H
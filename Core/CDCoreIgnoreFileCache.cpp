@@ -0,0 +1,432 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreIgnoreFileCache.h"
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "CDCorePath.h"
+
+namespace cdevents {
+
+#pragma mark Constants
+// Read in this order, so that the patterns of the later file take precedence.
+static const char *const kIgnoreFileNames[] = { ".gitignore", ".ignore" };
+static const size_t kIgnoreFileNameCount = sizeof(kIgnoreFileNames) / sizeof(kIgnoreFileNames[0]);
+
+// An event for a directory as a whole, in which anything may have changed.
+static const EventFlags kItemFlags = (kEventFlagItemCreated | kEventFlagItemRemoved | kEventFlagItemInodeMetaMod |
+									  kEventFlagItemRenamed | kEventFlagItemModified | kEventFlagItemFinderInfoMod |
+									  kEventFlagItemChangeOwner | kEventFlagItemXattrMod);
+static const EventFlags kTreeFlags = (kEventFlagMustScanSubDirs | kEventFlagRootChanged);
+
+// The compiled rules kept for reuse are swept of those no directory uses
+// any more whenever their number doubles.
+static const size_t kMinimumSweptRuleCount = 64;
+
+const size_t IgnoreFileCache::kIgnoreFileCount;
+static_assert(kIgnoreFileNameCount == 2, "IgnoreFileCache::kIgnoreFileCount is out of date");
+
+
+#pragma mark Helpers
+static bool readFile(const std::string &path, std::string &contents)
+{
+	FILE *file = fopen(path.c_str(), "r");
+	if (file == NULL) {
+		return false;
+	}
+	
+	char buffer[4096];
+	size_t length;
+	while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		contents.append(buffer, length);
+	}
+	fclose(file);
+	
+	return true;
+}
+
+// The attributes telling whether an ignore file changed, all zero if there is none.
+static ItemAttributes ignoreFileAttributes(const std::string &path)
+{
+	ItemAttributes attributes;
+	struct stat info;
+	if (stat(path.c_str(), &info) == 0) {
+		attributes.inode	= (uint64_t)info.st_ino;
+		attributes.size		= (uint64_t)info.st_size;
+#if defined(__APPLE__)
+		attributes.modificationTime = ((int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec);
+#else
+		attributes.modificationTime = ((int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec);
+#endif
+		attributes.type		= (S_ISREG(info.st_mode) ? kEventFlagItemIsFile : kEventFlagNone);
+	}
+	
+	return attributes;
+}
+
+static bool isSameFile(const ItemAttributes &attributes, const ItemAttributes &otherAttributes)
+{
+	return (attributes.inode == otherAttributes.inode &&
+			attributes.size == otherAttributes.size &&
+			attributes.modificationTime == otherAttributes.modificationTime &&
+			attributes.type == otherAttributes.type);
+}
+
+// Compiles the patterns [begin, end) into as few matchers as possible:
+// patterns too complex to compile at once are split in halves, matched in
+// order, and malformed patterns are left out, as git does.
+static void compilePatterns(const std::vector<std::string> &patterns, size_t begin, size_t end,
+							std::vector<std::unique_ptr<const PathMatcher> > &matchers, std::vector<std::string> &errors)
+{
+	try {
+		const std::vector<std::string> range(patterns.begin() + begin, patterns.begin() + end);
+		matchers.push_back(std::unique_ptr<const PathMatcher>(new PathMatcher(range)));
+		return;
+	} catch (const PathPatternError &error) {
+		if (end - begin == 1) {
+			errors.push_back(error.what());
+			return;
+		}
+	}
+	
+	const size_t middle = begin + (end - begin) / 2;
+	compilePatterns(patterns, begin, middle, matchers, errors);
+	compilePatterns(patterns, middle, end, matchers, errors);
+}
+
+
+#pragma mark Init
+IgnoreFileCache::IgnoreFileCache()
+:	_sweptRuleCount(kMinimumSweptRuleCount),
+	_generation(0)
+{
+}
+
+
+#pragma mark Matching
+bool IgnoreFileCache::isIgnored(const std::string &path, const std::string &root)
+{
+	if (path.size() <= root.size() || !isPathPrefix(root, path)) {
+		return false;
+	}
+	
+	// Visit the directories from the root down to the parent of the path,
+	// the deepest one with a matching pattern decides.
+	std::unique_lock<std::mutex> lock(_mutex);
+	PathMatch decision = kPathMatchNone;
+	size_t end = root.size();
+	for (;;) {
+		if (const Rules *rules = rulesForDirectory(path, end, lock)) {
+			// The path relative to the directory, which starts with a slash.
+			const size_t offset = (end == 1 ? 0 : end);
+			const PathMatch match = rules->match(path.data() + offset, path.size() - offset);
+			if (match != kPathMatchNone) {
+				decision = match;
+			}
+		}
+		
+		end = path.find('/', end + 1);
+		if (end == std::string::npos) {
+			break;
+		}
+	}
+	
+	return (decision == kPathMatchExcluded);
+}
+
+PathMatch IgnoreFileCache::Rules::match(const char *path, size_t length) const
+{
+	PathMatch decision = kPathMatchNone;
+	for (size_t i = 0; i < matchers.size(); ++i) {
+		const PathMatch match = matchers[i]->match(path, length);
+		if (match != kPathMatchNone) {
+			decision = match;
+		}
+	}
+	
+	return decision;
+}
+
+
+#pragma mark Invalidating
+void IgnoreFileCache::invalidate(const std::string &path, EventFlags flags)
+{
+	if (flags & kTreeFlags) {
+		invalidateTree(path);
+		return;
+	}
+	if ((flags & kEventFlagItemIsDir) && (flags & (kEventFlagItemRemoved | kEventFlagItemRenamed))) {
+		invalidateTree(path);
+		return;
+	}
+	if ((flags & kItemFlags) == 0) {
+		// Any file of the directory may have changed, its ignore files included.
+		invalidateIfChanged(path);
+		return;
+	}
+	
+	const size_t slash = path.rfind('/');
+	if (slash == std::string::npos) {
+		return;
+	}
+	for (size_t i = 0; i < kIgnoreFileNameCount; ++i) {
+		if (path.compare(slash + 1, std::string::npos, kIgnoreFileNames[i]) == 0) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_directory.assign(path, 0, (slash == 0 ? 1 : slash));
+			if (_directories.erase(_directory) > 0) {
+				++_generation;
+			}
+			return;
+		}
+	}
+}
+
+void IgnoreFileCache::invalidateTree(const std::string &path)
+{
+	// Invalidating a tree is rare next to matching, so the directories are
+	// hashed for the latter and all of them visited for the former.
+	std::lock_guard<std::mutex> lock(_mutex);
+	++_generation;
+	for (auto iterator = _directories.begin(); iterator != _directories.end();) {
+		if (isPathPrefix(path, iterator->first)) {
+			iterator = _directories.erase(iterator);
+		} else {
+			++iterator;
+		}
+	}
+}
+
+
+#pragma mark Misc
+size_t IgnoreFileCache::directoryCount() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _directories.size();
+}
+
+size_t IgnoreFileCache::ruleCount() const
+{
+	std::unordered_set<const Rules *> rules;
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (auto iterator = _directories.begin(); iterator != _directories.end(); ++iterator) {
+		if (iterator->second.rules) {
+			rules.insert(iterator->second.rules.get());
+		}
+	}
+	return rules.size();
+}
+
+std::vector<std::string> IgnoreFileCache::errors() const
+{
+	std::vector<std::string> errors;
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (auto iterator = _directories.begin(); iterator != _directories.end(); ++iterator) {
+		if (!iterator->second.rules) {
+			continue;
+		}
+		const std::vector<std::string> &ruleErrors = iterator->second.rules->errors;
+		for (size_t i = 0; i < ruleErrors.size(); ++i) {
+			errors.push_back(iterator->first + ": " + ruleErrors[i]);
+		}
+	}
+	
+	return errors;
+}
+
+std::vector<std::string> IgnoreFileCache::patternsFromIgnoreFile(const std::string &contents)
+{
+	std::vector<std::string> patterns;
+	size_t start = 0;
+	while (start < contents.size()) {
+		size_t end = contents.find('\n', start);
+		if (end == std::string::npos) {
+			end = contents.size();
+		}
+		std::string line(contents, start, end - start);
+		start = end + 1;
+		
+		// Trailing spaces are ignored unless escaped.
+		if (!line.empty() && line[line.size() - 1] == '\r') {
+			line.erase(line.size() - 1);
+		}
+		while (!line.empty() && line[line.size() - 1] == ' ' &&
+			   (line.size() < 2 || line[line.size() - 2] != '\\')) {
+			line.erase(line.size() - 1);
+		}
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		
+		std::string pattern;
+		if (line[0] == '!') {
+			pattern.push_back('!');
+			line.erase(0, 1);
+		}
+		
+		// A pattern with a slash other than a trailing one is relative to
+		// the directory of the file, any other may match at any depth.
+		const size_t last = line.find_last_not_of('/');
+		if (last == std::string::npos) {
+			continue;
+		}
+		const bool anchored = (line.find('/') < last);
+		if (line[0] == '/') {
+			line.erase(0, 1);
+		}
+		if (anchored) {
+			pattern.push_back('/');
+		} else if (line.compare(0, 3, "re:") == 0 || line.compare(0, 5, "glob:") == 0) {
+			// Lines are globs, whatever they start with.
+			pattern.append("glob:");
+		}
+		pattern.append(line);
+		patterns.push_back(pattern);
+	}
+	
+	return patterns;
+}
+
+
+#pragma mark Private
+const IgnoreFileCache::Rules *IgnoreFileCache::rulesForDirectory(const std::string &path, size_t length,
+																 std::unique_lock<std::mutex> &lock)
+{
+	_directory.assign(path, 0, length);
+	auto found = _directories.find(_directory);
+	if (found != _directories.end()) {
+		return found->second.rules.get();
+	}
+	
+	// The ignore files are read and compiled without the lock, and read
+	// again should the rules be invalidated meanwhile, as it is not known
+	// whether that happened before or after they were read. Directories
+	// without ignore files are remembered too, so that they are only looked
+	// for once.
+	const std::string directory(_directory);
+	Directory entry;
+	for (;;) {
+		const uint64_t generation = _generation;
+		lock.unlock();
+		
+		std::vector<std::string> patterns;
+		for (size_t i = 0; i < kIgnoreFileNameCount; ++i) {
+			const std::string ignoreFile = pathByAppendingComponent(directory, kIgnoreFileNames[i]);
+			entry.ignoreFiles[i] = ignoreFileAttributes(ignoreFile);
+			std::string contents;
+			if (entry.ignoreFiles[i].type == kEventFlagItemIsFile && readFile(ignoreFile, contents)) {
+				const std::vector<std::string> filePatterns = patternsFromIgnoreFile(contents);
+				patterns.insert(patterns.end(), filePatterns.begin(), filePatterns.end());
+			}
+		}
+		entry.rules = rulesForPatterns(patterns, lock);
+		
+		if (generation == _generation) {
+			break;
+		}
+	}
+	
+	found = _directories.insert(std::make_pair(directory, entry)).first;
+	return found->second.rules.get();
+}
+
+std::shared_ptr<const IgnoreFileCache::Rules> IgnoreFileCache::rulesForPatterns(const std::vector<std::string> &patterns,
+																				  std::unique_lock<std::mutex> &lock)
+{
+	// Called without the lock, returns with it held.
+	if (patterns.empty()) {
+		lock.lock();
+		return std::shared_ptr<const Rules>();
+	}
+	
+	// Patterns never contain a newline, so joined with one they tell apart
+	// the lists of patterns.
+	std::string key;
+	for (size_t i = 0; i < patterns.size(); ++i) {
+		key.append(patterns[i]);
+		key.push_back('\n');
+	}
+	
+	lock.lock();
+	auto found = _rulesByPatterns.find(key);
+	std::shared_ptr<const Rules> rules = (found != _rulesByPatterns.end() ? found->second.lock() : std::shared_ptr<const Rules>());
+	if (rules) {
+		return rules;
+	}
+	lock.unlock();
+	
+	const std::shared_ptr<Rules> compiled = std::make_shared<Rules>();
+	compilePatterns(patterns, 0, patterns.size(), compiled->matchers, compiled->errors);
+	
+	lock.lock();
+	_rulesByPatterns[key] = compiled;
+	if (_rulesByPatterns.size() >= _sweptRuleCount * 2) {
+		for (auto iterator = _rulesByPatterns.begin(); iterator != _rulesByPatterns.end();) {
+			if (iterator->second.expired()) {
+				iterator = _rulesByPatterns.erase(iterator);
+			} else {
+				++iterator;
+			}
+		}
+		_sweptRuleCount = std::max(_rulesByPatterns.size(), kMinimumSweptRuleCount);
+	}
+	
+	return compiled;
+}
+
+void IgnoreFileCache::invalidateIfChanged(const std::string &directory)
+{
+	ItemAttributes ignoreFiles[kIgnoreFileCount];
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		const auto found = _directories.find(directory);
+		if (found == _directories.end()) {
+			return;
+		}
+		for (size_t i = 0; i < kIgnoreFileCount; ++i) {
+			ignoreFiles[i] = found->second.ignoreFiles[i];
+		}
+	}
+	
+	for (size_t i = 0; i < kIgnoreFileCount; ++i) {
+		const ItemAttributes attributes = ignoreFileAttributes(pathByAppendingComponent(directory, kIgnoreFileNames[i]));
+		if (!isSameFile(attributes, ignoreFiles[i])) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_directories.erase(directory) > 0) {
+				++_generation;
+			}
+			return;
+		}
+	}
+}
+
+} // namespace cdevents
@@ -0,0 +1,155 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreIgnoreFileCache.h
+ * The rules of the .gitignore and .ignore files in the watched trees.
+ */
+
+#ifndef CD_CORE_IGNORE_FILE_CACHE_H
+#define CD_CORE_IGNORE_FILE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CDCoreEvent.h"
+#include "CDCorePathMatcher.h"
+#include "CDCoreTreeWalker.h"
+
+namespace cdevents {
+
+/**
+ * The compiled .gitignore and .ignore files of the watched trees, per directory.
+ *
+ * The ignore files of a directory are read and compiled the first time a
+ * path beneath it is matched, and kept until an event tells that they may
+ * have changed. Their patterns are matched against the path relative to the
+ * directory, so directories with the same ignore files, as is common in
+ * vendored trees, share one compiled copy of them. A path is ignored
+ * according to the ignore files of the directories between the watched
+ * path containing it and the path itself: the deepest directory with a
+ * pattern matching the path decides, and within a directory the .ignore
+ * file takes precedence over the .gitignore file. Ignore files outside the
+ * watched paths, and the global git excludes, are not read.
+ *
+ * Malformed patterns are left out, as git does, and reported by errors().
+ *
+ * All methods may be called from any thread. Ignore files are read and
+ * compiled without holding the lock other threads match with.
+ *
+ * @since head
+ */
+class IgnoreFileCache {
+public:
+	IgnoreFileCache();
+	
+	/**
+	 * Whether the ignore files of the watched tree at <em>root</em> ignore the given standardized path beneath it.
+	 */
+	bool isIgnored(const std::string &path, const std::string &root);
+	
+	/**
+	 * Forgets the rules an event for the given standardized path may have made stale.
+	 *
+	 * Changing an ignore file forgets the rules of its directory, and a
+	 * directory removed, renamed or to be rescanned those of its whole tree.
+	 * An event for a directory as a whole only forgets its rules if its
+	 * ignore files are no longer the ones read.
+	 */
+	void invalidate(const std::string &path, EventFlags flags);
+	
+	/**
+	 * Forgets the rules of the given standardized directory and every directory beneath it.
+	 */
+	void invalidateTree(const std::string &path);
+	
+	/**
+	 * The number of directories whose ignore files have been read.
+	 */
+	size_t directoryCount() const;
+	
+	/**
+	 * The number of compiled sets of rules the directories read use, each shared by the directories with the same ignore files.
+	 */
+	size_t ruleCount() const;
+	
+	/**
+	 * The problems found in the ignore files currently read, such as malformed patterns, one message each.
+	 */
+	std::vector<std::string> errors() const;
+	
+	/**
+	 * Translates the contents of an ignore file into patterns of the paths relative to its directory, see PathMatcher.
+	 *
+	 * The relative paths start with a slash, so a pattern relative to the
+	 * directory of the ignore file is anchored and any other is not.
+	 */
+	static std::vector<std::string> patternsFromIgnoreFile(const std::string &contents);
+	
+private:
+	static const size_t kIgnoreFileCount = 2;
+	
+	// The patterns of the ignore files of a directory, compiled into one
+	// matcher or, if they are too complex for one, several matched in order.
+	struct Rules {
+		std::vector<std::unique_ptr<const PathMatcher> >	matchers;
+		std::vector<std::string>	errors;
+		
+		PathMatch match(const char *path, size_t length) const;
+	};
+	
+	struct Directory {
+		// NULL if the directory has no patterns.
+		std::shared_ptr<const Rules>	rules;
+		// The ignore files as they were read.
+		ItemAttributes					ignoreFiles[kIgnoreFileCount];
+	};
+	
+	const Rules *rulesForDirectory(const std::string &path, size_t length, std::unique_lock<std::mutex> &lock);
+	std::shared_ptr<const Rules> rulesForPatterns(const std::vector<std::string> &patterns, std::unique_lock<std::mutex> &lock);
+	void invalidateIfChanged(const std::string &directory);
+	
+	IgnoreFileCache(const IgnoreFileCache &);
+	IgnoreFileCache &operator=(const IgnoreFileCache &);
+	
+	mutable std::mutex	_mutex;
+	std::unordered_map<std::string, Directory>	_directories;
+	std::unordered_map<std::string, std::weak_ptr<const Rules> >	_rulesByPatterns;
+	size_t				_sweptRuleCount;
+	uint64_t			_generation;
+	std::string			_directory;
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_IGNORE_FILE_CACHE_H
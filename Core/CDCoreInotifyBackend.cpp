@@ -0,0 +1,343 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreInotifyBackend.h"
+
+#if defined(__linux__)
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <vector>
+
+#include "CDCorePath.h"
+
+namespace cdevents {
+
+#pragma mark Constants
+static const uint32_t kInotifyWatchMask = (IN_CREATE |
+										   IN_DELETE |
+										   IN_MOVED_FROM |
+										   IN_MOVED_TO |
+										   IN_MODIFY |
+										   IN_ATTRIB |
+										   IN_DELETE_SELF |
+										   IN_MOVE_SELF |
+										   IN_ONLYDIR |
+										   IN_EXCL_UNLINK);
+
+
+#pragma mark Init/dealloc
+InotifyBackend::InotifyBackend()
+{
+}
+
+InotifyBackend::~InotifyBackend()
+{
+	stop();
+}
+
+
+#pragma mark Backend
+std::string InotifyBackend::description() const
+{
+	std::ostringstream description;
+	description << "InotifyBackend { watchedPaths = (";
+	for (size_t i = 0; i < _configuration.watchedPaths.size(); ++i) {
+		description << (i > 0 ? ", " : "") << _configuration.watchedPaths[i];
+	}
+	description << "), latency = " << _configuration.notificationLatency
+				<< ", sinceWhen = " << _configuration.sinceEventIdentifier
+				<< ", flags = " << _configuration.creationFlags
+				<< ", watches = " << _watches.size() << " }";
+	
+	return description.str();
+}
+
+
+#pragma mark Event source
+void InotifyBackend::openEventSource()
+{
+	_eventDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_eventDescriptor < 0) {
+		throw StreamCreationFailure(std::string("inotify_init1 failed: ") + strerror(errno));
+	}
+	
+	for (size_t i = 0; i < _configuration.watchedPaths.size(); ++i) {
+		if (!addWatches(_configuration.watchedPaths[i], false)) {
+			throw StreamCreationFailure("Failed to watch \"" + _configuration.watchedPaths[i] +
+										"\", the inotify watch limit may have been reached.");
+		}
+	}
+}
+
+void InotifyBackend::readEvents()
+{
+	char buffer[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+	
+	for (;;) {
+		const ssize_t length = read(_eventDescriptor, buffer, sizeof(buffer));
+		if (length <= 0) {
+			break;
+		}
+		
+		for (char *pointer = buffer; pointer < buffer + length; ) {
+			const struct inotify_event *event = (const struct inotify_event *)pointer;
+			handleEvent(event);
+			pointer += sizeof(struct inotify_event) + event->len;
+		}
+	}
+}
+
+void InotifyBackend::handleEvent(const struct inotify_event *event)
+{
+	if (event->mask & IN_Q_OVERFLOW) {
+		addRescanEvents(kEventFlagKernelDropped);
+		return;
+	}
+	
+	std::unordered_map<int, std::string>::iterator watch = _watches.find(event->wd);
+	if (watch == _watches.end()) {
+		return;
+	}
+	if (event->mask & IN_IGNORED) {
+		_watches.erase(watch);
+		return;
+	}
+	
+	// Copied since the watches may change below.
+	const std::string directory(watch->second);
+	
+	if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+		// Changes of other directories are reported by their parents.
+		if ((_configuration.creationFlags & kStreamCreationFlagWatchRoot) && isWatchedPath(directory)) {
+			addEvent(directory, kEventFlagRootChanged, 0);
+		}
+		return;
+	}
+	
+	const std::string path = (event->len > 0 ? pathByAppendingComponent(directory, event->name) : directory);
+	const bool isDirectory = ((event->mask & IN_ISDIR) != 0);
+	
+	EventFlags flags = (isDirectory ? kEventFlagItemIsDir : kEventFlagItemIsFile);
+	if (event->mask & IN_CREATE) {
+		flags |= kEventFlagItemCreated;
+	}
+	if (event->mask & IN_DELETE) {
+		flags |= kEventFlagItemRemoved;
+	}
+	if (event->mask & (IN_MOVED_FROM | IN_MOVED_TO)) {
+		flags |= kEventFlagItemRenamed;
+	}
+	if (event->mask & IN_MODIFY) {
+		flags |= kEventFlagItemModified;
+	}
+	if (event->mask & IN_ATTRIB) {
+		flags |= kEventFlagItemInodeMetaMod;
+	}
+	// Both halves of a rename carry the same cookie.
+	addItemEvent(directory, path, flags, ((event->mask & (IN_MOVED_FROM | IN_MOVED_TO)) ? event->cookie : 0));
+	
+	if (!isDirectory) {
+		return;
+	}
+	
+	// Keep the watches in sync with the directories of the watched trees.
+	if (event->mask & IN_MOVED_FROM) {
+		_movedDirectories[event->cookie] = path;
+	} else if (event->mask & IN_MOVED_TO) {
+		std::unordered_map<uint32_t, std::string>::iterator moved = _movedDirectories.find(event->cookie);
+		if (moved != _movedDirectories.end()) {
+			moveWatches(moved->second, path);
+			_movedDirectories.erase(moved);
+		} else if (!addWatches(path, true)) {
+			addEvent(path, (kEventFlagMustScanSubDirs | kEventFlagUserDropped));
+		}
+	} else if (event->mask & IN_CREATE) {
+		if (!addWatches(path, true)) {
+			addEvent(path, (kEventFlagMustScanSubDirs | kEventFlagUserDropped));
+		}
+	}
+}
+
+void InotifyBackend::willDeliverEvents()
+{
+	// Directories moved out of the watched trees are no longer of interest.
+	for (std::unordered_map<uint32_t, std::string>::const_iterator moved = _movedDirectories.begin(); moved != _movedDirectories.end(); ++moved) {
+		removeWatches(moved->second);
+	}
+	_movedDirectories.clear();
+}
+
+void InotifyBackend::watchedPathsChanged(const std::vector<std::string> &previous)
+{
+	const std::vector<std::string> &paths = _configuration.watchedPaths;
+	
+	// Trees no longer watched lose their watches, unless they are part of
+	// another watched tree. Watched trees within them get theirs back.
+	for (size_t i = 0; i < previous.size(); ++i) {
+		if (isInWatchedTree(previous[i])) {
+			continue;
+		}
+		removeWatches(previous[i]);
+		for (size_t j = 0; j < paths.size(); ++j) {
+			if (isPathPrefix(previous[i], paths[j]) && !isWatchedDirectory(paths[j]) && !addWatches(paths[j], false)) {
+				addEvent(paths[j], (kEventFlagMustScanSubDirs | kEventFlagUserDropped));
+			}
+		}
+	}
+	
+	// The watches of new trees within watched ones already exist.
+	for (size_t i = 0; i < paths.size(); ++i) {
+		if (!isWatchedDirectory(paths[i]) && !addWatches(paths[i], false)) {
+			addEvent(paths[i], (kEventFlagMustScanSubDirs | kEventFlagUserDropped));
+		}
+	}
+}
+
+void InotifyBackend::closeEventSource()
+{
+	_watches.clear();
+	_movedDirectories.clear();
+}
+
+
+#pragma mark Watches
+bool InotifyBackend::addWatches(const std::string &path, bool reportContents)
+{
+	std::vector<std::string> directories(1, path);
+	bool isWatchedPath = !reportContents;
+	
+	while (!directories.empty()) {
+		const std::string directory(directories.back());
+		directories.pop_back();
+		
+		// Watched paths may be symbolic links, directories below them are not followed.
+		const uint32_t mask = (kInotifyWatchMask | (isWatchedPath ? 0 : IN_DONT_FOLLOW));
+		isWatchedPath = false;
+		
+		const int descriptor = inotify_add_watch(_eventDescriptor, directory.c_str(), mask);
+		if (descriptor < 0) {
+			if (errno == ENOSPC || errno == ENOMEM) {
+				return false;
+			}
+			// Vanished, not a directory or not readable; nothing to watch.
+			continue;
+		}
+		_watches[descriptor] = directory;
+		
+		DIR *stream = opendir(directory.c_str());
+		if (stream == NULL) {
+			continue;
+		}
+		
+		struct dirent *entry;
+		while ((entry = readdir(stream)) != NULL) {
+			if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+				continue;
+			}
+			
+			unsigned char type = entry->d_type;
+			if (type == DT_UNKNOWN) {
+				struct stat info;
+				if (fstatat(dirfd(stream), entry->d_name, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+					continue;
+				}
+				type = (S_ISDIR(info.st_mode) ? DT_DIR : (S_ISLNK(info.st_mode) ? DT_LNK : DT_REG));
+			}
+			
+			const std::string child = pathByAppendingComponent(directory, entry->d_name);
+			if (reportContents) {
+				const EventFlags typeFlag = (type == DT_DIR ? kEventFlagItemIsDir :
+											 (type == DT_LNK ? kEventFlagItemIsSymlink : kEventFlagItemIsFile));
+				addItemEvent(directory, child, (kEventFlagItemCreated | typeFlag));
+			}
+			if (type == DT_DIR) {
+				directories.push_back(child);
+			}
+		}
+		closedir(stream);
+	}
+	
+	return true;
+}
+
+void InotifyBackend::moveWatches(const std::string &from, const std::string &to)
+{
+	for (std::unordered_map<int, std::string>::iterator watch = _watches.begin(); watch != _watches.end(); ++watch) {
+		std::string &directory = watch->second;
+		if (isPathPrefix(from, directory)) {
+			directory.replace(0, from.size(), to);
+		}
+	}
+}
+
+bool InotifyBackend::isWatchedDirectory(const std::string &path) const
+{
+	for (std::unordered_map<int, std::string>::const_iterator watch = _watches.begin(); watch != _watches.end(); ++watch) {
+		if (watch->second == path) {
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+bool InotifyBackend::isInWatchedTree(const std::string &path) const
+{
+	for (size_t i = 0; i < _configuration.watchedPaths.size(); ++i) {
+		if (isPathPrefix(_configuration.watchedPaths[i], path)) {
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+void InotifyBackend::removeWatches(const std::string &path)
+{
+	for (std::unordered_map<int, std::string>::iterator watch = _watches.begin(); watch != _watches.end(); ) {
+		const std::string &directory = watch->second;
+		if (isPathPrefix(path, directory)) {
+			inotify_rm_watch(_eventDescriptor, watch->first);
+			watch = _watches.erase(watch);
+		} else {
+			++watch;
+		}
+	}
+}
+
+} // namespace cdevents
+
+#endif // defined(__linux__)
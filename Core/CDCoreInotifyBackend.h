@@ -0,0 +1,105 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreInotifyBackend.h
+ * A Linux backend built on inotify.
+ */
+
+#ifndef CD_CORE_INOTIFY_BACKEND_H
+#define CD_CORE_INOTIFY_BACKEND_H
+
+#if defined(__linux__)
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CDCorePollingBackend.h"
+
+struct inotify_event;
+
+namespace cdevents {
+
+/**
+ * A backend which watches the watched paths recursively with inotify.
+ *
+ * Every directory below the watched paths gets its own watch; directories
+ * created or moved into the watched trees are watched (and their contents
+ * reported as created) as they appear.
+ *
+ * The inotify events are mapped onto the event flags as follows:
+ * IN_CREATE onto kEventFlagItemCreated, IN_DELETE onto kEventFlagItemRemoved,
+ * IN_MOVED_FROM and IN_MOVED_TO onto kEventFlagItemRenamed, with the cookie
+ * of the move as RawEvent::renameCookie, IN_MODIFY onto
+ * kEventFlagItemModified and IN_ATTRIB onto kEventFlagItemInodeMetaMod. A
+ * queue overflow is reported as kEventFlagMustScanSubDirs together with
+ * kEventFlagKernelDropped for each watched path. Unless the stream is created
+ * with kStreamCreationFlagFileEvents, events are reported as generic changes
+ * of the containing directory, just like FSEvents does.
+ *
+ * @see PollingBackend for batching, event identifiers and event history.
+ *
+ * @since head
+ */
+class InotifyBackend : public PollingBackend {
+public:
+	InotifyBackend();
+	virtual ~InotifyBackend();
+	
+	virtual std::string description() const;
+	
+protected:
+	virtual void openEventSource();
+	virtual void readEvents();
+	virtual void willDeliverEvents();
+	virtual void watchedPathsChanged(const std::vector<std::string> &previous);
+	virtual void closeEventSource();
+	
+private:
+	InotifyBackend(const InotifyBackend &);
+	InotifyBackend &operator=(const InotifyBackend &);
+	
+	void handleEvent(const struct inotify_event *event);
+	
+	bool addWatches(const std::string &path, bool reportContents);
+	void moveWatches(const std::string &from, const std::string &to);
+	void removeWatches(const std::string &path);
+	bool isWatchedDirectory(const std::string &path) const;
+	bool isInWatchedTree(const std::string &path) const;
+	
+	std::unordered_map<int, std::string>				_watches;
+	std::unordered_map<uint32_t, std::string>			_movedDirectories;
+};
+
+} // namespace cdevents
+
+#endif // defined(__linux__)
+
+#endif // CD_CORE_INOTIFY_BACKEND_H
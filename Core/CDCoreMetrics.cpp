@@ -0,0 +1,157 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreMetrics.h"
+
+namespace cdevents {
+
+#pragma mark Constants
+// Intervals shorter than this many nanoseconds have a bucket each.
+static const uint64_t kLinearBucketCount = 16;
+
+// Every power of two above them is split into 2^3 buckets.
+static const unsigned kSubBucketBits = 3;
+
+const size_t LatencyHistogram::kBucketCount;
+
+
+#pragma mark Helpers
+static unsigned highestBit(uint64_t value)
+{
+	unsigned bit = 0;
+	while (value >>= 1) {
+		++bit;
+	}
+	
+	return bit;
+}
+
+
+#pragma mark Latency histogram snapshots
+uint64_t LatencyHistogramSnapshot::percentile(double fraction) const
+{
+	if (count == 0) {
+		return 0;
+	}
+	
+	const uint64_t rank = (uint64_t)(fraction * (double)count);
+	uint64_t seen = 0;
+	for (size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+		seen += buckets[bucket];
+		if (seen > rank) {
+			// The middle of the bucket, but never more than was recorded.
+			const uint64_t lower = LatencyHistogram::lowerBoundOfBucket(bucket);
+			const uint64_t upper = (bucket + 1 < LatencyHistogram::kBucketCount ?
+									LatencyHistogram::lowerBoundOfBucket(bucket + 1) : lower);
+			const uint64_t middle = lower + (upper - lower) / 2;
+			return (maximum > 0 && middle > maximum ? maximum : middle);
+		}
+	}
+	
+	return maximum;
+}
+
+
+#pragma mark Latency histograms
+LatencyHistogram::LatencyHistogram()
+:	_total(0),
+	_maximum(0)
+{
+	for (size_t i = 0; i < kBucketCount; ++i) {
+		_buckets[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+	_buckets[bucketOfInterval(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+	_total.fetch_add(nanoseconds, std::memory_order_relaxed);
+	
+	uint64_t maximum = _maximum.load(std::memory_order_relaxed);
+	while (nanoseconds > maximum &&
+		   !_maximum.compare_exchange_weak(maximum, nanoseconds, std::memory_order_relaxed)) {
+	}
+}
+
+void LatencyHistogram::read(LatencyHistogramSnapshot &snapshot) const
+{
+	// The count is summed from the buckets so that percentiles add up, even
+	// though the total and maximum may be a recording ahead or behind.
+	snapshot.buckets.resize(kBucketCount);
+	snapshot.count = 0;
+	for (size_t i = 0; i < kBucketCount; ++i) {
+		snapshot.buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+		snapshot.count += snapshot.buckets[i];
+	}
+	snapshot.total		= _total.load(std::memory_order_relaxed);
+	snapshot.maximum	= _maximum.load(std::memory_order_relaxed);
+}
+
+size_t LatencyHistogram::bucketOfInterval(uint64_t nanoseconds)
+{
+	if (nanoseconds < kLinearBucketCount) {
+		return (size_t)nanoseconds;
+	}
+	
+	const unsigned exponent = highestBit(nanoseconds);
+	const uint64_t subBucket = (nanoseconds >> (exponent - kSubBucketBits)) & ((1u << kSubBucketBits) - 1);
+	return (size_t)(kLinearBucketCount + ((exponent - highestBit(kLinearBucketCount)) << kSubBucketBits) + subBucket);
+}
+
+uint64_t LatencyHistogram::lowerBoundOfBucket(size_t bucket)
+{
+	if (bucket < kLinearBucketCount) {
+		return bucket;
+	}
+	
+	const size_t index = bucket - kLinearBucketCount;
+	const unsigned exponent = (unsigned)(index >> kSubBucketBits) + highestBit(kLinearBucketCount);
+	const uint64_t subBucket = index & ((1u << kSubBucketBits) - 1);
+	return ((uint64_t)1 << exponent) + (subBucket << (exponent - kSubBucketBits));
+}
+
+
+#pragma mark Stream metrics
+StreamMetrics::StreamMetrics()
+{
+	for (size_t i = 0; i < kMetricsCounterCount; ++i) {
+		_counters[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+void StreamMetrics::read(StreamMetricsSnapshot &snapshot) const
+{
+	for (size_t i = 0; i < kMetricsCounterCount; ++i) {
+		snapshot.counters[i] = _counters[i].load(std::memory_order_relaxed);
+	}
+	for (size_t i = 0; i < kMetricsStageCount; ++i) {
+		_stages[i].read(snapshot.stages[i]);
+	}
+}
+
+} // namespace cdevents
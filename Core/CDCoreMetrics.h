@@ -0,0 +1,234 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreMetrics.h
+ * Counters and latency histograms of a stream, cheap enough to leave on.
+ */
+
+#ifndef CD_CORE_METRICS_H
+#define CD_CORE_METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+namespace cdevents {
+
+/**
+ * The current time in nanoseconds of a clock which never goes backwards, for measuring intervals.
+ *
+ * @since head
+ */
+inline uint64_t monotonicNanoseconds()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+#pragma mark -
+#pragma mark Latency histograms
+/**
+ * The contents of a latency histogram at one point in time.
+ *
+ * @since head
+ */
+struct LatencyHistogramSnapshot {
+	/** The number of intervals recorded. */
+	uint64_t				count;
+	/** The sum of the intervals recorded, in nanoseconds. */
+	uint64_t				total;
+	/** The longest interval recorded, in nanoseconds. */
+	uint64_t				maximum;
+	/** The number of intervals in each bucket, see LatencyHistogram::lowerBoundOfBucket(). */
+	std::vector<uint64_t>	buckets;
+	
+	LatencyHistogramSnapshot() : count(0), total(0), maximum(0) {}
+	
+	/**
+	 * The interval, in nanoseconds, below which the given fraction (0 to 1) of the intervals fall. Accurate to within an eighth.
+	 */
+	uint64_t percentile(double fraction) const;
+	
+	/**
+	 * The mean interval in nanoseconds.
+	 */
+	uint64_t mean() const { return (count > 0 ? total / count : 0); }
+};
+
+/**
+ * A histogram of time intervals which any number of threads may record into at once.
+ *
+ * Recording is a handful of relaxed atomic additions, without locks. The
+ * buckets are log-linear: every power of two is split into eight buckets,
+ * so every interval, from a nanosecond to centuries, is counted to within an
+ * eighth of its length.
+ *
+ * @since head
+ */
+class LatencyHistogram {
+public:
+	/** The number of buckets. */
+	static const size_t kBucketCount = 496;
+	
+	LatencyHistogram();
+	
+	/**
+	 * Counts an interval of the given length.
+	 */
+	void record(uint64_t nanoseconds);
+	
+	/**
+	 * Copies the counts, while others may still be recording.
+	 */
+	void read(LatencyHistogramSnapshot &snapshot) const;
+	
+	/**
+	 * The bucket intervals of the given length are counted in.
+	 */
+	static size_t bucketOfInterval(uint64_t nanoseconds);
+	
+	/**
+	 * The shortest interval counted in the given bucket, in nanoseconds.
+	 */
+	static uint64_t lowerBoundOfBucket(size_t bucket);
+	
+private:
+	LatencyHistogram(const LatencyHistogram &);
+	LatencyHistogram &operator=(const LatencyHistogram &);
+	
+	std::atomic<uint64_t>	_buckets[kBucketCount];
+	std::atomic<uint64_t>	_total;
+	std::atomic<uint64_t>	_maximum;
+};
+
+
+#pragma mark -
+#pragma mark Stream metrics
+/**
+ * The events a stream counts.
+ *
+ * @since head
+ */
+enum MetricsCounter {
+	/** Events reported by the backend. */
+	kMetricsCounterEventsReceived,
+	/** Events ignored because they are in an excluded path. */
+	kMetricsCounterEventsExcluded,
+	/** Events ignored because they are in a sub-directory of a watched path. */
+	kMetricsCounterEventsInSubDirectories,
+	/** Events delivered to the handler. */
+	kMetricsCounterEventsDelivered,
+	/** Batches delivered to the handler. */
+	kMetricsCounterBatchesDelivered,
+	/** Events reporting that events were dropped, by the kernel or in user space. */
+	kMetricsCounterDroppedEventReports,
+	/** Events asking for a rescan. */
+	kMetricsCounterRescanRequests,
+	
+	kMetricsCounterCount
+};
+
+/**
+ * The stages of a batch, from the backend to the client, whose time a stream measures.
+ *
+ * @since head
+ */
+enum MetricsStage {
+	/** Waiting for a delivery thread. */
+	kMetricsStageQueueWait,
+	/** Standardizing, filtering and coalescing the events. */
+	kMetricsStageFiltering,
+	/** Running the handler of the stream. */
+	kMetricsStageHandler,
+	/** Creating the objects handed to the client, measured by the client of the core. */
+	kMetricsStageObjectConstruction,
+	/** Running the client's code, measured by the client of the core. */
+	kMetricsStageClient,
+	
+	kMetricsStageCount
+};
+
+/**
+ * The counters and histograms of a stream at one point in time.
+ *
+ * @since head
+ */
+struct StreamMetricsSnapshot {
+	uint64_t					counters[kMetricsCounterCount];
+	LatencyHistogramSnapshot	stages[kMetricsStageCount];
+	
+	StreamMetricsSnapshot()
+	{
+		for (size_t i = 0; i < kMetricsCounterCount; ++i) {
+			counters[i] = 0;
+		}
+	}
+};
+
+/**
+ * The counters and per stage latency histograms of a stream.
+ *
+ * A stream only measures itself when created with metrics, see
+ * StreamConfiguration::metrics. Everything may be recorded, and read, from
+ * any thread at any time; nothing ever waits.
+ *
+ * @since head
+ */
+class StreamMetrics {
+public:
+	StreamMetrics();
+	
+	/**
+	 * Adds to one of the counters.
+	 */
+	void add(MetricsCounter counter, uint64_t count) { _counters[counter].fetch_add(count, std::memory_order_relaxed); }
+	
+	/**
+	 * Records the time a batch spent in one of the stages.
+	 */
+	void record(MetricsStage stage, uint64_t nanoseconds) { _stages[stage].record(nanoseconds); }
+	
+	/**
+	 * Copies the counters and histograms, while the stream keeps recording.
+	 */
+	void read(StreamMetricsSnapshot &snapshot) const;
+	
+private:
+	StreamMetrics(const StreamMetrics &);
+	StreamMetrics &operator=(const StreamMetrics &);
+	
+	std::atomic<uint64_t>	_counters[kMetricsCounterCount];
+	LatencyHistogram		_stages[kMetricsStageCount];
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_METRICS_H
@@ -0,0 +1,146 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCorePath.h"
+
+#include <string.h>
+
+namespace cdevents {
+
+void standardizePath(std::string &path)
+{
+	if (path.empty()) {
+		return;
+	}
+	
+	const size_t length = path.size();
+	const size_t base = (path[0] == '/' ? 1 : 0);
+	size_t out = base;
+	size_t in = base;
+	
+	// Components are copied down in place, "out" is always the length of the
+	// standardized part written so far.
+	while (in < length) {
+		while (in < length && path[in] == '/') {
+			++in;
+		}
+		size_t end = in;
+		while (end < length && path[end] != '/') {
+			++end;
+		}
+		const size_t componentLength = end - in;
+		const bool isDot = (componentLength == 1 && path[in] == '.');
+		const bool isDotDot = (componentLength == 2 && path[in] == '.' && path[in + 1] == '.');
+		
+		if (componentLength == 0 || isDot) {
+			// Skip empty and "." components.
+		} else if (isDotDot && out > base) {
+			const size_t slash = path.rfind('/', out - 1);
+			const size_t lastStart = (slash == std::string::npos ? 0 : slash + 1);
+			if (out - lastStart == 2 && path[lastStart] == '.' && path[lastStart + 1] == '.') {
+				// Relative paths keep leading ".." components.
+				path.replace(out, 3, "/..");
+				out += 3;
+			} else {
+				out = (slash == std::string::npos || slash < base ? base : slash);
+			}
+		} else if (isDotDot && base == 1) {
+			// The parent of the root is the root.
+		} else {
+			if (out > base) {
+				path[out++] = '/';
+			}
+			memmove(&path[out], &path[in], componentLength);
+			out += componentLength;
+		}
+		
+		in = end;
+	}
+	
+	if (out == 0) {
+		path = ".";
+		return;
+	}
+	path.resize(out);
+	
+#if defined(__APPLE__)
+	static const char *const privatePrefixes[] = { "/private/var", "/private/tmp", "/private/etc" };
+	static const size_t privateLength = 8; // strlen("/private")
+	for (size_t i = 0; i < sizeof(privatePrefixes) / sizeof(privatePrefixes[0]); ++i) {
+		const size_t prefixLength = strlen(privatePrefixes[i]);
+		if (path.compare(0, prefixLength, privatePrefixes[i]) == 0 &&
+			(path.size() == prefixLength || path[prefixLength] == '/')) {
+			path.erase(0, privateLength);
+			break;
+		}
+	}
+#endif
+}
+
+std::string standardizedPath(const std::string &path)
+{
+	std::string standardized(path);
+	standardizePath(standardized);
+	
+	return standardized;
+}
+
+bool isPathPrefix(const std::string &prefix, const std::string &path)
+{
+	if (prefix.size() > path.size() || path.compare(0, prefix.size(), prefix) != 0) {
+		return false;
+	}
+	
+	return (prefix.size() == path.size() ||
+			path[prefix.size()] == '/' ||
+			(!prefix.empty() && prefix[prefix.size() - 1] == '/'));
+}
+
+std::string pathByAppendingComponent(const std::string &directory, const char *name)
+{
+	std::string path(directory);
+	if (path.empty() || path[path.size() - 1] != '/') {
+		path += '/';
+	}
+	path += name;
+	
+	return path;
+}
+
+uint32_t hashPath(const char *path, size_t length)
+{
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; ++i) {
+		hash ^= (uint8_t)path[i];
+		hash *= 16777619u;
+	}
+	
+	return hash;
+}
+
+} // namespace cdevents
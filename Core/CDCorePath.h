@@ -0,0 +1,107 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCorePath.h
+ * Path helpers shared by the CDEvents core.
+ */
+
+#ifndef CD_CORE_PATH_H
+#define CD_CORE_PATH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace cdevents {
+
+/**
+ * Standardizes the given path in place.
+ *
+ * Collapses repeated slashes, removes "." components, resolves ".."
+ * components lexically and strips any trailing slash. On OS X the "/private"
+ * prefix of "/private/var", "/private/tmp" and "/private/etc" is removed as
+ * well, mirroring <code>-[NSString stringByStandardizingPath]</code>.
+ *
+ * @param path The path to standardize.
+ *
+ * @since head
+ */
+void standardizePath(std::string &path);
+
+/**
+ * Returns a standardized copy of the given path.
+ *
+ * @param path The path to standardize.
+ * @return The standardized path.
+ *
+ * @see standardizePath(std::string &)
+ *
+ * @since head
+ */
+std::string standardizedPath(const std::string &path);
+
+/**
+ * Whether the path <em>prefix</em> is equal to or an ancestor of <em>path</em>.
+ *
+ * Both paths must be standardized. The comparison respects component
+ * boundaries, i.e. "/a/b" is a prefix of "/a/b/c" but not of "/a/bc".
+ *
+ * @param prefix The possible ancestor.
+ * @param path The path to check.
+ * @return <code>true</code> if <em>prefix</em> is equal to or an ancestor of <em>path</em>.
+ *
+ * @since head
+ */
+bool isPathPrefix(const std::string &prefix, const std::string &path);
+
+/**
+ * Returns the path of the entry <em>name</em> in <em>directory</em>.
+ *
+ * @param directory The directory containing the entry.
+ * @param name The name of the entry.
+ * @return The path of the entry.
+ *
+ * @since head
+ */
+std::string pathByAppendingComponent(const std::string &directory, const char *name);
+
+/**
+ * Returns a hash of the given path, for hash tables keyed on paths.
+ *
+ * @param path The path to hash, it need not be NUL terminated.
+ * @param length The length of the path in bytes.
+ * @return The FNV-1a hash of the path.
+ *
+ * @since head
+ */
+uint32_t hashPath(const char *path, size_t length);
+
+} // namespace cdevents
+
+#endif // CD_CORE_PATH_H
@@ -0,0 +1,252 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCorePathInternTable.h
+ * A bounded table sharing one value between all occurrences of a path.
+ */
+
+#ifndef CD_CORE_PATH_INTERN_TABLE_H
+#define CD_CORE_PATH_INTERN_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "CDCorePath.h"
+
+namespace cdevents {
+
+/**
+ * The counters of a path intern table.
+ *
+ * @since head
+ */
+struct PathInternStatistics {
+	/** The number of lookups which found the path in the table. */
+	uint64_t	hits;
+	/** The number of lookups which had to create the value of the path. */
+	uint64_t	misses;
+	/** The number of paths evicted to make room for another one. */
+	uint64_t	evictions;
+	
+	PathInternStatistics() : hits(0), misses(0), evictions(0) {}
+};
+
+
+/**
+ * A table mapping paths to a value created once per path, for example an immutable object representing it.
+ *
+ * The table holds at most <em>capacity</em> paths and evicts the least
+ * recently used one when a new path is added to a full table. Looking up a
+ * path which is in the table allocates nothing. The table is not thread-safe.
+ *
+ * The value type must be default constructible and assignable.
+ *
+ * @since head
+ */
+template <typename Value>
+class PathInternTable {
+public:
+	/**
+	 * Returns a table holding at most the given number of paths, zero disables interning.
+	 */
+	explicit PathInternTable(size_t capacity) { setCapacity(capacity); }
+	
+	/**
+	 * Sets the maximum number of paths, removing all paths but keeping the counters.
+	 */
+	void setCapacity(size_t capacity);
+	size_t capacity() const { return _capacity; }
+	
+	/**
+	 * The number of paths in the table.
+	 */
+	size_t size() const { return _entries.size(); }
+	
+	/**
+	 * Removes all paths, keeping the counters.
+	 */
+	void clear() { setCapacity(_capacity); }
+	
+	/**
+	 * Returns the value of the given path, calling <em>create</em>(path, length) to create it if the path is not in the table.
+	 *
+	 * The returned reference is valid until the next call to a non-const method.
+	 */
+	template <typename Create>
+	const Value &valueForPath(const char *path, size_t length, Create create);
+	
+	/** @name Counters */
+	const PathInternStatistics &statistics() const { return _statistics; }
+	void resetStatistics() { _statistics = PathInternStatistics(); }
+	
+private:
+	static const size_t kNone = (size_t)-1;
+	
+	struct Entry {
+		std::string	path;
+		uint32_t	hash;
+		Value		value;
+		size_t		nextInBucket;
+		size_t		newer;
+		size_t		older;
+	};
+	
+	PathInternTable(const PathInternTable &);
+	PathInternTable &operator=(const PathInternTable &);
+	
+	void unlink(size_t index);
+	void linkAsNewest(size_t index);
+	void removeFromBucket(size_t index);
+	
+	size_t					_capacity;
+	std::vector<Entry>		_entries;
+	std::vector<size_t>		_buckets;
+	size_t					_newest;
+	size_t					_oldest;
+	Value					_uninterned;
+	PathInternStatistics	_statistics;
+};
+
+
+#pragma mark -
+#pragma mark Template implementation
+template <typename Value>
+const size_t PathInternTable<Value>::kNone;
+
+template <typename Value>
+void PathInternTable<Value>::setCapacity(size_t capacity)
+{
+	_capacity	= capacity;
+	_newest		= kNone;
+	_oldest		= kNone;
+	_uninterned	= Value();
+	
+	std::vector<Entry>().swap(_entries);
+	_entries.reserve(capacity);
+	
+	// At most half full, so that the bucket chains stay short.
+	size_t bucketCount = 1;
+	while (bucketCount < capacity * 2) {
+		bucketCount *= 2;
+	}
+	_buckets.assign(bucketCount, kNone);
+}
+
+template <typename Value>
+template <typename Create>
+const Value &PathInternTable<Value>::valueForPath(const char *path, size_t length, Create create)
+{
+	if (_capacity == 0) {
+		_statistics.misses++;
+		_uninterned = create(path, length);
+		return _uninterned;
+	}
+	
+	const uint32_t hash = hashPath(path, length);
+	size_t &bucket = _buckets[hash & (_buckets.size() - 1)];
+	for (size_t index = bucket; index != kNone; index = _entries[index].nextInBucket) {
+		Entry &entry = _entries[index];
+		if (entry.hash == hash && entry.path.size() == length && memcmp(entry.path.data(), path, length) == 0) {
+			_statistics.hits++;
+			unlink(index);
+			linkAsNewest(index);
+			return entry.value;
+		}
+	}
+	
+	_statistics.misses++;
+	size_t index;
+	if (_entries.size() < _capacity) {
+		index = _entries.size();
+		_entries.push_back(Entry());
+	} else {
+		_statistics.evictions++;
+		index = _oldest;
+		unlink(index);
+		removeFromBucket(index);
+	}
+	
+	// The path of an evicted entry keeps its storage for the new one.
+	Entry &entry		= _entries[index];
+	entry.path.assign(path, length);
+	entry.hash			= hash;
+	entry.value			= create(path, length);
+	entry.nextInBucket	= bucket;
+	bucket				= index;
+	linkAsNewest(index);
+	
+	return entry.value;
+}
+
+template <typename Value>
+void PathInternTable<Value>::unlink(size_t index)
+{
+	Entry &entry = _entries[index];
+	if (entry.newer != kNone) {
+		_entries[entry.newer].older = entry.older;
+	} else {
+		_newest = entry.older;
+	}
+	if (entry.older != kNone) {
+		_entries[entry.older].newer = entry.newer;
+	} else {
+		_oldest = entry.newer;
+	}
+}
+
+template <typename Value>
+void PathInternTable<Value>::linkAsNewest(size_t index)
+{
+	Entry &entry = _entries[index];
+	entry.newer = kNone;
+	entry.older = _newest;
+	if (_newest != kNone) {
+		_entries[_newest].newer = index;
+	} else {
+		_oldest = index;
+	}
+	_newest = index;
+}
+
+template <typename Value>
+void PathInternTable<Value>::removeFromBucket(size_t index)
+{
+	size_t *link = &_buckets[_entries[index].hash & (_buckets.size() - 1)];
+	while (*link != index) {
+		link = &_entries[*link].nextInBucket;
+	}
+	*link = _entries[index].nextInBucket;
+}
+
+} // namespace cdevents
+
+#endif // CD_CORE_PATH_INTERN_TABLE_H
@@ -0,0 +1,842 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCorePathMatcher.h"
+
+#include <algorithm>
+#include <bitset>
+#include <ctype.h>
+#include <deque>
+#include <string.h>
+#include <unordered_map>
+
+namespace cdevents {
+
+// The patterns are compiled in three steps: each is parsed into a small
+// syntax tree, the trees are joined into one nondeterministic automaton
+// (Thompson's construction) and that is turned into a deterministic one by
+// the subset construction. Bytes which no pattern tells apart share a class,
+// so the transition table has a column per class rather than per byte.
+//
+// Rather than carrying "a pattern matched an ancestor" through the states,
+// which would multiply their number by every combination of patterns, each
+// state records the last pattern accepting there and the match checks it at
+// every component boundary on the way. Regular expressions not anchored at
+// the end are likewise checked after every byte.
+static const size_t kMaximumStateCount = 16384;
+static const size_t kMaximumNfaStateCount = 65536;
+static const unsigned kMaximumRepetition = 255;
+static const unsigned kUnbounded = ~0u;
+
+static const uint32_t kDeadState = 0;
+
+namespace {
+
+typedef std::bitset<256> ByteSet;
+
+
+#pragma mark Syntax tree
+struct SyntaxNode {
+	enum Type {
+		kBytes,
+		kSequence,
+		kAlternation,
+		kRepetition
+	};
+	
+	Type				type;
+	ByteSet				bytes;
+	std::vector<size_t>	children;
+	unsigned			minimum;
+	unsigned			maximum;
+};
+
+class SyntaxTree {
+public:
+	const SyntaxNode &operator[](size_t node) const { return _nodes[node]; }
+	
+	size_t bytes(const ByteSet &bytes)
+	{
+		SyntaxNode node = newNode(SyntaxNode::kBytes);
+		node.bytes = bytes;
+		return add(node);
+	}
+	
+	size_t byte(unsigned char byte)
+	{
+		ByteSet bytes;
+		bytes.set(byte);
+		return this->bytes(bytes);
+	}
+	
+	size_t sequence(const std::vector<size_t> &children)
+	{
+		SyntaxNode node = newNode(SyntaxNode::kSequence);
+		node.children = children;
+		return add(node);
+	}
+	
+	size_t alternation(const std::vector<size_t> &children)
+	{
+		SyntaxNode node = newNode(SyntaxNode::kAlternation);
+		node.children = children;
+		return add(node);
+	}
+	
+	size_t repetition(size_t child, unsigned minimum, unsigned maximum)
+	{
+		SyntaxNode node = newNode(SyntaxNode::kRepetition);
+		node.children.push_back(child);
+		node.minimum = minimum;
+		node.maximum = maximum;
+		return add(node);
+	}
+	
+private:
+	static SyntaxNode newNode(SyntaxNode::Type type)
+	{
+		SyntaxNode node;
+		node.type		= type;
+		node.minimum	= 1;
+		node.maximum	= 1;
+		return node;
+	}
+	
+	size_t add(const SyntaxNode &node)
+	{
+		_nodes.push_back(node);
+		return _nodes.size() - 1;
+	}
+	
+	std::vector<SyntaxNode> _nodes;
+};
+
+static ByteSet anyByte()
+{
+	return ByteSet().set();
+}
+
+static ByteSet anyByteButSlash()
+{
+	return ByteSet().set().reset('/');
+}
+
+
+#pragma mark Parsing
+class PatternParser {
+public:
+	PatternParser(const std::string &pattern, size_t offset, SyntaxTree &tree)
+	:	_pattern(pattern),
+		_position(offset),
+		_end(pattern.size()),
+		_tree(tree)
+	{}
+	
+	size_t parseGlob(bool &anchored, bool &beneath);
+	size_t parseRegularExpression(bool &anchoredAtStart, bool &anchoredAtEnd);
+	
+private:
+	PathPatternError error(const std::string &reason) const
+	{
+		return PathPatternError("Malformed path pattern \"" + _pattern + "\": " + reason + ".");
+	}
+	
+	bool atEnd() const { return (_position >= _end); }
+	unsigned char peek() const { return static_cast<unsigned char>(_pattern[_position]); }
+	unsigned char next() { return static_cast<unsigned char>(_pattern[_position++]); }
+	
+	ByteSet parseClass();
+	size_t parseAlternation(unsigned depth);
+	size_t parseSequence(unsigned depth);
+	size_t parseAtom(unsigned depth);
+	bool parseRepetition(unsigned &minimum, unsigned &maximum);
+	unsigned parseCount();
+	
+	const std::string	&_pattern;
+	size_t				_position;
+	size_t				_end;
+	SyntaxTree			&_tree;
+};
+
+size_t PatternParser::parseGlob(bool &anchored, bool &beneath)
+{
+	// A trailing slash only marks a directory, which the paths cannot tell.
+	while (_end - _position > 1 && _pattern[_end - 1] == '/' && _pattern[_end - 2] != '\\') {
+		--_end;
+	}
+	if (atEnd()) {
+		throw error("it is empty");
+	}
+	
+	anchored = (peek() == '/');
+	
+	// A leading "**" component matches at the start of any component, which
+	// is what an unanchored pattern does already.
+	const size_t start = _position + (anchored ? 1 : 0);
+	if (_end - start > 3 && _pattern.compare(start, 3, "**/") == 0) {
+		anchored = false;
+		_position = start + 3;
+		while (_end - _position > 3 && _pattern.compare(_position, 3, "**/") == 0) {
+			_position += 3;
+		}
+	}
+	
+	// A trailing "**" component matches everything beneath the rest of the
+	// pattern. Rather than a loop over any bytes, which would stay alive in
+	// every state after a match, the rest is accepted before a slash only.
+	beneath = false;
+	while (_end - _position > 3 && _pattern.compare(_end - 3, 3, "/**") == 0 &&
+		   (_end - _position == 4 || _pattern[_end - 4] != '\\')) {
+		beneath = true;
+		_end -= 3;
+	}
+	
+	std::vector<size_t> items;
+	bool atComponentStart = true;
+	while (!atEnd()) {
+		if (atComponentStart && _pattern.compare(_position, 2, "**") == 0 &&
+			(_position + 2 == _end || _pattern[_position + 2] == '/')) {
+			const size_t anything = _tree.repetition(_tree.bytes(anyByte()), 0, kUnbounded);
+			if (_position + 2 == _end) {
+				items.push_back(anything);
+				_position += 2;
+			} else {
+				std::vector<size_t> components;
+				components.push_back(anything);
+				components.push_back(_tree.byte('/'));
+				items.push_back(_tree.repetition(_tree.sequence(components), 0, 1));
+				_position += 3;
+			}
+			continue;
+		}
+		
+		const unsigned char character = next();
+		atComponentStart = (character == '/');
+		switch (character) {
+			case '*':
+				items.push_back(_tree.repetition(_tree.bytes(anyByteButSlash()), 0, kUnbounded));
+				break;
+			case '?':
+				items.push_back(_tree.bytes(anyByteButSlash()));
+				break;
+			case '[':
+				items.push_back(_tree.bytes(parseClass() & anyByteButSlash()));
+				break;
+			case '\\':
+				if (atEnd()) {
+					throw error("it ends with an escape");
+				}
+				items.push_back(_tree.byte(next()));
+				break;
+			default:
+				items.push_back(_tree.byte(character));
+				break;
+		}
+	}
+	
+	return _tree.sequence(items);
+}
+
+size_t PatternParser::parseRegularExpression(bool &anchoredAtStart, bool &anchoredAtEnd)
+{
+	anchoredAtStart = (!atEnd() && peek() == '^');
+	if (anchoredAtStart) {
+		++_position;
+	}
+	
+	// A "$" preceded by an odd number of backslashes is escaped.
+	anchoredAtEnd = false;
+	if (_end > _position && _pattern[_end - 1] == '$') {
+		size_t escapes = 0;
+		while (_end - 1 - escapes > _position && _pattern[_end - 2 - escapes] == '\\') {
+			++escapes;
+		}
+		anchoredAtEnd = (escapes % 2 == 0);
+		if (anchoredAtEnd) {
+			--_end;
+		}
+	}
+	
+	const size_t expression = parseAlternation(0);
+	if (!atEnd()) {
+		throw error("unbalanced \")\"");
+	}
+	
+	return expression;
+}
+
+ByteSet PatternParser::parseClass()
+{
+	ByteSet bytes;
+	bool negated = false;
+	if (!atEnd() && (peek() == '!' || peek() == '^')) {
+		negated = true;
+		++_position;
+	}
+	
+	// A "]" right after the opening bracket is a member, not the end.
+	bool first = true;
+	for (;;) {
+		if (atEnd()) {
+			throw error("unterminated character class");
+		}
+		unsigned char low = next();
+		if (low == ']' && !first) {
+			break;
+		}
+		first = false;
+		if (low == '\\') {
+			if (atEnd()) {
+				throw error("unterminated character class");
+			}
+			low = next();
+		}
+		
+		unsigned char high = low;
+		if (_position + 1 < _end && peek() == '-' && _pattern[_position + 1] != ']') {
+			++_position;
+			high = next();
+			if (high == '\\') {
+				if (atEnd()) {
+					throw error("unterminated character class");
+				}
+				high = next();
+			}
+			if (high < low) {
+				throw error("reversed character range");
+			}
+		}
+		for (unsigned byte = low; byte <= high; ++byte) {
+			bytes.set(byte);
+		}
+	}
+	
+	return (negated ? ~bytes : bytes);
+}
+
+size_t PatternParser::parseAlternation(unsigned depth)
+{
+	std::vector<size_t> alternatives;
+	alternatives.push_back(parseSequence(depth));
+	while (!atEnd() && peek() == '|') {
+		++_position;
+		alternatives.push_back(parseSequence(depth));
+	}
+	
+	return (alternatives.size() == 1 ? alternatives[0] : _tree.alternation(alternatives));
+}
+
+size_t PatternParser::parseSequence(unsigned depth)
+{
+	std::vector<size_t> items;
+	while (!atEnd() && peek() != '|' && peek() != ')') {
+		size_t item = parseAtom(depth);
+		unsigned minimum;
+		unsigned maximum;
+		while (parseRepetition(minimum, maximum)) {
+			item = _tree.repetition(item, minimum, maximum);
+		}
+		items.push_back(item);
+	}
+	
+	return _tree.sequence(items);
+}
+
+size_t PatternParser::parseAtom(unsigned depth)
+{
+	const unsigned char character = next();
+	switch (character) {
+		case '(': {
+			// Deep nesting would overflow the stack of the recursive parser.
+			if (depth >= 64) {
+				throw error("groups are nested too deeply");
+			}
+			const size_t group = parseAlternation(depth + 1);
+			if (atEnd() || next() != ')') {
+				throw error("unbalanced \"(\"");
+			}
+			return group;
+		}
+		case '.':
+			return _tree.bytes(anyByte());
+		case '[':
+			return _tree.bytes(parseClass());
+		case '*':
+		case '+':
+		case '?':
+		case '{':
+			throw error("nothing to repeat");
+		case '^':
+		case '$':
+			throw error("anchors are only supported at the start and end");
+		case '\\': {
+			if (atEnd()) {
+				throw error("it ends with an escape");
+			}
+			const unsigned char escaped = next();
+			ByteSet bytes;
+			switch (escaped) {
+				case 'd':
+				case 'D':
+					for (unsigned byte = '0'; byte <= '9'; ++byte) {
+						bytes.set(byte);
+					}
+					return _tree.bytes(escaped == 'D' ? ~bytes : bytes);
+				case 'w':
+				case 'W':
+					for (unsigned byte = 0; byte < 256; ++byte) {
+						bytes[byte] = (isalnum(static_cast<int>(byte)) && byte < 128) || byte == '_';
+					}
+					return _tree.bytes(escaped == 'W' ? ~bytes : bytes);
+				case 's':
+				case 'S':
+					bytes.set(' ').set('\t').set('\n').set('\r').set('\f').set('\v');
+					return _tree.bytes(escaped == 'S' ? ~bytes : bytes);
+				default:
+					return _tree.byte(escaped);
+			}
+		}
+		default:
+			return _tree.byte(character);
+	}
+}
+
+bool PatternParser::parseRepetition(unsigned &minimum, unsigned &maximum)
+{
+	if (atEnd()) {
+		return false;
+	}
+	
+	switch (peek()) {
+		case '*':
+			minimum = 0;
+			maximum = kUnbounded;
+			break;
+		case '+':
+			minimum = 1;
+			maximum = kUnbounded;
+			break;
+		case '?':
+			minimum = 0;
+			maximum = 1;
+			break;
+		case '{':
+			++_position;
+			minimum = parseCount();
+			maximum = minimum;
+			if (!atEnd() && peek() == ',') {
+				++_position;
+				maximum = (!atEnd() && peek() == '}' ? kUnbounded : parseCount());
+			}
+			if (atEnd() || peek() != '}') {
+				throw error("malformed repetition");
+			}
+			if (maximum < minimum) {
+				throw error("reversed repetition bounds");
+			}
+			break;
+		default:
+			return false;
+	}
+	++_position;
+	
+	return true;
+}
+
+unsigned PatternParser::parseCount()
+{
+	unsigned count = 0;
+	size_t digits = 0;
+	while (!atEnd() && peek() >= '0' && peek() <= '9') {
+		count = count * 10 + (next() - '0');
+		if (++digits > 3 || count > kMaximumRepetition) {
+			throw error("repetition count is too large");
+		}
+	}
+	if (digits == 0) {
+		throw error("malformed repetition");
+	}
+	
+	return count;
+}
+
+
+#pragma mark Nondeterministic automaton
+struct NfaState {
+	enum Type {
+		kByte,
+		kEpsilon,
+		kAccept
+	};
+	
+	Type					type;
+	ByteSet					bytes;
+	uint32_t				next;
+	std::vector<uint32_t>	epsilons;
+	uint32_t				rule;
+	bool					acceptsAnywhere;
+	bool					acceptsBeneath;
+};
+
+class Nfa {
+public:
+	std::vector<NfaState> states;
+	
+	uint32_t addState(NfaState::Type type)
+	{
+		if (states.size() >= kMaximumNfaStateCount) {
+			throw PathPatternError("The path patterns are too complex to compile.");
+		}
+		NfaState state;
+		state.type	= type;
+		state.next				= 0;
+		state.rule				= 0;
+		state.acceptsAnywhere	= false;
+		state.acceptsBeneath	= false;
+		states.push_back(state);
+		return static_cast<uint32_t>(states.size() - 1);
+	}
+	
+	// Builds the states matching the given node followed by those starting
+	// at "next", and returns the first of them.
+	uint32_t build(const SyntaxTree &tree, size_t node, uint32_t next);
+};
+
+uint32_t Nfa::build(const SyntaxTree &tree, size_t node, uint32_t next)
+{
+	const SyntaxNode &syntax = tree[node];
+	switch (syntax.type) {
+		case SyntaxNode::kBytes: {
+			const uint32_t state = addState(NfaState::kByte);
+			states[state].bytes	= syntax.bytes;
+			states[state].next	= next;
+			return state;
+		}
+		case SyntaxNode::kSequence:
+			for (size_t i = syntax.children.size(); i > 0; --i) {
+				next = build(tree, syntax.children[i - 1], next);
+			}
+			return next;
+		case SyntaxNode::kAlternation: {
+			const uint32_t state = addState(NfaState::kEpsilon);
+			for (size_t i = 0; i < syntax.children.size(); ++i) {
+				const uint32_t alternative = build(tree, syntax.children[i], next);
+				states[state].epsilons.push_back(alternative);
+			}
+			return state;
+		}
+		case SyntaxNode::kRepetition: {
+			const size_t child = syntax.children[0];
+			uint32_t tail = next;
+			if (syntax.maximum == kUnbounded) {
+				const uint32_t loop = addState(NfaState::kEpsilon);
+				const uint32_t body = build(tree, child, loop);
+				states[loop].epsilons.push_back(body);
+				states[loop].epsilons.push_back(next);
+				tail = loop;
+			} else {
+				// Each optional copy either goes on to the next one or skips the rest.
+				for (unsigned i = syntax.minimum; i < syntax.maximum; ++i) {
+					const uint32_t choice = addState(NfaState::kEpsilon);
+					const uint32_t body = build(tree, child, tail);
+					states[choice].epsilons.push_back(body);
+					states[choice].epsilons.push_back(next);
+					tail = choice;
+				}
+			}
+			for (unsigned i = 0; i < syntax.minimum; ++i) {
+				tail = build(tree, child, tail);
+			}
+			return tail;
+		}
+	}
+	
+	return next;
+}
+
+// Computes the states reachable from the seeds without consuming a byte,
+// keeping only those that consume one or accept, sorted.
+class ClosureBuilder {
+public:
+	explicit ClosureBuilder(const Nfa &nfa)
+	:	_nfa(nfa),
+		_marks(nfa.states.size(), 0),
+		_generation(0)
+	{}
+	
+	void closure(const std::vector<uint32_t> &seeds, std::vector<uint32_t> &states)
+	{
+		states.clear();
+		++_generation;
+		_stack.assign(seeds.begin(), seeds.end());
+		while (!_stack.empty()) {
+			const uint32_t state = _stack.back();
+			_stack.pop_back();
+			if (_marks[state] == _generation) {
+				continue;
+			}
+			_marks[state] = _generation;
+			
+			const NfaState &nfaState = _nfa.states[state];
+			if (nfaState.type == NfaState::kEpsilon) {
+				_stack.insert(_stack.end(), nfaState.epsilons.begin(), nfaState.epsilons.end());
+			} else {
+				states.push_back(state);
+			}
+		}
+		std::sort(states.begin(), states.end());
+	}
+	
+private:
+	const Nfa				&_nfa;
+	std::vector<uint32_t>	_marks;
+	uint32_t				_generation;
+	std::vector<uint32_t>	_stack;
+};
+
+struct StateSetHash {
+	size_t operator()(const std::vector<uint32_t> &states) const
+	{
+		// FNV-1a over the state numbers.
+		uint64_t hash = 14695981039346656037ULL;
+		for (size_t i = 0; i < states.size(); ++i) {
+			hash = (hash ^ states[i]) * 1099511628211ULL;
+		}
+		return static_cast<size_t>(hash);
+	}
+};
+
+} // namespace
+
+
+#pragma mark Init
+PathMatcher::PathMatcher()
+:	_classCount(1),
+	_startState(kDeadState)
+{
+	memset(_byteClasses, 0, sizeof(_byteClasses));
+}
+
+PathMatcher::PathMatcher(const std::vector<std::string> &patterns)
+:	_patterns(patterns),
+	_classCount(1),
+	_startState(kDeadState)
+{
+	memset(_byteClasses, 0, sizeof(_byteClasses));
+	if (patterns.empty()) {
+		return;
+	}
+	
+	// Every pattern leads to an accepting state of its own. Rules are
+	// numbered from one so that zero can stand for none.
+	SyntaxTree tree;
+	Nfa nfa;
+	_ruleMatches.push_back(kPathMatchNone);
+	const uint32_t nfaStart = nfa.addState(NfaState::kEpsilon);
+	
+	// The patterns not anchored at the start share the loop skipping the
+	// leading bytes, or components as paths are absolute, rather than each
+	// keeping a loop of its own alive in every state.
+	const uint32_t componentStart = nfa.addState(NfaState::kEpsilon);
+	const uint32_t byteStart = nfa.addState(NfaState::kEpsilon);
+	const uint32_t componentLoop = nfa.addState(NfaState::kEpsilon);
+	const uint32_t byteLoop = nfa.addState(NfaState::kEpsilon);
+	const uint32_t anyByteBeforeComponent = nfa.addState(NfaState::kByte);
+	const uint32_t slash = nfa.addState(NfaState::kByte);
+	const uint32_t anyByteBeforeByte = nfa.addState(NfaState::kByte);
+	nfa.states[anyByteBeforeComponent].bytes	= anyByte();
+	nfa.states[anyByteBeforeComponent].next		= componentLoop;
+	nfa.states[slash].bytes.set('/');
+	nfa.states[slash].next						= componentStart;
+	nfa.states[componentLoop].epsilons.push_back(anyByteBeforeComponent);
+	nfa.states[componentLoop].epsilons.push_back(slash);
+	nfa.states[anyByteBeforeByte].bytes			= anyByte();
+	nfa.states[anyByteBeforeByte].next			= byteLoop;
+	nfa.states[byteLoop].epsilons.push_back(anyByteBeforeByte);
+	nfa.states[byteLoop].epsilons.push_back(byteStart);
+	nfa.states[nfaStart].epsilons.push_back(componentLoop);
+	nfa.states[nfaStart].epsilons.push_back(byteLoop);
+	for (size_t i = 0; i < patterns.size(); ++i) {
+		const std::string &pattern = patterns[i];
+		size_t offset = 0;
+		
+		PathMatch ruleMatch = kPathMatchExcluded;
+		if (pattern.compare(offset, 1, "!") == 0) {
+			ruleMatch = kPathMatchIncluded;
+			++offset;
+		}
+		
+		size_t node;
+		uint32_t from;
+		bool acceptsAnywhere = false;
+		bool acceptsBeneath = false;
+		if (pattern.compare(offset, 3, "re:") == 0) {
+			bool anchoredAtStart;
+			bool anchoredAtEnd;
+			node = PatternParser(pattern, offset + 3, tree).parseRegularExpression(anchoredAtStart, anchoredAtEnd);
+			from = (anchoredAtStart ? nfaStart : byteStart);
+			acceptsAnywhere = !anchoredAtEnd;
+		} else {
+			if (pattern.compare(offset, 5, "glob:") == 0) {
+				offset += 5;
+			}
+			bool anchored;
+			node = PatternParser(pattern, offset, tree).parseGlob(anchored, acceptsBeneath);
+			from = (anchored ? nfaStart : componentStart);
+		}
+		
+		const uint32_t accept = nfa.addState(NfaState::kAccept);
+		nfa.states[accept].rule				= static_cast<uint32_t>(_ruleMatches.size());
+		nfa.states[accept].acceptsAnywhere	= acceptsAnywhere;
+		nfa.states[accept].acceptsBeneath	= acceptsBeneath;
+		const uint32_t start = nfa.build(tree, node, accept);
+		nfa.states[from].epsilons.push_back(start);
+		_ruleMatches.push_back(static_cast<uint8_t>(ruleMatch));
+	}
+	
+	// Split the bytes into the classes no byte set tells apart.
+	std::vector<int> refined;
+	for (size_t i = 0; i < nfa.states.size(); ++i) {
+		if (nfa.states[i].type != NfaState::kByte) {
+			continue;
+		}
+		const ByteSet &bytes = nfa.states[i].bytes;
+		refined.assign(_classCount * 2, -1);
+		size_t classCount = 0;
+		for (unsigned byte = 0; byte < 256; ++byte) {
+			int &refinedClass = refined[_byteClasses[byte] * 2 + (bytes[byte] ? 1 : 0)];
+			if (refinedClass < 0) {
+				refinedClass = static_cast<int>(classCount++);
+			}
+			_byteClasses[byte] = static_cast<uint8_t>(refinedClass);
+		}
+		_classCount = classCount;
+	}
+	std::vector<unsigned char> representatives(_classCount);
+	for (unsigned byte = 256; byte > 0; --byte) {
+		representatives[_byteClasses[byte - 1]] = static_cast<unsigned char>(byte - 1);
+	}
+	
+	// The subset construction, the dead state (no live NFA states) first.
+	std::unordered_map<std::vector<uint32_t>, uint32_t, StateSetHash> stateIdentifiers;
+	std::vector<const std::vector<uint32_t> *> stateSets;
+	std::deque<uint32_t> pending;
+	const auto addState = [&](const std::vector<uint32_t> &set) -> uint32_t {
+		const auto found = stateIdentifiers.find(set);
+		if (found != stateIdentifiers.end()) {
+			return found->second;
+		}
+		if (stateSets.size() >= kMaximumStateCount) {
+			throw PathPatternError("The path patterns are too complex to compile.");
+		}
+		
+		const uint32_t state = static_cast<uint32_t>(stateSets.size());
+		const auto inserted = stateIdentifiers.insert(std::make_pair(set, state)).first;
+		stateSets.push_back(&inserted->first);
+		_transitions.resize(_transitions.size() + _classCount, kDeadState);
+		
+		Accepts accepts = { 0, 0, 0 };
+		for (size_t i = 0; i < set.size(); ++i) {
+			const NfaState &nfaState = nfa.states[set[i]];
+			if (nfaState.type == NfaState::kAccept) {
+				if (nfaState.acceptsBeneath) {
+					accepts.beneath = std::max(accepts.beneath, nfaState.rule);
+					continue;
+				}
+				accepts.atBoundary = std::max(accepts.atBoundary, nfaState.rule);
+				accepts.beneath = std::max(accepts.beneath, nfaState.rule);
+				if (nfaState.acceptsAnywhere) {
+					accepts.anywhere = std::max(accepts.anywhere, nfaState.rule);
+				}
+			}
+		}
+		_accepts.push_back(accepts);
+		
+		pending.push_back(state);
+		return state;
+	};
+	
+	ClosureBuilder closures(nfa);
+	std::vector<uint32_t> seeds;
+	std::vector<uint32_t> set;
+	addState(set);
+	pending.clear();
+	seeds.push_back(nfaStart);
+	closures.closure(seeds, set);
+	_startState = addState(set);
+	
+	while (!pending.empty()) {
+		const uint32_t state = pending.front();
+		pending.pop_front();
+		
+		for (size_t byteClass = 0; byteClass < _classCount; ++byteClass) {
+			const unsigned char byte = representatives[byteClass];
+			const std::vector<uint32_t> &current = *stateSets[state];
+			seeds.clear();
+			for (size_t i = 0; i < current.size(); ++i) {
+				const NfaState &nfaState = nfa.states[current[i]];
+				if (nfaState.type == NfaState::kByte && nfaState.bytes[byte]) {
+					seeds.push_back(nfaState.next);
+				}
+			}
+			closures.closure(seeds, set);
+			const uint32_t target = addState(set);
+			_transitions[state * _classCount + byteClass] = target;
+		}
+	}
+}
+
+
+#pragma mark Matching
+PathMatch PathMatcher::match(const char *path, size_t length) const
+{
+	if (_accepts.empty()) {
+		return kPathMatchNone;
+	}
+	
+	// A pattern matching an ancestor matches the path too, so the state of
+	// every ancestor is checked before the slash following it, which is also
+	// where the patterns matching only beneath a path accept.
+	const uint32_t *transitions = _transitions.data();
+	const Accepts *accepts = _accepts.data();
+	uint32_t state = _startState;
+	uint32_t rule = accepts[state].anywhere;
+	for (size_t i = 0; i < length && state != kDeadState; ++i) {
+		const unsigned char byte = static_cast<unsigned char>(path[i]);
+		if (byte == '/') {
+			rule = std::max(rule, accepts[state].beneath);
+		}
+		state = transitions[state * _classCount + _byteClasses[byte]];
+		rule = std::max(rule, accepts[state].anywhere);
+	}
+	rule = std::max(rule, accepts[state].atBoundary);
+	
+	return static_cast<PathMatch>(_ruleMatches[rule]);
+}
+
+} // namespace cdevents
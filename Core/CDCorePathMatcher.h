@@ -0,0 +1,149 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCorePathMatcher.h
+ * Glob and regular expression path patterns compiled into one automaton.
+ */
+
+#ifndef CD_CORE_PATH_MATCHER_H
+#define CD_CORE_PATH_MATCHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace cdevents {
+
+/**
+ * Which rule, if any, the last pattern matching a path belongs to.
+ *
+ * @since head
+ */
+enum PathMatch {
+	/** No pattern matches the path. */
+	kPathMatchNone,
+	/** The last pattern matching the path excludes it. */
+	kPathMatchExcluded,
+	/** The last pattern matching the path is negated and includes it again. */
+	kPathMatchIncluded
+};
+
+/**
+ * The exception thrown if a path pattern is malformed.
+ *
+ * @since head
+ */
+class PathPatternError : public std::runtime_error {
+public:
+	explicit PathPatternError(const std::string &reason)
+	:	std::runtime_error(reason)
+	{}
+};
+
+/**
+ * A list of path patterns compiled into a single deterministic automaton.
+ *
+ * Patterns are written much like the lines of a .gitignore file:
+ *
+ * - "*" and "?" match any characters but "/", "[...]" a character class
+ *   ("[!...]" negated) and "\" escapes the next character.
+ * - "**" as a whole component matches zero or more components, so that
+ *   one pattern can match everything in, say, any ".git/objects" directory.
+ * - A pattern starting with "/" is matched against the whole absolute path,
+ *   any other pattern against its trailing components, so "*.o" matches
+ *   every object file and "build/tmp" every "tmp" directory in a "build"
+ *   directory. A trailing "/" is ignored.
+ * - A pattern also matches everything beneath the paths it matches.
+ * - A pattern prefixed with "re:" is an extended regular expression
+ *   searched for anywhere in the absolute path unless anchored with "^" or
+ *   "$". Groups, "|", "*", "+", "?", "{m,n}", "." and character classes
+ *   are supported, back-references are not.
+ * - A pattern prefixed with "!" (before any "re:") includes the paths it
+ *   matches again, and the last pattern matching a path decides.
+ * - A pattern may be prefixed with "glob:" to start with a literal "re:".
+ *
+ * All patterns are compiled up front, so a path is matched against every
+ * one of them in a single pass over its bytes, without allocating.
+ *
+ * @since head
+ */
+class PathMatcher {
+public:
+	/**
+	 * Creates a matcher which matches nothing.
+	 */
+	PathMatcher();
+	
+	/**
+	 * Compiles the given patterns.
+	 *
+	 * @throws PathPatternError if a pattern is malformed or the patterns are too complex to compile.
+	 */
+	explicit PathMatcher(const std::vector<std::string> &patterns);
+	
+	/**
+	 * The patterns the matcher was compiled from.
+	 */
+	const std::vector<std::string> &patterns() const { return _patterns; }
+	
+	/**
+	 * The number of states of the compiled automaton.
+	 */
+	size_t stateCount() const { return _accepts.size(); }
+	
+	/**
+	 * Matches the given standardized path against all the patterns at once.
+	 */
+	PathMatch match(const char *path, size_t length) const;
+	PathMatch match(const std::string &path) const { return match(path.data(), path.size()); }
+	
+private:
+	// The last rules accepting in a state, numbered from one, or zero: at
+	// the end of a path or an ancestor, only before the slash ending an
+	// ancestor (including those of the former) and after any byte.
+	struct Accepts {
+		uint32_t	atBoundary;
+		uint32_t	beneath;
+		uint32_t	anywhere;
+	};
+	
+	std::vector<std::string>	_patterns;
+	std::vector<uint8_t>		_ruleMatches;
+	uint8_t						_byteClasses[256];
+	size_t						_classCount;
+	std::vector<uint32_t>		_transitions;
+	std::vector<Accepts>		_accepts;
+	uint32_t					_startState;
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_PATH_MATCHER_H
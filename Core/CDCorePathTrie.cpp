@@ -0,0 +1,224 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCorePathTrie.h"
+
+#include <string.h>
+
+namespace cdevents {
+
+// The edge table uses open addressing with linear probing and is kept at most
+// half full. An empty slot has a nameLength of zero since components are never
+// empty.
+static const size_t kInitialEdgeCapacity = 16;
+
+const PathTrie::Node PathTrie::kRootNode;
+const PathTrie::Node PathTrie::kNotFound;
+
+PathTrie::PathTrie()
+:	_terminals(1, false),
+	_edges(kInitialEdgeCapacity),
+	_edgeCount(0),
+	_terminalCount(0)
+{
+}
+
+void PathTrie::clear()
+{
+	_terminals.assign(1, false);
+	_edges.assign(kInitialEdgeCapacity, Edge());
+	_names.clear();
+	_edgeCount = 0;
+	_terminalCount = 0;
+}
+
+PathTrie::Node PathTrie::insert(const char *path, size_t length)
+{
+	Node node = kRootNode;
+	
+	size_t offset = 0;
+	const char *name;
+	size_t nameLength;
+	while (nextComponent(path, length, offset, name, nameLength)) {
+		Node next = child(node, name, nameLength);
+		if (next == kNotFound) {
+			next = addChild(node, name, nameLength);
+		}
+		node = next;
+	}
+	
+	if (!_terminals[node]) {
+		_terminals[node] = true;
+		++_terminalCount;
+	}
+	
+	return node;
+}
+
+PathTrie::Node PathTrie::find(const char *path, size_t length) const
+{
+	Node node = kRootNode;
+	
+	size_t offset = 0;
+	const char *name;
+	size_t nameLength;
+	while (nextComponent(path, length, offset, name, nameLength)) {
+		node = child(node, name, nameLength);
+		if (node == kNotFound) {
+			return kNotFound;
+		}
+	}
+	
+	return (_terminals[node] ? node : kNotFound);
+}
+
+PathTrie::Node PathTrie::shortestPrefixOfPath(const char *path, size_t length) const
+{
+	Node found = kNotFound;
+	visitPrefixesOfPath(path, length, [&found](Node node) {
+		if (found == kNotFound) {
+			found = node;
+		}
+	});
+	
+	return found;
+}
+
+PathTrie::Node PathTrie::longestPrefixOfPath(const char *path, size_t length) const
+{
+	Node found = kNotFound;
+	visitPrefixesOfPath(path, length, [&found](Node node) {
+		found = node;
+	});
+	
+	return found;
+}
+
+
+#pragma mark Private
+uint32_t PathTrie::hashComponent(Node parent, const char *name, size_t length)
+{
+	// FNV-1a seeded with the parent node.
+	uint32_t hash = 2166136261u ^ (parent * 0x9E3779B1u);
+	for (size_t i = 0; i < length; ++i) {
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619u;
+	}
+	
+	return hash;
+}
+
+bool PathTrie::nextComponent(const char *path, size_t length, size_t &offset, const char *&name, size_t &nameLength)
+{
+	while (offset < length && path[offset] == '/') {
+		++offset;
+	}
+	if (offset >= length) {
+		return false;
+	}
+	
+	size_t end = offset;
+	while (end < length && path[end] != '/') {
+		++end;
+	}
+	
+	name = path + offset;
+	nameLength = end - offset;
+	offset = end;
+	
+	return true;
+}
+
+PathTrie::Node PathTrie::child(Node parent, const char *name, size_t length) const
+{
+	const uint32_t hash = hashComponent(parent, name, length);
+	const size_t mask = _edges.size() - 1;
+	
+	for (size_t slot = hash & mask; ; slot = (slot + 1) & mask) {
+		const Edge &edge = _edges[slot];
+		if (edge.nameLength == 0) {
+			return kNotFound;
+		}
+		if (edge.hash == hash &&
+			edge.parent == parent &&
+			edge.nameLength == length &&
+			memcmp(_names.data() + edge.nameOffset, name, length) == 0) {
+			return edge.child;
+		}
+	}
+}
+
+PathTrie::Node PathTrie::addChild(Node parent, const char *name, size_t length)
+{
+	if ((_edgeCount + 1) * 2 > _edges.size()) {
+		growEdges();
+	}
+	
+	Edge edge;
+	edge.parent		= parent;
+	edge.child		= (Node)_terminals.size();
+	edge.hash		= hashComponent(parent, name, length);
+	edge.nameOffset	= (uint32_t)_names.size();
+	edge.nameLength	= (uint32_t)length;
+	
+	_names.append(name, length);
+	_terminals.push_back(false);
+	
+	const size_t mask = _edges.size() - 1;
+	size_t slot = edge.hash & mask;
+	while (_edges[slot].nameLength != 0) {
+		slot = (slot + 1) & mask;
+	}
+	_edges[slot] = edge;
+	++_edgeCount;
+	
+	return edge.child;
+}
+
+void PathTrie::growEdges()
+{
+	std::vector<Edge> edges(_edges.size() * 2);
+	const size_t mask = edges.size() - 1;
+	
+	for (size_t i = 0; i < _edges.size(); ++i) {
+		const Edge &edge = _edges[i];
+		if (edge.nameLength == 0) {
+			continue;
+		}
+		
+		size_t slot = edge.hash & mask;
+		while (edges[slot].nameLength != 0) {
+			slot = (slot + 1) & mask;
+		}
+		edges[slot] = edge;
+	}
+	
+	_edges.swap(edges);
+}
+
+} // namespace cdevents
@@ -0,0 +1,177 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCorePathTrie.h
+ * A trie of path components used to match paths against a set of prefixes.
+ */
+
+#ifndef CD_CORE_PATH_TRIE_H
+#define CD_CORE_PATH_TRIE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace cdevents {
+
+/**
+ * A trie of path components.
+ *
+ * Paths are inserted once and then matched without any allocation in time
+ * proportional to the depth of the matched path. Matching happens on
+ * component boundaries only, i.e. the inserted path "/a/b" is a prefix of
+ * "/a/b" and "/a/b/c" but not of "/a/bc". Nodes are identified by index so
+ * that callers can attach their own data to the inserted paths.
+ *
+ * @since head
+ */
+class PathTrie {
+public:
+	/** The type identifying a node of the trie. */
+	typedef uint32_t Node;
+	
+	/** The node of the root directory ("/"). */
+	static const Node kRootNode = 0;
+	/** Returned when no matching node exists. */
+	static const Node kNotFound = 0xFFFFFFFF;
+	
+	PathTrie();
+	
+	/**
+	 * Removes all inserted paths.
+	 */
+	void clear();
+	
+	/**
+	 * Whether no path has been inserted.
+	 */
+	bool empty() const { return (_terminalCount == 0); }
+	
+	/**
+	 * The number of distinct paths inserted.
+	 */
+	size_t count() const { return _terminalCount; }
+	
+	/**
+	 * Inserts the given standardized path and returns its node.
+	 */
+	Node insert(const char *path, size_t length);
+	Node insert(const std::string &path) { return insert(path.data(), path.size()); }
+	
+	/**
+	 * Returns the node of the given path if it has been inserted, otherwise kNotFound.
+	 */
+	Node find(const char *path, size_t length) const;
+	Node find(const std::string &path) const { return find(path.data(), path.size()); }
+	
+	/**
+	 * Returns the node of the shortest inserted path which is equal to or an ancestor of the given path, otherwise kNotFound.
+	 */
+	Node shortestPrefixOfPath(const char *path, size_t length) const;
+	
+	/**
+	 * Returns the node of the longest inserted path which is equal to or an ancestor of the given path, otherwise kNotFound.
+	 */
+	Node longestPrefixOfPath(const char *path, size_t length) const;
+	
+	/**
+	 * Whether any inserted path is equal to or an ancestor of the given path.
+	 */
+	bool containsPrefixOfPath(const char *path, size_t length) const
+	{ return (shortestPrefixOfPath(path, length) != kNotFound); }
+	bool containsPrefixOfPath(const std::string &path) const
+	{ return containsPrefixOfPath(path.data(), path.size()); }
+	
+	/**
+	 * Calls <em>visitor</em> with the node of every inserted path which is equal to or an ancestor of the given path, shortest first.
+	 */
+	template <typename Visitor>
+	void visitPrefixesOfPath(const char *path, size_t length, Visitor visitor) const;
+	
+	/**
+	 * The number of nodes, valid node indexes are [0, nodeCount()).
+	 */
+	size_t nodeCount() const { return _terminals.size(); }
+	
+private:
+	struct Edge {
+		Node		parent;
+		Node		child;
+		uint32_t	hash;
+		uint32_t	nameOffset;
+		uint32_t	nameLength;
+	};
+	
+	static uint32_t hashComponent(Node parent, const char *name, size_t length);
+	static bool nextComponent(const char *path, size_t length, size_t &offset, const char *&name, size_t &nameLength);
+	
+	Node child(Node parent, const char *name, size_t length) const;
+	Node addChild(Node parent, const char *name, size_t length);
+	void growEdges();
+	
+	std::vector<bool>	_terminals;
+	std::vector<Edge>	_edges;
+	std::string			_names;
+	size_t				_edgeCount;
+	size_t				_terminalCount;
+};
+
+
+#pragma mark -
+#pragma mark Template implementation
+template <typename Visitor>
+void PathTrie::visitPrefixesOfPath(const char *path, size_t length, Visitor visitor) const
+{
+	if (_terminalCount == 0) {
+		return;
+	}
+	
+	Node node = kRootNode;
+	if (_terminals[node]) {
+		visitor(node);
+	}
+	
+	size_t offset = 0;
+	const char *name;
+	size_t nameLength;
+	while (nextComponent(path, length, offset, name, nameLength)) {
+		node = child(node, name, nameLength);
+		if (node == kNotFound) {
+			return;
+		}
+		if (_terminals[node]) {
+			visitor(node);
+		}
+	}
+}
+
+} // namespace cdevents
+
+#endif // CD_CORE_PATH_TRIE_H
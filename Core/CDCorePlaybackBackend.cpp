@@ -0,0 +1,181 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCorePlaybackBackend.h"
+
+#include <chrono>
+#include <sstream>
+
+namespace cdevents {
+
+#pragma mark Init/dealloc
+PlaybackBackend::PlaybackBackend(const std::string &file, double speed)
+:	_file(file),
+	_speed(speed),
+	_stopping(false),
+	_delivering(false),
+	_finished(true),
+	_currentEventIdentifier(0),
+	_batchCount(0)
+{
+}
+
+PlaybackBackend::~PlaybackBackend()
+{
+	stop();
+}
+
+
+#pragma mark Backend
+void PlaybackBackend::start(const StreamConfiguration &configuration, const BackendHandler &handler)
+{
+	stop();
+	
+	if (!_reader.open(_file)) {
+		throw StreamCreationFailure("Failed to open the event log \"" + _file + "\".");
+	}
+	
+	std::lock_guard<std::mutex> lock(_mutex);
+	_configuration	= configuration;
+	_handler		= handler;
+	_stopping		= false;
+	_finished		= false;
+	_batchCount.store(0);
+	_thread = std::thread(&PlaybackBackend::run, this);
+}
+
+void PlaybackBackend::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+		_condition.notify_all();
+	}
+	
+	if (_thread.joinable()) {
+		_thread.join();
+	}
+	_reader.close();
+}
+
+void PlaybackBackend::setNotificationLatency(double latency)
+{
+	// The batches keep the boundaries they were recorded with.
+	std::lock_guard<std::mutex> lock(_mutex);
+	_configuration.notificationLatency = latency;
+}
+
+void PlaybackBackend::setWatchedPaths(const std::vector<std::string> &paths)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_configuration.watchedPaths = paths;
+}
+
+void PlaybackBackend::flushSynchronously()
+{
+	// Every batch is reported as soon as it is due, so at most the one being
+	// reported has not been delivered yet.
+	std::unique_lock<std::mutex> lock(_mutex);
+	_condition.wait(lock, [this]() {
+		return !_delivering;
+	});
+}
+
+void PlaybackBackend::flushAsynchronously()
+{
+}
+
+EventIdentifier PlaybackBackend::currentEventIdentifier() const
+{
+	return _currentEventIdentifier.load();
+}
+
+std::string PlaybackBackend::description() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::ostringstream description;
+	description << "PlaybackBackend { file = " << _file
+				<< ", speed = " << _speed
+				<< ", latency = " << _configuration.notificationLatency
+				<< ", batches = " << _batchCount.load() << " }";
+	
+	return description.str();
+}
+
+
+#pragma mark Playback
+void PlaybackBackend::waitUntilFinished()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_condition.wait(lock, [this]() {
+		return (_finished || _stopping);
+	});
+}
+
+void PlaybackBackend::run()
+{
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+	EventLogBatch batch;
+	
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (!_stopping) {
+		lock.unlock();
+		const bool read = _reader.read(batch);
+		lock.lock();
+		if (!read) {
+			break;
+		}
+		
+		if (_speed > 0.0) {
+			const std::chrono::nanoseconds offset((int64_t)((double)batch.time / _speed));
+			_condition.wait_until(lock, startTime + offset, [this]() {
+				return _stopping;
+			});
+			if (_stopping) {
+				break;
+			}
+		}
+		if (batch.events.empty()) {
+			continue;
+		}
+		
+		_delivering = true;
+		lock.unlock();
+		_handler(batch.events.data(), batch.events.size());
+		_currentEventIdentifier.store(batch.events.back().identifier);
+		++_batchCount;
+		lock.lock();
+		_delivering = false;
+		_condition.notify_all();
+	}
+	
+	_finished = true;
+	_condition.notify_all();
+}
+
+} // namespace cdevents
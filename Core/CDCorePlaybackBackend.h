@@ -0,0 +1,121 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCorePlaybackBackend.h
+ * A backend which plays back a log written by EventRecorder.
+ */
+
+#ifndef CD_CORE_PLAYBACK_BACKEND_H
+#define CD_CORE_PLAYBACK_BACKEND_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CDCoreBackend.h"
+#include "CDCoreEventLog.h"
+
+namespace cdevents {
+
+/**
+ * A backend which reports the batches of an event log instead of watching the file system.
+ *
+ * The batches are reported on a thread of the backend, exactly as they were
+ * recorded, so that they go through the same filtering and delivery as live
+ * events: at the pace they were recorded at, scaled by the speed, or as fast
+ * as the stream takes them. The watched paths, latency and flags of the
+ * stream do not change what is reported, and the log is played once.
+ *
+ * Use it to reproduce a recorded event storm, or to benchmark the filtering
+ * and delivery of a stream, without touching the file system.
+ *
+ * @see EventRecorder
+ *
+ * @since head
+ */
+class PlaybackBackend : public Backend {
+public:
+	/**
+	 * Returns a backend playing back the log at the given path, <em>speed</em> times as fast as it was recorded or, with a speed of 0, as fast as possible.
+	 */
+	explicit PlaybackBackend(const std::string &file, double speed = 1.0);
+	virtual ~PlaybackBackend();
+	
+	/**
+	 * Opens the log and starts playing it back.
+	 *
+	 * @throws StreamCreationFailure if the log could not be opened.
+	 */
+	virtual void start(const StreamConfiguration &configuration, const BackendHandler &handler);
+	virtual void stop();
+	virtual void setNotificationLatency(double latency);
+	virtual void setWatchedPaths(const std::vector<std::string> &paths);
+	virtual void flushSynchronously();
+	virtual void flushAsynchronously();
+	virtual EventIdentifier currentEventIdentifier() const;
+	virtual std::string description() const;
+	
+	/**
+	 * Waits until the whole log has been played back, or the backend stopped. Must not be called from within the handler.
+	 */
+	void waitUntilFinished();
+	
+	/**
+	 * The number of batches played back so far.
+	 */
+	uint64_t batchCount() const { return _batchCount.load(); }
+	
+private:
+	PlaybackBackend(const PlaybackBackend &);
+	PlaybackBackend &operator=(const PlaybackBackend &);
+	
+	void run();
+	
+	const std::string				_file;
+	const double					_speed;
+	StreamConfiguration				_configuration;
+	BackendHandler					_handler;
+	EventLogReader					_reader;
+	std::thread						_thread;
+	
+	mutable std::mutex				_mutex;
+	std::condition_variable			_condition;
+	bool							_stopping;
+	bool							_delivering;
+	bool							_finished;
+	std::atomic<EventIdentifier>	_currentEventIdentifier;
+	std::atomic<uint64_t>			_batchCount;
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_PLAYBACK_BACKEND_H
@@ -0,0 +1,392 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCorePollingBackend.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+
+namespace cdevents {
+
+#pragma mark Constants
+static const char kWakeCommandStop	= 's';
+static const char kWakeCommandFlush	= 'f';
+static const char kWakeCommandPaths	= 'p';
+
+// The kernel interfaces have no event identifiers, so they are handed out
+// process wide in the order events are read.
+static std::atomic<EventIdentifier> sCurrentEventIdentifier(0);
+
+
+#pragma mark Init/dealloc
+PollingBackend::PollingBackend()
+:	_eventDescriptor(-1),
+	_flushesRequested(0),
+	_flushesCompleted(0),
+	_watchedPathChangesRequested(0),
+	_watchedPathChangesApplied(0),
+	_running(false)
+{
+	_wakeDescriptors[0] = -1;
+	_wakeDescriptors[1] = -1;
+}
+
+PollingBackend::~PollingBackend()
+{
+}
+
+
+#pragma mark Backend
+void PollingBackend::start(const StreamConfiguration &configuration, const BackendHandler &handler)
+{
+	_configuration	= configuration;
+	_handler		= handler;
+	
+	if (pipe2(_wakeDescriptors, O_NONBLOCK | O_CLOEXEC) != 0) {
+		throw StreamCreationFailure(std::string("pipe2 failed: ") + strerror(errno));
+	}
+	
+	try {
+		openEventSource();
+	} catch (...) {
+		stop();
+		throw;
+	}
+	
+	// There is no history to replay, tell the client to rescan instead.
+	if (_configuration.sinceEventIdentifier != kEventIdentifierSinceNow &&
+		!_configuration.watchedPaths.empty()) {
+		addRescanEvents(kEventFlagNone);
+		if (!_configuration.resumesEarlierStream) {
+			addEvent(_configuration.watchedPaths[0], kEventFlagHistoryDone);
+		}
+		_deadline = std::chrono::steady_clock::now();
+	}
+	
+	_running = true;
+	_thread = std::thread(&PollingBackend::run, this);
+}
+
+void PollingBackend::stop()
+{
+	if (_thread.joinable()) {
+		wake(kWakeCommandStop);
+		_thread.join();
+	}
+	
+	{
+		std::lock_guard<std::mutex> lock(_flushMutex);
+		_running = false;
+	}
+	_flushCondition.notify_all();
+	
+	closeEventSource();
+	if (_eventDescriptor >= 0) {
+		close(_eventDescriptor);
+		_eventDescriptor = -1;
+	}
+	for (int i = 0; i < 2; ++i) {
+		if (_wakeDescriptors[i] >= 0) {
+			close(_wakeDescriptors[i]);
+			_wakeDescriptors[i] = -1;
+		}
+	}
+	
+	_pendingPaths.clear();
+	_pendingEvents.clear();
+}
+
+void PollingBackend::setNotificationLatency(double latency)
+{
+	// Called on the backend thread, the next batch waits for the new latency.
+	_configuration.notificationLatency = latency;
+}
+
+void PollingBackend::setWatchedPaths(const std::vector<std::string> &paths)
+{
+	if (!_thread.joinable() || std::this_thread::get_id() == _thread.get_id()) {
+		applyWatchedPaths(paths);
+		return;
+	}
+	
+	// Applied on the backend thread, which owns the watches, before returning.
+	std::unique_lock<std::mutex> lock(_flushMutex);
+	_requestedWatchedPaths = paths;
+	const uint64_t ticket = ++_watchedPathChangesRequested;
+	wake(kWakeCommandPaths);
+	_flushCondition.wait(lock, [this, ticket]() {
+		return (_watchedPathChangesApplied >= ticket || !_running);
+	});
+}
+
+void PollingBackend::flushSynchronously()
+{
+	// Flushing from within the handler would wait for ourselves.
+	if (!_thread.joinable() || std::this_thread::get_id() == _thread.get_id()) {
+		return;
+	}
+	
+	std::unique_lock<std::mutex> lock(_flushMutex);
+	const uint64_t ticket = ++_flushesRequested;
+	wake(kWakeCommandFlush);
+	_flushCondition.wait(lock, [this, ticket]() {
+		return (_flushesCompleted >= ticket || !_running);
+	});
+}
+
+void PollingBackend::flushAsynchronously()
+{
+	if (_thread.joinable()) {
+		wake(kWakeCommandFlush);
+	}
+}
+
+EventIdentifier PollingBackend::currentEventIdentifier() const
+{
+	return sCurrentEventIdentifier.load();
+}
+
+
+#pragma mark Pending events
+void PollingBackend::addEvent(const std::string &path, EventFlags flags, EventIdentifier identifier, uint64_t renameCookie)
+{
+	if (_pendingEvents.empty()) {
+		_deadline = (std::chrono::steady_clock::now() +
+					 std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+						std::chrono::duration<double>(_configuration.notificationLatency)));
+	}
+	
+	PendingEvent event;
+	event.pathOffset	= _pendingPaths.size();
+	event.pathLength	= path.size();
+	event.flags			= flags;
+	event.identifier	= identifier;
+	event.renameCookie	= renameCookie;
+	
+	_pendingPaths.append(path);
+	_pendingEvents.push_back(event);
+}
+
+void PollingBackend::addItemEvent(const std::string &directory, const std::string &path, EventFlags flags, uint64_t renameCookie)
+{
+	if (_configuration.creationFlags & kStreamCreationFlagFileEvents) {
+		addEvent(path, flags, nextEventIdentifier(), renameCookie);
+		return;
+	}
+	
+	// Without file-level events only the containing directory is reported,
+	// coalesced with the previous event if it concerned the same directory.
+	if (!_pendingEvents.empty()) {
+		const PendingEvent &last = _pendingEvents.back();
+		if (last.flags == kEventFlagNone &&
+			last.pathLength == directory.size() &&
+			_pendingPaths.compare(last.pathOffset, last.pathLength, directory) == 0) {
+			return;
+		}
+	}
+	addEvent(directory, kEventFlagNone);
+}
+
+void PollingBackend::addRescanEvents(EventFlags flags)
+{
+	for (size_t i = 0; i < _configuration.watchedPaths.size(); ++i) {
+		addEvent(_configuration.watchedPaths[i], (kEventFlagMustScanSubDirs | flags));
+	}
+}
+
+bool PollingBackend::isWatchedPath(const std::string &path) const
+{
+	for (size_t i = 0; i < _configuration.watchedPaths.size(); ++i) {
+		if (_configuration.watchedPaths[i] == path) {
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+EventIdentifier PollingBackend::nextEventIdentifier()
+{
+	return ++sCurrentEventIdentifier;
+}
+
+
+#pragma mark Event loop
+void PollingBackend::run()
+{
+	struct pollfd descriptors[2];
+	descriptors[0].fd		= _eventDescriptor;
+	descriptors[0].events	= POLLIN;
+	descriptors[1].fd		= _wakeDescriptors[0];
+	descriptors[1].events	= POLLIN;
+	
+	bool running = true;
+	while (running) {
+		int timeout = -1;
+		if (!_pendingEvents.empty()) {
+			const std::chrono::steady_clock::duration remaining = _deadline - std::chrono::steady_clock::now();
+			const long long milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count();
+			timeout = (int)(milliseconds > 0 ? milliseconds + 1 : 0);
+		}
+		
+		descriptors[0].revents = 0;
+		descriptors[1].revents = 0;
+		if (poll(descriptors, 2, timeout) < 0 && errno != EINTR) {
+			break;
+		}
+		
+		bool flush = false;
+		bool changePaths = false;
+		uint64_t flushTicket = 0;
+		if (descriptors[1].revents & POLLIN) {
+			char commands[64];
+			ssize_t count;
+			while ((count = read(_wakeDescriptors[0], commands, sizeof(commands))) > 0) {
+				for (ssize_t i = 0; i < count; ++i) {
+					if (commands[i] == kWakeCommandStop) {
+						running = false;
+					} else if (commands[i] == kWakeCommandFlush) {
+						flush = true;
+					} else if (commands[i] == kWakeCommandPaths) {
+						changePaths = true;
+					}
+				}
+			}
+			if (flush) {
+				std::lock_guard<std::mutex> lock(_flushMutex);
+				flushTicket = _flushesRequested;
+			}
+		}
+		
+		if (changePaths) {
+			// What happened before the change is read with the old watches.
+			readEvents();
+			
+			// Requests made in the meantime are applied at once, the last one wins.
+			std::vector<std::string> paths;
+			uint64_t ticket;
+			{
+				std::lock_guard<std::mutex> lock(_flushMutex);
+				paths.swap(_requestedWatchedPaths);
+				ticket = _watchedPathChangesRequested;
+				changePaths = (ticket > _watchedPathChangesApplied);
+			}
+			if (changePaths) {
+				applyWatchedPaths(paths);
+				{
+					std::lock_guard<std::mutex> lock(_flushMutex);
+					_watchedPathChangesApplied = ticket;
+				}
+				_flushCondition.notify_all();
+			}
+		}
+		
+		if (flush || (descriptors[0].revents & POLLIN)) {
+			readEvents();
+		}
+		
+		if (!_pendingEvents.empty() &&
+			(flush || std::chrono::steady_clock::now() >= _deadline)) {
+			deliverEvents();
+		}
+		
+		if (flush) {
+			{
+				std::lock_guard<std::mutex> lock(_flushMutex);
+				if (_flushesCompleted < flushTicket) {
+					_flushesCompleted = flushTicket;
+				}
+			}
+			_flushCondition.notify_all();
+		}
+	}
+	
+	// Only a failed poll() ends the loop while running. Nothing more will be
+	// delivered then, so the client is told what it missed, and whoever waits
+	// for a flush or a change of the watched paths goes on.
+	if (running) {
+		addRescanEvents(kEventFlagKernelDropped);
+		if (!_pendingEvents.empty()) {
+			deliverEvents();
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(_flushMutex);
+		_running = false;
+	}
+	_flushCondition.notify_all();
+}
+
+void PollingBackend::deliverEvents()
+{
+	willDeliverEvents();
+	
+	_rawEvents.resize(_pendingEvents.size());
+	for (size_t i = 0; i < _pendingEvents.size(); ++i) {
+		const PendingEvent &pending = _pendingEvents[i];
+		RawEvent &event = _rawEvents[i];
+		event.path			= _pendingPaths.data() + pending.pathOffset;
+		event.pathLength	= pending.pathLength;
+		event.flags			= pending.flags;
+		event.identifier	= pending.identifier;
+		event.renameCookie	= pending.renameCookie;
+	}
+	
+	_handler(_rawEvents.data(), _rawEvents.size());
+	
+	_pendingEvents.clear();
+	_pendingPaths.clear();
+}
+
+void PollingBackend::applyWatchedPaths(const std::vector<std::string> &paths)
+{
+	const std::vector<std::string> previous(_configuration.watchedPaths);
+	_configuration.watchedPaths = paths;
+	if (_eventDescriptor >= 0) {
+		watchedPathsChanged(previous);
+	}
+}
+
+void PollingBackend::wake(char command)
+{
+	if (_wakeDescriptors[1] >= 0) {
+		while (write(_wakeDescriptors[1], &command, 1) < 0 && errno == EINTR) {
+		}
+	}
+}
+
+} // namespace cdevents
+
+#endif // defined(__linux__)
@@ -0,0 +1,191 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCorePollingBackend.h
+ * The base of backends which read events from a kernel descriptor on a thread of their own.
+ */
+
+#ifndef CD_CORE_POLLING_BACKEND_H
+#define CD_CORE_POLLING_BACKEND_H
+
+#if defined(__linux__)
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CDCoreBackend.h"
+
+namespace cdevents {
+
+/**
+ * A backend which polls a kernel descriptor on a thread owned by the backend.
+ *
+ * Subclasses open the kernel event source and translate what they read into
+ * pending events with addEvent(); the polling backend batches the pending
+ * events for the notification latency, delivers them on its thread and takes
+ * care of flushing and stopping.
+ *
+ * Event identifiers are assigned by the process in the order events are read,
+ * since the kernel interfaces have none. There is no event history, so if a
+ * stream asks for events since an earlier identifier every watched path is
+ * reported with kEventFlagMustScanSubDirs followed by kEventFlagHistoryDone.
+ * If polling fails, every watched path is reported with
+ * kEventFlagMustScanSubDirs and kEventFlagKernelDropped, and nothing more.
+ *
+ * @note Subclasses must call stop() in their destructor.
+ *
+ * @since head
+ */
+class PollingBackend : public Backend {
+public:
+	virtual ~PollingBackend();
+	
+	virtual void start(const StreamConfiguration &configuration, const BackendHandler &handler);
+	virtual void stop();
+	virtual void setNotificationLatency(double latency);
+	virtual void setWatchedPaths(const std::vector<std::string> &paths);
+	virtual void flushSynchronously();
+	virtual void flushAsynchronously();
+	virtual EventIdentifier currentEventIdentifier() const;
+	
+protected:
+	PollingBackend();
+	
+	/**
+	 * Opens the kernel event source and stores its non-blocking descriptor in _eventDescriptor.
+	 *
+	 * @throws StreamCreationFailure if the event source could not be opened.
+	 */
+	virtual void openEventSource() = 0;
+	
+	/**
+	 * Reads all events currently available from the event source.
+	 */
+	virtual void readEvents() = 0;
+	
+	/**
+	 * Called on the backend thread right before the pending events are delivered.
+	 */
+	virtual void willDeliverEvents() {}
+	
+	/**
+	 * Called on the backend thread once _configuration holds the new watched paths, to watch them instead of <em>previous</em>.
+	 */
+	virtual void watchedPathsChanged(const std::vector<std::string> &previous) = 0;
+	
+	/**
+	 * Releases anything associated with the event source, the descriptor itself is closed by the polling backend.
+	 */
+	virtual void closeEventSource() = 0;
+	
+	/**
+	 * Adds an event to the pending batch.
+	 */
+	void addEvent(const std::string &path, EventFlags flags, EventIdentifier identifier, uint64_t renameCookie = 0);
+	void addEvent(const std::string &path, EventFlags flags) { addEvent(path, flags, nextEventIdentifier()); }
+	
+	/**
+	 * Adds an item-level event, or a generic change of <em>directory</em> if the stream did not ask for file-level events.
+	 *
+	 * @param renameCookie The same for both halves of a rename, 0 if unknown, see RawEvent.
+	 */
+	void addItemEvent(const std::string &directory, const std::string &path, EventFlags flags, uint64_t renameCookie = 0);
+	
+	/**
+	 * Adds a kEventFlagMustScanSubDirs event with the given extra flags for every watched path.
+	 */
+	void addRescanEvents(EventFlags flags);
+	
+	/**
+	 * Whether the path is one of the watched paths.
+	 */
+	bool isWatchedPath(const std::string &path) const;
+	
+	/**
+	 * Returns a new, process wide unique, event identifier.
+	 */
+	static EventIdentifier nextEventIdentifier();
+	
+	/**
+	 * The configuration the backend was started with.
+	 */
+	StreamConfiguration								_configuration;
+	
+	/**
+	 * The descriptor of the kernel event source, or -1.
+	 */
+	int												_eventDescriptor;
+	
+private:
+	struct PendingEvent {
+		size_t			pathOffset;
+		size_t			pathLength;
+		EventFlags		flags;
+		EventIdentifier	identifier;
+		uint64_t		renameCookie;
+	};
+	
+	PollingBackend(const PollingBackend &);
+	PollingBackend &operator=(const PollingBackend &);
+	
+	void run();
+	void deliverEvents();
+	void applyWatchedPaths(const std::vector<std::string> &paths);
+	void wake(char command);
+	
+	BackendHandler									_handler;
+	int												_wakeDescriptors[2];
+	std::thread										_thread;
+	
+	std::string										_pendingPaths;
+	std::vector<PendingEvent>						_pendingEvents;
+	std::vector<RawEvent>							_rawEvents;
+	std::chrono::steady_clock::time_point			_deadline;
+	
+	// Guards the requests handed to the backend thread.
+	std::mutex										_flushMutex;
+	std::condition_variable							_flushCondition;
+	uint64_t										_flushesRequested;
+	uint64_t										_flushesCompleted;
+	std::vector<std::string>						_requestedWatchedPaths;
+	uint64_t										_watchedPathChangesRequested;
+	uint64_t										_watchedPathChangesApplied;
+	bool											_running;
+};
+
+} // namespace cdevents
+
+#endif // defined(__linux__)
+
+#endif // CD_CORE_POLLING_BACKEND_H
@@ -0,0 +1,177 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreRingBuffer.h
+ * A bounded, lock-free queue between one producer and one consumer thread.
+ */
+
+#ifndef CD_CORE_RING_BUFFER_H
+#define CD_CORE_RING_BUFFER_H
+
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+
+namespace cdevents {
+
+/**
+ * A fixed capacity queue of small, trivially copyable values, such as
+ * pointers, shared by exactly one producer and one consumer thread.
+ *
+ * Neither side ever takes a lock or waits for the other. Besides pushing,
+ * the producer may discard the oldest value to make room for a new one; the
+ * consumer then simply never gets it. The capacity is rounded up to a power
+ * of two, and the indexes of the two sides are kept on separate cache lines.
+ *
+ * @since head
+ */
+template <typename T>
+class RingBuffer {
+public:
+	/**
+	 * Returns an empty ring with room for at least <em>capacity</em> (at least one) values.
+	 */
+	explicit RingBuffer(size_t capacity);
+	
+	/**
+	 * The number of values the ring can hold.
+	 */
+	size_t capacity() const { return _mask + 1; }
+	
+	/**
+	 * The number of values in the ring. Exact only when called by one of its two sides while the other is idle.
+	 */
+	size_t size() const;
+	
+	bool empty() const { return (size() == 0); }
+	
+	/** @name Producer */
+	/**
+	 * Appends the value, returns <code>false</code> if the ring is full.
+	 */
+	bool push(const T &value);
+	
+	/**
+	 * Removes the oldest value into <em>value</em>, returns <code>false</code> if the ring is empty.
+	 */
+	bool discardOldest(T &value);
+	
+	/** @name Consumer */
+	/**
+	 * Removes the oldest value into <em>value</em>, returns <code>false</code> if the ring is empty.
+	 */
+	bool pop(T &value);
+	
+private:
+	RingBuffer(const RingBuffer &);
+	RingBuffer &operator=(const RingBuffer &);
+	
+	// Padding keeping the two indexes off each other's cache line.
+	static const size_t kCacheLineSize = 64;
+	
+	std::unique_ptr<std::atomic<T>[]>	_slots;
+	size_t								_mask;
+	char								_padding0[kCacheLineSize];
+	// The next value to remove. Advanced by the consumer, and by the
+	// producer when it discards, so it is only ever compared and swapped.
+	std::atomic<size_t>					_head;
+	char								_padding1[kCacheLineSize - sizeof(std::atomic<size_t>)];
+	// The next slot to fill, only written by the producer.
+	std::atomic<size_t>					_tail;
+	char								_padding2[kCacheLineSize - sizeof(std::atomic<size_t>)];
+};
+
+
+#pragma mark -
+#pragma mark Template implementation
+template <typename T>
+RingBuffer<T>::RingBuffer(size_t capacity)
+:	_mask(0),
+	_head(0),
+	_tail(0)
+{
+	size_t size = 1;
+	while (size < capacity) {
+		size <<= 1;
+	}
+	_mask = size - 1;
+	_slots.reset(new std::atomic<T>[size]);
+}
+
+template <typename T>
+size_t RingBuffer<T>::size() const
+{
+	const size_t head = _head.load();
+	const size_t tail = _tail.load();
+	
+	return (tail >= head ? tail - head : 0);
+}
+
+template <typename T>
+bool RingBuffer<T>::push(const T &value)
+{
+	const size_t tail = _tail.load(std::memory_order_relaxed);
+	if (tail - _head.load() > _mask) {
+		return false;
+	}
+	
+	_slots[tail & _mask].store(value, std::memory_order_relaxed);
+	_tail.store(tail + 1);
+	return true;
+}
+
+template <typename T>
+bool RingBuffer<T>::discardOldest(T &value)
+{
+	// Races the consumer for the oldest value, see pop().
+	return pop(value);
+}
+
+template <typename T>
+bool RingBuffer<T>::pop(T &value)
+{
+	size_t head = _head.load();
+	for (;;) {
+		if (head == _tail.load()) {
+			return false;
+		}
+		
+		// The slot is read before it is claimed. If the other side claimed it
+		// first, the producer may already be refilling it and the value read
+		// is thrown away.
+		value = _slots[head & _mask].load(std::memory_order_relaxed);
+		if (_head.compare_exchange_weak(head, head + 1)) {
+			return true;
+		}
+	}
+}
+
+} // namespace cdevents
+
+#endif // CD_CORE_RING_BUFFER_H
@@ -0,0 +1,1022 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreStream.h"
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <utility>
+
+#include "CDCoreAdaptiveLatency.h"
+#include "CDCoreCheckpointStore.h"
+#include "CDCoreContentVerifier.h"
+#include "CDCoreDirectorySnapshot.h"
+#include "CDCoreEventCoalescer.h"
+#include "CDCoreEventLog.h"
+#include "CDCoreFileIdentityTracker.h"
+#include "CDCoreMetrics.h"
+#include "CDCorePath.h"
+#include "CDCoreTreeWalker.h"
+#include "CDCoreWorkerPool.h"
+
+namespace cdevents {
+
+#pragma mark Constants
+// Events telling the client that it has missed events and must rescan.
+static const EventFlags kRescanFlags = (kEventFlagMustScanSubDirs | kEventFlagUserDropped | kEventFlagKernelDropped);
+
+// Events telling the client what happened to one item.
+static const EventFlags kItemFlags = (kEventFlagItemCreated | kEventFlagItemRemoved | kEventFlagItemInodeMetaMod |
+									  kEventFlagItemRenamed | kEventFlagItemModified | kEventFlagItemFinderInfoMod |
+									  kEventFlagItemChangeOwner | kEventFlagItemXattrMod);
+
+// The kind of item an event is for.
+static const EventFlags kItemKindFlags = (kEventFlagItemIsFile | kEventFlagItemIsDir | kEventFlagItemIsSymlink);
+
+// Events about the stream or a whole tree rather than one item.
+static const EventFlags kStreamFlags = (kRescanFlags | kEventFlagEventIdsWrapped | kEventFlagHistoryDone |
+										kEventFlagRootChanged | kEventFlagMount | kEventFlagUnmount);
+
+// The number of events a rescan reports at a time.
+static const size_t kRescanBatchSize = 1024;
+
+
+#pragma mark Helpers
+static void recordFlags(StreamMetrics &metrics, EventFlags flags)
+{
+	if (flags & (kEventFlagUserDropped | kEventFlagKernelDropped)) {
+		metrics.add(kMetricsCounterDroppedEventReports, 1);
+	}
+	if (flags & kEventFlagMustScanSubDirs) {
+		metrics.add(kMetricsCounterRescanRequests, 1);
+	}
+}
+
+static bool isRenameHalf(const RawEvent &event)
+{
+	return ((event.flags & kEventFlagItemRenamed) && !(event.flags & kStreamFlags));
+}
+
+// Whether the second event is the other half of the rename of the first,
+// and if so whether it is the destination. The halves share a cookie or, if
+// the backend has none, exactly one of their paths still exists: the
+// destination, which must then have the identity last seen at the source,
+// if the tracker remembers one, or else follow the source immediately.
+static bool isRenamePair(const RawEvent &first, const char *firstPath, const RawEvent &second, const std::string &secondPath,
+						 const FileIdentityTracker *identityTracker, std::string &sourcePath, bool &secondIsDestination)
+{
+	if (!isRenameHalf(second) || (first.flags & kItemKindFlags) != (second.flags & kItemKindFlags)) {
+		return false;
+	}
+	if (first.renameCookie != 0 || second.renameCookie != 0) {
+		secondIsDestination = true;
+		return (first.renameCookie == second.renameCookie);
+	}
+	
+	struct stat firstStatus;
+	struct stat secondStatus;
+	const bool firstExists = (lstat(firstPath, &firstStatus) == 0);
+	const bool secondExists = (lstat(secondPath.c_str(), &secondStatus) == 0);
+	if (!firstExists && !secondExists) {
+		return false;
+	}
+	secondIsDestination = !(firstExists && !secondExists);
+	
+	if (identityTracker && firstExists != secondExists) {
+		sourcePath.assign(secondIsDestination ? firstPath : secondPath.c_str());
+		const FileIdentity identity = identityTracker->rememberedIdentity(sourcePath);
+		if (identity.isKnown()) {
+			const struct stat &destination = (secondIsDestination ? secondStatus : firstStatus);
+			return (identity == FileIdentity(destination.st_dev, destination.st_ino));
+		}
+	}
+	
+	return (second.identifier == first.identifier + 1);
+}
+
+
+// A batch copied off the backend thread, owned by the stream and reused,
+// along with the buffers its delivery reuses.
+struct Stream::DeliveryJob {
+	std::string				paths;
+	std::vector<RawEvent>	events;
+	std::string				path;
+	std::string				renameSourcePath;
+	EventBatch				batch;
+	EventBatch				trackedBatch;
+	EventCoalescer			coalescer;
+	EventBatch				coalescedBatch;
+	EventBatch				verifiedBatch;
+	uint64_t				sequence;
+	uint64_t				queuedTime;
+	// For a rescan, the last batch held before it which it makes up for.
+	uint64_t				compensatedSequence;
+};
+
+#pragma mark Init/dealloc
+Stream::Stream(std::unique_ptr<Backend> backend,
+			   const StreamConfiguration &configuration,
+			   const EventsHandler &handler)
+:	_backend(std::move(backend)),
+	_configuration(configuration),
+	_handler(handler),
+	_lastEventIdentifier(kEventIdentifierSinceNow),
+	_created(false),
+	_notificationLatency(0.0),
+	_backendJob(new DeliveryJob()),
+	_resumedWithoutHistory(false),
+	_batchSequence(0),
+	_checkpointedSequence(0),
+	_producerWaiting(false),
+	_consumerWaiting(false),
+	_consumerBusy(false),
+	_stoppingDelivery(false),
+	_rescanSequence(0),
+	_lastQueuedSequence(0),
+	_maximumQueueDepth(0),
+	_queuedBatches(0),
+	_blockedBatches(0),
+	_droppedBatches(0),
+	_droppedEvents(0),
+	_overflowRescans(0)
+{
+	for (size_t i = 0; i < _configuration.watchedPaths.size(); ++i) {
+		standardizePath(_configuration.watchedPaths[i]);
+	}
+	
+	std::shared_ptr<Filter> filter(new Filter());
+	filter->setWatchedPaths(_configuration.watchedPaths);
+	filter->setExcludedPaths(_configuration.excludedPaths);
+	filter->setPathPatterns(_configuration.pathPatterns);
+	filter->setIgnoreEventsFromSubDirectories(_configuration.ignoreEventsFromSubDirectories);
+	if (_configuration.honorsIgnoreFiles) {
+		filter->setIgnoreFiles(std::make_shared<IgnoreFileCache>());
+	}
+	_filter = filter;
+	_walker = createWalker(_configuration.excludedPaths);
+	
+	// Events can only be merged with those delivered in the same batch.
+	if (_configuration.coalescingWindow > _configuration.notificationLatency) {
+		_configuration.notificationLatency = _configuration.coalescingWindow;
+	}
+	if (_configuration.minimumNotificationLatency > 0.0 &&
+		_configuration.minimumNotificationLatency < _configuration.coalescingWindow) {
+		_configuration.minimumNotificationLatency = _configuration.coalescingWindow;
+	}
+	if (_configuration.minimumNotificationLatency > 0.0 &&
+		_configuration.minimumNotificationLatency < _configuration.notificationLatency) {
+		_adaptiveLatency.reset(new AdaptiveLatency(_configuration.minimumNotificationLatency,
+												   _configuration.notificationLatency));
+	}
+	_notificationLatency.store(_configuration.notificationLatency);
+	
+	if (_configuration.deliveryThreadCount > 0) {
+		_ring.reset(new RingBuffer<DeliveryJob *>(_configuration.deliveryQueueCapacity));
+		if (_configuration.deliveryThreadCount > 1) {
+			_workers.reset(new WorkerPool(_configuration.deliveryThreadCount, _configuration.deliveryQueueCapacity));
+		}
+		_deliveryThread = std::thread(&Stream::runDeliveryThread, this);
+	}
+}
+
+Stream::~Stream()
+{
+	stopRescan();
+	dispose();
+	
+	if (_deliveryThread.joinable()) {
+		_stoppingDelivery.store(true);
+		wakeDeliveryWaiters();
+		_deliveryThread.join();
+	}
+}
+
+
+#pragma mark Stream lifecycle
+void Stream::create()
+{
+	if (_created) {
+		return;
+	}
+	
+	_batchSequence = 0;
+	_checkpointedSequence = 0;
+	_heldSequences.clear();
+	_finishedBatches.clear();
+	if (_configuration.checkpointStore) {
+		resumeFromCheckpoint();
+	}
+	if (_configuration.snapshot && _configuration.snapshot->empty()) {
+		const std::shared_ptr<const TreeWalker> walker = this->walker();
+		for (size_t i = 0; i < _configuration.watchedPaths.size(); ++i) {
+			_configuration.snapshot->rescan(_configuration.watchedPaths[i], true, *walker, DirectorySnapshot::ChangeHandler());
+		}
+	}
+	
+	// An adapted latency carries over to the backend of a recreated stream.
+	StreamConfiguration configuration = _configuration;
+	if (_adaptiveLatency) {
+		configuration.notificationLatency = _adaptiveLatency->latency();
+	}
+	_notificationLatency.store(configuration.notificationLatency);
+	
+	if (_ring) {
+		_backend->start(configuration, [this](const RawEvent *events, size_t count) {
+			if (_configuration.recorder) {
+				_configuration.recorder->record(events, count);
+			}
+			adaptLatency(count);
+			enqueueEvents(events, count);
+		});
+	} else {
+		_backend->start(configuration, [this](const RawEvent *events, size_t count) {
+			if (_configuration.recorder) {
+				_configuration.recorder->record(events, count);
+			}
+			adaptLatency(count);
+			handleEvents(events, count);
+		});
+	}
+	_created = true;
+	
+	// Starting from now is a checkpoint of its own, a restart before any
+	// event is delivered must still resume from here.
+	if (_configuration.checkpointStore &&
+		_configuration.sinceEventIdentifier == kEventIdentifierSinceNow) {
+		_configuration.checkpointStore->record(_configuration.checkpointKey,
+											   _backend->currentEventIdentifier(),
+											   _history);
+	}
+}
+
+void Stream::dispose()
+{
+	stopRescan();
+	if (!_created) {
+		return;
+	}
+	
+	_backend->stop();
+	waitForDeliveries();
+	_created = false;
+}
+
+
+#pragma mark Flushing events
+void Stream::flushSynchronously()
+{
+	if (_created) {
+		_backend->flushSynchronously();
+		waitForDeliveries();
+	}
+}
+
+void Stream::flushAsynchronously()
+{
+	if (_created) {
+		_backend->flushAsynchronously();
+	}
+}
+
+
+#pragma mark Configuring the stream
+void Stream::setWatchedPaths(const std::vector<std::string> &paths)
+{
+	std::vector<std::string> watchedPaths(paths);
+	std::vector<std::string> addedPaths;
+	for (size_t i = 0; i < watchedPaths.size(); ++i) {
+		standardizePath(watchedPaths[i]);
+		
+		bool watched = false;
+		for (size_t j = 0; j < _configuration.watchedPaths.size() && !watched; ++j) {
+			watched = isPathPrefix(_configuration.watchedPaths[j], watchedPaths[i]);
+		}
+		if (!watched) {
+			addedPaths.push_back(watchedPaths[i]);
+		}
+	}
+	
+	// New trees are added to the snapshot before their events can arrive.
+	if (_configuration.snapshot) {
+		const std::shared_ptr<const TreeWalker> walker = this->walker();
+		for (size_t i = 0; i < addedPaths.size(); ++i) {
+			_configuration.snapshot->rescan(addedPaths[i], true, *walker, DirectorySnapshot::ChangeHandler());
+		}
+	}
+	
+	// Nothing told whether the ignore files of a tree watched before changed meanwhile.
+	_configuration.watchedPaths = watchedPaths;
+	updateFilter([&watchedPaths, &addedPaths](Filter &filter) {
+		if (IgnoreFileCache *ignoreFiles = filter.ignoreFiles()) {
+			for (size_t i = 0; i < addedPaths.size(); ++i) {
+				ignoreFiles->invalidateTree(addedPaths[i]);
+			}
+		}
+		filter.setWatchedPaths(watchedPaths);
+	});
+	if (_created) {
+		_backend->setWatchedPaths(watchedPaths);
+	}
+}
+
+std::vector<std::string> Stream::watchedPaths() const
+{
+	return filter()->watchedPaths();
+}
+
+void Stream::setExcludedPaths(const std::vector<std::string> &paths)
+{
+	updateFilter([&paths](Filter &filter) {
+		filter.setExcludedPaths(paths);
+	});
+	std::atomic_store(&_walker, createWalker(paths));
+}
+
+std::vector<std::string> Stream::excludedPaths() const
+{
+	return filter()->excludedPaths();
+}
+
+void Stream::setPathPatterns(const std::vector<std::string> &patterns)
+{
+	updateFilter([&patterns](Filter &filter) {
+		filter.setPathPatterns(patterns);
+	});
+}
+
+std::vector<std::string> Stream::pathPatterns() const
+{
+	return filter()->pathPatterns();
+}
+
+void Stream::setIgnoreEventsFromSubDirectories(bool flag)
+{
+	updateFilter([flag](Filter &filter) {
+		filter.setIgnoreEventsFromSubDirectories(flag);
+	});
+}
+
+bool Stream::ignoreEventsFromSubDirectories() const
+{
+	return filter()->ignoreEventsFromSubDirectories();
+}
+
+void Stream::setHonorsIgnoreFiles(bool flag)
+{
+	updateFilter([flag](Filter &filter) {
+		if (!flag) {
+			filter.setIgnoreFiles(std::shared_ptr<IgnoreFileCache>());
+		} else if (!filter.ignoreFiles()) {
+			filter.setIgnoreFiles(std::make_shared<IgnoreFileCache>());
+		}
+	});
+}
+
+bool Stream::honorsIgnoreFiles() const
+{
+	return (filter()->ignoreFiles() != NULL);
+}
+
+std::vector<std::string> Stream::ignoreFileErrors() const
+{
+	const std::shared_ptr<const Filter> filter = this->filter();
+	return (filter->ignoreFiles() ? filter->ignoreFiles()->errors() : std::vector<std::string>());
+}
+
+
+#pragma mark Rescanning
+void Stream::rescan(const RescanHandler &handler)
+{
+	stopRescan();
+	
+	std::lock_guard<std::mutex> lock(_rescanMutex);
+	_rescanWalker = createWalker(excludedPaths());
+	_rescanThread = std::thread(&Stream::runRescan, this, _rescanWalker, handler);
+}
+
+
+#pragma mark Misc
+DeliveryQueueStatistics Stream::deliveryQueueStatistics() const
+{
+	DeliveryQueueStatistics statistics;
+	if (_ring) {
+		statistics.depth		= _ring->size();
+	}
+	statistics.maximumDepth		= _maximumQueueDepth.load();
+	statistics.queuedBatches	= _queuedBatches.load();
+	statistics.blockedBatches	= _blockedBatches.load();
+	statistics.droppedBatches	= _droppedBatches.load();
+	statistics.droppedEvents	= _droppedEvents.load();
+	statistics.rescans			= _overflowRescans.load();
+	
+	return statistics;
+}
+
+std::string Stream::description() const
+{
+	return _backend->description();
+}
+
+
+#pragma mark Private
+std::shared_ptr<const Filter> Stream::filter() const
+{
+	return std::atomic_load(&_filter);
+}
+
+void Stream::updateFilter(const std::function<void (Filter &filter)> &update)
+{
+	// Writers are serialized by the mutex while the delivery path only ever
+	// loads the current filter, which is never modified once published.
+	std::lock_guard<std::mutex> lock(_filterMutex);
+	std::shared_ptr<Filter> filter(new Filter(*std::atomic_load(&_filter)));
+	update(*filter);
+	std::atomic_store(&_filter, std::shared_ptr<const Filter>(filter));
+}
+
+std::shared_ptr<const TreeWalker> Stream::walker() const
+{
+	return std::atomic_load(&_walker);
+}
+
+std::shared_ptr<const TreeWalker> Stream::createWalker(const std::vector<std::string> &excludedPaths) const
+{
+	std::vector<std::string> paths(excludedPaths);
+	for (size_t i = 0; i < paths.size(); ++i) {
+		standardizePath(paths[i]);
+	}
+	
+	std::shared_ptr<TreeWalker> walker(new TreeWalker(_configuration.rescanThreadCount));
+	walker->setExcludedPaths(paths);
+	return walker;
+}
+
+void Stream::adaptLatency(size_t count)
+{
+	if (_adaptiveLatency && _adaptiveLatency->observe(count, std::chrono::steady_clock::now())) {
+		_backend->setNotificationLatency(_adaptiveLatency->latency());
+		_notificationLatency.store(_adaptiveLatency->latency());
+	}
+}
+
+void Stream::handleEvents(const RawEvent *events, size_t count)
+{
+	_backendJob->sequence = ++_batchSequence;
+	_backendJob->compensatedSequence = 0;
+	_backendJob->queuedTime = 0;
+	deliverEvents(events, count, *_backendJob);
+}
+
+void Stream::enqueueEvents(const RawEvent *events, size_t count)
+{
+	DeliveryJob *job = takeJob();
+	
+	// The raw events are only valid during this call, so the paths are copied
+	// into the job first and pointed at once the buffer no longer moves.
+	job->paths.clear();
+	job->events.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		job->events[i] = events[i];
+		job->events[i].path = NULL;
+		job->paths.append(events[i].path, events[i].pathLength);
+	}
+	job->sequence = ++_batchSequence;
+	job->compensatedSequence = 0;
+	job->queuedTime = (_configuration.metrics ? monotonicNanoseconds() : 0);
+	size_t offset = 0;
+	for (size_t i = 0; i < count; ++i) {
+		job->events[i].path = job->paths.data() + offset;
+		offset += job->events[i].pathLength;
+	}
+	
+	bool blocked = false;
+	while (!_ring->push(job)) {
+		if (_configuration.overflowPolicy == kOverflowPolicyDropOldest) {
+			DeliveryJob *oldest = NULL;
+			if (_ring->discardOldest(oldest)) {
+				dropJob(oldest);
+				uint64_t none = 0;
+				_rescanSequence.compare_exchange_strong(none, _lastQueuedSequence);
+			}
+		} else if (_configuration.overflowPolicy == kOverflowPolicyRescan) {
+			dropJob(job);
+			uint64_t none = 0;
+			_rescanSequence.compare_exchange_strong(none, _lastQueuedSequence);
+			if (_consumerWaiting.load()) {
+				wakeDeliveryWaiters();
+			}
+			return;
+		} else {
+			if (!blocked) {
+				blocked = true;
+				++_blockedBatches;
+			}
+			std::unique_lock<std::mutex> lock(_deliveryMutex);
+			_producerWaiting.store(true);
+			_deliveryChanged.wait(lock, [this]() {
+				return (_ring->size() < _ring->capacity() || _stoppingDelivery.load());
+			});
+			_producerWaiting.store(false);
+		}
+	}
+	_lastQueuedSequence = job->sequence;
+	++_queuedBatches;
+	
+	const size_t depth = _ring->size();
+	size_t maximumDepth = _maximumQueueDepth.load();
+	while (depth > maximumDepth && !_maximumQueueDepth.compare_exchange_weak(maximumDepth, depth)) {
+	}
+	
+	if (_consumerWaiting.load()) {
+		wakeDeliveryWaiters();
+	}
+}
+
+Stream::DeliveryJob *Stream::takeJob()
+{
+	std::lock_guard<std::mutex> lock(_jobsMutex);
+	if (_freeJobs.empty()) {
+		_jobs.push_back(std::unique_ptr<DeliveryJob>(new DeliveryJob()));
+		_freeJobs.push_back(_jobs.back().get());
+	}
+	DeliveryJob *job = _freeJobs.back();
+	_freeJobs.pop_back();
+	
+	return job;
+}
+
+void Stream::recycleJob(DeliveryJob *job)
+{
+	std::lock_guard<std::mutex> lock(_jobsMutex);
+	_freeJobs.push_back(job);
+}
+
+void Stream::dropJob(DeliveryJob *job)
+{
+	++_droppedBatches;
+	_droppedEvents += job->events.size();
+	
+	// Nothing of the batch is delivered. The client is told to rescan in its
+	// place, right away under the rescan policy, so later batches may still
+	// be checkpointed. Under drop-oldest the rescan only follows the batches
+	// queued before, so until it is delivered the checkpoint stays before the
+	// batch, and a stream resuming from it is handed its events again.
+	if (_configuration.checkpointStore) {
+		if (_configuration.overflowPolicy == kOverflowPolicyDropOldest) {
+			std::lock_guard<std::mutex> lock(_checkpointMutex);
+			_heldSequences.push_back(job->sequence);
+		}
+		recordCheckpoint(job->sequence, 0);
+	}
+	recycleJob(job);
+}
+
+void Stream::dispatchJob(DeliveryJob *job)
+{
+	if (_workers) {
+		_workers->submit([this, job]() {
+			deliverEvents(job->events.data(), job->events.size(), *job);
+			recycleJob(job);
+		});
+	} else {
+		deliverEvents(job->events.data(), job->events.size(), *job);
+		recycleJob(job);
+	}
+}
+
+void Stream::dispatchOverflowRescan()
+{
+	DeliveryJob *job = takeJob();
+	const EventIdentifier identifier = _backend->currentEventIdentifier();
+	const std::shared_ptr<const Filter> filter = this->filter();
+	const std::vector<std::string> &watchedPaths = filter->watchedPaths();
+	
+	job->paths.clear();
+	job->events.resize(watchedPaths.size());
+	for (size_t i = 0; i < watchedPaths.size(); ++i) {
+		job->paths.append(watchedPaths[i]);
+	}
+	size_t offset = 0;
+	for (size_t i = 0; i < watchedPaths.size(); ++i) {
+		RawEvent &event	= job->events[i];
+		event.path		= job->paths.data() + offset;
+		event.pathLength	= watchedPaths[i].size();
+		event.flags		= (kEventFlagMustScanSubDirs | kEventFlagUserDropped);
+		event.identifier	= identifier;
+		event.renameCookie	= 0;
+		offset += event.pathLength;
+	}
+	// Not a batch of the backend, so there is nothing to checkpoint, but it
+	// makes up for the batches dropped so far.
+	job->sequence = 0;
+	job->queuedTime = 0;
+	job->compensatedSequence = 0;
+	if (_configuration.checkpointStore) {
+		std::lock_guard<std::mutex> lock(_checkpointMutex);
+		if (!_heldSequences.empty()) {
+			job->compensatedSequence = _heldSequences.back();
+		}
+	}
+	
+	++_overflowRescans;
+	dispatchJob(job);
+}
+
+void Stream::runDeliveryThread()
+{
+	for (;;) {
+		_consumerBusy.store(true);
+		
+		DeliveryJob *job = NULL;
+		if (_ring->pop(job)) {
+			if (_producerWaiting.load()) {
+				wakeDeliveryWaiters();
+			}
+			
+			const uint64_t sequence = job->sequence;
+			dispatchJob(job);
+			
+			uint64_t rescanSequence = _rescanSequence.load();
+			if (rescanSequence != 0 && sequence >= rescanSequence &&
+				_rescanSequence.compare_exchange_strong(rescanSequence, 0)) {
+				dispatchOverflowRescan();
+			}
+			continue;
+		}
+		
+		// The batches before the dropped ones may all have been delivered already.
+		if (_rescanSequence.exchange(0) != 0) {
+			dispatchOverflowRescan();
+			continue;
+		}
+		
+		_consumerBusy.store(false);
+		std::unique_lock<std::mutex> lock(_deliveryMutex);
+		_consumerWaiting.store(true);
+		// Anyone waiting for the deliveries to finish can go on.
+		_deliveryChanged.notify_all();
+		_deliveryChanged.wait(lock, [this]() {
+			return (!_ring->empty() || _rescanSequence.load() != 0 || _stoppingDelivery.load());
+		});
+		_consumerWaiting.store(false);
+		if (_ring->empty() && _rescanSequence.load() == 0 && _stoppingDelivery.load()) {
+			break;
+		}
+	}
+}
+
+void Stream::wakeDeliveryWaiters()
+{
+	std::lock_guard<std::mutex> lock(_deliveryMutex);
+	_deliveryChanged.notify_all();
+}
+
+void Stream::waitForDeliveries()
+{
+	if (!_ring || isDeliveryThread()) {
+		return;
+	}
+	
+	{
+		std::unique_lock<std::mutex> lock(_deliveryMutex);
+		_deliveryChanged.wait(lock, [this]() {
+			return (_ring->empty() && _rescanSequence.load() == 0 && !_consumerBusy.load());
+		});
+	}
+	if (_workers) {
+		_workers->waitUntilIdle();
+	}
+}
+
+bool Stream::isDeliveryThread() const
+{
+	return (std::this_thread::get_id() == _deliveryThread.get_id() ||
+			(_workers && _workers->isWorkerThread()));
+}
+
+void Stream::deliverEvents(const RawEvent *events, size_t count, DeliveryJob &job)
+{
+	std::string &path = job.path;
+	EventBatch &batch = job.batch;
+	std::shared_ptr<const Filter> filter = this->filter();
+	const double timestamp = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+	
+	StreamMetrics *metrics = _configuration.metrics.get();
+	uint64_t startTime = 0;
+	uint64_t excluded = 0;
+	uint64_t inSubDirectories = 0;
+	if (metrics) {
+		startTime = monotonicNanoseconds();
+		if (job.queuedTime != 0) {
+			metrics->record(kMetricsStageQueueWait, startTime - job.queuedTime);
+		}
+		metrics->add(kMetricsCounterEventsReceived, count);
+	}
+	
+	// Identifiers may wrap, so the checkpoint is the last one rather than the highest.
+	EventIdentifier checkpointIdentifier = 0;
+	
+	// The half of a rename last appended, waiting for the other half. Events
+	// filtered out meanwhile leave it waiting.
+	const RawEvent *renameHalf = NULL;
+	
+	batch.clear();
+	for (size_t i = 0; i < count; ++i) {
+		if (events[i].identifier != 0) {
+			checkpointIdentifier = events[i].identifier;
+		}
+		if (metrics) {
+			recordFlags(*metrics, events[i].flags);
+		}
+		
+		// Make sure the path doesn't contain any trailing slash or other
+		// redundant components before matching it.
+		path.assign(events[i].path, events[i].pathLength);
+		standardizePath(path);
+		
+		// A changed ignore file applies to this very batch.
+		if (IgnoreFileCache *ignoreFiles = filter->ignoreFiles()) {
+			ignoreFiles->invalidate(path, events[i].flags);
+		}
+		
+		if (_configuration.snapshot) {
+			if (events[i].flags & kRescanFlags) {
+				// The client is told exactly what changed instead of to rescan.
+				rescanSnapshot(events[i], path, *filter, timestamp, batch);
+				renameHalf = NULL;
+				continue;
+			}
+			if (events[i].flags & kEventFlagRootChanged) {
+				// Told along with the change of the root itself.
+				rescanSnapshot(events[i], path, *filter, timestamp, batch);
+				renameHalf = NULL;
+			} else {
+				refreshSnapshot(events[i].flags, path);
+			}
+		}
+		
+		const FilterResult result = filter->classifyPath(path);
+		if (result != kFilterResultPass) {
+			if (result == kFilterResultExcluded) {
+				++excluded;
+			} else {
+				++inSubDirectories;
+			}
+			
+			// The item was moved out of the watched paths after all.
+			if (renameHalf && renameHalf->renameCookie != 0 && renameHalf->renameCookie == events[i].renameCookie) {
+				renameHalf = NULL;
+			}
+			continue;
+		}
+		
+		// The halves of a rename with a cookie come in order.
+		bool isDestination;
+		if (renameHalf && isRenamePair(*renameHalf, batch.path(batch.size() - 1), events[i], path,
+									   _configuration.identityTracker.get(), job.renameSourcePath, isDestination)) {
+			batch.joinRename(events[i].identifier, events[i].flags, path.data(), path.size(), isDestination);
+			renameHalf = NULL;
+			continue;
+		}
+		
+		batch.append(events[i].identifier, events[i].flags, timestamp, path.data(), path.size());
+		renameHalf = ((_configuration.pairsRenames && isRenameHalf(events[i])) ? &events[i] : NULL);
+	}
+	
+	if (!batch.empty()) {
+		const EventBatch *delivered = &batch;
+		if (_configuration.identityTracker) {
+			_configuration.identityTracker->track(batch, job.trackedBatch);
+			delivered = &job.trackedBatch;
+		}
+		if (_configuration.coalescingWindow > 0.0) {
+			job.coalescer.coalesce(*delivered, job.coalescedBatch);
+			delivered = &job.coalescedBatch;
+		}
+		if (_configuration.contentVerifier) {
+			// May leave nothing to deliver, if no file changed after all.
+			_configuration.contentVerifier->verify(*delivered, job.verifiedBatch);
+			delivered = &job.verifiedBatch;
+		}
+		
+		if (metrics) {
+			const uint64_t handlerTime = monotonicNanoseconds();
+			metrics->record(kMetricsStageFiltering, handlerTime - startTime);
+			if (!delivered->empty()) {
+				_handler(*this, *delivered);
+				metrics->record(kMetricsStageHandler, monotonicNanoseconds() - handlerTime);
+				metrics->add(kMetricsCounterEventsDelivered, delivered->size());
+				metrics->add(kMetricsCounterBatchesDelivered, 1);
+			}
+		} else if (!delivered->empty()) {
+			_handler(*this, *delivered);
+		}
+		
+		// Events merged or dropped on the way have been seen all the same.
+		const EventIdentifier identifier = batch.back().identifier;
+		if (!_workers || _workers->threadCount() == 1) {
+			_lastEventIdentifier.store(identifier);
+		} else {
+			// Batches may finish out of order, keep the highest identifier.
+			EventIdentifier last = _lastEventIdentifier.load();
+			while ((last == kEventIdentifierSinceNow || last < identifier) &&
+				   !_lastEventIdentifier.compare_exchange_weak(last, identifier)) {
+			}
+		}
+	}
+	
+	if (metrics) {
+		if (batch.empty()) {
+			metrics->record(kMetricsStageFiltering, monotonicNanoseconds() - startTime);
+		}
+		metrics->add(kMetricsCounterEventsExcluded, excluded);
+		metrics->add(kMetricsCounterEventsInSubDirectories, inSubDirectories);
+	}
+	
+	// Filtered out events are done with as well.
+	if (_configuration.checkpointStore && job.sequence != 0) {
+		recordCheckpoint(job.sequence, checkpointIdentifier);
+	} else if (job.compensatedSequence != 0) {
+		releaseCheckpoint(job.compensatedSequence);
+	}
+}
+
+void Stream::rescanSnapshot(const RawEvent &event, const std::string &path, const Filter &filter, double timestamp, EventBatch &batch)
+{
+	const DirectorySnapshot::ChangeHandler append = [&event, &filter, timestamp, &batch](const std::string &changed, EventFlags flags) {
+		if (!filter.shouldIgnorePath(changed)) {
+			batch.append(event.identifier, flags, timestamp, changed.data(), changed.size());
+		}
+	};
+	
+	const std::shared_ptr<const TreeWalker> walker = this->walker();
+	if (!filter.shouldIgnorePath(path)) {
+		_configuration.snapshot->rescan(path, true, *walker, append);
+		return;
+	}
+	if ((event.flags & (kEventFlagUserDropped | kEventFlagKernelDropped)) == 0) {
+		return;
+	}
+	
+	// Dropped events reported outside the watched paths could have been for any of them.
+	const std::vector<std::string> &watchedPaths = filter.watchedPaths();
+	for (size_t i = 0; i < watchedPaths.size(); ++i) {
+		if (isPathPrefix(watchedPaths[i], path)) {
+			return;
+		}
+	}
+	for (size_t i = 0; i < watchedPaths.size(); ++i) {
+		_configuration.snapshot->rescan(watchedPaths[i], true, *walker, append);
+	}
+}
+
+void Stream::refreshSnapshot(EventFlags flags, const std::string &path)
+{
+	DirectorySnapshot &snapshot = *_configuration.snapshot;
+	if ((flags & kItemFlags) == 0) {
+		// Something changed in the directory, but not what.
+		snapshot.rescan(path, false, *walker(), DirectorySnapshot::ChangeHandler());
+	} else if ((flags & kEventFlagItemIsDir) && (flags & (kEventFlagItemCreated | kEventFlagItemRenamed))) {
+		// A directory moved in, or created with contents, brings a tree along.
+		snapshot.rescan(path, true, *walker(), DirectorySnapshot::ChangeHandler());
+	} else {
+		snapshot.update(path);
+	}
+}
+
+void Stream::runRescan(const std::shared_ptr<const TreeWalker> &walker, const RescanHandler &handler)
+{
+	std::shared_ptr<const Filter> filter = this->filter();
+	const EventIdentifier identifier = _backend->currentEventIdentifier();
+	const double timestamp = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+	
+	// Items are found by all the threads of the walk at once.
+	std::mutex batchMutex;
+	EventBatch batch;
+	const auto append = [&](const std::string &path, EventFlags flags) {
+		if (filter->shouldIgnorePath(path)) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(batchMutex);
+		batch.append(identifier, flags, timestamp, path.data(), path.size());
+		if (batch.size() >= kRescanBatchSize) {
+			handler(batch, false);
+			batch.clear();
+		}
+	};
+	
+	bool finished = true;
+	const std::vector<std::string> &watchedPaths = filter->watchedPaths();
+	if (_configuration.snapshot) {
+		for (size_t i = 0; i < watchedPaths.size() && finished; ++i) {
+			finished = _configuration.snapshot->rescan(watchedPaths[i], true, *walker, append);
+		}
+	} else {
+		finished = walker->walk(watchedPaths, true,
+								[&append](size_t, const std::string &path, const ItemAttributes &attributes) {
+			append(path, (kEventFlagItemCreated | attributes.type));
+		});
+	}
+	
+	if (finished) {
+		handler(batch, true);
+	}
+}
+
+void Stream::stopRescan()
+{
+	std::lock_guard<std::mutex> lock(_rescanMutex);
+	if (_rescanThread.joinable()) {
+		_rescanWalker->cancel();
+		_rescanThread.join();
+	}
+	_rescanWalker.reset();
+}
+
+void Stream::resumeFromCheckpoint()
+{
+	CheckpointStore &store = *_configuration.checkpointStore;
+	_history = (_configuration.watchedPaths.empty() ?
+				std::string() :
+				_backend->historyIdentifier(_configuration.watchedPaths[0]));
+	_resumedWithoutHistory = false;
+	
+	CheckpointStore::Checkpoint checkpoint;
+	if (!store.checkpoint(_configuration.checkpointKey, checkpoint)) {
+		return;
+	}
+	
+	// An identifier from another history, or one the history has not reached
+	// yet, says nothing about what happened since.
+	if (checkpoint.history != _history ||
+		(!_history.empty() && checkpoint.identifier > _backend->currentEventIdentifier())) {
+		_configuration.sinceEventIdentifier = kEventIdentifierSinceNow;
+		_resumedWithoutHistory = true;
+		return;
+	}
+	
+	_configuration.sinceEventIdentifier = checkpoint.identifier;
+}
+
+void Stream::recordCheckpoint(uint64_t sequence, EventIdentifier identifier)
+{
+	std::lock_guard<std::mutex> lock(_checkpointMutex);
+	_finishedBatches[sequence] = identifier;
+	advanceCheckpoint();
+}
+
+void Stream::releaseCheckpoint(uint64_t sequence)
+{
+	std::lock_guard<std::mutex> lock(_checkpointMutex);
+	while (!_heldSequences.empty() && _heldSequences.front() <= sequence) {
+		_heldSequences.pop_front();
+	}
+	advanceCheckpoint();
+}
+
+void Stream::advanceCheckpoint()
+{
+	// Called locked. The checkpoint moves over the batches finished in order,
+	// up to the first one held; those after it wait for the rescan.
+	EventIdentifier checkpoint = 0;
+	while (!_finishedBatches.empty() && _finishedBatches.begin()->first == _checkpointedSequence + 1 &&
+		   (_heldSequences.empty() || _finishedBatches.begin()->first < _heldSequences.front())) {
+		if (_finishedBatches.begin()->second != 0) {
+			checkpoint = _finishedBatches.begin()->second;
+		}
+		_checkpointedSequence++;
+		_finishedBatches.erase(_finishedBatches.begin());
+	}
+	
+	if (checkpoint != 0) {
+		_configuration.checkpointStore->record(_configuration.checkpointKey, checkpoint, _history);
+	}
+}
+
+} // namespace cdevents
@@ -0,0 +1,349 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreStream.h
+ * The platform-neutral event stream of the CDEvents core.
+ */
+
+#ifndef CD_CORE_STREAM_H
+#define CD_CORE_STREAM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CDCoreBackend.h"
+#include "CDCoreEvent.h"
+#include "CDCoreFilter.h"
+#include "CDCoreRingBuffer.h"
+
+namespace cdevents {
+
+/**
+ * The counters of the queue between the backend of a stream and its delivery threads.
+ *
+ * @since head
+ */
+struct DeliveryQueueStatistics {
+	/** The number of batches waiting for a delivery thread. */
+	size_t		depth;
+	/** The highest number of batches which have been waiting at once. */
+	size_t		maximumDepth;
+	/** The number of batches queued. */
+	uint64_t	queuedBatches;
+	/** The number of batches which had to wait for room in the queue. */
+	uint64_t	blockedBatches;
+	/** The number of batches dropped because the queue was full. */
+	uint64_t	droppedBatches;
+	/** The number of events in the dropped batches. */
+	uint64_t	droppedEvents;
+	/** The number of rescan events delivered in place of dropped batches. */
+	uint64_t	rescans;
+	
+	DeliveryQueueStatistics()
+	:	depth(0),
+		maximumDepth(0),
+		queuedBatches(0),
+		blockedBatches(0),
+		droppedBatches(0),
+		droppedEvents(0),
+		rescans(0)
+	{}
+};
+
+
+/**
+ * An event stream which filters the events of a backend and delivers them to a handler.
+ *
+ * The stream owns its backend. Events are standardized, filtered with the
+ * watched paths, excluded paths and sub-directory rule, and delivered one
+ * batch at a time on the thread the backend reports them on (the run loop or
+ * dispatch queue for FSEvents, the backend thread for inotify).
+ *
+ * If the configuration asks for delivery threads, each batch is instead
+ * copied and handed to a WorkerPool of that many threads which filter and
+ * deliver it, so neither runs on the thread of the backend. With more than
+ * one delivery thread the handler is called concurrently and batches may be
+ * delivered out of order.
+ *
+ * @see CDEvents
+ *
+ * @since head
+ */
+class AdaptiveLatency;
+class TreeWalker;
+class WorkerPool;
+
+class Stream {
+public:
+	/**
+	 * Type of the handler which gets called with the filtered events of a batch.
+	 *
+	 * The batch is reused by the stream and only valid for the duration of the call.
+	 */
+	typedef std::function<void (Stream &stream, const EventBatch &events)> EventsHandler;
+	
+	/**
+	 * Type of the handler which gets called with the events found by a rescan, the last time with <em>finished</em> set.
+	 *
+	 * The batch is only valid for the duration of the call.
+	 */
+	typedef std::function<void (const EventBatch &events, bool finished)> RescanHandler;
+	
+	/**
+	 * Returns a stream for the given backend and configuration. The stream is not created until create() is called.
+	 *
+	 * @throws PathPatternError if a path pattern of the configuration is malformed.
+	 */
+	Stream(std::unique_ptr<Backend> backend,
+		   const StreamConfiguration &configuration,
+		   const EventsHandler &handler);
+	~Stream();
+	
+	/** @name Stream lifecycle */
+	/**
+	 * Creates and starts the event stream.
+	 *
+	 * @throws StreamCreationFailure if the backend failed to create its event stream.
+	 */
+	void create();
+	
+	/**
+	 * Stops and disposes of the event stream. Calling it on a disposed stream does nothing.
+	 */
+	void dispose();
+	
+	/**
+	 * Whether the event stream has been created and not yet disposed.
+	 */
+	bool isCreated() const { return _created; }
+	
+	/** @name Flushing events */
+	void flushSynchronously();
+	void flushAsynchronously();
+	
+	/** @name Configuring the stream */
+	/**
+	 * The configuration the stream was created with. The watched paths, excluded paths, path patterns, sub-directory rule and ignore file rule may since have changed.
+	 */
+	const StreamConfiguration &configuration() const { return _configuration; }
+	
+	/**
+	 * Changes the watched paths without recreating the stream.
+	 *
+	 * The backend watches the new paths in place where it can, or else hands
+	 * over to a new event stream starting from the last event of the old one;
+	 * either way no event of the paths watched throughout is lost or
+	 * delivered twice. Paths added to a stream with a snapshot are walked
+	 * first.
+	 */
+	void setWatchedPaths(const std::vector<std::string> &paths);
+	std::vector<std::string> watchedPaths() const;
+	
+	void setExcludedPaths(const std::vector<std::string> &paths);
+	std::vector<std::string> excludedPaths() const;
+	
+	/**
+	 * Changes the path patterns, compiling them before the next batch is filtered.
+	 *
+	 * @throws PathPatternError if a pattern is malformed, in which case the patterns are left unchanged.
+	 */
+	void setPathPatterns(const std::vector<std::string> &patterns);
+	std::vector<std::string> pathPatterns() const;
+	
+	void setIgnoreEventsFromSubDirectories(bool flag);
+	bool ignoreEventsFromSubDirectories() const;
+	
+	/**
+	 * Changes whether events are ignored according to the ignore files in the watched paths. The ignore files are read again when turned back on.
+	 */
+	void setHonorsIgnoreFiles(bool flag);
+	bool honorsIgnoreFiles() const;
+	
+	/**
+	 * The problems found in the ignore files read so far, such as malformed patterns which are left out. May be called from any thread.
+	 */
+	std::vector<std::string> ignoreFileErrors() const;
+	
+	/** @name Rescanning */
+	/**
+	 * Walks the watched paths in the background and reports what it finds to <em>handler</em>, in batches.
+	 *
+	 * The trees are walked by configuration().rescanThreadCount threads and
+	 * excluded paths are not descended into. With a snapshot only the
+	 * differences from it are reported, otherwise every item is reported as
+	 * created. The handler is called from a thread of the rescan. A rescan
+	 * still running when another is started, or the stream disposed of, is
+	 * cancelled and its handler not called again.
+	 */
+	void rescan(const RescanHandler &handler);
+	
+	/** @name Misc */
+	/**
+	 * The notification latency the backend currently delivers with, which only differs from the configured one if it adapts to the load. May be called from any thread.
+	 */
+	double notificationLatency() const { return _notificationLatency.load(); }
+	
+	/**
+	 * The counters of the queue to the delivery threads, all zero without delivery threads. May be called from any thread.
+	 */
+	DeliveryQueueStatistics deliveryQueueStatistics() const;
+	
+	/**
+	 * The identifier of the last event delivered to the handler, or kEventIdentifierSinceNow if none has been.
+	 *
+	 * With more than one delivery thread this is the highest identifier delivered.
+	 */
+	EventIdentifier lastEventIdentifier() const { return _lastEventIdentifier.load(); }
+	
+	/**
+	 * Whether the stream found a checkpoint it could not resume from, because the event history it belonged to is gone.
+	 *
+	 * Such a stream starts with events since now; whatever happened before is
+	 * unknown and the watched paths must be rescanned.
+	 */
+	bool resumedWithoutHistory() const { return _resumedWithoutHistory; }
+	
+	/**
+	 * The backend of the stream.
+	 */
+	Backend &backend() { return *_backend; }
+	
+	/**
+	 * A description of the event stream, for debugging only.
+	 */
+	std::string description() const;
+	
+private:
+	Stream(const Stream &);
+	Stream &operator=(const Stream &);
+	
+	struct DeliveryJob;
+	
+	std::shared_ptr<const Filter> filter() const;
+	void updateFilter(const std::function<void (Filter &filter)> &update);
+	std::shared_ptr<const TreeWalker> walker() const;
+	std::shared_ptr<const TreeWalker> createWalker(const std::vector<std::string> &excludedPaths) const;
+	void adaptLatency(size_t count);
+	void handleEvents(const RawEvent *events, size_t count);
+	void enqueueEvents(const RawEvent *events, size_t count);
+	DeliveryJob *takeJob();
+	void recycleJob(DeliveryJob *job);
+	void dropJob(DeliveryJob *job);
+	void dispatchJob(DeliveryJob *job);
+	void dispatchOverflowRescan();
+	void runDeliveryThread();
+	void wakeDeliveryWaiters();
+	void waitForDeliveries();
+	bool isDeliveryThread() const;
+	void deliverEvents(const RawEvent *events, size_t count, DeliveryJob &job);
+	void rescanSnapshot(const RawEvent &event, const std::string &path, const Filter &filter, double timestamp, EventBatch &batch);
+	void refreshSnapshot(EventFlags flags, const std::string &path);
+	void runRescan(const std::shared_ptr<const TreeWalker> &walker, const RescanHandler &handler);
+	void stopRescan();
+	void resumeFromCheckpoint();
+	void recordCheckpoint(uint64_t sequence, EventIdentifier identifier);
+	void releaseCheckpoint(uint64_t sequence);
+	void advanceCheckpoint();
+	
+	std::unique_ptr<Backend>		_backend;
+	StreamConfiguration				_configuration;
+	EventsHandler					_handler;
+	
+	mutable std::mutex				_filterMutex;
+	std::shared_ptr<const Filter>	_filter;
+	std::shared_ptr<const TreeWalker>	_walker;
+	
+	std::atomic<EventIdentifier>	_lastEventIdentifier;
+	bool							_created;
+	
+	// Only set if the latency adapts to the load, fed on the thread of the backend.
+	std::unique_ptr<AdaptiveLatency>	_adaptiveLatency;
+	std::atomic<double>				_notificationLatency;
+	
+	// Reused across the batches delivered on the thread of the backend.
+	std::unique_ptr<DeliveryJob>	_backendJob;
+	
+	// Batches are numbered as they arrive, a checkpoint is only recorded
+	// once every earlier batch has been delivered too.
+	std::string						_history;
+	bool							_resumedWithoutHistory;
+	uint64_t						_batchSequence;
+	std::mutex						_checkpointMutex;
+	uint64_t						_checkpointedSequence;
+	// The batches dropped under drop-oldest whose rescan has not been
+	// delivered yet, oldest first; no checkpoint is recorded past them.
+	std::deque<uint64_t>			_heldSequences;
+	std::map<uint64_t, EventIdentifier>	_finishedBatches;
+	
+	// With delivery threads, batches are handed from the backend to one
+	// delivery thread through a lock-free ring. It delivers them itself or,
+	// with more threads, passes them on to a pool.
+	std::unique_ptr<RingBuffer<DeliveryJob *> >	_ring;
+	std::thread						_deliveryThread;
+	std::mutex						_deliveryMutex;
+	std::condition_variable			_deliveryChanged;
+	std::atomic<bool>				_producerWaiting;
+	std::atomic<bool>				_consumerWaiting;
+	std::atomic<bool>				_consumerBusy;
+	std::atomic<bool>				_stoppingDelivery;
+	// Set when a batch is dropped: the rescan in its place is delivered
+	// after the batch with this sequence number, the last one queued.
+	std::atomic<uint64_t>			_rescanSequence;
+	uint64_t						_lastQueuedSequence;
+	
+	std::atomic<size_t>				_maximumQueueDepth;
+	std::atomic<uint64_t>			_queuedBatches;
+	std::atomic<uint64_t>			_blockedBatches;
+	std::atomic<uint64_t>			_droppedBatches;
+	std::atomic<uint64_t>			_droppedEvents;
+	std::atomic<uint64_t>			_overflowRescans;
+	
+	// Delivery threads beyond the first, with the jobs they recycle.
+	std::unique_ptr<WorkerPool>		_workers;
+	std::mutex						_jobsMutex;
+	std::vector<std::unique_ptr<DeliveryJob> >	_jobs;
+	std::vector<DeliveryJob *>		_freeJobs;
+	
+	// The background rescan, cancelled through its walker.
+	std::mutex						_rescanMutex;
+	std::thread						_rescanThread;
+	std::shared_ptr<const TreeWalker>	_rescanWalker;
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_STREAM_H
@@ -0,0 +1,458 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreStreamMultiplexer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <sstream>
+#include <utility>
+
+#include "CDCorePath.h"
+
+namespace cdevents {
+
+#pragma mark Constants
+// Events about the stream as a whole rather than a path, which every subscriber gets.
+static const EventFlags kStreamEventFlags = (kEventFlagUserDropped |
+											 kEventFlagKernelDropped |
+											 kEventFlagEventIdsWrapped |
+											 kEventFlagHistoryDone |
+											 kEventFlagMount |
+											 kEventFlagUnmount);
+
+static const size_t kNoEvent = (size_t)-1;
+
+
+#pragma mark Routes
+struct StreamMultiplexer::Route {
+	Subscriber						subscriber;
+	std::vector<std::string>		watchedPaths;
+	SubscriberHandler				handler;
+	std::shared_ptr<const Filter>	filter;
+	
+	// Guard the state below; removal waits for the handler to return
+	// unless it is removing from within a handler.
+	std::mutex						deliveryMutex;
+	std::condition_variable			deliveryFinished;
+	bool							delivering;
+	bool							removed;
+	
+	// Only used by the delivering thread.
+	std::shared_ptr<const Filter>	deliveryFilter;
+	EventBatch						batch;
+	size_t							lastEventIndex;
+	
+	Route()
+	:	subscriber(0),
+		delivering(false),
+		removed(false),
+		lastEventIndex(kNoEvent)
+	{}
+};
+
+struct StreamMultiplexer::Routing {
+	PathTrie								paths;
+	std::vector<std::vector<size_t> >		routesByNode;
+	std::vector<std::shared_ptr<Route> >	routes;
+};
+
+
+#pragma mark Init/dealloc
+StreamMultiplexer::StreamMultiplexer(const BackendFactory &backendFactory, const StreamConfiguration &configuration)
+:	_backendFactory(backendFactory),
+	_configuration(configuration),
+	_nextSubscriber(1),
+	_deliveringThread(std::thread::id()),
+	_routing(new Routing())
+{
+	_configuration.watchedPaths.clear();
+	_configuration.excludedPaths.clear();
+	_configuration.pathPatterns.clear();
+	_configuration.sinceEventIdentifier				= kEventIdentifierSinceNow;
+	_configuration.resumesEarlierStream				= false;
+	_configuration.ignoreEventsFromSubDirectories	= false;
+	_configuration.pairsRenames						= false;
+	_configuration.deliveryThreadCount				= std::min(_configuration.deliveryThreadCount, (size_t)1);
+	_configuration.checkpointStore.reset();
+	_configuration.snapshot.reset();
+	_configuration.identityTracker.reset();
+	_configuration.contentVerifier.reset();
+}
+
+StreamMultiplexer::~StreamMultiplexer()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_stream.reset();
+	_retiredStream.reset();
+}
+
+
+#pragma mark Subscribers
+StreamMultiplexer::Subscriber StreamMultiplexer::addSubscriber(const std::vector<std::string> &watchedPaths,
+															   const std::vector<std::string> &excludedPaths,
+															   bool ignoreEventsFromSubDirectories,
+															   const SubscriberHandler &handler)
+{
+	std::shared_ptr<Route> route(new Route());
+	route->handler = handler;
+	for (size_t i = 0; i < watchedPaths.size(); ++i) {
+		route->watchedPaths.push_back(standardizedPath(watchedPaths[i]));
+	}
+	
+	std::shared_ptr<Filter> filter(new Filter());
+	filter->setWatchedPaths(route->watchedPaths);
+	filter->setExcludedPaths(excludedPaths);
+	filter->setIgnoreEventsFromSubDirectories(ignoreEventsFromSubDirectories);
+	route->filter = filter;
+	
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (!isDelivering()) {
+		_retiredStream.reset();
+	}
+	route->subscriber = _nextSubscriber++;
+	_routes.push_back(route);
+	publishRouting();
+	
+	if (!_stream || !coversPaths(route->watchedPaths)) {
+		try {
+			updateStreamPaths();
+		} catch (...) {
+			_routes.pop_back();
+			publishRouting();
+			throw;
+		}
+	}
+	
+	return route->subscriber;
+}
+
+void StreamMultiplexer::removeSubscriber(Subscriber subscriber)
+{
+	std::shared_ptr<Route> route;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (size_t i = 0; i < _routes.size(); ++i) {
+			if (_routes[i]->subscriber == subscriber) {
+				route = _routes[i];
+				_routes.erase(_routes.begin() + i);
+				break;
+			}
+		}
+		if (!route) {
+			return;
+		}
+		publishRouting();
+		
+		// The paths of the subscriber are only dropped when the paths of the
+		// stream change for another subscriber, or here when there are none
+		// left. A stream cannot be destroyed from a thread it owns, which
+		// would have to join itself, so from within a handler it is retired
+		// and left delivering to nobody until then.
+		if (_routes.empty()) {
+			if (isDelivering()) {
+				_retiredStream = std::move(_stream);
+			} else {
+				_stream.reset();
+				_retiredStream.reset();
+			}
+			_streamPaths.clear();
+		}
+	}
+	
+	// A delivery which loaded the routing before it was published may still
+	// be calling the handler, unless that is where this is called from.
+	std::unique_lock<std::mutex> deliveryLock(route->deliveryMutex);
+	route->removed = true;
+	if (!isDelivering()) {
+		route->deliveryFinished.wait(deliveryLock, [&route]() {
+			return !route->delivering;
+		});
+	}
+}
+
+size_t StreamMultiplexer::subscriberCount() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _routes.size();
+}
+
+
+#pragma mark Configuring subscribers
+void StreamMultiplexer::setWatchedPaths(Subscriber subscriber, const std::vector<std::string> &paths)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::shared_ptr<Route> route = findRoute(subscriber);
+	if (!route) {
+		return;
+	}
+	
+	route->watchedPaths.clear();
+	for (size_t i = 0; i < paths.size(); ++i) {
+		route->watchedPaths.push_back(standardizedPath(paths[i]));
+	}
+	std::shared_ptr<Filter> filter(new Filter(*std::atomic_load(&route->filter)));
+	filter->setWatchedPaths(route->watchedPaths);
+	std::atomic_store(&route->filter, std::shared_ptr<const Filter>(filter));
+	publishRouting();
+	
+	if (_stream && !coversPaths(route->watchedPaths)) {
+		updateStreamPaths();
+	}
+}
+
+void StreamMultiplexer::setExcludedPaths(Subscriber subscriber, const std::vector<std::string> &paths)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::shared_ptr<Route> route = findRoute(subscriber);
+	if (route) {
+		std::shared_ptr<Filter> filter(new Filter(*std::atomic_load(&route->filter)));
+		filter->setExcludedPaths(paths);
+		std::atomic_store(&route->filter, std::shared_ptr<const Filter>(filter));
+	}
+}
+
+void StreamMultiplexer::setPathPatterns(Subscriber subscriber, const std::vector<std::string> &patterns)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::shared_ptr<Route> route = findRoute(subscriber);
+	if (route) {
+		std::shared_ptr<Filter> filter(new Filter(*std::atomic_load(&route->filter)));
+		filter->setPathPatterns(patterns);
+		std::atomic_store(&route->filter, std::shared_ptr<const Filter>(filter));
+	}
+}
+
+void StreamMultiplexer::setIgnoreEventsFromSubDirectories(Subscriber subscriber, bool flag)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	std::shared_ptr<Route> route = findRoute(subscriber);
+	if (route) {
+		std::shared_ptr<Filter> filter(new Filter(*std::atomic_load(&route->filter)));
+		filter->setIgnoreEventsFromSubDirectories(flag);
+		std::atomic_store(&route->filter, std::shared_ptr<const Filter>(filter));
+	}
+}
+
+
+#pragma mark Shared stream
+void StreamMultiplexer::flushSynchronously()
+{
+	// Without the lock, as the handlers called meanwhile may take it.
+	std::shared_ptr<Stream> stream;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		stream = _stream;
+	}
+	if (stream) {
+		stream->flushSynchronously();
+	}
+}
+
+void StreamMultiplexer::flushAsynchronously()
+{
+	std::shared_ptr<Stream> stream;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		stream = _stream;
+	}
+	if (stream) {
+		stream->flushAsynchronously();
+	}
+}
+
+std::string StreamMultiplexer::description() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	
+	std::ostringstream description;
+	description << "StreamMultiplexer { subscribers = " << _routes.size()
+				<< ", stream = " << (_stream ? _stream->description() : std::string("(none)")) << " }";
+	
+	return description.str();
+}
+
+
+#pragma mark Private
+std::shared_ptr<StreamMultiplexer::Route> StreamMultiplexer::findRoute(Subscriber subscriber) const
+{
+	for (size_t i = 0; i < _routes.size(); ++i) {
+		if (_routes[i]->subscriber == subscriber) {
+			return _routes[i];
+		}
+	}
+	
+	return std::shared_ptr<Route>();
+}
+
+void StreamMultiplexer::publishRouting()
+{
+	std::shared_ptr<Routing> routing(new Routing());
+	routing->routes = _routes;
+	for (size_t i = 0; i < _routes.size(); ++i) {
+		const std::vector<std::string> &paths = _routes[i]->watchedPaths;
+		for (size_t j = 0; j < paths.size(); ++j) {
+			const PathTrie::Node node = routing->paths.insert(paths[j]);
+			routing->routesByNode.resize(routing->paths.nodeCount());
+			routing->routesByNode[node].push_back(i);
+		}
+	}
+	
+	std::atomic_store(&_routing, std::shared_ptr<const Routing>(routing));
+}
+
+bool StreamMultiplexer::coversPaths(const std::vector<std::string> &paths) const
+{
+	for (size_t i = 0; i < paths.size(); ++i) {
+		if (!_streamPaths.containsPrefixOfPath(paths[i])) {
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+void StreamMultiplexer::updateStreamPaths()
+{
+	// Watch the outermost paths only, the kernel reports everything below them anyway.
+	std::vector<std::string> paths;
+	for (size_t i = 0; i < _routes.size(); ++i) {
+		paths.insert(paths.end(), _routes[i]->watchedPaths.begin(), _routes[i]->watchedPaths.end());
+	}
+	std::sort(paths.begin(), paths.end(), [](const std::string &a, const std::string &b) {
+		return (a.size() < b.size() || (a.size() == b.size() && a < b));
+	});
+	
+	_streamPaths.clear();
+	StreamConfiguration configuration(_configuration);
+	for (size_t i = 0; i < paths.size(); ++i) {
+		if (!_streamPaths.containsPrefixOfPath(paths[i])) {
+			_streamPaths.insert(paths[i]);
+			configuration.watchedPaths.push_back(paths[i]);
+		}
+	}
+	
+	if (_stream) {
+		_stream->setWatchedPaths(configuration.watchedPaths);
+		return;
+	}
+	
+	std::shared_ptr<Stream> stream(new Stream(_backendFactory(), configuration, [this](Stream &, const EventBatch &events) {
+		handleEvents(events);
+	}));
+	try {
+		stream->create();
+	} catch (...) {
+		_streamPaths.clear();
+		throw;
+	}
+	_stream = std::move(stream);
+}
+
+void StreamMultiplexer::handleEvents(const EventBatch &events)
+{
+	std::shared_ptr<const Routing> routing = std::atomic_load(&_routing);
+	const std::vector<std::shared_ptr<Route> > &routes = routing->routes;
+	
+	std::vector<Route *> touched;
+	std::string path;
+	
+	// Starts collecting the events of a route for this batch.
+	auto touch = [&touched](Route *route) {
+		if (route->lastEventIndex == kNoEvent) {
+			route->deliveryFilter = std::atomic_load(&route->filter);
+			route->batch.clear();
+			touched.push_back(route);
+		}
+	};
+	
+	for (size_t i = 0; i < events.size(); ++i) {
+		const EventRecord &event = events[i];
+		const char *eventPath = events.path(i);
+		path.assign(eventPath, event.pathLength);
+		
+		bool routed = false;
+		routing->paths.visitPrefixesOfPath(eventPath, event.pathLength, [&](PathTrie::Node node) {
+			const std::vector<size_t> &indexes = routing->routesByNode[node];
+			for (size_t j = 0; j < indexes.size(); ++j) {
+				Route *route = routes[indexes[j]].get();
+				routed = true;
+				
+				// A route watching nested paths sees the event once.
+				touch(route);
+				if (route->lastEventIndex == i) {
+					continue;
+				}
+				route->lastEventIndex = i;
+				
+				if (!route->deliveryFilter->shouldIgnorePath(path)) {
+					route->batch.append(event.identifier, event.flags, event.timestamp, eventPath, event.pathLength);
+				}
+			}
+		});
+		
+		if (!routed && (event.flags & kStreamEventFlags)) {
+			for (size_t j = 0; j < routes.size(); ++j) {
+				Route *route = routes[j].get();
+				touch(route);
+				route->lastEventIndex = i;
+				route->batch.append(event.identifier, event.flags, event.timestamp, eventPath, event.pathLength);
+			}
+		}
+	}
+	
+	// The handlers are called without any lock held, so that they may
+	// change the subscribers, their own included.
+	_deliveringThread.store(std::this_thread::get_id());
+	for (size_t i = 0; i < touched.size(); ++i) {
+		Route *route = touched[i];
+		route->lastEventIndex = kNoEvent;
+		route->deliveryFilter.reset();
+		if (route->batch.empty()) {
+			continue;
+		}
+		
+		{
+			std::lock_guard<std::mutex> lock(route->deliveryMutex);
+			if (route->removed) {
+				continue;
+			}
+			route->delivering = true;
+		}
+		route->handler(route->batch);
+		{
+			std::lock_guard<std::mutex> lock(route->deliveryMutex);
+			route->delivering = false;
+		}
+		route->deliveryFinished.notify_all();
+	}
+	_deliveringThread.store(std::thread::id());
+}
+
+} // namespace cdevents
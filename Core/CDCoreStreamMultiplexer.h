@@ -0,0 +1,184 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreStreamMultiplexer.h
+ * Many subscribers sharing one event stream.
+ */
+
+#ifndef CD_CORE_STREAM_MULTIPLEXER_H
+#define CD_CORE_STREAM_MULTIPLEXER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CDCoreBackend.h"
+#include "CDCoreEvent.h"
+#include "CDCoreFilter.h"
+#include "CDCorePathTrie.h"
+#include "CDCoreStream.h"
+
+namespace cdevents {
+
+/**
+ * Shares one stream, and thus one kernel event stream, between any number of subscribers.
+ *
+ * The underlying stream watches the union of the watched paths of all
+ * subscribers, without any filtering of its own. Every batch it delivers is
+ * routed to the subscribers through a trie of the watched paths: an event
+ * goes to the subscribers watching one of its ancestors, is then filtered
+ * with the excluded paths and sub-directory rule of each subscriber, and
+ * every subscriber with events left gets one call for the batch. Events which
+ * concern no watched path but the stream as a whole (dropped events, wrapped
+ * identifiers, mounts) go to every subscriber.
+ *
+ * The paths of the stream are changed in place whenever a subscriber
+ * watches a path the stream does not yet cover, without missing events of
+ * the paths it already watched; subscribers which go away only stop
+ * receiving events, their paths are dropped the next time the paths of the
+ * stream change.
+ *
+ * All subscribers share the notification latency, creation flags and backend
+ * of the multiplexer, and must not ask for events since an earlier
+ * identifier. Deliveries never overlap, so at most one delivery thread is
+ * used. The multiplexer must not be destroyed from within a handler.
+ *
+ * @since head
+ */
+class StreamMultiplexer {
+public:
+	/** The type identifying a subscriber. */
+	typedef uint64_t Subscriber;
+	
+	/** The handler a subscriber gets its batches of events with. The batch is only valid during the call. */
+	typedef std::function<void (const EventBatch &events)> SubscriberHandler;
+	
+	/** The type of the function creating a backend for every (re)created stream. */
+	typedef std::function<std::unique_ptr<Backend> ()> BackendFactory;
+	
+	/**
+	 * Returns a multiplexer creating its streams with the given backends and configuration.
+	 *
+	 * The watched and excluded paths, since identifier, sub-directory rule and checkpoint store of the configuration are ignored.
+	 */
+	StreamMultiplexer(const BackendFactory &backendFactory, const StreamConfiguration &configuration);
+	~StreamMultiplexer();
+	
+	/** @name Subscribers */
+	/**
+	 * Adds a subscriber, creating the stream or extending its paths if needed, and returns it.
+	 *
+	 * @throws StreamCreationFailure if the stream had to be created and could not be.
+	 */
+	Subscriber addSubscriber(const std::vector<std::string> &watchedPaths,
+							 const std::vector<std::string> &excludedPaths,
+							 bool ignoreEventsFromSubDirectories,
+							 const SubscriberHandler &handler);
+	
+	/**
+	 * Removes a subscriber. Once this returns its handler is not called anymore, except for the call this is made from, if any.
+	 *
+	 * May be called from within a handler, that of the subscriber removed
+	 * included. The stream is then disposed of once the subscribers change
+	 * again outside of a handler, or the multiplexer is destroyed, since it
+	 * cannot be from one of its own threads.
+	 */
+	void removeSubscriber(Subscriber subscriber);
+	
+	/**
+	 * The number of subscribers.
+	 */
+	size_t subscriberCount() const;
+	
+	/** @name Configuring subscribers */
+	/**
+	 * Changes the paths a subscriber watches, extending the paths of the stream if needed.
+	 */
+	void setWatchedPaths(Subscriber subscriber, const std::vector<std::string> &paths);
+	void setExcludedPaths(Subscriber subscriber, const std::vector<std::string> &paths);
+	
+	/**
+	 * Changes the path patterns of a subscriber.
+	 *
+	 * @throws PathPatternError if a pattern is malformed, in which case the patterns are left unchanged.
+	 */
+	void setPathPatterns(Subscriber subscriber, const std::vector<std::string> &patterns);
+	void setIgnoreEventsFromSubDirectories(Subscriber subscriber, bool flag);
+	
+	/** @name Shared stream */
+	void flushSynchronously();
+	void flushAsynchronously();
+	
+	/**
+	 * A description of the shared event stream, for debugging only.
+	 */
+	std::string description() const;
+	
+private:
+	struct Route;
+	struct Routing;
+	
+	StreamMultiplexer(const StreamMultiplexer &);
+	StreamMultiplexer &operator=(const StreamMultiplexer &);
+	
+	bool isDelivering() const { return (_deliveringThread.load() == std::this_thread::get_id()); }
+	std::shared_ptr<Route> findRoute(Subscriber subscriber) const;
+	void publishRouting();
+	bool coversPaths(const std::vector<std::string> &paths) const;
+	void updateStreamPaths();
+	void handleEvents(const EventBatch &events);
+	
+	BackendFactory							_backendFactory;
+	StreamConfiguration						_configuration;
+	
+	// Serializes changes to the subscribers and the stream.
+	mutable std::mutex						_mutex;
+	std::vector<std::shared_ptr<Route> >	_routes;
+	Subscriber								_nextSubscriber;
+	// Shared with the flushes, which wait for deliveries without the lock.
+	std::shared_ptr<Stream>					_stream;
+	// A stream left by the last subscriber removed from within a handler.
+	std::shared_ptr<Stream>					_retiredStream;
+	PathTrie								_streamPaths;
+	
+	// The thread calling the handlers, while it does.
+	std::atomic<std::thread::id>			_deliveringThread;
+	
+	// Read while delivering, never modified once published.
+	std::shared_ptr<const Routing>			_routing;
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_STREAM_MULTIPLEXER_H
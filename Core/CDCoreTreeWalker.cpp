@@ -0,0 +1,348 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreTreeWalker.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(__linux__)
+	#include <sys/syscall.h>
+#endif
+
+#include "CDCorePath.h"
+
+namespace cdevents {
+
+#pragma mark Constants
+#if defined(__linux__)
+// The buffer the entries of a directory are read into with getdents64.
+static const size_t kDirectoryBufferSize = 32768;
+#endif
+
+
+#pragma mark Walk state
+// An open directory, closed once the last of its sub-directories is opened.
+struct DirectoryHandle {
+	int descriptor;
+	
+	explicit DirectoryHandle(int descriptor) : descriptor(descriptor) {}
+	~DirectoryHandle() { close(descriptor); }
+	
+private:
+	DirectoryHandle(const DirectoryHandle &);
+	DirectoryHandle &operator=(const DirectoryHandle &);
+};
+
+// A directory waiting to be walked, opened by name relative to its parent.
+struct PendingDirectory {
+	std::shared_ptr<DirectoryHandle>	parent;
+	std::string							name;
+	std::string							path;
+};
+
+// The directories found by one thread. The thread itself takes them from
+// the back, thieves from the front.
+struct WorkQueue {
+	std::mutex						mutex;
+	std::deque<PendingDirectory>	directories;
+};
+
+struct TreeWalker::Walk {
+	const Visitor					*visitor;
+	bool							recursive;
+	std::vector<std::unique_ptr<WorkQueue> >	queues;
+	// Directories queued or being walked; the walk is done when it reaches zero.
+	std::atomic<size_t>				pending;
+	// Directories queued, which an idle thread could take.
+	std::atomic<size_t>				available;
+	std::mutex						idleMutex;
+	std::condition_variable			idle;
+};
+
+
+#pragma mark Helpers
+static void attributesFromStat(const struct stat &info, ItemAttributes &attributes)
+{
+	attributes.inode	= (uint64_t)info.st_ino;
+	attributes.size		= (uint64_t)info.st_size;
+#if defined(__APPLE__)
+	attributes.modificationTime = ((int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec);
+#else
+	attributes.modificationTime = ((int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec);
+#endif
+	attributes.type		= (S_ISDIR(info.st_mode) ? kEventFlagItemIsDir :
+						   S_ISLNK(info.st_mode) ? kEventFlagItemIsSymlink :
+						   S_ISREG(info.st_mode) ? kEventFlagItemIsFile : kEventFlagNone);
+}
+
+static bool isDotOrDotDot(const char *name)
+{
+	return (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')));
+}
+
+// Calls the function with the name of every entry of the open directory.
+template <typename Function>
+static void listDirectory(int descriptor, Function function)
+{
+#if defined(__linux__)
+	// The layout of the records getdents64 fills the buffer with.
+	struct LinuxDirent64 {
+		uint64_t		d_ino;
+		int64_t			d_off;
+		unsigned short	d_reclen;
+		unsigned char	d_type;
+		char			d_name[1];
+	};
+	
+	std::unique_ptr<char[]> buffer(new char[kDirectoryBufferSize]);
+	for (;;) {
+		const long length = syscall(SYS_getdents64, descriptor, buffer.get(), kDirectoryBufferSize);
+		if (length <= 0) {
+			if (length < 0 && errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		for (long offset = 0; offset < length; ) {
+			const LinuxDirent64 *entry = (const LinuxDirent64 *)(buffer.get() + offset);
+			offset += entry->d_reclen;
+			if (!isDotOrDotDot(entry->d_name)) {
+				function(entry->d_name);
+			}
+		}
+	}
+#else
+	// The stream takes over the descriptor it is given.
+	const int duplicate = dup(descriptor);
+	DIR *stream = (duplicate < 0 ? NULL : fdopendir(duplicate));
+	if (stream == NULL) {
+		if (duplicate >= 0) {
+			close(duplicate);
+		}
+		return;
+	}
+	
+	struct dirent *entry;
+	while ((entry = readdir(stream)) != NULL) {
+		if (!isDotOrDotDot(entry->d_name)) {
+			function(entry->d_name);
+		}
+	}
+	closedir(stream);
+#endif
+}
+
+
+#pragma mark Init/dealloc
+TreeWalker::TreeWalker(size_t threadCount)
+:	_threadCount(threadCount),
+	_cancelled(false)
+{
+	if (_threadCount == 0) {
+		_threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+}
+
+
+#pragma mark Excluding paths
+void TreeWalker::setExcludedPaths(const std::vector<std::string> &paths)
+{
+	_excludedPaths = paths;
+	_excludedTrie.clear();
+	for (size_t i = 0; i < paths.size(); ++i) {
+		_excludedTrie.insert(paths[i]);
+	}
+}
+
+bool TreeWalker::isExcluded(const std::string &path) const
+{
+	return (!_excludedTrie.empty() && _excludedTrie.containsPrefixOfPath(path));
+}
+
+
+#pragma mark Walking
+bool TreeWalker::walk(const std::vector<std::string> &paths, bool recursive, const Visitor &visitor) const
+{
+	Walk walk;
+	walk.visitor = &visitor;
+	walk.recursive = recursive;
+	walk.pending.store(0);
+	walk.available.store(0);
+	for (size_t i = 0; i < _threadCount; ++i) {
+		walk.queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+	}
+	
+	for (size_t i = 0; i < paths.size(); ++i) {
+		if (isExcluded(paths[i])) {
+			continue;
+		}
+		PendingDirectory root;
+		root.path = paths[i];
+		walk.queues[0]->directories.push_back(root);
+		++walk.pending;
+		++walk.available;
+	}
+	
+	run(walk, 0);
+	
+	return !isCancelled();
+}
+
+bool TreeWalker::readAttributes(const std::string &path, ItemAttributes &attributes)
+{
+	struct stat info;
+	if (lstat(path.c_str(), &info) != 0) {
+		return false;
+	}
+	
+	attributesFromStat(info, attributes);
+	return true;
+}
+
+
+#pragma mark Private
+void TreeWalker::run(Walk &walk, size_t thread) const
+{
+	// Only the calling thread, number 0, starts the others, and only once
+	// there is work to share.
+	std::vector<std::thread> helpers;
+	
+	for (;;) {
+		if (thread == 0 && helpers.empty() && _threadCount > 1 && walk.available.load() > 1) {
+			for (size_t i = 1; i < _threadCount; ++i) {
+				helpers.push_back(std::thread(&TreeWalker::run, this, std::ref(walk), i));
+			}
+		}
+		
+		// Take the last directory found by this thread, or steal the first
+		// one found by another.
+		PendingDirectory directory;
+		bool found = false;
+		for (size_t i = 0; i < _threadCount && !found; ++i) {
+			WorkQueue &queue = *walk.queues[(thread + i) % _threadCount];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (!queue.directories.empty()) {
+				if (i == 0) {
+					directory = std::move(queue.directories.back());
+					queue.directories.pop_back();
+				} else {
+					directory = std::move(queue.directories.front());
+					queue.directories.pop_front();
+				}
+				--walk.available;
+				found = true;
+			}
+		}
+		
+		if (!found) {
+			std::unique_lock<std::mutex> lock(walk.idleMutex);
+			walk.idle.wait(lock, [&walk]() {
+				return (walk.pending.load() == 0 || walk.available.load() > 0);
+			});
+			if (walk.pending.load() == 0) {
+				break;
+			}
+			continue;
+		}
+		
+		if (!isCancelled()) {
+			int descriptor = (directory.parent ?
+							  openat(directory.parent->descriptor, directory.name.c_str(),
+									 O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC) :
+							  open(directory.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+			if (descriptor < 0 && (errno == EMFILE || errno == ENFILE)) {
+				// Out of descriptors, held by the parents of queued directories.
+				directory.parent.reset();
+				descriptor = open(directory.path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+			}
+			directory.parent.reset();
+			
+			if (descriptor >= 0) {
+				std::shared_ptr<DirectoryHandle> handle(new DirectoryHandle(descriptor));
+				WorkQueue &queue = *walk.queues[thread];
+				size_t queued = 0;
+				
+				listDirectory(descriptor, [&](const char *name) {
+					const std::string path = pathByAppendingComponent(directory.path, name);
+					if (isExcluded(path)) {
+						return;
+					}
+					
+					struct stat info;
+					if (fstatat(descriptor, name, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+						// Vanished since it was listed.
+						return;
+					}
+					ItemAttributes attributes;
+					attributesFromStat(info, attributes);
+					(*walk.visitor)(thread, path, attributes);
+					
+					if (walk.recursive && attributes.type == kEventFlagItemIsDir) {
+						PendingDirectory child;
+						child.parent	= handle;
+						child.name		= name;
+						child.path		= path;
+						
+						std::lock_guard<std::mutex> lock(queue.mutex);
+						queue.directories.push_back(std::move(child));
+						++walk.pending;
+						++walk.available;
+						++queued;
+					}
+				});
+				
+				if (queued > 0) {
+					std::lock_guard<std::mutex> lock(walk.idleMutex);
+					walk.idle.notify_all();
+				}
+			}
+		}
+		
+		if (--walk.pending == 0) {
+			std::lock_guard<std::mutex> lock(walk.idleMutex);
+			walk.idle.notify_all();
+		}
+	}
+	
+	for (size_t i = 0; i < helpers.size(); ++i) {
+		helpers[i].join();
+	}
+}
+
+} // namespace cdevents
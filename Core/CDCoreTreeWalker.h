@@ -0,0 +1,155 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreTreeWalker.h
+ * A parallel walker of directory trees, used to rescan the watched paths.
+ */
+
+#ifndef CD_CORE_TREE_WALKER_H
+#define CD_CORE_TREE_WALKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "CDCoreEvent.h"
+#include "CDCorePathTrie.h"
+
+namespace cdevents {
+
+/**
+ * The attributes of a file system item which tell whether it changed.
+ *
+ * @since head
+ */
+struct ItemAttributes {
+	/** The inode number of the item. */
+	uint64_t	inode;
+	/** The size of the item in bytes. */
+	uint64_t	size;
+	/** The modification time of the item, in nanoseconds since 1970. */
+	int64_t		modificationTime;
+	/** The type of the item, one of kEventFlagItemIsFile, kEventFlagItemIsDir, kEventFlagItemIsSymlink or kEventFlagNone. */
+	EventFlags	type;
+	
+	ItemAttributes() : inode(0), size(0), modificationTime(0), type(kEventFlagNone) {}
+};
+
+
+/**
+ * Walks directory trees with a pool of threads.
+ *
+ * Each thread walks the directories it finds itself, depth first, and when it
+ * runs out of work it steals the directories found first by another thread,
+ * so that the threads keep to separate parts of the trees. Directories are
+ * opened relative to their parent and their items read with directory
+ * relative calls (getdents64 and fstatat on Linux), so no path is resolved
+ * more than once. Excluded paths are pruned without being descended into.
+ *
+ * Helper threads are only started once a walk turns out to have more than
+ * one directory left to walk, so small walks stay on the calling thread.
+ *
+ * @since head
+ */
+class TreeWalker {
+public:
+	/**
+	 * The function items are reported to, with the index of the thread which found it (less than threadCount()).
+	 *
+	 * It is called concurrently from all the threads of the walk.
+	 */
+	typedef std::function<void (size_t thread, const std::string &path, const ItemAttributes &attributes)> Visitor;
+	
+	/**
+	 * Returns a walker using up to <em>threadCount</em> threads, the calling one included, or one per processor if 0.
+	 */
+	explicit TreeWalker(size_t threadCount = 0);
+	
+	/**
+	 * The number of threads a walk may use.
+	 */
+	size_t threadCount() const { return _threadCount; }
+	
+	/** @name Excluding paths */
+	/**
+	 * The standardized paths which are neither reported nor walked.
+	 */
+	void setExcludedPaths(const std::vector<std::string> &paths);
+	const std::vector<std::string> &excludedPaths() const { return _excludedPaths; }
+	
+	/**
+	 * Whether the given standardized path is, or is below, an excluded path.
+	 */
+	bool isExcluded(const std::string &path) const;
+	
+	/** @name Walking */
+	/**
+	 * Reports every item below the given standardized paths to the visitor, blocking until all have been.
+	 *
+	 * The paths themselves are not reported. The attributes of symbolic links
+	 * are those of the link, and links are not followed. With
+	 * <em>recursive</em> false only the items directly in the paths are.
+	 *
+	 * @return <code>false</code> if the walk was cancelled before it was done.
+	 */
+	bool walk(const std::vector<std::string> &paths, bool recursive, const Visitor &visitor) const;
+	
+	/**
+	 * Makes running and future walks stop as soon as possible. May be called from any thread.
+	 */
+	void cancel() const { _cancelled.store(true); }
+	bool isCancelled() const { return _cancelled.load(); }
+	
+	/**
+	 * Reads the attributes of the item at the given path, without following a symbolic link.
+	 *
+	 * @return <code>false</code> if there is no such item.
+	 */
+	static bool readAttributes(const std::string &path, ItemAttributes &attributes);
+	
+private:
+	struct Walk;
+	
+	TreeWalker(const TreeWalker &);
+	TreeWalker &operator=(const TreeWalker &);
+	
+	void run(Walk &walk, size_t thread) const;
+	
+	size_t						_threadCount;
+	std::vector<std::string>	_excludedPaths;
+	PathTrie					_excludedTrie;
+	mutable std::atomic<bool>	_cancelled;
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_TREE_WALKER_H
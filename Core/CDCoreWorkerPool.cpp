@@ -0,0 +1,135 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CDCoreWorkerPool.h"
+
+namespace cdevents {
+
+#pragma mark Init/dealloc
+WorkerPool::WorkerPool(size_t threadCount, size_t capacity)
+:	_tasks(capacity > 0 ? capacity : 1),
+	_head(0),
+	_count(0),
+	_running(0),
+	_stopping(false)
+{
+	if (threadCount == 0) {
+		threadCount = 1;
+	}
+	
+	_threads.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; ++i) {
+		_threads.push_back(std::thread(&WorkerPool::run, this));
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_taskAvailable.notify_all();
+	
+	for (size_t i = 0; i < _threads.size(); ++i) {
+		_threads[i].join();
+	}
+}
+
+
+#pragma mark Tasks
+void WorkerPool::submit(const Task &task)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_spaceAvailable.wait(lock, [this]() {
+		return (_count < _tasks.size());
+	});
+	
+	_tasks[(_head + _count) % _tasks.size()] = task;
+	++_count;
+	lock.unlock();
+	
+	_taskAvailable.notify_one();
+}
+
+void WorkerPool::waitUntilIdle()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle.wait(lock, [this]() {
+		return (_count == 0 && _running == 0);
+	});
+}
+
+bool WorkerPool::isWorkerThread() const
+{
+	const std::thread::id current = std::this_thread::get_id();
+	for (size_t i = 0; i < _threads.size(); ++i) {
+		if (_threads[i].get_id() == current) {
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+
+#pragma mark Worker threads
+void WorkerPool::run()
+{
+	Task task;
+	
+	std::unique_lock<std::mutex> lock(_mutex);
+	for (;;) {
+		_taskAvailable.wait(lock, [this]() {
+			return (_count > 0 || _stopping);
+		});
+		// Queued tasks are still run when stopping.
+		if (_count == 0) {
+			break;
+		}
+		
+		// Swapped out so that the slot does not keep the task's captures alive.
+		task.swap(_tasks[_head]);
+		_head = (_head + 1) % _tasks.size();
+		--_count;
+		++_running;
+		lock.unlock();
+		_spaceAvailable.notify_one();
+		
+		task();
+		task = nullptr;
+		
+		lock.lock();
+		--_running;
+		if (_count == 0 && _running == 0) {
+			_idle.notify_all();
+		}
+	}
+}
+
+} // namespace cdevents
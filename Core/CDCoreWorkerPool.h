@@ -0,0 +1,111 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreWorkerPool.h
+ * A fixed size pool of threads working off a bounded queue of tasks.
+ */
+
+#ifndef CD_CORE_WORKER_POOL_H
+#define CD_CORE_WORKER_POOL_H
+
+#include <stddef.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cdevents {
+
+/**
+ * A fixed number of threads running tasks from a bounded queue.
+ *
+ * Tasks are started in the order they are submitted but, with more than one
+ * thread, may run concurrently and finish in any order. The queue is a ring
+ * allocated up front; submitting to a full queue blocks until a thread has
+ * picked up a task, which pushes back on whoever produces the tasks instead of
+ * letting the queue grow without bound.
+ *
+ * @since head
+ */
+class WorkerPool {
+public:
+	/** The type of the tasks run by the pool. */
+	typedef std::function<void ()> Task;
+	
+	/**
+	 * Returns a pool of <em>threadCount</em> threads (at least one) with room for <em>capacity</em> (at least one) queued tasks.
+	 */
+	WorkerPool(size_t threadCount, size_t capacity);
+	
+	/**
+	 * Runs the queued tasks and joins the threads.
+	 */
+	~WorkerPool();
+	
+	/**
+	 * Queues a task, blocking while the queue is full. Must not be called from a task.
+	 */
+	void submit(const Task &task);
+	
+	/**
+	 * Blocks until the queue is empty and no task is running. Must not be called from a task.
+	 */
+	void waitUntilIdle();
+	
+	/**
+	 * Whether the calling thread is one of the threads of the pool.
+	 */
+	bool isWorkerThread() const;
+	
+	size_t threadCount() const { return _threads.size(); }
+	size_t capacity() const { return _tasks.size(); }
+	
+private:
+	WorkerPool(const WorkerPool &);
+	WorkerPool &operator=(const WorkerPool &);
+	
+	void run();
+	
+	std::vector<std::thread>	_threads;
+	
+	std::mutex					_mutex;
+	std::condition_variable		_taskAvailable;
+	std::condition_variable		_spaceAvailable;
+	std::condition_variable		_idle;
+	std::vector<Task>			_tasks;
+	size_t						_head;
+	size_t						_count;
+	size_t						_running;
+	bool						_stopping;
+};
+
+} // namespace cdevents
+
+#endif // CD_CORE_WORKER_POOL_H
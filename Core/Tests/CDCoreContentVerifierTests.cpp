@@ -0,0 +1,187 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests that modifications leaving the contents of a file as they were are
+ * suppressed, and everything else delivered with the hash of the file.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "CDCoreContentVerifier.h"
+#include "CDCoreTestSupport.h"
+
+using namespace cdevents;
+
+
+#pragma mark Helpers
+static void writeFile(const std::string &path, const std::string &contents)
+{
+	FILE *file = fopen(path.c_str(), "w");
+	if (file == NULL) {
+		perror(path.c_str());
+		exit(EXIT_FAILURE);
+	}
+	fwrite(contents.data(), 1, contents.size(), file);
+	fclose(file);
+}
+
+static void touchFile(const std::string &path)
+{
+	if (utimes(path.c_str(), NULL) != 0) {
+		perror(path.c_str());
+		exit(EXIT_FAILURE);
+	}
+}
+
+// Verifies one event of the file at the given path, leaving what is delivered in verified.
+static void verifyEvent(ContentVerifier &verifier, const std::string &path, EventFlags flags, EventBatch &verified)
+{
+	EventBatch events;
+	events.append(1, (flags | kEventFlagItemIsFile), 0.0, path.data(), path.size());
+	verifier.verify(events, verified);
+}
+
+
+#pragma mark Cases
+static void testSuppressesUnchangedContents()
+{
+	test::TemporaryDirectory directory;
+	const std::string path = directory.path() + "/file";
+	writeFile(path, "contents");
+	
+	ContentVerifier verifier;
+	EventBatch verified;
+	
+	// Nothing is known of the file yet.
+	verifyEvent(verifier, path, kEventFlagItemModified, verified);
+	CD_CHECK(verified.size() == 1);
+	const uint64_t hash = (verified.empty() ? 0 : verified[0].contentHash);
+	CD_CHECK(hash != 0);
+	
+	touchFile(path);
+	verifyEvent(verifier, path, kEventFlagItemModified | kEventFlagItemInodeMetaMod, verified);
+	CD_CHECK(verified.empty());
+	
+	writeFile(path, "contents");
+	verifyEvent(verifier, path, kEventFlagItemModified, verified);
+	CD_CHECK(verified.empty());
+	
+	writeFile(path, "other contents");
+	verifyEvent(verifier, path, kEventFlagItemModified, verified);
+	CD_CHECK(verified.size() == 1);
+	CD_CHECK(!verified.empty() && verified[0].contentHash != 0 && verified[0].contentHash != hash);
+	
+	const ContentVerificationStatistics statistics = verifier.statistics();
+	CD_CHECK(statistics.filesHashed == 4);
+	CD_CHECK(statistics.eventsSuppressed == 2);
+	CD_CHECK(statistics.bytesHashed == 3 * strlen("contents") + strlen("other contents"));
+}
+
+static void testDeliversOtherChanges()
+{
+	test::TemporaryDirectory directory;
+	const std::string path = directory.path() + "/file";
+	writeFile(path, "contents");
+	
+	ContentVerifier verifier;
+	EventBatch verified;
+	verifyEvent(verifier, path, kEventFlagItemCreated, verified);
+	CD_CHECK(verified.size() == 1);
+	
+	// Worth delivering whatever the contents.
+	verifyEvent(verifier, path, kEventFlagItemModified | kEventFlagItemRenamed, verified);
+	CD_CHECK(verified.size() == 1);
+	verifyEvent(verifier, path, kEventFlagItemChangeOwner, verified);
+	CD_CHECK(verified.size() == 1);
+	
+	// A removed file is forgotten, so the first modification after it is back is delivered.
+	CD_CHECK(unlink(path.c_str()) == 0);
+	verifyEvent(verifier, path, kEventFlagItemRemoved, verified);
+	CD_CHECK(verified.size() == 1);
+	CD_CHECK(verifier.size() == 0);
+	writeFile(path, "contents");
+	verifyEvent(verifier, path, kEventFlagItemModified, verified);
+	CD_CHECK(verified.size() == 1);
+}
+
+static void testLeavesLargeFilesUnhashed()
+{
+	test::TemporaryDirectory directory;
+	const std::string path = directory.path() + "/file";
+	writeFile(path, std::string(64, 'x'));
+	
+	ContentVerifier verifier(16);
+	EventBatch verified;
+	for (int i = 0; i < 2; ++i) {
+		verifyEvent(verifier, path, kEventFlagItemModified, verified);
+		CD_CHECK(verified.size() == 1);
+		CD_CHECK(!verified.empty() && verified[0].contentHash == 0);
+	}
+	CD_CHECK(verifier.statistics().filesHashed == 0);
+}
+
+static void testHashesWithThreads()
+{
+	test::TemporaryDirectory directory;
+	ContentVerifier verifier(kDefaultContentVerificationSizeLimit, 4);
+	EventBatch events;
+	EventBatch verified;
+	
+	for (int i = 0; i < 32; ++i) {
+		const std::string path = directory.path() + "/" + std::to_string(i);
+		writeFile(path, "contents " + std::to_string(i % 2));
+		events.append(i + 1, (kEventFlagItemModified | kEventFlagItemIsFile), 0.0, path.data(), path.size());
+	}
+	verifier.verify(events, verified);
+	CD_CHECK(verified.size() == 32);
+	
+	// Every other file rewritten with other contents.
+	for (int i = 0; i < 32; i += 2) {
+		writeFile(directory.path() + "/" + std::to_string(i), "changed");
+	}
+	verifier.verify(events, verified);
+	CD_CHECK(verified.size() == 16);
+	CD_CHECK(verifier.statistics().eventsSuppressed == 16);
+}
+
+
+int main()
+{
+	testSuppressesUnchangedContents();
+	testDeliversOtherChanges();
+	testLeavesLargeFilesUnhashed();
+	testHashesWithThreads();
+	
+	return test::testResult();
+}
@@ -0,0 +1,310 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests the differences rescans report, and that snapshots survive being
+ * written to a file and mapped back while damaged files are rejected.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CDCoreDirectorySnapshot.h"
+#include "CDCoreTestSupport.h"
+
+using namespace cdevents;
+
+
+#pragma mark Helpers
+typedef std::vector<std::pair<std::string, EventFlags> > Changes;
+
+static void makeDirectory(const std::string &path)
+{
+	if (mkdir(path.c_str(), 0755) != 0) {
+		perror(path.c_str());
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void writeFile(const std::string &path, const std::string &contents)
+{
+	FILE *file = fopen(path.c_str(), "w");
+	if (file == NULL) {
+		perror(path.c_str());
+		exit(EXIT_FAILURE);
+	}
+	fwrite(contents.data(), 1, contents.size(), file);
+	fclose(file);
+}
+
+static void removeTree(const std::string &path)
+{
+	const std::string command = "rm -rf '" + path + "'";
+	if (system(command.c_str()) != 0) {
+		fprintf(stderr, "Could not remove %s\n", path.c_str());
+		exit(EXIT_FAILURE);
+	}
+}
+
+static std::string readFile(const std::string &path)
+{
+	std::string contents;
+	FILE *file = fopen(path.c_str(), "rb");
+	if (file == NULL) {
+		return contents;
+	}
+	char buffer[4096];
+	size_t length;
+	while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		contents.append(buffer, length);
+	}
+	fclose(file);
+	return contents;
+}
+
+static Changes rescan(DirectorySnapshot &snapshot, const std::string &path, bool recursive)
+{
+	Changes changes;
+	const TreeWalker walker(2);
+	snapshot.rescan(path, recursive, walker, [&changes](const std::string &changed, EventFlags flags) {
+		changes.push_back(std::make_pair(changed, flags));
+	});
+	return changes;
+}
+
+// Returns the index of the given change, or the number of changes if it was not reported.
+static size_t indexOfChange(const Changes &changes, const std::string &path, EventFlags flags)
+{
+	size_t index = 0;
+	while (index < changes.size() && (changes[index].first != path || changes[index].second != flags)) {
+		++index;
+	}
+	return index;
+}
+
+static bool hasChange(const Changes &changes, const std::string &path, EventFlags flags)
+{
+	return (indexOfChange(changes, path, flags) < changes.size());
+}
+
+static bool hasEntry(const DirectorySnapshot &snapshot, const std::string &path)
+{
+	SnapshotEntry entry;
+	return snapshot.entry(path, entry);
+}
+
+static const EventFlags kCreatedFile		= (kEventFlagItemCreated | kEventFlagItemIsFile);
+static const EventFlags kRemovedFile		= (kEventFlagItemRemoved | kEventFlagItemIsFile);
+static const EventFlags kCreatedDirectory	= (kEventFlagItemCreated | kEventFlagItemIsDir);
+static const EventFlags kRemovedDirectory	= (kEventFlagItemRemoved | kEventFlagItemIsDir);
+
+
+#pragma mark Cases
+static void testReportsReplacedDirectories()
+{
+	test::TemporaryDirectory directory;
+	const std::string root = directory.path();
+	makeDirectory(root + "/a");
+	writeFile(root + "/a/old", "old");
+	
+	DirectorySnapshot snapshot;
+	rescan(snapshot, root, true);
+	CD_CHECK(snapshot.size() == 3);
+	
+	// The replacement exists before the original is removed, so it cannot reuse its inode.
+	makeDirectory(root + "/b");
+	writeFile(root + "/b/new", "new");
+	removeTree(root + "/a");
+	CD_CHECK(rename((root + "/b").c_str(), (root + "/a").c_str()) == 0);
+	
+	const Changes changes = rescan(snapshot, root, false);
+	CD_CHECK(changes.size() == 4);
+	CD_CHECK(hasChange(changes, root + "/a/old", kRemovedFile));
+	CD_CHECK(hasChange(changes, root + "/a/new", kCreatedFile));
+	CD_CHECK(indexOfChange(changes, root + "/a", kRemovedDirectory) < indexOfChange(changes, root + "/a", kCreatedDirectory));
+	CD_CHECK(hasChange(changes, root + "/a", kCreatedDirectory));
+	
+	CD_CHECK(snapshot.size() == 3);
+	CD_CHECK(!hasEntry(snapshot, root + "/a/old"));
+	CD_CHECK(hasEntry(snapshot, root + "/a/new"));
+}
+
+static void testWalksNewSubtreesOnShallowRescans()
+{
+	test::TemporaryDirectory directory;
+	const std::string root = directory.path();
+	writeFile(root + "/file", "file");
+	
+	DirectorySnapshot snapshot;
+	rescan(snapshot, root, true);
+	
+	makeDirectory(root + "/a");
+	makeDirectory(root + "/a/b");
+	writeFile(root + "/a/b/file", "file");
+	
+	// Nothing was known below the new directory, so all of it is reported.
+	const Changes changes = rescan(snapshot, root, false);
+	CD_CHECK(changes.size() == 3);
+	CD_CHECK(hasChange(changes, root + "/a", kCreatedDirectory));
+	CD_CHECK(hasChange(changes, root + "/a/b", kCreatedDirectory));
+	CD_CHECK(hasChange(changes, root + "/a/b/file", kCreatedFile));
+	
+	CD_CHECK(snapshot.size() == 5);
+	CD_CHECK(hasEntry(snapshot, root + "/a/b/file"));
+}
+
+static void testDropsRemovedSubtrees()
+{
+	test::TemporaryDirectory directory;
+	const std::string root = directory.path();
+	writeFile(root + "/file", "file");
+	makeDirectory(root + "/a");
+	makeDirectory(root + "/a/b");
+	writeFile(root + "/a/b/file", "file");
+	
+	DirectorySnapshot snapshot;
+	rescan(snapshot, root, true);
+	CD_CHECK(snapshot.size() == 5);
+	
+	removeTree(root + "/a");
+	
+	const Changes changes = rescan(snapshot, root, false);
+	CD_CHECK(changes.size() == 3);
+	CD_CHECK(hasChange(changes, root + "/a", kRemovedDirectory));
+	CD_CHECK(hasChange(changes, root + "/a/b", kRemovedDirectory));
+	CD_CHECK(hasChange(changes, root + "/a/b/file", kRemovedFile));
+	
+	CD_CHECK(snapshot.size() == 2);
+	CD_CHECK(!hasEntry(snapshot, root + "/a/b"));
+	CD_CHECK(!hasEntry(snapshot, root + "/a/b/file"));
+	CD_CHECK(hasEntry(snapshot, root + "/file"));
+}
+
+static void testRoundTripsThroughFiles()
+{
+	test::TemporaryDirectory directory;
+	test::TemporaryDirectory storage;
+	const std::string root = directory.path();
+	const std::string file = storage.path() + "/snapshot";
+	makeDirectory(root + "/a");
+	writeFile(root + "/a/file", "file");
+	writeFile(root + "/b", "b");
+	
+	DirectorySnapshot snapshot;
+	rescan(snapshot, root, true);
+	
+	// A change only in the overlay is saved too.
+	writeFile(root + "/c", "c");
+	snapshot.update(root + "/c");
+	CD_CHECK(snapshot.save(file));
+	
+	DirectorySnapshot loaded;
+	CD_CHECK(loaded.load(file));
+	CD_CHECK(loaded.size() == snapshot.size());
+	
+	const char *paths[] = { "", "/a", "/a/file", "/b", "/c" };
+	for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); ++i) {
+		SnapshotEntry expected;
+		SnapshotEntry entry;
+		CD_CHECK(snapshot.entry(root + paths[i], expected));
+		CD_CHECK(loaded.entry(root + paths[i], entry));
+		CD_CHECK(entry.inode == expected.inode && entry.type == expected.type &&
+				 entry.size == expected.size && entry.modificationTime == expected.modificationTime);
+	}
+	
+	// The loaded snapshot describes the tree as it is.
+	CD_CHECK(rescan(loaded, root, true).empty());
+}
+
+static void testRejectsDamagedFiles()
+{
+	test::TemporaryDirectory directory;
+	test::TemporaryDirectory storage;
+	const std::string root = directory.path();
+	const std::string file = storage.path() + "/snapshot";
+	writeFile(root + "/a", "a");
+	writeFile(root + "/b", "b");
+	
+	DirectorySnapshot snapshot;
+	rescan(snapshot, root, true);
+	CD_CHECK(snapshot.save(file));
+	const std::string contents = readFile(file);
+	CD_CHECK(contents.size() > 1);
+	
+	DirectorySnapshot loaded;
+	writeFile(root + "/c", "c");
+	rescan(loaded, root, true);
+	CD_CHECK(loaded.size() == 4);
+	
+	// A truncated file is rejected, and the snapshot left as it was.
+	writeFile(file, contents.substr(0, contents.size() - 1));
+	CD_CHECK(!loaded.load(file));
+	CD_CHECK(loaded.size() == 4);
+	CD_CHECK(hasEntry(loaded, root + "/c"));
+	
+	// So is one whose records are out of order, though each is valid: the
+	// header holds the magic and the record and path byte counts, and the
+	// last two records are swapped.
+	uint64_t counts[2];
+	memcpy(counts, contents.data() + 8, sizeof(counts));
+	const size_t headerBytes = 8 + sizeof(counts);
+	const size_t recordBytes = (size_t)((contents.size() - headerBytes - counts[1]) / counts[0]);
+	CD_CHECK(counts[0] == 3);
+	std::string reordered = contents;
+	const size_t last = headerBytes + 2 * recordBytes;
+	reordered.replace(last - recordBytes, recordBytes, contents, last, recordBytes);
+	reordered.replace(last, recordBytes, contents, last - recordBytes, recordBytes);
+	writeFile(file, reordered);
+	CD_CHECK(!loaded.load(file));
+	CD_CHECK(loaded.size() == 4);
+	
+	// The intact file is still accepted.
+	writeFile(file, contents);
+	CD_CHECK(loaded.load(file));
+	CD_CHECK(loaded.size() == 3);
+	CD_CHECK(!hasEntry(loaded, root + "/c"));
+}
+
+
+int main()
+{
+	testReportsReplacedDirectories();
+	testWalksNewSubtreesOnShallowRescans();
+	testDropsRemovedSubtrees();
+	testRoundTripsThroughFiles();
+	testRejectsDamagedFiles();
+	
+	return test::testResult();
+}
@@ -0,0 +1,185 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests how the events of a batch are merged per path, where runs of events
+ * end, and that events about the stream are left alone.
+ */
+
+#include <string.h>
+
+#include "CDCoreEventCoalescer.h"
+#include "CDCoreTestSupport.h"
+
+using namespace cdevents;
+
+
+#pragma mark Helpers
+static void appendEvent(EventBatch &batch, EventIdentifier identifier, EventFlags flags, const char *path)
+{
+	batch.append(identifier, flags, 0.0, path, strlen(path));
+}
+
+static bool hasEvent(const EventBatch &batch, size_t index, EventIdentifier identifier, EventFlags flags, const char *path)
+{
+	return (index < batch.size() &&
+			batch[index].identifier == identifier &&
+			batch[index].flags == flags &&
+			strcmp(batch.path(index), path) == 0);
+}
+
+static const EventFlags kCreatedFile	= (kEventFlagItemCreated | kEventFlagItemIsFile);
+static const EventFlags kModifiedFile	= (kEventFlagItemModified | kEventFlagItemIsFile);
+static const EventFlags kRemovedFile	= (kEventFlagItemRemoved | kEventFlagItemIsFile);
+static const EventFlags kRenamedFile	= (kEventFlagItemRenamed | kEventFlagItemIsFile);
+
+
+#pragma mark Cases
+static void testMergesEventsPerPath()
+{
+	EventBatch events;
+	appendEvent(events, 1, kModifiedFile, "/a");
+	appendEvent(events, 2, kEventFlagItemInodeMetaMod | kEventFlagItemIsFile, "/a");
+	appendEvent(events, 3, kModifiedFile, "/b");
+	appendEvent(events, 4, kModifiedFile, "/a");
+	
+	EventCoalescer coalescer;
+	EventBatch coalesced;
+	coalescer.coalesce(events, coalesced);
+	
+	// The merged event takes the identifier and place of the last one.
+	CD_CHECK(coalesced.size() == 2);
+	CD_CHECK(hasEvent(coalesced, 0, 3, kModifiedFile, "/b"));
+	CD_CHECK(hasEvent(coalesced, 1, 4, kModifiedFile | kEventFlagItemInodeMetaMod, "/a"));
+}
+
+static void testEndsRunsOnRemovalAndRename()
+{
+	EventBatch events;
+	appendEvent(events, 1, kModifiedFile, "/a");
+	appendEvent(events, 2, kRenamedFile, "/a");
+	appendEvent(events, 3, kModifiedFile, "/a");
+	appendEvent(events, 4, kRemovedFile, "/a");
+	appendEvent(events, 5, kModifiedFile, "/a");
+	
+	EventCoalescer coalescer;
+	EventBatch coalesced;
+	coalescer.coalesce(events, coalesced);
+	
+	CD_CHECK(coalesced.size() == 3);
+	CD_CHECK(hasEvent(coalesced, 0, 2, kModifiedFile | kRenamedFile, "/a"));
+	CD_CHECK(hasEvent(coalesced, 1, 4, kModifiedFile | kRemovedFile, "/a"));
+	CD_CHECK(hasEvent(coalesced, 2, 5, kModifiedFile, "/a"));
+}
+
+static void testKeepsCreationBeforeRemovalTogether()
+{
+	EventBatch events;
+	appendEvent(events, 1, kCreatedFile, "/a");
+	appendEvent(events, 2, kModifiedFile, "/a");
+	appendEvent(events, 3, kRemovedFile, "/a");
+	
+	EventCoalescer coalescer;
+	EventBatch coalesced;
+	coalescer.coalesce(events, coalesced);
+	
+	// The item came and went within the batch.
+	CD_CHECK(coalesced.size() == 1);
+	CD_CHECK(hasEvent(coalesced, 0, 3, kCreatedFile | kModifiedFile | kRemovedFile, "/a"));
+}
+
+static void testKeepsRemovalBeforeCreationApart()
+{
+	EventBatch events;
+	appendEvent(events, 1, kRemovedFile, "/a");
+	appendEvent(events, 2, kCreatedFile, "/a");
+	appendEvent(events, 3, kModifiedFile, "/a");
+	
+	EventCoalescer coalescer;
+	EventBatch coalesced;
+	coalescer.coalesce(events, coalesced);
+	
+	// The old item is gone and a new one is there.
+	CD_CHECK(coalesced.size() == 2);
+	CD_CHECK(hasEvent(coalesced, 0, 1, kRemovedFile, "/a"));
+	CD_CHECK(hasEvent(coalesced, 1, 3, kCreatedFile | kModifiedFile, "/a"));
+}
+
+static void testNeverMergesStreamEvents()
+{
+	EventBatch events;
+	appendEvent(events, 1, kModifiedFile, "/a");
+	appendEvent(events, 2, kEventFlagMustScanSubDirs | kEventFlagUserDropped, "/a");
+	appendEvent(events, 3, kEventFlagMustScanSubDirs | kEventFlagUserDropped, "/a");
+	appendEvent(events, 4, kEventFlagRootChanged, "/a");
+	appendEvent(events, 5, kModifiedFile, "/a");
+	appendEvent(events, 6, kEventFlagHistoryDone, "/a");
+	
+	EventCoalescer coalescer;
+	EventBatch coalesced;
+	coalescer.coalesce(events, coalesced);
+	
+	// Each stays on its own and in its place, and their flags are not
+	// merged into the events of the item.
+	CD_CHECK(coalesced.size() == 5);
+	CD_CHECK(hasEvent(coalesced, 0, 2, kEventFlagMustScanSubDirs | kEventFlagUserDropped, "/a"));
+	CD_CHECK(hasEvent(coalesced, 1, 3, kEventFlagMustScanSubDirs | kEventFlagUserDropped, "/a"));
+	CD_CHECK(hasEvent(coalesced, 2, 4, kEventFlagRootChanged, "/a"));
+	CD_CHECK(hasEvent(coalesced, 3, 5, kModifiedFile, "/a"));
+	CD_CHECK(hasEvent(coalesced, 4, 6, kEventFlagHistoryDone, "/a"));
+}
+
+static void testKeepsSourcePathOfRenames()
+{
+	EventBatch events;
+	events.append(1, kRenamedFile, 0.0, "/b", 2, "/a", 2);
+	appendEvent(events, 2, kModifiedFile, "/b");
+	
+	EventCoalescer coalescer;
+	EventBatch coalesced;
+	coalescer.coalesce(events, coalesced);
+	
+	// The rename ends the run of the source, the destination goes on.
+	CD_CHECK(coalesced.size() == 2);
+	CD_CHECK(hasEvent(coalesced, 0, 1, kRenamedFile, "/b"));
+	CD_CHECK(!coalesced.empty() && coalesced.sourcePath(0) != NULL && strcmp(coalesced.sourcePath(0), "/a") == 0);
+	CD_CHECK(hasEvent(coalesced, 1, 2, kModifiedFile, "/b"));
+}
+
+
+int main()
+{
+	testMergesEventsPerPath();
+	testEndsRunsOnRemovalAndRename();
+	testKeepsCreationBeforeRemovalTogether();
+	testKeepsRemovalBeforeCreationApart();
+	testNeverMergesStreamEvents();
+	testKeepsSourcePathOfRenames();
+	
+	return test::testResult();
+}
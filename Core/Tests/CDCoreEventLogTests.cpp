@@ -0,0 +1,237 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests that batches recorded to an event log are played back into a stream
+ * with their paths, flags and identifiers intact, and that the damaged end of
+ * a log is not read.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "CDCoreEventLog.h"
+#include "CDCorePlaybackBackend.h"
+#include "CDCoreStream.h"
+#include "CDCoreTestSupport.h"
+
+using namespace cdevents;
+
+
+#pragma mark Helpers
+/** An event as recorded or delivered, with its path copied. */
+struct LoggedEvent {
+	EventFlags		flags;
+	EventIdentifier	identifier;
+	std::string		path;
+};
+
+static void writeFile(const std::string &path, const std::string &contents)
+{
+	FILE *file = fopen(path.c_str(), "wb");
+	if (file == NULL) {
+		perror(path.c_str());
+		exit(EXIT_FAILURE);
+	}
+	fwrite(contents.data(), 1, contents.size(), file);
+	fclose(file);
+}
+
+static std::string readFile(const std::string &path)
+{
+	std::string contents;
+	FILE *file = fopen(path.c_str(), "rb");
+	if (file == NULL) {
+		return contents;
+	}
+	char buffer[4096];
+	size_t length;
+	while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		contents.append(buffer, length);
+	}
+	fclose(file);
+	return contents;
+}
+
+static void record(EventRecorder &recorder, const std::vector<LoggedEvent> &batch)
+{
+	std::vector<RawEvent> events(batch.size());
+	for (size_t i = 0; i < batch.size(); ++i) {
+		events[i].path			= batch[i].path.c_str();
+		events[i].pathLength	= batch[i].path.size();
+		events[i].flags			= batch[i].flags;
+		events[i].identifier	= batch[i].identifier;
+		events[i].renameCookie	= 0;
+	}
+	recorder.record(events.data(), events.size());
+}
+
+static LoggedEvent loggedEvent(const std::string &path, EventFlags flags, EventIdentifier identifier)
+{
+	LoggedEvent event;
+	event.flags			= flags;
+	event.identifier	= identifier;
+	event.path			= path;
+	return event;
+}
+
+static bool isSameEvent(const LoggedEvent &a, const LoggedEvent &b)
+{
+	return (a.flags == b.flags && a.identifier == b.identifier && a.path == b.path);
+}
+
+// Batches whose paths share prefixes, and whose identifiers go back as well as forward.
+static std::vector<std::vector<LoggedEvent> > sampleBatches(const std::string &directory)
+{
+	std::vector<std::vector<LoggedEvent> > batches(3);
+	batches[0].push_back(loggedEvent(directory + "/a/file", kEventFlagItemCreated | kEventFlagItemIsFile, 100));
+	batches[0].push_back(loggedEvent(directory + "/a/file", kEventFlagItemModified | kEventFlagItemIsFile, 101));
+	batches[0].push_back(loggedEvent(directory + "/a", kEventFlagItemInodeMetaMod | kEventFlagItemIsDir, 102));
+	batches[1].push_back(loggedEvent(directory + "/b/some longer name", kEventFlagItemRenamed | kEventFlagItemIsFile, 90));
+	batches[2].push_back(loggedEvent(directory + "/b", kEventFlagItemRemoved | kEventFlagItemIsDir, (EventIdentifier)1 << 40));
+	batches[2].push_back(loggedEvent(directory + "/c", kEventFlagItemCreated | kEventFlagItemIsSymlink, 7));
+	return batches;
+}
+
+
+#pragma mark Cases
+static void testPlaysBackRecordedBatches()
+{
+	test::TemporaryDirectory directory;
+	const std::string file = directory.path() + "/events.log";
+	const std::vector<std::vector<LoggedEvent> > batches = sampleBatches(directory.path());
+	
+	EventRecorder recorder;
+	CD_CHECK(recorder.open(file));
+	for (size_t i = 0; i < batches.size(); ++i) {
+		record(recorder, batches[i]);
+	}
+	CD_CHECK(recorder.batchCount() == batches.size());
+	CD_CHECK(recorder.close());
+	
+	StreamConfiguration configuration;
+	configuration.watchedPaths.push_back(directory.path());
+	
+	std::mutex mutex;
+	std::vector<std::vector<LoggedEvent> > delivered;
+	Stream stream(std::unique_ptr<Backend>(new PlaybackBackend(file, 0.0)), configuration,
+				  [&mutex, &delivered](Stream &stream, const EventBatch &events) {
+		(void)stream;
+		std::lock_guard<std::mutex> lock(mutex);
+		delivered.push_back(std::vector<LoggedEvent>());
+		for (size_t i = 0; i < events.size(); ++i) {
+			delivered.back().push_back(loggedEvent(events.path(i), events[i].flags, events[i].identifier));
+		}
+	});
+	stream.create();
+	PlaybackBackend &backend = static_cast<PlaybackBackend &>(stream.backend());
+	backend.waitUntilFinished();
+	backend.flushSynchronously();
+	CD_CHECK(backend.batchCount() == batches.size());
+	CD_CHECK(backend.currentEventIdentifier() == batches.back().back().identifier);
+	stream.dispose();
+	
+	std::lock_guard<std::mutex> lock(mutex);
+	CD_CHECK(delivered.size() == batches.size());
+	for (size_t i = 0; i < delivered.size() && i < batches.size(); ++i) {
+		CD_CHECK(delivered[i].size() == batches[i].size());
+		for (size_t j = 0; j < delivered[i].size() && j < batches[i].size(); ++j) {
+			CD_CHECK(isSameEvent(delivered[i][j], batches[i][j]));
+		}
+	}
+}
+
+static void testStopsAtTruncatedBatches()
+{
+	test::TemporaryDirectory directory;
+	const std::string file = directory.path() + "/events.log";
+	const std::vector<std::vector<LoggedEvent> > batches = sampleBatches(directory.path());
+	
+	EventRecorder recorder;
+	CD_CHECK(recorder.open(file));
+	record(recorder, batches[0]);
+	record(recorder, batches[1]);
+	CD_CHECK(recorder.close());
+	const std::string contents = readFile(file);
+	
+	// Cut anywhere past its 8 byte magic, the log yields the batches which are whole, and only them.
+	const std::string truncated = directory.path() + "/truncated.log";
+	size_t previousCount = 0;
+	for (size_t length = 0; length < contents.size(); ++length) {
+		writeFile(truncated, contents.substr(0, length));
+		
+		EventLogReader reader;
+		if (!reader.open(truncated)) {
+			CD_CHECK(length < 8);
+			continue;
+		}
+		
+		EventLogBatch batch;
+		size_t count = 0;
+		while (count < 2 && reader.read(batch)) {
+			CD_CHECK(batch.events.size() == batches[count].size());
+			for (size_t i = 0; i < batch.events.size() && i < batches[count].size(); ++i) {
+				const RawEvent &event = batch.events[i];
+				CD_CHECK(isSameEvent(loggedEvent(std::string(event.path, event.pathLength), event.flags, event.identifier), batches[count][i]));
+			}
+			++count;
+		}
+		CD_CHECK(count <= 1 && count >= previousCount);
+		CD_CHECK(count == 0 || length > 8);
+		CD_CHECK(count == 1 || length < contents.size() - 1);
+		previousCount = count;
+	}
+	
+	// A log cut within its header cannot be played back.
+	writeFile(truncated, contents.substr(0, 4));
+	PlaybackBackend backend(truncated, 0.0);
+	bool failed = false;
+	try {
+		backend.start(StreamConfiguration(), [](const RawEvent *events, size_t count) {
+			(void)events;
+			(void)count;
+		});
+	} catch (const StreamCreationFailure &) {
+		failed = true;
+	}
+	CD_CHECK(failed);
+}
+
+
+int main()
+{
+	testPlaysBackRecordedBatches();
+	testStopsAtTruncatedBatches();
+	
+	return test::testResult();
+}
@@ -0,0 +1,216 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests how file identities collapse atomic saves into one modification and
+ * pair renames reported without their other half.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <string>
+
+#include "CDCoreFileIdentityTracker.h"
+#include "CDCoreTestSupport.h"
+
+using namespace cdevents;
+
+
+#pragma mark Helpers
+static void writeFile(const std::string &path, const std::string &contents)
+{
+	FILE *file = fopen(path.c_str(), "w");
+	if (file == NULL) {
+		perror(path.c_str());
+		exit(EXIT_FAILURE);
+	}
+	fwrite(contents.data(), 1, contents.size(), file);
+	fclose(file);
+}
+
+static FileIdentity identityOfFile(const std::string &path)
+{
+	struct stat status;
+	if (lstat(path.c_str(), &status) != 0) {
+		return FileIdentity();
+	}
+	return FileIdentity(status.st_dev, status.st_ino);
+}
+
+static void append(EventBatch &events, const std::string &path, EventFlags flags)
+{
+	events.append(events.size() + 1, (flags | kEventFlagItemIsFile), 0.0, path.data(), path.size());
+}
+
+static void appendRename(EventBatch &events, const std::string &sourcePath, const std::string &path)
+{
+	events.append(events.size() + 1, (kEventFlagItemRenamed | kEventFlagItemIsFile), 0.0, path.data(), path.size(), sourcePath.data(), sourcePath.size());
+}
+
+
+#pragma mark Cases
+static void testCollapsesAtomicSaves()
+{
+	test::TemporaryDirectory directory;
+	const std::string document	= directory.path() + "/document";
+	const std::string temporary	= directory.path() + "/document.tmp";
+	writeFile(document, "before");
+	
+	FileIdentityTracker tracker;
+	EventBatch events;
+	EventBatch tracked;
+	
+	// Written under another name and renamed over the document, the halves
+	// of the rename not paired.
+	writeFile(temporary, "after");
+	CD_CHECK(rename(temporary.c_str(), document.c_str()) == 0);
+	append(events, temporary, kEventFlagItemCreated);
+	append(events, temporary, kEventFlagItemModified);
+	append(events, temporary, kEventFlagItemRenamed);
+	append(events, document, kEventFlagItemRenamed);
+	tracker.track(events, tracked);
+	
+	CD_CHECK(tracked.size() == 1);
+	if (tracked.size() == 1) {
+		CD_CHECK(strcmp(tracked.path(0), document.c_str()) == 0);
+		CD_CHECK(tracked[0].flags & kEventFlagItemModified);
+		CD_CHECK(!(tracked[0].flags & (kEventFlagItemCreated | kEventFlagItemRenamed)));
+		CD_CHECK(tracked.sourcePath(0) == NULL);
+		CD_CHECK(tracked[0].fileIdentity == identityOfFile(document));
+	}
+	
+	// Saved again, the rename paired by the stream.
+	writeFile(temporary, "again");
+	CD_CHECK(rename(temporary.c_str(), document.c_str()) == 0);
+	events.clear();
+	append(events, temporary, kEventFlagItemCreated);
+	appendRename(events, temporary, document);
+	tracker.track(events, tracked);
+	
+	CD_CHECK(tracked.size() == 1);
+	if (tracked.size() == 1) {
+		CD_CHECK(strcmp(tracked.path(0), document.c_str()) == 0);
+		CD_CHECK(tracked[0].flags & kEventFlagItemModified);
+		CD_CHECK(!(tracked[0].flags & kEventFlagItemRenamed));
+		CD_CHECK(tracked[0].fileIdentity == identityOfFile(document));
+	}
+}
+
+static void testKeepsRenamesOfExistingFiles()
+{
+	test::TemporaryDirectory directory;
+	const std::string source		= directory.path() + "/source";
+	const std::string destination	= directory.path() + "/destination";
+	writeFile(source, "contents");
+	
+	FileIdentityTracker tracker;
+	EventBatch events;
+	EventBatch tracked;
+	append(events, source, kEventFlagItemModified);
+	tracker.track(events, tracked);
+	
+	// Not created in the batch, so a rename rather than a save.
+	CD_CHECK(rename(source.c_str(), destination.c_str()) == 0);
+	events.clear();
+	appendRename(events, source, destination);
+	tracker.track(events, tracked);
+	
+	CD_CHECK(tracked.size() == 1);
+	if (tracked.size() == 1) {
+		CD_CHECK(tracked[0].flags & kEventFlagItemRenamed);
+		CD_CHECK(tracked.sourcePath(0) && strcmp(tracked.sourcePath(0), source.c_str()) == 0);
+	}
+}
+
+static void testPairsRenamesByIdentity()
+{
+	test::TemporaryDirectory directory;
+	const std::string source		= directory.path() + "/source";
+	const std::string destination	= directory.path() + "/destination";
+	writeFile(source, "contents");
+	
+	FileIdentityTracker tracker;
+	EventBatch events;
+	EventBatch tracked;
+	append(events, source, kEventFlagItemCreated);
+	tracker.track(events, tracked);
+	CD_CHECK(tracker.rememberedIdentity(source) == identityOfFile(source));
+	
+	// The halves of the rename reported in different batches.
+	CD_CHECK(rename(source.c_str(), destination.c_str()) == 0);
+	events.clear();
+	append(events, source, kEventFlagItemRenamed);
+	tracker.track(events, tracked);
+	CD_CHECK(tracked.size() == 1);
+	
+	events.clear();
+	append(events, destination, kEventFlagItemRenamed);
+	tracker.track(events, tracked);
+	
+	CD_CHECK(tracked.size() == 1);
+	if (tracked.size() == 1) {
+		CD_CHECK(strcmp(tracked.path(0), destination.c_str()) == 0);
+		CD_CHECK(tracked.sourcePath(0) && strcmp(tracked.sourcePath(0), source.c_str()) == 0);
+		CD_CHECK(tracked[0].fileIdentity == identityOfFile(destination));
+	}
+	CD_CHECK(tracker.rememberedIdentity(destination) == identityOfFile(destination));
+}
+
+static void testCapacity()
+{
+	test::TemporaryDirectory directory;
+	FileIdentityTracker tracker(2);
+	EventBatch events;
+	EventBatch tracked;
+	
+	for (int i = 0; i < 3; ++i) {
+		const std::string path = directory.path() + "/" + std::to_string(i);
+		writeFile(path, "contents");
+		append(events, path, kEventFlagItemCreated);
+	}
+	tracker.track(events, tracked);
+	
+	// The least recently seen item is forgotten first.
+	CD_CHECK(tracked.size() == 3);
+	CD_CHECK(tracker.size() == 2);
+	CD_CHECK(!tracker.rememberedIdentity(directory.path() + "/0").isKnown());
+	CD_CHECK(tracker.rememberedIdentity(directory.path() + "/2").isKnown());
+}
+
+
+int main()
+{
+	testCollapsesAtomicSaves();
+	testKeepsRenamesOfExistingFiles();
+	testPairsRenamesByIdentity();
+	testCapacity();
+	
+	return test::testResult();
+}
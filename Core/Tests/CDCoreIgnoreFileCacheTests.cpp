@@ -0,0 +1,249 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests how the rules of .gitignore and .ignore files are translated,
+ * matched, invalidated and reported.
+ */
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#include "CDCoreIgnoreFileCache.h"
+#include "CDCoreTestSupport.h"
+
+using namespace cdevents;
+
+
+#pragma mark Helpers
+static void writeFile(const std::string &path, const std::string &contents)
+{
+	FILE *file = fopen(path.c_str(), "w");
+	if (file == NULL) {
+		perror(path.c_str());
+		exit(EXIT_FAILURE);
+	}
+	fwrite(contents.data(), 1, contents.size(), file);
+	fclose(file);
+}
+
+static void makeDirectory(const std::string &path)
+{
+	if (mkdir(path.c_str(), 0755) != 0) {
+		perror(path.c_str());
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+#pragma mark Cases
+static void testTranslation()
+{
+	const std::vector<std::string> patterns = IgnoreFileCache::patternsFromIgnoreFile(
+		"# comment\n"
+		"*.o\n"
+		"\n"
+		"/build/\n"
+		"doc/*.html\r\n"
+		"!keep.o\n"
+		"trailing \n"
+		"escaped\\ \n"
+		"re:literal\n"
+		"/\n");
+	
+	std::vector<std::string> expected;
+	expected.push_back("*.o");
+	expected.push_back("/build/");
+	expected.push_back("/doc/*.html");
+	expected.push_back("!keep.o");
+	expected.push_back("trailing");
+	expected.push_back("escaped\\ ");
+	expected.push_back("glob:re:literal");
+	CD_CHECK(patterns == expected);
+}
+
+static void testAnchoringAndNegation()
+{
+	test::TemporaryDirectory root;
+	const std::string &path = root.path();
+	makeDirectory(path + "/src");
+	makeDirectory(path + "/src/build");
+	writeFile(path + "/.gitignore", "*.o\n!keep.o\n/build\nlogs/\n");
+	writeFile(path + "/src/.gitignore", "/generated\n!debug.o\n");
+	
+	IgnoreFileCache cache;
+	CD_CHECK(cache.isIgnored(path + "/a.o", path));
+	CD_CHECK(cache.isIgnored(path + "/src/a.o", path));
+	CD_CHECK(!cache.isIgnored(path + "/src/keep.o", path));
+	CD_CHECK(!cache.isIgnored(path + "/a.c", path));
+	
+	// Anchored to the directory of the ignore file.
+	CD_CHECK(cache.isIgnored(path + "/build", path));
+	CD_CHECK(cache.isIgnored(path + "/build/a.c", path));
+	CD_CHECK(!cache.isIgnored(path + "/src/build/a.c", path));
+	CD_CHECK(cache.isIgnored(path + "/src/generated/a.c", path));
+	CD_CHECK(!cache.isIgnored(path + "/generated/a.c", path));
+	
+	// Unanchored patterns match at any depth, the deepest directory decides.
+	CD_CHECK(cache.isIgnored(path + "/src/build/logs/a", path));
+	CD_CHECK(!cache.isIgnored(path + "/src/debug.o", path));
+	CD_CHECK(cache.isIgnored(path + "/debug.o", path));
+	
+	// Only the ignore files beneath the root are read.
+	CD_CHECK(!cache.isIgnored(path + "/src/a.c", path + "/src"));
+	CD_CHECK(!cache.isIgnored(path + "/src/a.o", path + "/src"));
+	CD_CHECK(!cache.isIgnored(path + "/a.o", path + "/src"));
+	
+	// Paths holding glob characters are matched literally.
+	makeDirectory(path + "/[x]");
+	writeFile(path + "/[x]/.gitignore", "/a\n");
+	CD_CHECK(cache.isIgnored(path + "/[x]/a", path));
+	CD_CHECK(!cache.isIgnored(path + "/[x]/b", path));
+}
+
+static void testIgnoreFilePrecedence()
+{
+	test::TemporaryDirectory root;
+	const std::string &path = root.path();
+	writeFile(path + "/.gitignore", "*.log\n");
+	writeFile(path + "/.ignore", "!important.log\n");
+	
+	IgnoreFileCache cache;
+	CD_CHECK(cache.isIgnored(path + "/a.log", path));
+	CD_CHECK(!cache.isIgnored(path + "/important.log", path));
+}
+
+static void testInvalidation()
+{
+	test::TemporaryDirectory root;
+	const std::string &path = root.path();
+	makeDirectory(path + "/a");
+	writeFile(path + "/.gitignore", "*.o\n");
+	
+	IgnoreFileCache cache;
+	CD_CHECK(cache.isIgnored(path + "/a/b.o", path));
+	CD_CHECK(cache.directoryCount() == 2);
+	
+	// Another file changing leaves the rules alone, even when only the
+	// directory is told about.
+	writeFile(path + "/other", "x");
+	cache.invalidate(path + "/other", kEventFlagItemCreated | kEventFlagItemIsFile);
+	cache.invalidate(path, kEventFlagNone);
+	CD_CHECK(cache.directoryCount() == 2);
+	
+	// The ignore file changing is noticed from either event.
+	writeFile(path + "/.gitignore", "*.cc\n");
+	cache.invalidate(path, kEventFlagNone);
+	CD_CHECK(cache.directoryCount() == 1);
+	CD_CHECK(!cache.isIgnored(path + "/a/b.o", path));
+	CD_CHECK(cache.isIgnored(path + "/a/b.cc", path));
+	
+	writeFile(path + "/.gitignore", "*.hpp\n");
+	cache.invalidate(path + "/.gitignore", kEventFlagItemModified | kEventFlagItemIsFile);
+	CD_CHECK(cache.isIgnored(path + "/a/b.hpp", path));
+	CD_CHECK(!cache.isIgnored(path + "/a/b.cc", path));
+	
+	// So is an ignore file created in a sub-directory.
+	writeFile(path + "/a/.gitignore", "!b.hpp\n");
+	cache.invalidate(path + "/a", kEventFlagNone);
+	CD_CHECK(!cache.isIgnored(path + "/a/b.hpp", path));
+	
+	cache.invalidate(path, kEventFlagMustScanSubDirs);
+	CD_CHECK(cache.directoryCount() == 0);
+}
+
+static void testMalformedPatterns()
+{
+	test::TemporaryDirectory root;
+	const std::string &path = root.path();
+	writeFile(path + "/.gitignore", "*.o\n[abc\n*.a\n");
+	
+	// The well-formed patterns still apply, the malformed one is reported.
+	IgnoreFileCache cache;
+	CD_CHECK(cache.isIgnored(path + "/x.o", path));
+	CD_CHECK(cache.isIgnored(path + "/x.a", path));
+	const std::vector<std::string> errors = cache.errors();
+	CD_CHECK(errors.size() == 1);
+	CD_CHECK(errors.size() == 1 && errors[0].find("[abc") != std::string::npos);
+	CD_CHECK(errors.size() == 1 && errors[0].compare(0, path.size(), path) == 0);
+}
+
+static void testLargeIgnoreFiles()
+{
+	// The ignore file of a large project, in many directories.
+	std::string contents;
+	for (int i = 0; i < 200; ++i) {
+		contents += "directory" + std::to_string(i) + "/\n";
+		contents += "*.extension" + std::to_string(i) + "\n";
+		contents += "/build" + std::to_string(i) + "/**\n";
+		contents += "docs/**/draft" + std::to_string(i) + "\n";
+	}
+	contents += "!directory7/\n";
+	
+	test::TemporaryDirectory root;
+	const std::string &path = root.path();
+	writeFile(path + "/.gitignore", contents);
+	for (int i = 0; i < 64; ++i) {
+		const std::string directory = path + "/package" + std::to_string(i);
+		makeDirectory(directory);
+		writeFile(directory + "/.gitignore", contents);
+	}
+	
+	IgnoreFileCache cache;
+	for (int i = 0; i < 64; ++i) {
+		const std::string directory = path + "/package" + std::to_string(i);
+		CD_CHECK(cache.isIgnored(directory + "/a/directory12/b", path));
+		CD_CHECK(cache.isIgnored(directory + "/build3/b", path));
+		CD_CHECK(!cache.isIgnored(directory + "/a/build3/b", path));
+		CD_CHECK(cache.isIgnored(directory + "/docs/a/b/draft150", path));
+		CD_CHECK(cache.isIgnored(directory + "/a.extension199", path));
+		CD_CHECK(!cache.isIgnored(directory + "/directory7/a", path));
+		CD_CHECK(!cache.isIgnored(directory + "/a.c", path));
+	}
+	
+	// The same ignore files are compiled once for all the directories.
+	CD_CHECK(cache.directoryCount() > 64);
+	CD_CHECK(cache.ruleCount() == 1);
+	CD_CHECK(cache.errors().empty());
+}
+
+
+int main()
+{
+	testTranslation();
+	testAnchoringAndNegation();
+	testIgnoreFilePrecedence();
+	testInvalidation();
+	testMalformedPatterns();
+	testLargeIgnoreFiles();
+	
+	return test::testResult();
+}
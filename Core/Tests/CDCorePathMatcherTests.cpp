@@ -0,0 +1,184 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests the semantics of the path patterns and that compiling many of them
+ * stays small.
+ */
+
+#include <string>
+#include <vector>
+
+#include "CDCorePathMatcher.h"
+#include "CDCoreTestSupport.h"
+
+using namespace cdevents;
+
+
+#pragma mark Helpers
+static PathMatch matchPath(const std::vector<std::string> &patterns, const char *path)
+{
+	return PathMatcher(patterns).match(path);
+}
+
+static bool matches(const char *pattern, const char *path)
+{
+	return (matchPath(std::vector<std::string>(1, pattern), path) == kPathMatchExcluded);
+}
+
+static bool isMalformed(const char *pattern)
+{
+	try {
+		PathMatcher(std::vector<std::string>(1, pattern));
+	} catch (const PathPatternError &) {
+		return true;
+	}
+	return false;
+}
+
+
+#pragma mark Cases
+static void testGlobs()
+{
+	CD_CHECK(matches("*.o", "/a/b.o"));
+	CD_CHECK(matches("*.o", "/b.o"));
+	CD_CHECK(!matches("*.o", "/a/b.oo"));
+	CD_CHECK(matches("*.o", "/a/b.o/c"));
+	CD_CHECK(matches("?.c", "/a/b.c"));
+	CD_CHECK(!matches("?.c", "/a/bb.c"));
+	CD_CHECK(matches("[ab].c", "/x/b.c"));
+	CD_CHECK(!matches("[!ab].c", "/x/b.c"));
+	CD_CHECK(matches("\\*.c", "/x/*.c"));
+	CD_CHECK(!matches("\\*.c", "/x/a.c"));
+	CD_CHECK(!matches("a*b", "/a/b"));
+	CD_CHECK(matches("build/", "/x/build"));
+}
+
+static void testAnchoring()
+{
+	CD_CHECK(matches("/a/b", "/a/b"));
+	CD_CHECK(matches("/a/b", "/a/b/c"));
+	CD_CHECK(!matches("/a/b", "/x/a/b"));
+	CD_CHECK(!matches("/a/b", "/a/bc"));
+	CD_CHECK(matches("build/tmp", "/x/build/tmp"));
+	CD_CHECK(matches("build/tmp", "/x/build/tmp/y"));
+	CD_CHECK(!matches("build/tmp", "/x/build/tmpy"));
+	CD_CHECK(!matches("build/tmp", "/x/xbuild/tmp"));
+}
+
+static void testDoubleStars()
+{
+	CD_CHECK(matches("**/objects", "/a/objects"));
+	CD_CHECK(matches("**/objects", "/objects"));
+	CD_CHECK(matches("/**/objects", "/a/b/objects"));
+	CD_CHECK(matches("a/**/b", "/a/b"));
+	CD_CHECK(matches("a/**/b", "/x/a/c/d/b"));
+	CD_CHECK(!matches("a/**/b", "/x/a/c/db"));
+	CD_CHECK(matches("/a/**", "/a/b"));
+	CD_CHECK(!matches("/a/**", "/a"));
+	CD_CHECK(!matches("/a/**", "/ab/c"));
+	CD_CHECK(matches("**/dir/**", "/x/dir/y"));
+	CD_CHECK(matches("**/dir/**", "/dir/y/z"));
+	CD_CHECK(!matches("**/dir/**", "/x/dir"));
+	CD_CHECK(!matches("**/dir/**", "/x/dirt/y"));
+	CD_CHECK(matches("dir/**/**", "/x/dir/y"));
+	CD_CHECK(matches("**", "/x"));
+	CD_CHECK(matches("/**", "/x/y"));
+	CD_CHECK(matches("a\\/**", "/a/**"));
+}
+
+static void testRegularExpressions()
+{
+	CD_CHECK(matches("re:\\.tmp$", "/a/b.tmp"));
+	CD_CHECK(matches("re:\\.tmp$", "/a/b.tmp/c"));
+	CD_CHECK(!matches("re:\\.tmp$", "/a/b.tmpx"));
+	CD_CHECK(matches("re:cache", "/a/xcachex/b"));
+	CD_CHECK(matches("re:^/a/(b|c)+/d", "/a/bcb/d/e"));
+	CD_CHECK(!matches("re:^/a/(b|c)+/d", "/x/a/b/d"));
+	CD_CHECK(matches("glob:re:x", "/a/re:x"));
+}
+
+static void testNegation()
+{
+	std::vector<std::string> patterns;
+	patterns.push_back("*.o");
+	patterns.push_back("!keep.o");
+	CD_CHECK(matchPath(patterns, "/a/b.o") == kPathMatchExcluded);
+	CD_CHECK(matchPath(patterns, "/a/keep.o") == kPathMatchIncluded);
+	CD_CHECK(matchPath(patterns, "/a/b.c") == kPathMatchNone);
+	
+	// The last pattern matching the path or an ancestor decides.
+	patterns.push_back("/a/**");
+	CD_CHECK(matchPath(patterns, "/a/keep.o") == kPathMatchExcluded);
+	CD_CHECK(matchPath(patterns, "/b/keep.o") == kPathMatchIncluded);
+}
+
+static void testMalformedPatterns()
+{
+	CD_CHECK(isMalformed(""));
+	CD_CHECK(isMalformed("a\\"));
+	CD_CHECK(isMalformed("[ab"));
+	CD_CHECK(isMalformed("re:(a"));
+	CD_CHECK(!isMalformed("a/**"));
+}
+
+static void testManyDoubleStarPatterns()
+{
+	// Hundreds of patterns matching beneath a directory anywhere, which a
+	// .gitignore of a large project easily has, compile to about as many
+	// states as the patterns have bytes.
+	std::vector<std::string> patterns;
+	for (int i = 0; i < 300; ++i) {
+		patterns.push_back("**/directory" + std::to_string(i) + "/**");
+		patterns.push_back("*.extension" + std::to_string(i));
+	}
+	
+	const PathMatcher matcher(patterns);
+	CD_CHECK(matcher.stateCount() < 4 * patterns.size());
+	CD_CHECK(matcher.match("/a/directory17/b") == kPathMatchExcluded);
+	CD_CHECK(matcher.match("/a/b/directory299/c/d") == kPathMatchExcluded);
+	CD_CHECK(matcher.match("/a/directory17") == kPathMatchNone);
+	CD_CHECK(matcher.match("/a/directory300/b") == kPathMatchNone);
+	CD_CHECK(matcher.match("/a/b.extension42") == kPathMatchExcluded);
+	CD_CHECK(matcher.match("/a/b.extension42x") == kPathMatchNone);
+	CD_CHECK(matcher.match("/a/b.extension42/directory3") == kPathMatchExcluded);
+}
+
+
+int main()
+{
+	testGlobs();
+	testAnchoring();
+	testDoubleStars();
+	testRegularExpressions();
+	testNegation();
+	testMalformedPatterns();
+	testManyDoubleStarPatterns();
+	
+	return test::testResult();
+}
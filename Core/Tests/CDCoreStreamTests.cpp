@@ -0,0 +1,364 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Tests how a stream pairs the halves of renames reported by its backend,
+ * across events it filters out and between unrelated renames, and that
+ * batches it drops are not checkpointed past until it has told the client to
+ * rescan in their place.
+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "CDCoreCheckpointStore.h"
+#include "CDCoreFileIdentityTracker.h"
+#include "CDCoreStream.h"
+#include "CDCoreTestSupport.h"
+
+using namespace cdevents;
+
+
+#pragma mark Manual backend
+/**
+ * A backend which reports the events it is handed, on the calling thread.
+ */
+class ManualBackend : public Backend {
+public:
+	virtual void start(const StreamConfiguration &configuration, const BackendHandler &handler)
+	{
+		(void)configuration;
+		_handler = handler;
+	}
+	
+	virtual void stop() { _handler = BackendHandler(); }
+	virtual void setNotificationLatency(double latency) { (void)latency; }
+	virtual void setWatchedPaths(const std::vector<std::string> &paths) { (void)paths; }
+	virtual void flushSynchronously() {}
+	virtual void flushAsynchronously() {}
+	virtual EventIdentifier currentEventIdentifier() const { return 0; }
+	virtual std::string description() const { return "ManualBackend"; }
+	
+	void report(const std::vector<RawEvent> &events) { _handler(events.data(), events.size()); }
+	
+private:
+	BackendHandler	_handler;
+};
+
+
+#pragma mark Helpers
+/** An event as delivered, with its paths copied out of the batch. */
+struct DeliveredEvent {
+	EventFlags	flags;
+	std::string	path;
+	std::string	sourcePath;
+};
+
+/**
+ * A stream of a manual backend, collecting the events it delivers.
+ */
+class TestStream {
+public:
+	explicit TestStream(const StreamConfiguration &configuration)
+	:	_backend(new ManualBackend()),
+		_stream(std::unique_ptr<Backend>(_backend), configuration, [this](Stream &stream, const EventBatch &events) {
+			(void)stream;
+			for (size_t i = 0; i < events.size(); ++i) {
+				DeliveredEvent event;
+				event.flags	= events[i].flags;
+				event.path	= events.path(i);
+				if (events.sourcePath(i)) {
+					event.sourcePath = events.sourcePath(i);
+				}
+				delivered.push_back(event);
+			}
+		})
+	{
+		_stream.create();
+	}
+	
+	~TestStream() { _stream.dispose(); }
+	
+	void report(const std::vector<RawEvent> &events) { _backend->report(events); }
+	
+	std::vector<DeliveredEvent> delivered;
+	
+private:
+	TestStream(const TestStream &);
+	TestStream &operator=(const TestStream &);
+	
+	ManualBackend	*_backend;
+	Stream			_stream;
+};
+
+static RawEvent rawEvent(const std::string &path, EventFlags flags, EventIdentifier identifier, uint64_t renameCookie = 0)
+{
+	RawEvent event;
+	event.path			= path.c_str();
+	event.pathLength	= path.size();
+	event.flags			= flags;
+	event.identifier	= identifier;
+	event.renameCookie	= renameCookie;
+	return event;
+}
+
+static void createFile(const std::string &path)
+{
+	const int descriptor = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (descriptor < 0) {
+		perror(path.c_str());
+		exit(EXIT_FAILURE);
+	}
+	close(descriptor);
+}
+
+static const EventFlags kRenamedFile = (kEventFlagItemRenamed | kEventFlagItemIsFile);
+
+
+#pragma mark Cases
+static void testPairsCookiesAcrossFilteredEvents()
+{
+	test::TemporaryDirectory directory;
+	const std::string source		= directory.path() + "/a";
+	const std::string destination	= directory.path() + "/b";
+	const std::string excluded		= directory.path() + "/excluded/c";
+	
+	StreamConfiguration configuration;
+	configuration.watchedPaths.push_back(directory.path());
+	configuration.excludedPaths.push_back(directory.path() + "/excluded");
+	configuration.pairsRenames = true;
+	TestStream stream(configuration);
+	
+	std::vector<RawEvent> events;
+	events.push_back(rawEvent(source, kRenamedFile, 1, 7));
+	events.push_back(rawEvent(excluded, kEventFlagItemModified | kEventFlagItemIsFile, 2));
+	events.push_back(rawEvent(destination, kRenamedFile, 3, 7));
+	stream.report(events);
+	
+	CD_CHECK(stream.delivered.size() == 1);
+	if (stream.delivered.size() == 1) {
+		CD_CHECK(stream.delivered[0].path == destination);
+		CD_CHECK(stream.delivered[0].sourcePath == source);
+	}
+}
+
+static void testKeepsRenamesOutOfWatchedPathsApart()
+{
+	test::TemporaryDirectory directory;
+	const std::string source		= directory.path() + "/a";
+	const std::string destination	= directory.path() + "/b";
+	const std::string outside		= directory.path() + "/excluded/a";
+	
+	StreamConfiguration configuration;
+	configuration.watchedPaths.push_back(directory.path());
+	configuration.excludedPaths.push_back(directory.path() + "/excluded");
+	configuration.pairsRenames = true;
+	TestStream stream(configuration);
+	
+	// Moved out, its other half filtered, before another item is renamed.
+	std::vector<RawEvent> events;
+	events.push_back(rawEvent(source, kRenamedFile, 1, 7));
+	events.push_back(rawEvent(outside, kRenamedFile, 2, 7));
+	events.push_back(rawEvent(destination, kRenamedFile, 3, 8));
+	stream.report(events);
+	
+	CD_CHECK(stream.delivered.size() == 2);
+	for (size_t i = 0; i < stream.delivered.size(); ++i) {
+		CD_CHECK(stream.delivered[i].sourcePath.empty());
+	}
+}
+
+static void testConfirmsRenamesWithoutCookiesByIdentity()
+{
+	test::TemporaryDirectory directory;
+	const std::string source		= directory.path() + "/a";
+	const std::string destination	= directory.path() + "/b";
+	const std::string unrelated		= directory.path() + "/c";
+	const std::string outside		= directory.path() + "/outside";
+	CD_CHECK(mkdir(outside.c_str(), 0755) == 0);
+	
+	StreamConfiguration configuration;
+	configuration.watchedPaths.push_back(directory.path());
+	configuration.excludedPaths.push_back(outside);
+	configuration.pairsRenames = true;
+	configuration.identityTracker = std::make_shared<FileIdentityTracker>();
+	TestStream stream(configuration);
+	
+	createFile(source);
+	std::vector<RawEvent> events;
+	events.push_back(rawEvent(source, kEventFlagItemCreated | kEventFlagItemIsFile, 1));
+	stream.report(events);
+	CD_CHECK(configuration.identityTracker->rememberedIdentity(source).isKnown());
+	
+	// Moved out right before an unrelated item is renamed into place: the
+	// events follow each other, but the identities differ.
+	CD_CHECK(rename(source.c_str(), (outside + "/a").c_str()) == 0);
+	createFile(unrelated);
+	CD_CHECK(rename(unrelated.c_str(), destination.c_str()) == 0);
+	stream.delivered.clear();
+	events.clear();
+	events.push_back(rawEvent(source, kRenamedFile, 2));
+	events.push_back(rawEvent(destination, kRenamedFile, 3));
+	stream.report(events);
+	
+	CD_CHECK(stream.delivered.size() == 2);
+	for (size_t i = 0; i < stream.delivered.size(); ++i) {
+		CD_CHECK(stream.delivered[i].sourcePath.empty());
+	}
+	
+	// Renamed within the watched paths, the identity confirms the pair.
+	CD_CHECK(rename(destination.c_str(), source.c_str()) == 0);
+	stream.delivered.clear();
+	events.clear();
+	events.push_back(rawEvent(destination, kRenamedFile, 4));
+	events.push_back(rawEvent(source, kRenamedFile, 5));
+	stream.report(events);
+	
+	CD_CHECK(stream.delivered.size() == 1);
+	if (stream.delivered.size() == 1) {
+		CD_CHECK(stream.delivered[0].path == source);
+		CD_CHECK(stream.delivered[0].sourcePath == destination);
+	}
+}
+
+static void testPairsAdjacentRenamesWithoutIdentity()
+{
+	test::TemporaryDirectory directory;
+	const std::string source		= directory.path() + "/a";
+	const std::string destination	= directory.path() + "/b";
+	
+	StreamConfiguration configuration;
+	configuration.watchedPaths.push_back(directory.path());
+	configuration.pairsRenames = true;
+	TestStream stream(configuration);
+	
+	createFile(destination);
+	std::vector<RawEvent> events;
+	events.push_back(rawEvent(destination, kRenamedFile, 1));
+	events.push_back(rawEvent(source, kRenamedFile, 2));
+	events.push_back(rawEvent(source, kRenamedFile, 4));
+	stream.report(events);
+	
+	// The destination is told apart by still existing; a half which does not
+	// follow the other one is not paired.
+	CD_CHECK(stream.delivered.size() == 2);
+	if (stream.delivered.size() == 2) {
+		CD_CHECK(stream.delivered[0].path == destination);
+		CD_CHECK(stream.delivered[0].sourcePath == source);
+		CD_CHECK(stream.delivered[1].sourcePath.empty());
+	}
+}
+
+static void testHoldsCheckpointBeforeDroppedBatches()
+{
+	test::TemporaryDirectory directory;
+	const std::string path = directory.path() + "/a";
+	
+	StreamConfiguration configuration;
+	configuration.watchedPaths.push_back(directory.path());
+	configuration.deliveryThreadCount = 1;
+	configuration.deliveryQueueCapacity = 1;
+	configuration.overflowPolicy = kOverflowPolicyDropOldest;
+	configuration.checkpointStore = std::make_shared<CheckpointStore>(directory.path() + "/checkpoints");
+	configuration.checkpointKey = "stream";
+	
+	// The first batch is held up in the handler until the queue overflows,
+	// and the rescan in place of the dropped batches until it is checked.
+	std::mutex mutex;
+	std::condition_variable changed;
+	bool first = true;
+	unsigned held = 0;
+	unsigned released = 0;
+	ManualBackend *backend = new ManualBackend();
+	Stream stream(std::unique_ptr<Backend>(backend), configuration, [&](Stream &, const EventBatch &events) {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (first || (events[0].flags & kEventFlagMustScanSubDirs)) {
+			first = false;
+			const unsigned position = ++held;
+			changed.notify_all();
+			changed.wait(lock, [&]() { return released >= position; });
+		}
+	});
+	stream.create();
+	
+	std::vector<RawEvent> events(1, rawEvent(path, kEventFlagItemModified | kEventFlagItemIsFile, 1));
+	backend->report(events);
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [&]() { return held == 1; });
+	}
+	for (EventIdentifier identifier = 2; identifier <= 10; ++identifier) {
+		events[0].identifier = identifier;
+		backend->report(events);
+	}
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		released = 1;
+		changed.notify_all();
+		changed.wait(lock, [&]() { return held == 2; });
+	}
+	
+	// The last batch has been delivered, but not yet the rescan.
+	CheckpointStore::Checkpoint checkpoint;
+	CD_CHECK(stream.deliveryQueueStatistics().droppedBatches > 0);
+	CD_CHECK(configuration.checkpointStore->checkpoint("stream", checkpoint));
+	CD_CHECK(checkpoint.identifier == 1);
+	
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		released = 2;
+		changed.notify_all();
+	}
+	stream.flushSynchronously();
+	
+	CD_CHECK(stream.deliveryQueueStatistics().rescans == 1);
+	CD_CHECK(configuration.checkpointStore->checkpoint("stream", checkpoint));
+	CD_CHECK(checkpoint.identifier == 10);
+	stream.dispose();
+}
+
+
+int main()
+{
+	testPairsCookiesAcrossFilteredEvents();
+	testKeepsRenamesOutOfWatchedPathsApart();
+	testConfirmsRenamesWithoutCookiesByIdentity();
+	testPairsAdjacentRenamesWithoutIdentity();
+	testHoldsCheckpointBeforeDroppedBatches();
+	
+	return test::testResult();
+}
@@ -0,0 +1,112 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @headerfile CDCoreTestSupport.h
+ * The checks shared by the tests of the CDEvents core.
+ *
+ * A test is an executable which runs its cases from main() and returns
+ * testResult(), so that CTest reports every failed check without a test
+ * framework being needed.
+ */
+
+#ifndef CD_CORE_TEST_SUPPORT_H
+#define CD_CORE_TEST_SUPPORT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+
+namespace cdevents {
+namespace test {
+
+/** The number of checks failed so far. */
+static unsigned sFailureCount = 0;
+
+static inline void checkFailed(const char *file, int line, const char *expression)
+{
+	fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+	++sFailureCount;
+}
+
+/** The exit status of a test, printing how many checks failed. */
+static inline int testResult()
+{
+	if (sFailureCount > 0) {
+		fprintf(stderr, "%u check(s) failed\n", sFailureCount);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+/**
+ * A temporary directory removed with its contents when the scope ends.
+ */
+class TemporaryDirectory {
+public:
+	TemporaryDirectory()
+	{
+		char path[] = "/tmp/CDCoreTests.XXXXXX";
+		if (mkdtemp(path) == NULL) {
+			perror("mkdtemp");
+			exit(EXIT_FAILURE);
+		}
+		_path = path;
+	}
+	
+	~TemporaryDirectory()
+	{
+		const std::string command = "rm -rf '" + _path + "'";
+		if (system(command.c_str()) != 0) {
+			fprintf(stderr, "Could not remove %s\n", _path.c_str());
+		}
+	}
+	
+	const std::string &path() const { return _path; }
+	
+private:
+	TemporaryDirectory(const TemporaryDirectory &);
+	TemporaryDirectory &operator=(const TemporaryDirectory &);
+	
+	std::string _path;
+};
+
+} // namespace test
+} // namespace cdevents
+
+/** Checks that the expression is true, counting a failure otherwise. */
+#define CD_CHECK(expression) \
+	do { \
+		if (!(expression)) { \
+			cdevents::test::checkFailed(__FILE__, __LINE__, #expression); \
+		} \
+	} while (0)
+
+#endif // CD_CORE_TEST_SUPPORT_H
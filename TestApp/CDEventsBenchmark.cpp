@@ -0,0 +1,471 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Measures how fast the CDEvents core filters and delivers events, using
+ * generated batches instead of a file system.
+ *
+ * Every combination of the given parameters is run as a case: a stream with
+ * that many watched and excluded paths is fed batches of events of that
+ * size and path depth, for at least the given time, and the events per
+ * second, nanoseconds per event and heap allocations per event are
+ * reported. An eighth of the events are for a watched path itself, as
+ * FSEvents reports changes to a directory, the rest for items beneath it.
+ * The batches are the same from one run to the next, so the results of two
+ * builds can be compared.
+ *
+ * Usage: CDEventsBenchmark [-b batch-sizes] [-d path-depths] [-w watched-path-counts] [-x excluded-path-counts] [-s ignore-sub-directories] [-t delivery-thread-counts] [-n events] [-T seconds] [-o format]
+ *
+ *   -b  The number of events per batch (default 1,64,1024).
+ *   -d  The number of path components below the watched path, 1 for its immediate children (default 1,8).
+ *   -w  The number of watched paths (default 1,64).
+ *   -x  The number of excluded paths, a quarter of the events are beneath one (default 0,64).
+ *   -s  Whether to ignore events from sub-directories, 0 or 1 (default 0,1).
+ *   -t  The number of delivery threads (default 0).
+ *   -n  The number of distinct events generated per case (default 65536).
+ *   -T  The minimum time each case is measured for, in seconds (default 0.2).
+ *   -o  The output format, "text" (default), "csv" or "json".
+ *
+ * Each parameter takes a comma separated list of values.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "CDCoreMetrics.h"
+#include "CDCoreStream.h"
+
+using namespace cdevents;
+
+
+#pragma mark Counting allocations
+static std::atomic<uint64_t> sAllocationCount(0);
+
+void *operator new(size_t size)
+{
+	sAllocationCount.fetch_add(1, std::memory_order_relaxed);
+	void *pointer = malloc(size != 0 ? size : 1);
+	if (pointer == NULL) {
+		throw std::bad_alloc();
+	}
+	return pointer;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+	free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+	free(pointer);
+}
+
+
+#pragma mark Synthetic backend
+/**
+ * A backend which reports the batches it is handed, on the calling thread.
+ */
+class SyntheticBackend : public Backend {
+public:
+	SyntheticBackend() : _lastIdentifier(0) {}
+	
+	virtual void start(const StreamConfiguration &configuration, const BackendHandler &handler)
+	{
+		(void)configuration;
+		_handler = handler;
+	}
+	
+	virtual void stop()
+	{
+		_handler = BackendHandler();
+	}
+	
+	virtual void setNotificationLatency(double latency) { (void)latency; }
+	virtual void setWatchedPaths(const std::vector<std::string> &paths) { (void)paths; }
+	virtual void flushSynchronously() {}
+	virtual void flushAsynchronously() {}
+	virtual EventIdentifier currentEventIdentifier() const { return _lastIdentifier; }
+	virtual std::string description() const { return "SyntheticBackend"; }
+	
+	void report(const RawEvent *events, size_t count)
+	{
+		_handler(events, count);
+		_lastIdentifier = events[count - 1].identifier;
+	}
+	
+private:
+	BackendHandler	_handler;
+	EventIdentifier	_lastIdentifier;
+};
+
+
+#pragma mark Cases
+struct BenchmarkCase {
+	size_t	batchSize;
+	size_t	pathDepth;
+	size_t	watchedPathCount;
+	size_t	excludedPathCount;
+	bool	ignoreSubDirectories;
+	size_t	deliveryThreadCount;
+};
+
+struct BenchmarkResult {
+	uint64_t	events;
+	uint64_t	deliveredEvents;
+	uint64_t	nanoseconds;
+	uint64_t	allocations;
+};
+
+/**
+ * The paths and events of a case, generated from a fixed seed.
+ */
+struct BenchmarkEvents {
+	std::vector<std::string>	watchedPaths;
+	std::vector<std::string>	excludedPaths;
+	std::string					paths;
+	std::vector<RawEvent>		events;
+};
+
+static uint32_t nextRandom(uint32_t &state)
+{
+	state = state * 1664525u + 1013904223u;
+	return (state >> 8);
+}
+
+static void generateEvents(const BenchmarkCase &benchmarkCase, size_t eventCount, BenchmarkEvents &generated)
+{
+	uint32_t random = 0x43444576;
+	
+	for (size_t i = 0; i < benchmarkCase.watchedPathCount; ++i) {
+		generated.watchedPaths.push_back("/cdevents-benchmark/watched-" + std::to_string(i));
+	}
+	for (size_t i = 0; i < benchmarkCase.excludedPathCount; ++i) {
+		generated.excludedPaths.push_back(generated.watchedPaths[i % generated.watchedPaths.size()] + "/excluded-" + std::to_string(i));
+	}
+	
+	// The paths are appended to one buffer, and pointed into once it no longer moves.
+	std::vector<size_t> offsets;
+	std::vector<size_t> lengths;
+	for (size_t i = 0; i < eventCount; ++i) {
+		const size_t offset = generated.paths.size();
+		if ((i % 8) == 1) {
+			generated.paths += generated.watchedPaths[nextRandom(random) % generated.watchedPaths.size()];
+			offsets.push_back(offset);
+			lengths.push_back(generated.paths.size() - offset);
+			continue;
+		}
+		
+		if (!generated.excludedPaths.empty() && (i % 4) == 0) {
+			generated.paths += generated.excludedPaths[nextRandom(random) % generated.excludedPaths.size()];
+		} else {
+			generated.paths += generated.watchedPaths[nextRandom(random) % generated.watchedPaths.size()];
+		}
+		for (size_t level = 1; level < benchmarkCase.pathDepth; ++level) {
+			generated.paths += "/directory-" + std::to_string(nextRandom(random) % 8);
+		}
+		generated.paths += "/file-" + std::to_string(nextRandom(random) % 1024);
+		offsets.push_back(offset);
+		lengths.push_back(generated.paths.size() - offset);
+	}
+	
+	generated.events.resize(eventCount);
+	for (size_t i = 0; i < eventCount; ++i) {
+		RawEvent &event = generated.events[i];
+		event.path			= (generated.paths.data() + offsets[i]);
+		event.pathLength	= lengths[i];
+		if ((i % 8) == 1) {
+			event.flags		= kEventFlagNone;
+		} else {
+			event.flags		= (kEventFlagItemIsFile | ((i % 2) == 0 ? kEventFlagItemModified : kEventFlagItemCreated));
+		}
+		event.identifier	= (EventIdentifier)(i + 1);
+		event.renameCookie	= 0;
+	}
+}
+
+static BenchmarkResult runCase(const BenchmarkCase &benchmarkCase, size_t eventCount, double minimumSeconds)
+{
+	BenchmarkEvents generated;
+	generateEvents(benchmarkCase, eventCount, generated);
+	
+	StreamConfiguration configuration;
+	configuration.watchedPaths						= generated.watchedPaths;
+	configuration.excludedPaths						= generated.excludedPaths;
+	configuration.ignoreEventsFromSubDirectories	= benchmarkCase.ignoreSubDirectories;
+	configuration.creationFlags						|= kStreamCreationFlagFileEvents;
+	configuration.deliveryThreadCount				= benchmarkCase.deliveryThreadCount;
+	
+	std::atomic<uint64_t> deliveredEvents(0);
+	SyntheticBackend *backend = new SyntheticBackend();
+	Stream stream(std::unique_ptr<Backend>(backend), configuration, [&deliveredEvents](Stream &stream, const EventBatch &events) {
+		(void)stream;
+		deliveredEvents.fetch_add(events.size(), std::memory_order_relaxed);
+	});
+	stream.create();
+	
+	const RawEvent *events = generated.events.data();
+	const size_t batchSize = std::max(benchmarkCase.batchSize, (size_t)1);
+	
+	// One pass grows the storage the stream reuses, so the measured passes
+	// only count the allocations made for every batch.
+	for (size_t offset = 0; offset < eventCount; offset += batchSize) {
+		backend->report(events + offset, std::min(batchSize, eventCount - offset));
+	}
+	stream.flushSynchronously();
+	
+	BenchmarkResult result;
+	memset(&result, 0, sizeof(result));
+	deliveredEvents.store(0);
+	const uint64_t minimumNanoseconds = (uint64_t)(minimumSeconds * 1e9);
+	const uint64_t allocations = sAllocationCount.load();
+	const uint64_t startTime = monotonicNanoseconds();
+	do {
+		for (size_t offset = 0; offset < eventCount; offset += batchSize) {
+			backend->report(events + offset, std::min(batchSize, eventCount - offset));
+		}
+		stream.flushSynchronously();
+		result.events += eventCount;
+		result.nanoseconds = (monotonicNanoseconds() - startTime);
+	} while (result.nanoseconds < minimumNanoseconds);
+	result.allocations = (sAllocationCount.load() - allocations);
+	result.deliveredEvents = deliveredEvents.load();
+	
+	stream.dispose();
+	
+	return result;
+}
+
+
+#pragma mark Output
+enum OutputFormat {
+	kOutputFormatText,
+	kOutputFormatCSV,
+	kOutputFormatJSON
+};
+
+static void printHeader(OutputFormat format)
+{
+	switch (format) {
+		case kOutputFormatText:
+			printf("%9s %5s %7s %8s %7s %7s %12s %14s %10s %12s\n",
+				   "batch", "depth", "watched", "excluded", "subdirs", "threads",
+				   "delivered", "events/s", "ns/event", "allocs/event");
+			break;
+		case kOutputFormatCSV:
+			printf("batchSize,pathDepth,watchedPaths,excludedPaths,ignoreSubDirectories,deliveryThreads,events,deliveredEvents,seconds,eventsPerSecond,nanosecondsPerEvent,allocationsPerEvent\n");
+			break;
+		case kOutputFormatJSON:
+			printf("{\n\t\"benchmark\": \"CDEventsBenchmark\",\n\t\"results\": [");
+			break;
+	}
+}
+
+static void printResult(OutputFormat format, const BenchmarkCase &benchmarkCase, const BenchmarkResult &result, bool first)
+{
+	const double seconds = ((double)result.nanoseconds / 1e9);
+	const double eventsPerSecond = ((double)result.events / seconds);
+	const double nanosecondsPerEvent = ((double)result.nanoseconds / (double)result.events);
+	const double allocationsPerEvent = ((double)result.allocations / (double)result.events);
+	
+	switch (format) {
+		case kOutputFormatText:
+			printf("%9zu %5zu %7zu %8zu %7s %7zu %11.1f%% %14.0f %10.1f %12.3f\n",
+				   benchmarkCase.batchSize,
+				   benchmarkCase.pathDepth,
+				   benchmarkCase.watchedPathCount,
+				   benchmarkCase.excludedPathCount,
+				   (benchmarkCase.ignoreSubDirectories ? "yes" : "no"),
+				   benchmarkCase.deliveryThreadCount,
+				   (100.0 * (double)result.deliveredEvents / (double)result.events),
+				   eventsPerSecond,
+				   nanosecondsPerEvent,
+				   allocationsPerEvent);
+			break;
+		case kOutputFormatCSV:
+			printf("%zu,%zu,%zu,%zu,%d,%zu,%llu,%llu,%.6f,%.1f,%.3f,%.6f\n",
+				   benchmarkCase.batchSize,
+				   benchmarkCase.pathDepth,
+				   benchmarkCase.watchedPathCount,
+				   benchmarkCase.excludedPathCount,
+				   (benchmarkCase.ignoreSubDirectories ? 1 : 0),
+				   benchmarkCase.deliveryThreadCount,
+				   (unsigned long long)result.events,
+				   (unsigned long long)result.deliveredEvents,
+				   seconds,
+				   eventsPerSecond,
+				   nanosecondsPerEvent,
+				   allocationsPerEvent);
+			break;
+		case kOutputFormatJSON:
+			printf("%s\n\t\t{ \"batchSize\": %zu, \"pathDepth\": %zu, \"watchedPaths\": %zu, \"excludedPaths\": %zu, \"ignoreSubDirectories\": %s, \"deliveryThreads\": %zu, "
+				   "\"events\": %llu, \"deliveredEvents\": %llu, \"seconds\": %.6f, \"eventsPerSecond\": %.1f, \"nanosecondsPerEvent\": %.3f, \"allocationsPerEvent\": %.6f }",
+				   (first ? "" : ","),
+				   benchmarkCase.batchSize,
+				   benchmarkCase.pathDepth,
+				   benchmarkCase.watchedPathCount,
+				   benchmarkCase.excludedPathCount,
+				   (benchmarkCase.ignoreSubDirectories ? "true" : "false"),
+				   benchmarkCase.deliveryThreadCount,
+				   (unsigned long long)result.events,
+				   (unsigned long long)result.deliveredEvents,
+				   seconds,
+				   eventsPerSecond,
+				   nanosecondsPerEvent,
+				   allocationsPerEvent);
+			break;
+	}
+	fflush(stdout);
+}
+
+static void printFooter(OutputFormat format)
+{
+	if (format == kOutputFormatJSON) {
+		printf("\n\t]\n}\n");
+	}
+}
+
+
+#pragma mark Main
+static void printUsage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-b batch-sizes] [-d path-depths] [-w watched-path-counts] [-x excluded-path-counts] [-s ignore-sub-directories] [-t delivery-thread-counts] [-n events] [-T seconds] [-o format]\n", name);
+}
+
+static bool parseList(const char *string, std::vector<size_t> &values)
+{
+	values.clear();
+	while (*string != '\0') {
+		char *end;
+		const unsigned long value = strtoul(string, &end, 10);
+		if (end == string || (*end != ',' && *end != '\0')) {
+			return false;
+		}
+		values.push_back((size_t)value);
+		string = (*end == ',' ? end + 1 : end);
+	}
+	
+	return !values.empty();
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<size_t> batchSizes				= { 1, 64, 1024 };
+	std::vector<size_t> pathDepths				= { 1, 8 };
+	std::vector<size_t> watchedPathCounts		= { 1, 64 };
+	std::vector<size_t> excludedPathCounts		= { 0, 64 };
+	std::vector<size_t> ignoreSubDirectories	= { 0, 1 };
+	std::vector<size_t> deliveryThreadCounts	= { 0 };
+	size_t eventCount = 65536;
+	double minimumSeconds = 0.2;
+	OutputFormat format = kOutputFormatText;
+	
+	int option;
+	bool valid = true;
+	while (valid && (option = getopt(argc, argv, "b:d:w:x:s:t:n:T:o:")) != -1) {
+		switch (option) {
+			case 'b':
+				valid = parseList(optarg, batchSizes);
+				break;
+			case 'd':
+				valid = parseList(optarg, pathDepths);
+				break;
+			case 'w':
+				valid = parseList(optarg, watchedPathCounts);
+				break;
+			case 'x':
+				valid = parseList(optarg, excludedPathCounts);
+				break;
+			case 's':
+				valid = parseList(optarg, ignoreSubDirectories);
+				break;
+			case 't':
+				valid = parseList(optarg, deliveryThreadCounts);
+				break;
+			case 'n':
+				eventCount = (size_t)strtoul(optarg, NULL, 10);
+				break;
+			case 'T':
+				minimumSeconds = atof(optarg);
+				break;
+			case 'o':
+				if (strcmp(optarg, "csv") == 0) {
+					format = kOutputFormatCSV;
+				} else if (strcmp(optarg, "json") == 0) {
+					format = kOutputFormatJSON;
+				} else if (strcmp(optarg, "text") != 0) {
+					valid = false;
+				}
+				break;
+			default:
+				valid = false;
+				break;
+		}
+	}
+	if (!valid || optind != argc || eventCount == 0) {
+		printUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	
+	printHeader(format);
+	bool first = true;
+	for (size_t b = 0; b < batchSizes.size(); ++b)
+	for (size_t d = 0; d < pathDepths.size(); ++d)
+	for (size_t w = 0; w < watchedPathCounts.size(); ++w)
+	for (size_t x = 0; x < excludedPathCounts.size(); ++x)
+	for (size_t s = 0; s < ignoreSubDirectories.size(); ++s)
+	for (size_t t = 0; t < deliveryThreadCounts.size(); ++t) {
+		BenchmarkCase benchmarkCase;
+		benchmarkCase.batchSize				= batchSizes[b];
+		benchmarkCase.pathDepth				= std::max(pathDepths[d], (size_t)1);
+		benchmarkCase.watchedPathCount		= std::max(watchedPathCounts[w], (size_t)1);
+		benchmarkCase.excludedPathCount		= excludedPathCounts[x];
+		benchmarkCase.ignoreSubDirectories	= (ignoreSubDirectories[s] != 0);
+		benchmarkCase.deliveryThreadCount	= deliveryThreadCounts[t];
+		
+		const BenchmarkResult result = runCase(benchmarkCase, eventCount, minimumSeconds);
+		printResult(format, benchmarkCase, result, first);
+		first = false;
+	}
+	printFooter(format);
+	
+	return EXIT_SUCCESS;
+}
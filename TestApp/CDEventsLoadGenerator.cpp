@@ -0,0 +1,587 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * Generates file system load at a target rate, while a watcher on the same
+ * tree measures how long the events take to be delivered and how many are
+ * lost.
+ *
+ * A tree of directories is created, then every thread creates, modifies,
+ * renames and deletes files of its own in it at its share of the rate. The
+ * time of each operation is noted before it is made, and the watcher
+ * records, for the first event delivered for the file afterwards, the time
+ * from the operation to the delivery. Operations never reported once the
+ * load stops, and events reporting that events were dropped, are counted as
+ * losses. Run it with the same load for different backends and settings to
+ * compare them.
+ *
+ * Usage: CDEventsLoadGenerator [-D directory] [-F fanout] [-H height] [-n files] [-t threads] [-r rate] [-d seconds] [-m weights] [-b backend] [-l latency] [-w threads] [-o overflow-policy] [-j]
+ *
+ *   -D  The directory to create the tree in (default a new temporary directory, removed afterwards).
+ *   -F  The number of sub-directories of each directory of the tree (default 4).
+ *   -H  The number of levels of directories of the tree (default 2).
+ *   -n  The number of files each thread works on (default 256).
+ *   -t  The number of threads generating load (default 4).
+ *   -r  The total number of operations per second (default 1000).
+ *   -d  How long to generate load for, in seconds (default 10).
+ *   -m  The weights of modifying, renaming and deleting an existing file (default 6,2,2).
+ *   -b  The backend to use on Linux, "inotify" (default) or "fanotify".
+ *   -l  The notification latency of the watcher in seconds (default 0.1).
+ *   -w  The number of delivery threads of the watcher (default 0).
+ *   -o  What the watcher does when its delivery threads fall behind, "block" (default), "drop-oldest" or "rescan".
+ *   -j  Print the report as JSON.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+	#include <CoreFoundation/CoreFoundation.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CDCoreMetrics.h"
+#include "CDCoreStream.h"
+#if defined(__linux__)
+	#include "CDCoreFanotifyBackend.h"
+#endif
+
+using namespace cdevents;
+
+
+#pragma mark Operations
+enum Operation {
+	kOperationCreate,
+	kOperationModify,
+	kOperationRename,
+	kOperationDelete,
+	
+	kOperationCount
+};
+
+/**
+ * The files of one generating thread, and the time of their oldest operation not yet reported.
+ */
+struct LoadThread {
+	size_t									index;
+	std::vector<std::string>				paths;
+	std::vector<bool>						exists;
+	std::vector<bool>						renamed;
+	std::unique_ptr<std::atomic<uint64_t>[]>	pendingSince;
+	uint64_t								operations[kOperationCount];
+	uint64_t								failures;
+};
+
+struct LoadOptions {
+	std::string	directory;
+	size_t		fanout;
+	size_t		height;
+	size_t		fileCount;
+	size_t		threadCount;
+	double		rate;
+	double		duration;
+	unsigned	weights[3];
+};
+
+static uint32_t nextRandom(uint32_t &state)
+{
+	state = state * 1664525u + 1013904223u;
+	return (state >> 8);
+}
+
+static bool performOperation(Operation operation, LoadThread &thread, size_t file)
+{
+	const std::string &path = thread.paths[file];
+	const std::string renamedPath = path + "~";
+	const std::string &currentPath = (thread.renamed[file] ? renamedPath : path);
+	
+	switch (operation) {
+		case kOperationCreate: {
+			const int descriptor = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (descriptor < 0) {
+				return false;
+			}
+			close(descriptor);
+			thread.exists[file] = true;
+			thread.renamed[file] = false;
+			return true;
+		}
+		case kOperationModify: {
+			const int descriptor = open(currentPath.c_str(), O_WRONLY | O_APPEND);
+			if (descriptor < 0) {
+				return false;
+			}
+			const bool written = (write(descriptor, "load\n", 5) == 5);
+			close(descriptor);
+			return written;
+		}
+		case kOperationRename: {
+			const std::string &newPath = (thread.renamed[file] ? path : renamedPath);
+			if (rename(currentPath.c_str(), newPath.c_str()) != 0) {
+				return false;
+			}
+			thread.renamed[file] = !thread.renamed[file];
+			return true;
+		}
+		case kOperationDelete:
+			if (unlink(currentPath.c_str()) != 0) {
+				return false;
+			}
+			thread.exists[file] = false;
+			return true;
+		default:
+			return false;
+	}
+}
+
+static void generateLoad(const LoadOptions &options, LoadThread &thread, uint64_t endTime)
+{
+	uint32_t random = (uint32_t)(0x4c6f6164 + thread.index);
+	const unsigned weightSum = (options.weights[0] + options.weights[1] + options.weights[2]);
+	const uint64_t interval = (uint64_t)(1e9 * (double)options.threadCount / options.rate);
+	
+	uint64_t dueTime = monotonicNanoseconds();
+	while (dueTime < endTime) {
+		const uint64_t now = monotonicNanoseconds();
+		if (now < dueTime) {
+			std::this_thread::sleep_for(std::chrono::nanoseconds(dueTime - now));
+		}
+		dueTime += interval;
+		
+		const size_t file = (nextRandom(random) % thread.paths.size());
+		Operation operation = kOperationCreate;
+		if (thread.exists[file]) {
+			const unsigned weight = (weightSum > 0 ? nextRandom(random) % weightSum : 0);
+			if (weight < options.weights[0]) {
+				operation = kOperationModify;
+			} else if (weight < options.weights[0] + options.weights[1]) {
+				operation = kOperationRename;
+			} else {
+				operation = kOperationDelete;
+			}
+		}
+		
+		// Noted before the operation, as its event may be delivered before it returns.
+		uint64_t expected = 0;
+		thread.pendingSince[file].compare_exchange_strong(expected, monotonicNanoseconds());
+		if (performOperation(operation, thread, file)) {
+			++thread.operations[operation];
+		} else {
+			++thread.failures;
+		}
+	}
+}
+
+
+#pragma mark Tree
+static bool createTree(const std::string &directory, size_t fanout, size_t height, std::vector<std::string> &leaves)
+{
+	if (height == 0) {
+		leaves.push_back(directory);
+		return true;
+	}
+	
+	for (size_t i = 0; i < fanout; ++i) {
+		const std::string child = directory + "/directory-" + std::to_string(i);
+		if (mkdir(child.c_str(), 0755) != 0 && errno != EEXIST) {
+			return false;
+		}
+		if (!createTree(child, fanout, height - 1, leaves)) {
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+static void removeTree(const std::string &path)
+{
+	DIR *directory = opendir(path.c_str());
+	if (directory != NULL) {
+		struct dirent *entry;
+		while ((entry = readdir(directory)) != NULL) {
+			if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+				continue;
+			}
+			
+			const std::string child = path + "/" + entry->d_name;
+			struct stat status;
+			if (lstat(child.c_str(), &status) == 0 && S_ISDIR(status.st_mode)) {
+				removeTree(child);
+			} else {
+				unlink(child.c_str());
+			}
+		}
+		closedir(directory);
+	}
+	rmdir(path.c_str());
+}
+
+
+#pragma mark Watcher
+/**
+ * What the watcher saw of the load.
+ */
+struct LoadObservations {
+	std::atomic<uint64_t>	receivedEvents;
+	std::atomic<uint64_t>	matchedEvents;
+	std::atomic<uint64_t>	droppedEventReports;
+	std::atomic<uint64_t>	rescanRequests;
+	LatencyHistogram		latency;
+	
+	LoadObservations() : receivedEvents(0), matchedEvents(0), droppedEventReports(0), rescanRequests(0) {}
+};
+
+static void observeEvents(const EventBatch &events, std::vector<LoadThread> &threads, LoadObservations &observations)
+{
+	const uint64_t now = monotonicNanoseconds();
+	observations.receivedEvents.fetch_add(events.size(), std::memory_order_relaxed);
+	
+	for (size_t i = 0; i < events.size(); ++i) {
+		const EventFlags flags = events[i].flags;
+		if (isUserDropped(flags) || isKernelDropped(flags)) {
+			observations.droppedEventReports.fetch_add(1, std::memory_order_relaxed);
+		}
+		if (mustRescanSubDirectories(flags)) {
+			observations.rescanRequests.fetch_add(1, std::memory_order_relaxed);
+		}
+		
+		// The files are named "t<thread>-<file>", with a "~" appended while renamed.
+		const char *name = strrchr(events.path(i), '/');
+		unsigned threadIndex;
+		unsigned file;
+		if (name == NULL || sscanf(name, "/t%u-%u", &threadIndex, &file) != 2 ||
+			threadIndex >= threads.size() || file >= threads[threadIndex].paths.size()) {
+			continue;
+		}
+		
+		observations.matchedEvents.fetch_add(1, std::memory_order_relaxed);
+		const uint64_t pendingSince = threads[threadIndex].pendingSince[file].exchange(0);
+		if (pendingSince != 0 && now > pendingSince) {
+			observations.latency.record(now - pendingSince);
+		}
+	}
+}
+
+static std::unique_ptr<Backend> createBackend(const char *name)
+{
+#if defined(__linux__)
+	if (name != NULL && strcmp(name, "fanotify") == 0) {
+		return std::unique_ptr<Backend>(new FanotifyBackend());
+	}
+#endif
+	if (name != NULL && strcmp(name, "inotify") != 0) {
+		return std::unique_ptr<Backend>();
+	}
+	return createDefaultBackend();
+}
+
+#if defined(__APPLE__)
+static void runMainRunLoop(double seconds)
+{
+	CFRunLoopRunInMode(kCFRunLoopDefaultMode, seconds, false);
+}
+#else
+static void runMainRunLoop(double seconds)
+{
+	std::this_thread::sleep_for(std::chrono::nanoseconds((uint64_t)(seconds * 1e9)));
+}
+#endif
+
+
+#pragma mark Report
+static void printReport(bool json, const LoadOptions &options, const char *backendName, const StreamConfiguration &configuration, size_t directoryCount, double seconds, const uint64_t operations[kOperationCount], uint64_t failures, const LoadObservations &observations, uint64_t unreported)
+{
+	uint64_t issued = 0;
+	for (size_t i = 0; i < kOperationCount; ++i) {
+		issued += operations[i];
+	}
+	static const char *const kOverflowPolicyNames[] = { "block", "drop-oldest", "rescan" };
+	LatencyHistogramSnapshot latency;
+	observations.latency.read(latency);
+	
+	if (json) {
+		printf("{\n"
+			   "\t\"watcher\": { \"backend\": \"%s\", \"latency\": %.3f, \"deliveryThreads\": %zu, \"overflowPolicy\": \"%s\" },\n"
+			   "\t\"load\": { \"threads\": %zu, \"rate\": %.1f, \"seconds\": %.3f, \"directories\": %zu, \"files\": %zu },\n"
+			   "\t\"operations\": { \"issued\": %llu, \"perSecond\": %.1f, \"created\": %llu, \"modified\": %llu, \"renamed\": %llu, \"deleted\": %llu, \"failed\": %llu },\n"
+			   "\t\"events\": { \"received\": %llu, \"matched\": %llu, \"droppedReports\": %llu, \"rescanRequests\": %llu, \"unreportedOperations\": %llu },\n"
+			   "\t\"latency\": { \"count\": %llu, \"mean\": %llu, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu }\n"
+			   "}\n",
+			   backendName, configuration.notificationLatency, configuration.deliveryThreadCount, kOverflowPolicyNames[configuration.overflowPolicy],
+			   options.threadCount, options.rate, seconds, directoryCount, options.fileCount * options.threadCount,
+			   (unsigned long long)issued, (double)issued / seconds,
+			   (unsigned long long)operations[kOperationCreate],
+			   (unsigned long long)operations[kOperationModify],
+			   (unsigned long long)operations[kOperationRename],
+			   (unsigned long long)operations[kOperationDelete],
+			   (unsigned long long)failures,
+			   (unsigned long long)observations.receivedEvents.load(),
+			   (unsigned long long)observations.matchedEvents.load(),
+			   (unsigned long long)observations.droppedEventReports.load(),
+			   (unsigned long long)observations.rescanRequests.load(),
+			   (unsigned long long)unreported,
+			   (unsigned long long)latency.count,
+			   (unsigned long long)latency.mean(),
+			   (unsigned long long)latency.percentile(0.5),
+			   (unsigned long long)latency.percentile(0.9),
+			   (unsigned long long)latency.percentile(0.99),
+			   (unsigned long long)latency.percentile(0.999),
+			   (unsigned long long)latency.maximum);
+		return;
+	}
+	
+	printf("Watcher: { backend = %s, latency = %.3f, delivery threads = %zu, overflow policy = %s }\n",
+		   backendName, configuration.notificationLatency, configuration.deliveryThreadCount, kOverflowPolicyNames[configuration.overflowPolicy]);
+	printf("Load: { threads = %zu, rate = %.1f/s, seconds = %.3f, directories = %zu, files = %zu }\n",
+		   options.threadCount, options.rate, seconds, directoryCount, options.fileCount * options.threadCount);
+	printf("Operations: { issued = %llu (%.1f/s), created = %llu, modified = %llu, renamed = %llu, deleted = %llu, failed = %llu }\n",
+		   (unsigned long long)issued, (double)issued / seconds,
+		   (unsigned long long)operations[kOperationCreate],
+		   (unsigned long long)operations[kOperationModify],
+		   (unsigned long long)operations[kOperationRename],
+		   (unsigned long long)operations[kOperationDelete],
+		   (unsigned long long)failures);
+	printf("Events: { received = %llu, matched = %llu, dropped reports = %llu, rescan requests = %llu, unreported operations = %llu }\n",
+		   (unsigned long long)observations.receivedEvents.load(),
+		   (unsigned long long)observations.matchedEvents.load(),
+		   (unsigned long long)observations.droppedEventReports.load(),
+		   (unsigned long long)observations.rescanRequests.load(),
+		   (unsigned long long)unreported);
+	printf("Latency: { count = %llu, mean = %lluns, p50 = %lluns, p90 = %lluns, p99 = %lluns, p99.9 = %lluns, max = %lluns }\n",
+		   (unsigned long long)latency.count,
+		   (unsigned long long)latency.mean(),
+		   (unsigned long long)latency.percentile(0.5),
+		   (unsigned long long)latency.percentile(0.9),
+		   (unsigned long long)latency.percentile(0.99),
+		   (unsigned long long)latency.percentile(0.999),
+		   (unsigned long long)latency.maximum);
+}
+
+
+#pragma mark Main
+static void printUsage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-D directory] [-F fanout] [-H height] [-n files] [-t threads] [-r rate] [-d seconds] [-m weights] [-b backend] [-l latency] [-w threads] [-o overflow-policy] [-j]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	LoadOptions options;
+	options.fanout		= 4;
+	options.height		= 2;
+	options.fileCount	= 256;
+	options.threadCount	= 4;
+	options.rate		= 1000.0;
+	options.duration	= 10.0;
+	options.weights[0]	= 6;
+	options.weights[1]	= 2;
+	options.weights[2]	= 2;
+	
+	StreamConfiguration configuration;
+	configuration.notificationLatency = 0.1;
+	configuration.creationFlags |= kStreamCreationFlagFileEvents;
+	const char *backendName = NULL;
+	bool json = false;
+	
+	int option;
+	while ((option = getopt(argc, argv, "D:F:H:n:t:r:d:m:b:l:w:o:j")) != -1) {
+		switch (option) {
+			case 'D':
+				options.directory = optarg;
+				break;
+			case 'F':
+				options.fanout = (size_t)atoi(optarg);
+				break;
+			case 'H':
+				options.height = (size_t)atoi(optarg);
+				break;
+			case 'n':
+				options.fileCount = (size_t)atoi(optarg);
+				break;
+			case 't':
+				options.threadCount = (size_t)atoi(optarg);
+				break;
+			case 'r':
+				options.rate = atof(optarg);
+				break;
+			case 'd':
+				options.duration = atof(optarg);
+				break;
+			case 'm':
+				if (sscanf(optarg, "%u,%u,%u", &options.weights[0], &options.weights[1], &options.weights[2]) != 3) {
+					printUsage(argv[0]);
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'b':
+				backendName = optarg;
+				break;
+			case 'l':
+				configuration.notificationLatency = atof(optarg);
+				break;
+			case 'w':
+				configuration.deliveryThreadCount = (size_t)atoi(optarg);
+				break;
+			case 'o':
+				if (strcmp(optarg, "drop-oldest") == 0) {
+					configuration.overflowPolicy = kOverflowPolicyDropOldest;
+				} else if (strcmp(optarg, "rescan") == 0) {
+					configuration.overflowPolicy = kOverflowPolicyRescan;
+				} else if (strcmp(optarg, "block") != 0) {
+					fprintf(stderr, "Unknown overflow policy \"%s\".\n", optarg);
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'j':
+				json = true;
+				break;
+			default:
+				printUsage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+	if (optind != argc || options.fanout == 0 || options.fileCount == 0 || options.threadCount == 0 || options.rate <= 0.0) {
+		printUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	
+	std::unique_ptr<Backend> backend = createBackend(backendName);
+	if (!backend) {
+		fprintf(stderr, "Unknown backend \"%s\".\n", (backendName != NULL ? backendName : ""));
+		return EXIT_FAILURE;
+	}
+	
+	// A temporary tree is removed afterwards, a given one is left as it is.
+	const bool temporary = options.directory.empty();
+	if (temporary) {
+		char directory[] = "/tmp/cdevents-load.XXXXXX";
+		if (mkdtemp(directory) == NULL) {
+			fprintf(stderr, "Failed to create a temporary directory.\n");
+			return EXIT_FAILURE;
+		}
+		options.directory = directory;
+	}
+	char resolvedDirectory[PATH_MAX];
+	if (realpath(options.directory.c_str(), resolvedDirectory) == NULL) {
+		fprintf(stderr, "The directory \"%s\" does not exist.\n", options.directory.c_str());
+		return EXIT_FAILURE;
+	}
+	options.directory = resolvedDirectory;
+	
+	std::vector<std::string> leaves;
+	if (!createTree(options.directory, options.fanout, options.height, leaves)) {
+		fprintf(stderr, "Failed to create the tree in \"%s\".\n", options.directory.c_str());
+		return EXIT_FAILURE;
+	}
+	
+	std::vector<LoadThread> threads(options.threadCount);
+	for (size_t i = 0; i < threads.size(); ++i) {
+		LoadThread &thread = threads[i];
+		thread.index = i;
+		thread.exists.assign(options.fileCount, false);
+		thread.renamed.assign(options.fileCount, false);
+		thread.pendingSince.reset(new std::atomic<uint64_t>[options.fileCount]);
+		for (size_t file = 0; file < options.fileCount; ++file) {
+			thread.paths.push_back(leaves[(i + file * threads.size()) % leaves.size()] + "/t" + std::to_string(i) + "-" + std::to_string(file));
+			thread.pendingSince[file].store(0);
+		}
+		memset(thread.operations, 0, sizeof(thread.operations));
+		thread.failures = 0;
+	}
+	
+	LoadObservations observations;
+	configuration.watchedPaths.push_back(options.directory);
+	Stream stream(std::move(backend), configuration, [&threads, &observations](Stream &stream, const EventBatch &events) {
+		(void)stream;
+		observeEvents(events, threads, observations);
+	});
+	try {
+		stream.create();
+	} catch (const StreamCreationFailure &failure) {
+		fprintf(stderr, "%s\n", failure.what());
+		if (temporary) {
+			removeTree(options.directory);
+		}
+		return EXIT_FAILURE;
+	}
+	if (!json) {
+		printf("%s\n------\n", stream.description().c_str());
+		fflush(stdout);
+	}
+	
+	const uint64_t startTime = monotonicNanoseconds();
+	const uint64_t endTime = startTime + (uint64_t)(options.duration * 1e9);
+	std::vector<std::thread> generators;
+	for (size_t i = 0; i < threads.size(); ++i) {
+		generators.push_back(std::thread(generateLoad, std::cref(options), std::ref(threads[i]), endTime));
+	}
+	for (size_t i = 0; i < generators.size(); ++i) {
+		generators[i].join();
+	}
+	const double seconds = ((double)(monotonicNanoseconds() - startTime) / 1e9);
+	
+	// Give the watcher a few latencies to catch up before counting what it missed.
+	runMainRunLoop(3.0 * configuration.notificationLatency + 0.5);
+	stream.flushSynchronously();
+	stream.dispose();
+	
+	uint64_t operations[kOperationCount] = { 0 };
+	uint64_t failures = 0;
+	uint64_t unreported = 0;
+	for (size_t i = 0; i < threads.size(); ++i) {
+		for (size_t j = 0; j < kOperationCount; ++j) {
+			operations[j] += threads[i].operations[j];
+		}
+		failures += threads[i].failures;
+		for (size_t file = 0; file < options.fileCount; ++file) {
+			unreported += (threads[i].pendingSince[file].load() != 0 ? 1 : 0);
+		}
+	}
+	printReport(json, options, (backendName != NULL ? backendName : "default"), configuration, leaves.size(), seconds, operations, failures, observations, unreported);
+	
+	if (temporary) {
+		removeTree(options.directory);
+	}
+	
+	return EXIT_SUCCESS;
+}
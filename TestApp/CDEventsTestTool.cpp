@@ -0,0 +1,435 @@
+/**
+ * CDEvents
+ *
+ * Copyright (c) 2010-2013 Aron Cedercrantz
+ * http://github.com/rastersize/CDEvents/
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without
+ * restriction, including without limitation the rights to use,
+ * copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following
+ * conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ * HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * A command line counterpart of the test app which watches the given paths
+ * with the CDEvents core and prints every event it receives.
+ *
+ * Usage: CDEventsTestTool [-l latency] [-L minimum-latency] [-x excluded-path]... [-p path-pattern]... [-g] [-s] [-f] [-n] [-i] [-V size-limit] [-b backend] [-w threads] [-o overflow-policy] [-m] [-c window] [-k checkpoint-file] [-S snapshot-file] [-r] [-M] [-R log-file | -P log-file [-X speed]] path...
+ *
+ *   -l  The notification latency in seconds (default 3.0).
+ *   -L  Adapt the latency to the load, between this many seconds and the notification latency.
+ *   -x  A path to exclude, may be given more than once.
+ *   -p  A glob, or "re:" regular expression, of paths to exclude, may be given more than once.
+ *   -g  Ignore the paths ignored by the .gitignore and .ignore files in the watched paths.
+ *   -s  Ignore events from sub-directories of the watched paths.
+ *   -f  Request file-level events.
+ *   -n  Pair the two halves of a rename into one event, requires -f.
+ *   -i  Give events the file identities of their items and recognize moves and atomic saves by them, requires -f.
+ *   -V  Drop modifications which left the contents of files of at most this many bytes unchanged, requires -f.
+ *   -b  The backend to use on Linux, "inotify" (default) or "fanotify".
+ *   -w  The number of delivery threads (default 0, deliver on the backend thread).
+ *   -o  What to do when the delivery threads fall behind, "block" (default), "drop-oldest" or "rescan".
+ *   -m  Watch every path with its own subscriber of one shared stream.
+ *   -c  Merge the events for a path within this many seconds into one.
+ *   -k  Record the last delivered event in the given file and resume from it.
+ *   -S  Answer rescans from a snapshot of the watched paths, kept in the given file.
+ *   -r  Rescan the watched paths once the stream is created.
+ *   -M  Measure the stream and print its counters and latencies when stopped.
+ *   -R  Record the batches the stream receives to the given event log.
+ *   -P  Play back the given event log instead of watching the paths, then exit.
+ *   -X  The speed to play back at, relative to the recorded pace (default 1.0, 0 for as fast as possible).
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <thread>
+
+#if defined(__APPLE__)
+	#include <CoreFoundation/CoreFoundation.h>
+#endif
+
+#include "CDCoreCheckpointStore.h"
+#include "CDCoreContentVerifier.h"
+#include "CDCoreDirectorySnapshot.h"
+#include "CDCoreEventLog.h"
+#include "CDCoreFileIdentityTracker.h"
+#include "CDCoreMetrics.h"
+#include "CDCorePathMatcher.h"
+#include "CDCorePlaybackBackend.h"
+#include "CDCoreStream.h"
+#include "CDCoreStreamMultiplexer.h"
+#if defined(__linux__)
+	#include "CDCoreFanotifyBackend.h"
+#endif
+
+using namespace cdevents;
+
+
+static volatile sig_atomic_t sShouldStop = 0;
+
+static void handleSignal(int signal)
+{
+	(void)signal;
+	sShouldStop = 1;
+#if defined(__APPLE__)
+	CFRunLoopStop(CFRunLoopGetMain());
+#endif
+}
+
+static void printUsage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-l latency] [-L minimum-latency] [-x excluded-path]... [-p path-pattern]... [-g] [-s] [-f] [-n] [-i] [-V size-limit] [-b backend] [-w threads] [-o overflow-policy] [-m] [-c window] [-k checkpoint-file] [-S snapshot-file] [-r] [-M] [-R log-file | -P log-file [-X speed]] path...\n", name);
+}
+
+static std::unique_ptr<Backend> createBackend(const char *name)
+{
+#if defined(__linux__)
+	if (name != NULL && strcmp(name, "fanotify") == 0) {
+		return std::unique_ptr<Backend>(new FanotifyBackend());
+	}
+#endif
+	if (name != NULL && strcmp(name, "inotify") != 0) {
+		return std::unique_ptr<Backend>();
+	}
+	return createDefaultBackend();
+}
+
+static void printEvents(const char *prefix, const EventBatch &events)
+{
+	for (size_t i = 0; i < events.size(); ++i) {
+		const EventRecord &event = events[i];
+		printf("[%s] Event: { identifier = %llu, path = %s",
+			   prefix,
+			   (unsigned long long)event.identifier,
+			   events.path(i));
+		if (const char *sourcePath = events.sourcePath(i)) {
+			printf(", source path = %s", sourcePath);
+		}
+		if (event.fileIdentity.isKnown()) {
+			printf(", file = %llu:%llu",
+				   (unsigned long long)event.fileIdentity.device,
+				   (unsigned long long)event.fileIdentity.inode);
+		}
+		if (event.contentHash != 0) {
+			printf(", content hash = %016llx", (unsigned long long)event.contentHash);
+		}
+		printf(", flags = 0x%08x, timestamp = %.6f }\n",
+			   (unsigned int)event.flags,
+			   event.timestamp);
+	}
+	fflush(stdout);
+}
+
+static void printMetrics(const StreamMetrics &metrics)
+{
+	static const char *const kStageNames[kMetricsStageCount] = {
+		"queue wait", "filtering", "handler", "object construction", "client"
+	};
+	
+	StreamMetricsSnapshot snapshot;
+	metrics.read(snapshot);
+	printf("Events: { received = %llu, excluded = %llu, in sub-directories = %llu, delivered = %llu in %llu batches, dropped reports = %llu, rescan requests = %llu }\n",
+		   (unsigned long long)snapshot.counters[kMetricsCounterEventsReceived],
+		   (unsigned long long)snapshot.counters[kMetricsCounterEventsExcluded],
+		   (unsigned long long)snapshot.counters[kMetricsCounterEventsInSubDirectories],
+		   (unsigned long long)snapshot.counters[kMetricsCounterEventsDelivered],
+		   (unsigned long long)snapshot.counters[kMetricsCounterBatchesDelivered],
+		   (unsigned long long)snapshot.counters[kMetricsCounterDroppedEventReports],
+		   (unsigned long long)snapshot.counters[kMetricsCounterRescanRequests]);
+	for (size_t i = 0; i < kMetricsStageCount; ++i) {
+		const LatencyHistogramSnapshot &stage = snapshot.stages[i];
+		if (stage.count == 0) {
+			continue;
+		}
+		printf("Latency of %s: { count = %llu, mean = %lluns, p50 = %lluns, p90 = %lluns, p99 = %lluns, max = %lluns }\n",
+			   kStageNames[i],
+			   (unsigned long long)stage.count,
+			   (unsigned long long)stage.mean(),
+			   (unsigned long long)stage.percentile(0.5),
+			   (unsigned long long)stage.percentile(0.9),
+			   (unsigned long long)stage.percentile(0.99),
+			   (unsigned long long)stage.maximum);
+	}
+}
+
+static void waitForSignal()
+{
+	signal(SIGINT, handleSignal);
+	signal(SIGTERM, handleSignal);
+	
+#if defined(__APPLE__)
+	CFRunLoopRun();
+#else
+	while (!sShouldStop) {
+		pause();
+	}
+#endif
+}
+
+static int runMultiplexer(const char *backendName, const StreamConfiguration &configuration)
+{
+	StreamMultiplexer multiplexer([backendName]() {
+		return createBackend(backendName);
+	}, configuration);
+	
+	std::vector<StreamMultiplexer::Subscriber> subscribers;
+	try {
+		for (size_t i = 0; i < configuration.watchedPaths.size(); ++i) {
+			const std::string path = configuration.watchedPaths[i];
+			subscribers.push_back(multiplexer.addSubscriber(std::vector<std::string>(1, path),
+															configuration.excludedPaths,
+															configuration.ignoreEventsFromSubDirectories,
+															[path](const EventBatch &events) {
+				printEvents(path.c_str(), events);
+			}));
+			multiplexer.setPathPatterns(subscribers.back(), configuration.pathPatterns);
+		}
+	} catch (const StreamCreationFailure &failure) {
+		fprintf(stderr, "%s\n", failure.what());
+		return EXIT_FAILURE;
+	}
+	
+	printf("%s\n------\n", multiplexer.description().c_str());
+	fflush(stdout);
+	
+	waitForSignal();
+	
+	for (size_t i = 0; i < subscribers.size(); ++i) {
+		multiplexer.removeSubscriber(subscribers[i]);
+	}
+	if (configuration.metrics) {
+		printMetrics(*configuration.metrics);
+	}
+	
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+	StreamConfiguration configuration;
+	const char *backendName = NULL;
+	bool multiplex = false;
+	const char *snapshotFile = NULL;
+	bool rescan = false;
+	const char *playbackFile = NULL;
+	double playbackSpeed = 1.0;
+	
+	int option;
+	while ((option = getopt(argc, argv, "l:L:x:p:gsfniV:b:w:o:mc:k:S:rMR:P:X:")) != -1) {
+		switch (option) {
+			case 'l':
+				configuration.notificationLatency = atof(optarg);
+				break;
+			case 'L':
+				configuration.minimumNotificationLatency = atof(optarg);
+				break;
+			case 'x':
+				configuration.excludedPaths.push_back(optarg);
+				break;
+			case 'p':
+				configuration.pathPatterns.push_back(optarg);
+				break;
+			case 'g':
+				configuration.honorsIgnoreFiles = true;
+				break;
+			case 's':
+				configuration.ignoreEventsFromSubDirectories = true;
+				break;
+			case 'f':
+				configuration.creationFlags |= kStreamCreationFlagFileEvents;
+				break;
+			case 'n':
+				configuration.pairsRenames = true;
+				break;
+			case 'i':
+				configuration.identityTracker = std::make_shared<FileIdentityTracker>();
+				break;
+			case 'V':
+				configuration.contentVerifier = std::make_shared<ContentVerifier>(strtoull(optarg, NULL, 10),
+																				  std::max(std::thread::hardware_concurrency(), 1u));
+				break;
+			case 'b':
+				backendName = optarg;
+				break;
+			case 'w':
+				configuration.deliveryThreadCount = (size_t)atoi(optarg);
+				break;
+			case 'o':
+				if (strcmp(optarg, "drop-oldest") == 0) {
+					configuration.overflowPolicy = kOverflowPolicyDropOldest;
+				} else if (strcmp(optarg, "rescan") == 0) {
+					configuration.overflowPolicy = kOverflowPolicyRescan;
+				} else if (strcmp(optarg, "block") != 0) {
+					fprintf(stderr, "Unknown overflow policy \"%s\".\n", optarg);
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'm':
+				multiplex = true;
+				break;
+			case 'c':
+				configuration.coalescingWindow = atof(optarg);
+				break;
+			case 'k':
+				configuration.checkpointStore = std::make_shared<CheckpointStore>(optarg);
+				configuration.checkpointKey = "CDEventsTestTool";
+				break;
+			case 'S':
+				snapshotFile = optarg;
+				configuration.snapshot = std::make_shared<DirectorySnapshot>();
+				configuration.snapshot->load(snapshotFile);
+				break;
+			case 'r':
+				rescan = true;
+				break;
+			case 'M':
+				configuration.metrics = std::make_shared<StreamMetrics>();
+				break;
+			case 'R':
+				configuration.recorder = std::make_shared<EventRecorder>();
+				if (!configuration.recorder->open(optarg)) {
+					fprintf(stderr, "Failed to open the event log \"%s\".\n", optarg);
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'P':
+				playbackFile = optarg;
+				break;
+			case 'X':
+				playbackSpeed = atof(optarg);
+				break;
+			default:
+				printUsage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+	for (int i = optind; i < argc; ++i) {
+		configuration.watchedPaths.push_back(argv[i]);
+	}
+	if (configuration.watchedPaths.empty()) {
+		printUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	try {
+		PathMatcher matcher(configuration.pathPatterns);
+	} catch (const PathPatternError &error) {
+		fprintf(stderr, "%s\n", error.what());
+		return EXIT_FAILURE;
+	}
+	
+	if (playbackFile != NULL && (multiplex || configuration.recorder)) {
+		printUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	
+	// The playback backend is owned by the stream, but waited on here.
+	PlaybackBackend *playback = (playbackFile != NULL ? new PlaybackBackend(playbackFile, playbackSpeed) : NULL);
+	std::unique_ptr<Backend> backend = (playback != NULL ? std::unique_ptr<Backend>(playback) : createBackend(backendName));
+	if (!backend && backendName != NULL) {
+		fprintf(stderr, "Unknown backend \"%s\".\n", backendName);
+		return EXIT_FAILURE;
+	}
+	if (!backend) {
+		fprintf(stderr, "No event backend is available on this platform.\n");
+		return EXIT_FAILURE;
+	}
+	
+	if (multiplex) {
+		return runMultiplexer(backendName, configuration);
+	}
+	
+	Stream stream(std::move(backend), configuration, [](Stream &stream, const EventBatch &events) {
+		printEvents("Core", events);
+		if (stream.configuration().minimumNotificationLatency > 0.0) {
+			printf("Notification latency: %.3f\n", stream.notificationLatency());
+		}
+	});
+	
+	try {
+		stream.create();
+	} catch (const StreamCreationFailure &failure) {
+		fprintf(stderr, "%s\n", failure.what());
+		return EXIT_FAILURE;
+	}
+	
+	if (stream.resumedWithoutHistory()) {
+		printf("The checkpoint could not be resumed from, rescan the watched paths.\n");
+	}
+	printf("%s\n------\n", stream.description().c_str());
+	fflush(stdout);
+	
+	if (rescan) {
+		stream.rescan([](const EventBatch &events, bool finished) {
+			printEvents("Rescan", events);
+			if (finished) {
+				printf("Rescan finished.\n");
+				fflush(stdout);
+			}
+		});
+	}
+	
+	if (playback != NULL) {
+		playback->waitUntilFinished();
+		stream.flushSynchronously();
+		printf("Played back %llu batches.\n", (unsigned long long)playback->batchCount());
+	} else {
+		waitForSignal();
+	}
+	
+	stream.dispose();
+	const std::vector<std::string> ignoreFileErrors = stream.ignoreFileErrors();
+	for (size_t i = 0; i < ignoreFileErrors.size(); ++i) {
+		fprintf(stderr, "%s\n", ignoreFileErrors[i].c_str());
+	}
+	if (configuration.deliveryThreadCount > 0) {
+		const DeliveryQueueStatistics statistics = stream.deliveryQueueStatistics();
+		printf("Delivery queue: { maximumDepth = %zu, queued = %llu, blocked = %llu, dropped = %llu (%llu events), rescans = %llu }\n",
+			   statistics.maximumDepth,
+			   (unsigned long long)statistics.queuedBatches,
+			   (unsigned long long)statistics.blockedBatches,
+			   (unsigned long long)statistics.droppedBatches,
+			   (unsigned long long)statistics.droppedEvents,
+			   (unsigned long long)statistics.rescans);
+	}
+	if (configuration.metrics) {
+		printMetrics(*configuration.metrics);
+	}
+	if (configuration.contentVerifier) {
+		const ContentVerificationStatistics statistics = configuration.contentVerifier->statistics();
+		printf("Content verification: { filesHashed = %llu, bytesHashed = %llu, eventsSuppressed = %llu }\n",
+			   (unsigned long long)statistics.filesHashed,
+			   (unsigned long long)statistics.bytesHashed,
+			   (unsigned long long)statistics.eventsSuppressed);
+	}
+	if (configuration.recorder) {
+		printf("Recorded %llu batches.\n", (unsigned long long)configuration.recorder->batchCount());
+		if (!configuration.recorder->close()) {
+			fprintf(stderr, "Failed to write the event log.\n");
+		}
+	}
+	if (snapshotFile != NULL && !configuration.snapshot->save(snapshotFile)) {
+		fprintf(stderr, "Failed to write the snapshot to \"%s\".\n", snapshotFile);
+	}
+	
+	return EXIT_SUCCESS;
+}